@@ -441,6 +441,14 @@ gboolean g_attrib_set_mtu(GAttrib *attrib, int mtu)
 	return bt_att_set_mtu(attrib->att, mtu);
 }
 
+struct bt_gatt_client *g_attrib_get_client(GAttrib *attrib)
+{
+	if (!attrib)
+		return NULL;
+
+	return attrib->client;
+}
+
 gboolean g_attrib_attach_client(GAttrib *attrib, struct bt_gatt_client *client)
 {
 	if (!attrib || !client)
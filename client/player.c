@@ -27,6 +27,8 @@
 #include <wordexp.h>
 #include <sys/timerfd.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
 
 #include <glib.h>
 
@@ -65,7 +67,6 @@
 #define NSEC_USEC(_t) (_t / 1000L)
 #define SEC_USEC(_t)  (_t  * 1000000L)
 #define TS_USEC(_ts)  (SEC_USEC((_ts)->tv_sec) + NSEC_USEC((_ts)->tv_nsec))
-#define ROUND_CLOSEST(_x, _y) (((_x) + (_y / 2)) / (_y))
 
 #define EP_SRC_LOCATIONS 0x00000003
 #define EP_SNK_LOCATIONS 0x00000003
@@ -144,17 +145,31 @@ static uint8_t bcast_code[] = BCAST_CODE;
 static bool auto_acquire = false;
 static bool auto_select = false;
 
+struct transport_stats {
+	uint64_t bytes;
+	uint32_t early;
+	uint32_t late;
+	int64_t last;
+	int64_t lateness_sum;
+	int64_t lateness_max;
+};
+
 struct transport {
 	GDBusProxy *proxy;
 	int sk;
 	uint16_t mtu[2];
 	char *filename;
 	int fd;
-	struct stat stat;
 	struct io *io;
 	uint32_t seq;
 	struct io *timer_io;
-	int num;
+	uint8_t *map;
+	size_t map_len;
+	size_t offset;
+	uint8_t *buf;
+	struct timespec start;
+	uint32_t interval;
+	struct transport_stats stats;
 };
 
 struct transport_select_args {
@@ -4952,6 +4967,11 @@ static void transport_free(void *data)
 
 	io_destroy(transport->timer_io);
 	io_destroy(transport->io);
+
+	if (transport->map)
+		munmap(transport->map, transport->map_len);
+
+	free(transport->buf);
 	free(transport);
 }
 
@@ -5736,97 +5756,202 @@ static int open_file(const char *filename, int flags)
 	return fd;
 }
 
-static int elapsed_time(bool reset, int *secs, int *nsecs)
+/* Maximum number of SDUs passed to a single sendmmsg() */
+#define SEND_BATCH_MAX	16
+
+static void transport_send_unmap(struct transport *transport)
+{
+	if (transport->map) {
+		munmap(transport->map, transport->map_len);
+		transport->map = NULL;
+		transport->map_len = 0;
+	}
+
+	free(transport->buf);
+	transport->buf = NULL;
+}
+
+static int transport_send_map(struct transport *transport, int fd)
+{
+	struct stat st;
+
+	transport_send_unmap(transport);
+
+	transport->seq = 0;
+	transport->offset = 0;
+	memset(&transport->stats, 0, sizeof(transport->stats));
+
+	/* Send regular files straight from the page cache */
+	if (!fstat(fd, &st) && S_ISREG(st.st_mode) && st.st_size > 0) {
+		void *map;
+
+		map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (map != MAP_FAILED) {
+			madvise(map, st.st_size, MADV_SEQUENTIAL);
+			transport->map = map;
+			transport->map_len = st.st_size;
+			return 0;
+		}
+	}
+
+	/* Fallback to read() for anything that cannot be mapped */
+	transport->buf = malloc(transport->mtu[1] * SEND_BATCH_MAX);
+	if (!transport->buf)
+		return -ENOMEM;
+
+	return 0;
+}
+
+static ssize_t transport_next_sdu(struct transport *transport, int fd,
+					unsigned int slot, struct iovec *iov)
 {
-	static struct timespec start;
-	struct timespec curr;
+	ssize_t len;
 
-	if (reset) {
-		if (clock_gettime(CLOCK_MONOTONIC, &start) < 0) {
-			bt_shell_printf("clock_gettime: %s (%d)",
+	if (transport->map) {
+		len = MIN(transport->mtu[1],
+				transport->map_len - transport->offset);
+		iov->iov_base = transport->map + transport->offset;
+	} else {
+		iov->iov_base = transport->buf + slot * transport->mtu[1];
+		len = read(fd, iov->iov_base, transport->mtu[1]);
+		if (len < 0) {
+			bt_shell_printf("read failed: %s (%d)",
 						strerror(errno), errno);
 			return -errno;
 		}
 	}
 
-	if (clock_gettime(CLOCK_MONOTONIC, &curr) < 0) {
-		bt_shell_printf("clock_gettime: %s (%d)", strerror(errno),
-						errno);
+	iov->iov_len = len;
+	transport->offset += len;
+
+	return len;
+}
+
+/* Send up to num SDUs with a single sendmmsg(), returns the number sent or 0
+ * at the end of the input.
+ */
+static int transport_send_batch(struct transport *transport, int fd,
+							unsigned int num)
+{
+	struct mmsghdr msgs[SEND_BATCH_MAX];
+	struct iovec iov[SEND_BATCH_MAX];
+	unsigned int i;
+	int ret;
+
+	num = MIN(num, SEND_BATCH_MAX);
+
+	memset(msgs, 0, sizeof(msgs));
+
+	for (i = 0; i < num; i++) {
+		ssize_t len;
+
+		len = transport_next_sdu(transport, fd, i, &iov[i]);
+		if (len < 0)
+			return len;
+
+		if (!len)
+			break;
+
+		msgs[i].msg_hdr.msg_iov = &iov[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	if (!i)
+		return 0;
+
+	ret = sendmmsg(transport->sk, msgs, i, 0);
+	if (ret <= 0) {
+		bt_shell_printf("send failed: %s (%d)", strerror(errno),
+								errno);
 		return -errno;
 	}
 
-	*secs = curr.tv_sec - start.tv_sec;
-	*nsecs = curr.tv_nsec - start.tv_nsec;
-	if (*nsecs < 0) {
-		(*secs)--;
-		*nsecs += 1000000000;
+	/* Rewind whatever has not been sent so it is retried */
+	for (num = ret; num < i; num++) {
+		if (transport->map)
+			transport->offset -= iov[num].iov_len;
+		else
+			bt_shell_printf("SDU %u dropped\n",
+						transport->seq + num);
 	}
 
-	return 0;
+	for (num = 0; num < (unsigned int) ret; num++)
+		transport->stats.bytes += iov[num].iov_len;
+
+	return ret;
 }
 
-static int transport_send_seq(struct transport *transport, int fd, uint32_t num)
+static void transport_send_stats(struct transport *transport)
 {
-	uint8_t *buf;
-	uint32_t i;
+	struct transport_stats *stats = &transport->stats;
+	const char *path = g_dbus_proxy_get_path(transport->proxy);
 
-	if (!num)
-		return 0;
+	if (!transport->interval) {
+		bt_shell_printf("[%s] sent %u SDUs, %" PRIu64 " bytes\n",
+				path, transport->seq, stats->bytes);
+		return;
+	}
 
-	buf = malloc(transport->mtu[1]);
-	if (!buf)
-		return -ENOMEM;
+	bt_shell_printf("[%s] sent %u SDUs, %" PRIu64 " bytes, "
+			"interval %u us\n", path, transport->seq,
+			stats->bytes, transport->interval);
+	bt_shell_printf("[%s] early %u late %u lateness avg %" PRId64
+			" us max %" PRId64 " us\n", path, stats->early,
+			stats->late, transport->seq ?
+			stats->lateness_sum / transport->seq : 0,
+			stats->lateness_max);
+}
 
-	for (i = 0; i < num; i++, transport->seq++) {
-		ssize_t ret;
-		int secs = 0, nsecs = 0;
-		off_t offset;
+/* Send all SDUs whose slot, start + seq * interval, has been reached */
+static int transport_send_due(struct transport *transport)
+{
+	struct timespec now;
+	int64_t elapsed;
+	uint32_t due;
 
-		ret = read(fd, buf, transport->mtu[1]);
-		if (ret <= 0) {
-			if (ret < 0)
-				bt_shell_printf("read failed: %s (%d)",
-						strerror(errno), errno);
-			free(buf);
-			return ret;
-		}
+	if (clock_gettime(CLOCK_MONOTONIC, &now) < 0)
+		return -errno;
 
-		ret = send(transport->sk, buf, ret, 0);
-		if (ret <= 0) {
-			bt_shell_printf("send failed: %s (%d)",
-							strerror(errno), errno);
-			free(buf);
-			return -errno;
-		}
+	elapsed = TS_USEC(&now) - TS_USEC(&transport->start);
+	due = elapsed < 0 ? 0 : elapsed / transport->interval + 1;
 
-		elapsed_time(!transport->seq, &secs, &nsecs);
+	while (transport->seq < due) {
+		int ret, i;
 
-		if (!transport->seq && fstat(fd, &transport->stat) < 0) {
-			bt_shell_printf("fstat failed: %s (%d)",
-							strerror(errno), errno);
-			free(buf);
-			return -errno;
-		}
+		ret = transport_send_batch(transport, transport->fd,
+						due - transport->seq);
+		if (ret <= 0)
+			return ret;
 
-		offset = lseek(fd, 0, SEEK_CUR);
+		for (i = 0; i < ret; i++, transport->seq++) {
+			struct transport_stats *stats = &transport->stats;
+			int64_t lateness = elapsed - (int64_t) transport->seq *
+							transport->interval;
 
-		bt_shell_echo("[seq %d %d.%03ds] send: %lld/%lld bytes",
-				transport->seq, secs,
-				(nsecs + 500000) / 1000000,
-				(long long)offset,
-				(long long)transport->stat.st_size);
-	}
+			/* Late: more than half an interval after its slot.
+			 * Early: less than half an interval after the
+			 * previous SDU, i.e. bunched up with it.
+			 */
+			if (lateness > transport->interval / 2)
+				stats->late++;
+
+			if (transport->seq && elapsed - stats->last <
+						transport->interval / 2)
+				stats->early++;
 
-	free(buf);
+			stats->last = elapsed;
+			stats->lateness_sum += lateness;
+			if (lateness > stats->lateness_max)
+				stats->lateness_max = lateness;
+		}
+	}
 
-	return i;
+	return 1;
 }
 
 static bool transport_timer_read(struct io *io, void *user_data)
 {
 	struct transport *transport = user_data;
-	struct bt_iso_qos qos;
-	socklen_t len;
 	int ret, fd;
 	uint64_t exp;
 
@@ -5846,24 +5971,14 @@ static bool transport_timer_read(struct io *io, void *user_data)
 		return false;
 	}
 
-	/* Read QoS if available */
-	memset(&qos, 0, sizeof(qos));
-	len = sizeof(qos);
-	if (getsockopt(transport->sk, SOL_BLUETOOTH, BT_ISO_QOS, &qos,
-							&len) < 0) {
-		bt_shell_printf("Failed to getsockopt(BT_ISO_QOS): %s (%d)\n",
-					strerror(errno), -errno);
-		return false;
-	}
-
-	ret = transport_send_seq(transport, transport->fd, transport->num);
-	if (ret < 0) {
+	ret = transport_send_due(transport);
+	if (ret < 0)
 		bt_shell_printf("Unable to send: %s (%d)\n",
 					strerror(-ret), ret);
-		return false;
-	}
 
-	if (!ret) {
+	if (ret <= 0) {
+		transport_send_stats(transport);
+		transport_send_unmap(transport);
 		transport_close(transport);
 		return false;
 	}
@@ -5872,48 +5987,88 @@ static bool transport_timer_read(struct io *io, void *user_data)
 }
 
 static int transport_send(struct transport *transport, int fd,
-					struct bt_iso_io_qos *qos)
+					struct bt_iso_io_qos *qos,
+					const struct timespec *start)
 {
 	struct itimerspec ts;
-	int timer_fd;
-
-	transport->seq = 0;
-
-	if (!qos)
-		return transport_send_seq(transport, fd, UINT32_MAX);
+	uint64_t first;
+	int timer_fd, err;
 
 	if (transport->fd >= 0)
 		return -EALREADY;
 
+	err = transport_send_map(transport, fd);
+	if (err < 0)
+		return err;
+
+	if (!qos || !qos->interval) {
+		int ret;
+
+		transport->interval = 0;
+
+		while ((ret = transport_send_batch(transport, fd,
+						SEND_BATCH_MAX)) > 0)
+			transport->seq += ret;
+
+		transport_send_stats(transport);
+		transport_send_unmap(transport);
+
+		if (!ret)
+			close(fd);
+
+		return ret;
+	}
+
 	timer_fd = timerfd_create(CLOCK_MONOTONIC, 0);
-	if (timer_fd < 0)
-		return -errno;
+	if (timer_fd < 0) {
+		err = -errno;
+		transport_send_unmap(transport);
+		return err;
+	}
 
-	/* Send data in bursts of
-	 * num = ROUND_CLOSEST(Transport_Latency (ms) / SDU_Interval (us))
-	 * with average data rate = 1 packet / SDU_Interval
+	/* Pace one SDU per SDU_Interval against a start time shared by all
+	 * the transports of the command, so linked CIS/BIS get their SDUs
+	 * scheduled for the same slots. SDUs from late wakeups are sent
+	 * together with a single sendmmsg().
 	 */
-	transport->num = ROUND_CLOSEST(qos->latency * 1000, qos->interval);
-	if (!transport->num)
-		transport->num = 1;
+	transport->interval = qos->interval;
+	transport->start = *start;
+
+	first = (uint64_t) start->tv_sec * 1000000000 + start->tv_nsec +
+						(uint64_t) qos->interval * 1000;
 
 	memset(&ts, 0, sizeof(ts));
-	ts.it_value.tv_nsec = 1;
-	ts.it_interval.tv_nsec = transport->num * qos->interval * 1000;
+	ts.it_value.tv_sec = first / 1000000000;
+	ts.it_value.tv_nsec = first % 1000000000;
+	ts.it_interval.tv_sec = qos->interval / 1000000;
+	ts.it_interval.tv_nsec = (qos->interval % 1000000) * 1000;
 
 	if (timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &ts, NULL) < 0) {
+		err = -errno;
 		close(timer_fd);
-		return -errno;
+		transport_send_unmap(transport);
+		return err;
 	}
 
+	io_destroy(transport->timer_io);
+
 	transport->fd = fd;
 	transport->timer_io = io_new(timer_fd);
+	io_set_close_on_destroy(transport->timer_io, true);
 
 	io_set_read_handler(transport->timer_io, transport_timer_read,
 						transport, NULL);
 
-	/* One extra packet to buffers immediately */
-	return transport_send_seq(transport, fd, 1);
+	/* Send the SDU for the first slot right away */
+	err = transport_send_due(transport);
+	if (err < 0) {
+		io_destroy(transport->timer_io);
+		transport->timer_io = NULL;
+		transport->fd = -1;
+		transport_send_unmap(transport);
+	}
+
+	return err;
 }
 
 static void cmd_send_transport(int argc, char *argv[])
@@ -5922,9 +6077,17 @@ static void cmd_send_transport(int argc, char *argv[])
 	struct transport *transport;
 	int fd = -1, err;
 	struct bt_iso_qos qos;
+	struct timespec start;
 	socklen_t len;
 	int i;
 
+	/* Common start time for all transports so linked ones stay aligned */
+	if (clock_gettime(CLOCK_MONOTONIC, &start) < 0) {
+		bt_shell_printf("clock_gettime: %s (%d)", strerror(errno),
+								errno);
+		return bt_shell_noninteractive_quit(EXIT_FAILURE);
+	}
+
 	for (i = 1; i < argc; i++) {
 		proxy = g_dbus_proxy_lookup(transports, NULL, argv[i],
 					BLUEZ_MEDIA_TRANSPORT_INTERFACE);
@@ -5960,7 +6123,7 @@ static void cmd_send_transport(int argc, char *argv[])
 							&len) < 0) {
 			bt_shell_printf("Unable to getsockopt(BT_ISO_QOS): %s",
 							strerror(errno));
-			err = transport_send(transport, fd, NULL);
+			err = transport_send(transport, fd, NULL, &start);
 		} else {
 			struct sockaddr_iso addr;
 			socklen_t optlen = sizeof(addr);
@@ -5970,10 +6133,12 @@ static void cmd_send_transport(int argc, char *argv[])
 			if (!err) {
 				if (!(bacmp(&addr.iso_bdaddr, BDADDR_ANY)))
 					err = transport_send(transport, fd,
-							     &qos.bcast.out);
+							     &qos.bcast.out,
+							     &start);
 				else
 					err = transport_send(transport, fd,
-							     &qos.ucast.out);
+							     &qos.ucast.out,
+							     &start);
 			}
 		}
 
@@ -282,6 +282,14 @@ struct vhci *hciemu_get_vhci(struct hciemu *hciemu)
 	return hciemu->vhci;
 }
 
+uint16_t hciemu_get_index(struct hciemu *hciemu)
+{
+	if (!hciemu)
+		return 0xffff;
+
+	return vhci_get_index(hciemu->vhci);
+}
+
 struct hciemu_client *hciemu_get_client(struct hciemu *hciemu, int num)
 {
 	const struct queue_entry *entry;
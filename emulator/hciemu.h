@@ -56,6 +56,7 @@ bool hciemu_set_debug(struct hciemu *hciemu, hciemu_debug_func_t callback,
 			void *user_data, hciemu_destroy_func_t destroy);
 
 struct vhci *hciemu_get_vhci(struct hciemu *hciemu);
+uint16_t hciemu_get_index(struct hciemu *hciemu);
 struct bthost *hciemu_client_get_host(struct hciemu *hciemu);
 
 /* Process pending client events before new VHCI events */
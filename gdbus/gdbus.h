@@ -349,9 +349,36 @@ void g_dbus_emit_property_changed_full(DBusConnection *connection,
 gboolean g_dbus_get_properties(DBusConnection *connection, const char *path,
 				const char *interface, DBusMessageIter *iter);
 
+/*
+ * Rate limit PropertiesChanged signals caused by the given property, or by
+ * any property of the interface if name is NULL, to at most one signal per
+ * object and interval (in milliseconds). Changes within the interval are
+ * merged with any other change of the object. Rate limited properties are
+ * also subject to g_dbus_set_property_budget, on its own with an interval
+ * of 0.
+ */
+void g_dbus_set_property_interval(const char *interface, const char *name,
+						unsigned int interval);
+
+/*
+ * Maximum number of PropertiesChanged signals per second. When exceeded,
+ * changes of rate limited properties are delayed to the next second,
+ * whatever their interval; other properties are never delayed. A limit of
+ * 0 disables it.
+ */
+void g_dbus_set_property_budget(unsigned int limit);
+
 gboolean g_dbus_attach_object_manager(DBusConnection *connection);
 gboolean g_dbus_detach_object_manager(DBusConnection *connection);
 
+/*
+ * Registers the given interface on the root path providing filtered bulk
+ * object snapshots and coalesced per client delta signals.
+ */
+gboolean g_dbus_attach_delta_manager(DBusConnection *connection,
+						const char *interface);
+gboolean g_dbus_detach_delta_manager(DBusConnection *connection);
+
 typedef struct GDBusClient GDBusClient;
 typedef struct GDBusProxy GDBusProxy;
 
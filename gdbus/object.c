@@ -13,6 +13,7 @@
 #endif
 
 #include <stdio.h>
+#include <errno.h>
 #include <string.h>
 #include <stdbool.h>
 
@@ -51,6 +52,7 @@ struct generic_data {
 	GSList *added;
 	GSList *removed;
 	guint process_id;
+	guint throttle_id;
 	gboolean pending_prop;
 	char *introspect;
 	struct generic_data *parent;
@@ -74,6 +76,7 @@ struct interface_data {
 	const GDBusSignalTable *signals;
 	const GDBusPropertyTable *properties;
 	GSList *pending_prop;
+	gint64 last_emit;
 	void *user_data;
 	GDBusDestroyFunction destroy;
 };
@@ -97,12 +100,28 @@ struct debug_data {
 	void *data;
 };
 
+struct property_interval {
+	char *interface;
+	char *name;
+	unsigned int interval;
+};
+
+struct property_budget {
+	unsigned int limit;
+	unsigned int used;
+	gint64 start;
+};
+
 static int global_flags = 0;
 static struct generic_data *root;
 static GSList *pending = NULL;
 static struct debug_data debug = { NULL, NULL, NULL };
+static GSList *property_intervals = NULL;
+static struct property_budget budget = { 0, 0, 0 };
 
 static gboolean process_changes(gpointer user_data);
+static void delta_record(struct generic_data *data, const char *interface,
+							gboolean removed);
 static void process_properties_from_interface(struct generic_data *data,
 						struct interface_data *iface);
 static void process_property_changes(struct generic_data *data);
@@ -644,6 +663,7 @@ static void emit_interfaces_added(struct generic_data *data)
 {
 	DBusMessage *signal;
 	DBusMessageIter iter, array;
+	GSList *l;
 
 	if (root == NULL || data == root)
 		return;
@@ -675,6 +695,13 @@ static void emit_interfaces_added(struct generic_data *data)
 				DBUS_DICT_ENTRY_END_CHAR_AS_STRING, &array);
 
 	g_slist_foreach(data->added, append_interface, &array);
+
+	for (l = data->added; l; l = l->next) {
+		struct interface_data *iface = l->data;
+
+		delta_record(data, iface->name, FALSE);
+	}
+
 	g_slist_free(data->added);
 	data->added = NULL;
 
@@ -1060,6 +1087,7 @@ static void emit_interfaces_removed(struct generic_data *data)
 {
 	DBusMessage *signal;
 	DBusMessageIter iter, array;
+	GSList *l;
 
 	if (root == NULL || data == root)
 		return;
@@ -1077,6 +1105,10 @@ static void emit_interfaces_removed(struct generic_data *data)
 					DBUS_TYPE_STRING_AS_STRING, &array);
 
 	g_slist_foreach(data->removed, append_name, &array);
+
+	for (l = data->removed; l; l = l->next)
+		delta_record(data, l->data, TRUE);
+
 	g_slist_free_full(data->removed, g_free);
 	data->removed = NULL;
 
@@ -1093,6 +1125,11 @@ static void remove_pending(struct generic_data *data)
 		data->process_id = 0;
 	}
 
+	if (data->throttle_id > 0) {
+		g_source_remove(data->throttle_id);
+		data->throttle_id = 0;
+	}
+
 	pending = g_slist_remove(pending, data);
 }
 
@@ -1125,11 +1162,8 @@ static void generic_unregister(DBusConnection *connection, void *user_data)
 	if (parent != NULL)
 		parent->objects = g_slist_remove(parent->objects, data);
 
-	if (data->process_id > 0) {
-		g_source_remove(data->process_id);
-		data->process_id = 0;
+	if (data->process_id > 0 || data->throttle_id > 0)
 		process_changes(data);
-	}
 
 	g_slist_foreach(data->objects, reset_parent, data->parent);
 	g_slist_free(data->objects);
@@ -1900,6 +1934,19 @@ static void process_properties_from_interface(struct generic_data *data,
 	g_slist_free(iface->pending_prop);
 	iface->pending_prop = NULL;
 
+	iface->last_emit = g_get_monotonic_time();
+
+	delta_record(data, iface->name, FALSE);
+
+	if (budget.limit) {
+		if (iface->last_emit - budget.start >= G_USEC_PER_SEC) {
+			budget.start = iface->last_emit;
+			budget.used = 0;
+		}
+
+		budget.used++;
+	}
+
 	/* Use g_dbus_send_unref to avoid recursive calls to g_dbus_flush */
 	g_dbus_send_unref(data->conn, signal);
 }
@@ -1917,6 +1964,90 @@ static void process_property_changes(struct generic_data *data)
 	}
 }
 
+static struct property_interval *find_property_interval(
+					struct interface_data *iface,
+					const GDBusPropertyTable *property)
+{
+	GSList *l;
+
+	for (l = property_intervals; l != NULL; l = l->next) {
+		struct property_interval *pi = l->data;
+
+		if (strcmp(pi->interface, iface->name))
+			continue;
+
+		if (pi->name && strcmp(pi->name, property->name))
+			continue;
+
+		return pi;
+	}
+
+	return NULL;
+}
+
+/* Returns the delay in milliseconds until the budget allows a new signal */
+static unsigned int budget_delay(void)
+{
+	gint64 now, elapsed;
+
+	if (!budget.limit || budget.used < budget.limit)
+		return 0;
+
+	now = g_get_monotonic_time();
+	elapsed = now - budget.start;
+	if (elapsed >= G_USEC_PER_SEC)
+		return 0;
+
+	return (G_USEC_PER_SEC - elapsed) / 1000 + 1;
+}
+
+static unsigned int throttle_delay(struct interface_data *iface,
+						unsigned int interval)
+{
+	unsigned int delay = 0;
+	gint64 elapsed;
+
+	if (iface->last_emit) {
+		elapsed = (g_get_monotonic_time() - iface->last_emit) / 1000;
+		if (elapsed < interval)
+			delay = interval - elapsed;
+	}
+
+	return MAX(delay, budget_delay());
+}
+
+static gboolean process_throttled(gpointer user_data)
+{
+	struct generic_data *data = user_data;
+	unsigned int delay;
+
+	/* Other objects may have used the budget in the meantime */
+	delay = budget_delay();
+	if (delay) {
+		data->throttle_id = g_timeout_add(delay, process_throttled,
+									data);
+		return FALSE;
+	}
+
+	data->throttle_id = 0;
+	process_changes(data);
+
+	return FALSE;
+}
+
+static void add_throttled(struct generic_data *data, unsigned int delay)
+{
+	/*
+	 * Changes already scheduled are emitted together with this one, so
+	 * all changes of the object within the interval end up in a single
+	 * signal per interface.
+	 */
+	if (data->process_id > 0 || data->throttle_id > 0)
+		return;
+
+	data->throttle_id = g_timeout_add(delay, process_throttled, data);
+}
+
 void g_dbus_emit_property_changed_full(DBusConnection *connection,
 				const char *path, const char *interface,
 				const char *name,
@@ -1925,6 +2056,8 @@ void g_dbus_emit_property_changed_full(DBusConnection *connection,
 	const GDBusPropertyTable *property;
 	struct generic_data *data;
 	struct interface_data *iface;
+	struct property_interval *pi;
+	unsigned int delay;
 
 	if (path == NULL)
 		return;
@@ -1958,10 +2091,22 @@ void g_dbus_emit_property_changed_full(DBusConnection *connection,
 	iface->pending_prop = g_slist_prepend(iface->pending_prop,
 						(void *) property);
 
-	if (flags & G_DBUS_PROPERTY_CHANGED_FLAG_FLUSH)
+	if (flags & G_DBUS_PROPERTY_CHANGED_FLAG_FLUSH) {
 		process_property_changes(data);
-	else
-		add_pending(data);
+		return;
+	}
+
+	/* Rate limited properties are subject to the budget as well */
+	pi = find_property_interval(iface, property);
+	if (pi) {
+		delay = throttle_delay(iface, pi->interval);
+		if (delay) {
+			add_throttled(data, delay);
+			return;
+		}
+	}
+
+	add_pending(data);
 }
 
 void g_dbus_emit_property_changed(DBusConnection *connection, const char *path,
@@ -2019,6 +2164,618 @@ gboolean g_dbus_detach_object_manager(DBusConnection *connection)
 	return TRUE;
 }
 
+struct delta_subscriber {
+	char *owner;
+	guint watch;
+	char **interfaces;
+	char *prefix;
+	GHashTable *changed;
+	GHashTable *removed;
+};
+
+static DBusConnection *delta_conn = NULL;
+static char *delta_interface = NULL;
+static GSList *delta_subscribers = NULL;
+static guint delta_id = 0;
+
+#define OBJECTS_SIGNATURE \
+	DBUS_DICT_ENTRY_BEGIN_CHAR_AS_STRING \
+	DBUS_TYPE_OBJECT_PATH_AS_STRING \
+	DBUS_TYPE_ARRAY_AS_STRING \
+	DBUS_DICT_ENTRY_BEGIN_CHAR_AS_STRING \
+	DBUS_TYPE_STRING_AS_STRING \
+	DBUS_TYPE_ARRAY_AS_STRING \
+	DBUS_DICT_ENTRY_BEGIN_CHAR_AS_STRING \
+	DBUS_TYPE_STRING_AS_STRING \
+	DBUS_TYPE_VARIANT_AS_STRING \
+	DBUS_DICT_ENTRY_END_CHAR_AS_STRING \
+	DBUS_DICT_ENTRY_END_CHAR_AS_STRING \
+	DBUS_DICT_ENTRY_END_CHAR_AS_STRING
+
+struct objects_filter {
+	char **interfaces;
+	char *prefix;
+	char *after;
+	uint32_t count;
+};
+
+static gboolean filter_interface(char **interfaces, const char *name)
+{
+	int i;
+
+	if (interfaces == NULL)
+		return TRUE;
+
+	for (i = 0; interfaces[i]; i++) {
+		if (!strcmp(interfaces[i], name))
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+static gboolean filter_path(const char *prefix, const char *path)
+{
+	if (prefix == NULL)
+		return TRUE;
+
+	return g_str_has_prefix(path, prefix);
+}
+
+static int parse_objects_filter(DBusMessageIter *iter,
+						struct objects_filter *filter)
+{
+	DBusMessageIter dict;
+
+	memset(filter, 0, sizeof(*filter));
+
+	if (dbus_message_iter_get_arg_type(iter) != DBUS_TYPE_ARRAY)
+		return -EINVAL;
+
+	dbus_message_iter_recurse(iter, &dict);
+
+	while (dbus_message_iter_get_arg_type(&dict) == DBUS_TYPE_DICT_ENTRY) {
+		DBusMessageIter entry, value, array;
+		const char *key;
+		GPtrArray *names;
+
+		dbus_message_iter_recurse(&dict, &entry);
+		dbus_message_iter_get_basic(&entry, &key);
+		dbus_message_iter_next(&entry);
+
+		if (dbus_message_iter_get_arg_type(&entry) != DBUS_TYPE_VARIANT)
+			return -EINVAL;
+
+		dbus_message_iter_recurse(&entry, &value);
+
+		if (!strcmp(key, "Interfaces")) {
+			if (dbus_message_iter_get_arg_type(&value) !=
+							DBUS_TYPE_ARRAY)
+				return -EINVAL;
+
+			names = g_ptr_array_new();
+			dbus_message_iter_recurse(&value, &array);
+			while (dbus_message_iter_get_arg_type(&array) ==
+							DBUS_TYPE_STRING) {
+				const char *name;
+
+				dbus_message_iter_get_basic(&array, &name);
+				g_ptr_array_add(names, g_strdup(name));
+				dbus_message_iter_next(&array);
+			}
+			g_ptr_array_add(names, NULL);
+
+			g_strfreev(filter->interfaces);
+			filter->interfaces = (char **)
+					g_ptr_array_free(names, FALSE);
+		} else if (!strcmp(key, "PathPrefix")) {
+			const char *path;
+
+			if (dbus_message_iter_get_arg_type(&value) !=
+							DBUS_TYPE_OBJECT_PATH)
+				return -EINVAL;
+
+			dbus_message_iter_get_basic(&value, &path);
+			g_free(filter->prefix);
+			filter->prefix = g_strdup(path);
+		} else if (!strcmp(key, "After")) {
+			const char *path;
+
+			if (dbus_message_iter_get_arg_type(&value) !=
+							DBUS_TYPE_OBJECT_PATH)
+				return -EINVAL;
+
+			dbus_message_iter_get_basic(&value, &path);
+			g_free(filter->after);
+			filter->after = g_strdup(path);
+		} else if (!strcmp(key, "Count")) {
+			if (dbus_message_iter_get_arg_type(&value) !=
+							DBUS_TYPE_UINT32)
+				return -EINVAL;
+
+			dbus_message_iter_get_basic(&value, &filter->count);
+		} else
+			return -EINVAL;
+
+		dbus_message_iter_next(&dict);
+	}
+
+	return 0;
+}
+
+static void objects_filter_free(struct objects_filter *filter)
+{
+	g_strfreev(filter->interfaces);
+	g_free(filter->prefix);
+	g_free(filter->after);
+}
+
+static gboolean object_has_interface(struct generic_data *data,
+							char **interfaces)
+{
+	GSList *l;
+
+	for (l = data->interfaces; l; l = l->next) {
+		struct interface_data *iface = l->data;
+
+		if (filter_interface(interfaces, iface->name))
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+static void collect_objects(struct generic_data *data,
+				struct objects_filter *filter, GPtrArray *array)
+{
+	GSList *l;
+
+	for (l = data->objects; l; l = l->next) {
+		struct generic_data *child = l->data;
+
+		/* Skip subtrees which cannot contain the prefix */
+		if (filter->prefix && !g_str_has_prefix(child->path,
+							filter->prefix) &&
+				!g_str_has_prefix(filter->prefix, child->path))
+			continue;
+
+		if (filter_path(filter->prefix, child->path) &&
+				(!filter->after ||
+				strcmp(child->path, filter->after) > 0) &&
+				object_has_interface(child, filter->interfaces))
+			g_ptr_array_add(array, child);
+
+		collect_objects(child, filter, array);
+	}
+}
+
+static int object_path_cmp(gconstpointer a, gconstpointer b)
+{
+	const struct generic_data *d1 = *(struct generic_data * const *) a;
+	const struct generic_data *d2 = *(struct generic_data * const *) b;
+
+	return strcmp(d1->path, d2->path);
+}
+
+static void append_filtered_interfaces(struct generic_data *data,
+					char **interfaces, DBusMessageIter *iter)
+{
+	DBusMessageIter entry, array;
+	GSList *l;
+
+	dbus_message_iter_open_container(iter, DBUS_TYPE_DICT_ENTRY, NULL,
+								&entry);
+	dbus_message_iter_append_basic(&entry, DBUS_TYPE_OBJECT_PATH,
+								&data->path);
+	dbus_message_iter_open_container(&entry, DBUS_TYPE_ARRAY,
+				DBUS_DICT_ENTRY_BEGIN_CHAR_AS_STRING
+				DBUS_TYPE_STRING_AS_STRING
+				DBUS_TYPE_ARRAY_AS_STRING
+				DBUS_DICT_ENTRY_BEGIN_CHAR_AS_STRING
+				DBUS_TYPE_STRING_AS_STRING
+				DBUS_TYPE_VARIANT_AS_STRING
+				DBUS_DICT_ENTRY_END_CHAR_AS_STRING
+				DBUS_DICT_ENTRY_END_CHAR_AS_STRING, &array);
+
+	for (l = data->interfaces; l; l = l->next) {
+		struct interface_data *iface = l->data;
+
+		if (filter_interface(interfaces, iface->name))
+			append_interface(iface, &array);
+	}
+
+	dbus_message_iter_close_container(&entry, &array);
+	dbus_message_iter_close_container(iter, &entry);
+}
+
+static DBusMessage *delta_get_objects(DBusConnection *connection,
+					DBusMessage *message, void *user_data)
+{
+	struct objects_filter filter;
+	DBusMessage *reply;
+	DBusMessageIter iter, array;
+	GPtrArray *objects;
+	guint i, count;
+
+	dbus_message_iter_init(message, &iter);
+
+	if (parse_objects_filter(&iter, &filter) < 0) {
+		objects_filter_free(&filter);
+		return g_dbus_create_error(message, DBUS_ERROR_INVALID_ARGS,
+							"Invalid filter");
+	}
+
+	reply = dbus_message_new_method_return(message);
+	if (reply == NULL) {
+		objects_filter_free(&filter);
+		return NULL;
+	}
+
+	objects = g_ptr_array_new();
+
+	if (root)
+		collect_objects(root, &filter, objects);
+
+	/* Sort by path so clients can page with the After filter */
+	g_ptr_array_sort(objects, object_path_cmp);
+
+	count = objects->len;
+	if (filter.count && filter.count < count)
+		count = filter.count;
+
+	dbus_message_iter_init_append(reply, &iter);
+	dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY,
+					OBJECTS_SIGNATURE, &array);
+
+	for (i = 0; i < count; i++)
+		append_filtered_interfaces(g_ptr_array_index(objects, i),
+						filter.interfaces, &array);
+
+	dbus_message_iter_close_container(&iter, &array);
+
+	g_ptr_array_free(objects, TRUE);
+	objects_filter_free(&filter);
+
+	return reply;
+}
+
+static void delta_set_add(GHashTable *table, const char *path,
+							const char *interface)
+{
+	GHashTable *set;
+
+	set = g_hash_table_lookup(table, path);
+	if (set == NULL) {
+		set = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+									NULL);
+		g_hash_table_insert(table, g_strdup(path), set);
+	}
+
+	g_hash_table_add(set, g_strdup(interface));
+}
+
+static void delta_set_remove(GHashTable *table, const char *path,
+							const char *interface)
+{
+	GHashTable *set;
+
+	set = g_hash_table_lookup(table, path);
+	if (set == NULL)
+		return;
+
+	g_hash_table_remove(set, interface);
+
+	if (g_hash_table_size(set) == 0)
+		g_hash_table_remove(table, path);
+}
+
+static void append_changed(DBusMessageIter *array, GHashTable *changed)
+{
+	GHashTableIter iter, set_iter;
+	gpointer key, value, name;
+
+	g_hash_table_iter_init(&iter, changed);
+	while (g_hash_table_iter_next(&iter, &key, &value)) {
+		struct generic_data *data = NULL;
+		DBusMessageIter entry, ifaces;
+
+		if (!dbus_connection_get_object_path_data(delta_conn, key,
+						(void **) &data) || data == NULL)
+			continue;
+
+		dbus_message_iter_open_container(array, DBUS_TYPE_DICT_ENTRY,
+							NULL, &entry);
+		dbus_message_iter_append_basic(&entry, DBUS_TYPE_OBJECT_PATH,
+								&data->path);
+		dbus_message_iter_open_container(&entry, DBUS_TYPE_ARRAY,
+				DBUS_DICT_ENTRY_BEGIN_CHAR_AS_STRING
+				DBUS_TYPE_STRING_AS_STRING
+				DBUS_TYPE_ARRAY_AS_STRING
+				DBUS_DICT_ENTRY_BEGIN_CHAR_AS_STRING
+				DBUS_TYPE_STRING_AS_STRING
+				DBUS_TYPE_VARIANT_AS_STRING
+				DBUS_DICT_ENTRY_END_CHAR_AS_STRING
+				DBUS_DICT_ENTRY_END_CHAR_AS_STRING, &ifaces);
+
+		g_hash_table_iter_init(&set_iter, value);
+		while (g_hash_table_iter_next(&set_iter, &name, NULL)) {
+			struct interface_data *iface;
+
+			iface = find_interface(data->interfaces, name);
+			if (iface)
+				append_interface(iface, &ifaces);
+		}
+
+		dbus_message_iter_close_container(&entry, &ifaces);
+		dbus_message_iter_close_container(array, &entry);
+	}
+}
+
+static void append_removed(DBusMessageIter *array, GHashTable *removed)
+{
+	GHashTableIter iter, set_iter;
+	gpointer key, value, name;
+
+	g_hash_table_iter_init(&iter, removed);
+	while (g_hash_table_iter_next(&iter, &key, &value)) {
+		DBusMessageIter entry, names;
+
+		dbus_message_iter_open_container(array, DBUS_TYPE_DICT_ENTRY,
+							NULL, &entry);
+		dbus_message_iter_append_basic(&entry, DBUS_TYPE_OBJECT_PATH,
+									&key);
+		dbus_message_iter_open_container(&entry, DBUS_TYPE_ARRAY,
+					DBUS_TYPE_STRING_AS_STRING, &names);
+
+		g_hash_table_iter_init(&set_iter, value);
+		while (g_hash_table_iter_next(&set_iter, &name, NULL))
+			dbus_message_iter_append_basic(&names,
+						DBUS_TYPE_STRING, &name);
+
+		dbus_message_iter_close_container(&entry, &names);
+		dbus_message_iter_close_container(array, &entry);
+	}
+}
+
+static void delta_emit(struct delta_subscriber *sub)
+{
+	DBusMessage *signal;
+	DBusMessageIter iter, array;
+
+	if (!g_hash_table_size(sub->changed) &&
+					!g_hash_table_size(sub->removed))
+		return;
+
+	signal = dbus_message_new_signal("/", delta_interface,
+							"ObjectsChanged");
+	if (signal == NULL)
+		goto done;
+
+	/* Deltas are only of interest to the subscriber */
+	dbus_message_set_destination(signal, sub->owner);
+
+	dbus_message_iter_init_append(signal, &iter);
+
+	dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY,
+					OBJECTS_SIGNATURE, &array);
+	append_changed(&array, sub->changed);
+	dbus_message_iter_close_container(&iter, &array);
+
+	dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY,
+					DBUS_DICT_ENTRY_BEGIN_CHAR_AS_STRING
+					DBUS_TYPE_OBJECT_PATH_AS_STRING
+					DBUS_TYPE_ARRAY_AS_STRING
+					DBUS_TYPE_STRING_AS_STRING
+					DBUS_DICT_ENTRY_END_CHAR_AS_STRING,
+					&array);
+	append_removed(&array, sub->removed);
+	dbus_message_iter_close_container(&iter, &array);
+
+	/* Use g_dbus_send_unref to avoid recursive calls to g_dbus_flush */
+	g_dbus_send_unref(delta_conn, signal);
+
+done:
+	g_hash_table_remove_all(sub->changed);
+	g_hash_table_remove_all(sub->removed);
+}
+
+static gboolean delta_flush(gpointer user_data)
+{
+	delta_id = 0;
+
+	g_slist_foreach(delta_subscribers, (GFunc) delta_emit, NULL);
+
+	return FALSE;
+}
+
+static void delta_record(struct generic_data *data, const char *interface,
+							gboolean removed)
+{
+	GSList *l;
+
+	if (data->conn != delta_conn)
+		return;
+
+	for (l = delta_subscribers; l; l = l->next) {
+		struct delta_subscriber *sub = l->data;
+
+		if (!filter_path(sub->prefix, data->path) ||
+				!filter_interface(sub->interfaces, interface))
+			continue;
+
+		/* Only the last state matters when sending the batch */
+		if (removed) {
+			delta_set_remove(sub->changed, data->path, interface);
+			delta_set_add(sub->removed, data->path, interface);
+		} else {
+			delta_set_remove(sub->removed, data->path, interface);
+			delta_set_add(sub->changed, data->path, interface);
+		}
+	}
+
+	if (delta_subscribers && !delta_id)
+		delta_id = g_idle_add(delta_flush, NULL);
+}
+
+static void delta_subscriber_free(void *user_data)
+{
+	struct delta_subscriber *sub = user_data;
+
+	g_hash_table_destroy(sub->changed);
+	g_hash_table_destroy(sub->removed);
+	g_strfreev(sub->interfaces);
+	g_free(sub->prefix);
+	g_free(sub->owner);
+	g_free(sub);
+}
+
+static struct delta_subscriber *find_subscriber(const char *owner)
+{
+	GSList *l;
+
+	for (l = delta_subscribers; l; l = l->next) {
+		struct delta_subscriber *sub = l->data;
+
+		if (!strcmp(sub->owner, owner))
+			return sub;
+	}
+
+	return NULL;
+}
+
+static void delta_disconnect(DBusConnection *conn, void *user_data)
+{
+	struct delta_subscriber *sub = user_data;
+
+	delta_subscribers = g_slist_remove(delta_subscribers, sub);
+	delta_subscriber_free(sub);
+}
+
+static DBusMessage *delta_subscribe(DBusConnection *connection,
+					DBusMessage *message, void *user_data)
+{
+	const char *sender = dbus_message_get_sender(message);
+	struct delta_subscriber *sub;
+	struct objects_filter filter;
+	DBusMessageIter iter;
+
+	dbus_message_iter_init(message, &iter);
+
+	if (parse_objects_filter(&iter, &filter) < 0 || filter.after ||
+							filter.count) {
+		objects_filter_free(&filter);
+		return g_dbus_create_error(message, DBUS_ERROR_INVALID_ARGS,
+							"Invalid filter");
+	}
+
+	sub = find_subscriber(sender);
+	if (sub == NULL) {
+		sub = g_new0(struct delta_subscriber, 1);
+		sub->owner = g_strdup(sender);
+		sub->changed = g_hash_table_new_full(g_str_hash, g_str_equal,
+				g_free, (GDestroyNotify) g_hash_table_destroy);
+		sub->removed = g_hash_table_new_full(g_str_hash, g_str_equal,
+				g_free, (GDestroyNotify) g_hash_table_destroy);
+		sub->watch = g_dbus_add_disconnect_watch(connection, sender,
+						delta_disconnect, sub, NULL);
+		delta_subscribers = g_slist_append(delta_subscribers, sub);
+	}
+
+	/* A new subscription replaces the filter of the previous one */
+	g_strfreev(sub->interfaces);
+	sub->interfaces = filter.interfaces;
+	filter.interfaces = NULL;
+	g_free(sub->prefix);
+	sub->prefix = filter.prefix;
+	filter.prefix = NULL;
+
+	objects_filter_free(&filter);
+
+	return dbus_message_new_method_return(message);
+}
+
+static DBusMessage *delta_unsubscribe(DBusConnection *connection,
+					DBusMessage *message, void *user_data)
+{
+	const char *sender = dbus_message_get_sender(message);
+	struct delta_subscriber *sub;
+
+	sub = find_subscriber(sender);
+	if (sub == NULL)
+		return g_dbus_create_error(message, DBUS_ERROR_INVALID_ARGS,
+							"Not subscribed");
+
+	g_dbus_remove_watch(connection, sub->watch);
+	delta_subscribers = g_slist_remove(delta_subscribers, sub);
+	delta_subscriber_free(sub);
+
+	return dbus_message_new_method_return(message);
+}
+
+static const GDBusMethodTable delta_methods[] = {
+	{ GDBUS_EXPERIMENTAL_METHOD("GetObjects",
+			GDBUS_ARGS({ "filter", "a{sv}" }),
+			GDBUS_ARGS({ "objects", "a{oa{sa{sv}}}" }),
+			delta_get_objects) },
+	{ GDBUS_EXPERIMENTAL_METHOD("Subscribe",
+			GDBUS_ARGS({ "filter", "a{sv}" }), NULL,
+			delta_subscribe) },
+	{ GDBUS_EXPERIMENTAL_METHOD("Unsubscribe", NULL, NULL,
+			delta_unsubscribe) },
+	{ }
+};
+
+static const GDBusSignalTable delta_signals[] = {
+	{ GDBUS_EXPERIMENTAL_SIGNAL("ObjectsChanged",
+			GDBUS_ARGS({ "changed", "a{oa{sa{sv}}}" },
+					{ "removed", "a{oas}" })) },
+	{ }
+};
+
+gboolean g_dbus_attach_delta_manager(DBusConnection *connection,
+						const char *interface)
+{
+	if (delta_interface)
+		return FALSE;
+
+	if (!g_dbus_register_interface(connection, "/", interface,
+					delta_methods, delta_signals, NULL,
+					NULL, NULL))
+		return FALSE;
+
+	delta_conn = connection;
+	delta_interface = g_strdup(interface);
+
+	return TRUE;
+}
+
+gboolean g_dbus_detach_delta_manager(DBusConnection *connection)
+{
+	if (!delta_interface || connection != delta_conn)
+		return FALSE;
+
+	g_dbus_unregister_interface(connection, "/", delta_interface);
+
+	while (delta_subscribers) {
+		struct delta_subscriber *sub = delta_subscribers->data;
+
+		g_dbus_remove_watch(connection, sub->watch);
+		delta_subscribers = g_slist_remove(delta_subscribers, sub);
+		delta_subscriber_free(sub);
+	}
+
+	if (delta_id > 0) {
+		g_source_remove(delta_id);
+		delta_id = 0;
+	}
+
+	g_free(delta_interface);
+	delta_interface = NULL;
+	delta_conn = NULL;
+
+	return TRUE;
+}
+
 void g_dbus_set_flags(int flags)
 {
 	global_flags = flags;
@@ -2029,6 +2786,55 @@ int g_dbus_get_flags(void)
 	return global_flags;
 }
 
+static struct property_interval *find_interval(const char *interface,
+							const char *name)
+{
+	GSList *l;
+
+	for (l = property_intervals; l != NULL; l = l->next) {
+		struct property_interval *pi = l->data;
+
+		if (!strcmp(pi->interface, interface) &&
+					!g_strcmp0(pi->name, name))
+			return pi;
+	}
+
+	return NULL;
+}
+
+void g_dbus_set_property_interval(const char *interface, const char *name,
+						unsigned int interval)
+{
+	struct property_interval *pi;
+
+	if (interface == NULL)
+		return;
+
+	pi = find_interval(interface, name);
+	if (pi == NULL) {
+		pi = g_new0(struct property_interval, 1);
+		pi->interface = g_strdup(interface);
+		pi->name = g_strdup(name);
+
+		/* Entries for a given property take precedence */
+		if (name)
+			property_intervals = g_slist_prepend(property_intervals,
+									pi);
+		else
+			property_intervals = g_slist_append(property_intervals,
+									pi);
+	}
+
+	pi->interval = interval;
+}
+
+void g_dbus_set_property_budget(unsigned int limit)
+{
+	budget.limit = limit;
+	budget.used = 0;
+	budget.start = 0;
+}
+
 void g_dbus_set_debug(g_dbus_debug_func_t cb, void *user_data,
 				g_dbus_destroy_func_t destroy)
 {
@@ -28,8 +28,30 @@ static DBusHandlerResult message_filter(DBusConnection *connection,
 					DBusMessage *message, void *user_data);
 
 static guint listener_id = 0;
+static guint listener_seq = 0;
 static GSList *listeners = NULL;
 
+/* Listeners are indexed by interface, member and argument (or interface and
+ * member only when they have no argument) so that a message is only matched
+ * against the listeners it can be delivered to. Listeners without interface
+ * or member are kept in listeners_any.
+ */
+static GHashTable *listeners_index = NULL;
+static GSList *listeners_any = NULL;
+static GHashTable *listeners_names = NULL;
+static GHashTable *callbacks_index = NULL;
+
+/* Match rules removals are sent when idle so that a rule added back right
+ * away, as it happens when a client reconnects, doesn't hit the bus at all.
+ */
+static GSList *pending_removes = NULL;
+static guint pending_removes_id = 0;
+
+struct pending_match {
+	DBusConnection *connection;
+	char *rule;
+};
+
 struct service_data {
 	DBusConnection *conn;
 	DBusPendingCall *call;
@@ -61,10 +83,101 @@ struct filter_data {
 	GSList *callbacks;
 	GSList *processed;
 	guint name_watch;
+	guint seq;
 	gboolean lock;
 	gboolean registered;
 };
 
+static gboolean format_key(char *key, size_t size, const char *interface,
+				const char *member, const char *argument)
+{
+	int len;
+
+	if (interface == NULL || member == NULL)
+		return FALSE;
+
+	if (argument)
+		len = snprintf(key, size, "%s %s %s", interface, member,
+								argument);
+	else
+		len = snprintf(key, size, "%s %s", interface, member);
+
+	return len >= 0 && (size_t) len < size;
+}
+
+static void index_insert(GHashTable *table, const char *key,
+						struct filter_data *data)
+{
+	GSList *list = g_hash_table_lookup(table, key);
+
+	g_hash_table_insert(table, g_strdup(key), g_slist_append(list, data));
+}
+
+static void index_remove(GHashTable *table, const char *key,
+						struct filter_data *data)
+{
+	GSList *list = g_hash_table_lookup(table, key);
+
+	list = g_slist_remove(list, data);
+	if (list)
+		g_hash_table_insert(table, g_strdup(key), list);
+	else
+		g_hash_table_remove(table, key);
+}
+
+static void listeners_add(struct filter_data *data)
+{
+	char key[DBUS_MAXIMUM_MATCH_RULE_LENGTH];
+
+	if (listeners_index == NULL) {
+		listeners_index = g_hash_table_new_full(g_str_hash,
+						g_str_equal, g_free, NULL);
+		listeners_names = g_hash_table_new_full(g_str_hash,
+						g_str_equal, g_free, NULL);
+		callbacks_index = g_hash_table_new(g_direct_hash,
+							g_direct_equal);
+	}
+
+	data->seq = ++listener_seq;
+	listeners = g_slist_append(listeners, data);
+
+	if (format_key(key, sizeof(key), data->interface, data->member,
+							data->argument))
+		index_insert(listeners_index, key, data);
+	else
+		listeners_any = g_slist_append(listeners_any, data);
+
+	if (data->name)
+		index_insert(listeners_names, data->name, data);
+}
+
+static void callbacks_index_remove(void *data, void *user_data)
+{
+	struct filter_callback *cb = data;
+
+	g_hash_table_remove(callbacks_index, GUINT_TO_POINTER(cb->id));
+}
+
+static void listeners_remove(struct filter_data *data)
+{
+	char key[DBUS_MAXIMUM_MATCH_RULE_LENGTH];
+
+	listeners = g_slist_remove(listeners, data);
+
+	/* Watches can no longer be removed by id once data is unlisted */
+	g_slist_foreach(data->callbacks, callbacks_index_remove, NULL);
+	g_slist_foreach(data->processed, callbacks_index_remove, NULL);
+
+	if (format_key(key, sizeof(key), data->interface, data->member,
+							data->argument))
+		index_remove(listeners_index, key, data);
+	else
+		listeners_any = g_slist_remove(listeners_any, data);
+
+	if (data->name)
+		index_remove(listeners_names, data->name, data);
+}
+
 static struct filter_data *filter_data_find_match(DBusConnection *connection,
 							const char *name,
 							const char *owner,
@@ -73,10 +186,18 @@ static struct filter_data *filter_data_find_match(DBusConnection *connection,
 							const char *member,
 							const char *argument)
 {
+	char key[DBUS_MAXIMUM_MATCH_RULE_LENGTH];
 	GSList *current;
 
-	for (current = listeners;
-			current != NULL; current = current->next) {
+	if (listeners_index == NULL)
+		return NULL;
+
+	if (format_key(key, sizeof(key), interface, member, argument))
+		current = g_hash_table_lookup(listeners_index, key);
+	else
+		current = listeners_any;
+
+	for (; current != NULL; current = current->next) {
 		struct filter_data *data = current->data;
 
 		if (connection != data->connection)
@@ -170,22 +291,71 @@ static gboolean format_rule(struct filter_data *data, char *rule, size_t size)
 	return TRUE;
 }
 
+static void pending_match_free(void *user_data)
+{
+	struct pending_match *match = user_data;
+
+	dbus_bus_remove_match(match->connection, match->rule, NULL);
+	dbus_connection_unref(match->connection);
+	g_free(match->rule);
+	g_free(match);
+}
+
+static void flush_pending_removes(void)
+{
+	if (pending_removes_id) {
+		g_source_remove(pending_removes_id);
+		pending_removes_id = 0;
+	}
+
+	g_slist_free_full(pending_removes, pending_match_free);
+	pending_removes = NULL;
+}
+
+static gboolean pending_removes_timeout(gpointer user_data)
+{
+	pending_removes_id = 0;
+	flush_pending_removes();
+
+	return FALSE;
+}
+
+/* Returns TRUE if the rule was pending removal and is kept installed */
+static gboolean cancel_pending_remove(DBusConnection *connection,
+							const char *rule)
+{
+	GSList *l;
+
+	for (l = pending_removes; l != NULL; l = l->next) {
+		struct pending_match *match = l->data;
+
+		if (match->connection != connection ||
+					!g_str_equal(match->rule, rule))
+			continue;
+
+		pending_removes = g_slist_delete_link(pending_removes, l);
+		dbus_connection_unref(match->connection);
+		g_free(match->rule);
+		g_free(match);
+
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
 static gboolean add_match(struct filter_data *data,
 				DBusHandleMessageFunction filter)
 {
-	DBusError err;
 	char rule[DBUS_MAXIMUM_MATCH_RULE_LENGTH];
 
 	format_rule(data, rule, sizeof(rule));
-	dbus_error_init(&err);
 
-	dbus_bus_add_match(data->connection, rule, &err);
-	if (dbus_error_is_set(&err)) {
-		error("Adding match rule \"%s\" failed: %s", rule,
-				err.message);
-		dbus_error_free(&err);
-		return FALSE;
-	}
+	/* Don't block waiting for the bus to reply, the rule is installed
+	 * before any message sent afterwards is processed.
+	 */
+	if (!cancel_pending_remove(data->connection, rule))
+		dbus_bus_add_match(data->connection, rule, NULL);
 
 	data->handle_func = filter;
 	data->registered = TRUE;
@@ -195,20 +365,19 @@ static gboolean add_match(struct filter_data *data,
 
 static gboolean remove_match(struct filter_data *data)
 {
-	DBusError err;
+	struct pending_match *match;
 	char rule[DBUS_MAXIMUM_MATCH_RULE_LENGTH];
 
 	format_rule(data, rule, sizeof(rule));
 
-	dbus_error_init(&err);
+	match = g_new0(struct pending_match, 1);
+	match->connection = dbus_connection_ref(data->connection);
+	match->rule = g_strdup(rule);
 
-	dbus_bus_remove_match(data->connection, rule, &err);
-	if (dbus_error_is_set(&err)) {
-		error("Removing owner match rule for %s failed: %s",
-				rule, err.message);
-		dbus_error_free(&err);
-		return FALSE;
-	}
+	pending_removes = g_slist_append(pending_removes, match);
+
+	if (!pending_removes_id)
+		pending_removes_id = g_idle_add(pending_removes_timeout, NULL);
 
 	return TRUE;
 }
@@ -285,7 +454,7 @@ proceed:
 		return NULL;
 	}
 
-	listeners = g_slist_append(listeners, data);
+	listeners_add(data);
 
 	return data;
 }
@@ -320,9 +489,9 @@ static void filter_data_call_and_free(struct filter_data *data)
 			cb->disc_func(data->connection, cb->user_data);
 		if (cb->destroy_func)
 			cb->destroy_func(cb->user_data);
-		g_free(cb);
 	}
 
+	/* Callbacks are freed along with data */
 	filter_data_free(data);
 }
 
@@ -350,6 +519,8 @@ static struct filter_callback *filter_data_add_callback(
 	else
 		data->callbacks = g_slist_append(data->callbacks, cb);
 
+	g_hash_table_insert(callbacks_index, GUINT_TO_POINTER(cb->id), data);
+
 	return cb;
 }
 
@@ -388,6 +559,7 @@ static gboolean filter_data_remove_callback(struct filter_data *data,
 	if (cb->destroy_func)
 		cb->destroy_func(cb->user_data);
 
+	g_hash_table_remove(callbacks_index, GUINT_TO_POINTER(cb->id));
 	g_free(cb);
 
 	/* Don't remove the filter if other callbacks exist or data is lock
@@ -398,7 +570,7 @@ static gboolean filter_data_remove_callback(struct filter_data *data,
 	if (data->registered && !remove_match(data))
 		return FALSE;
 
-	listeners = g_slist_remove(listeners, data);
+	listeners_remove(data);
 	filter_data_free(data);
 
 	return TRUE;
@@ -437,11 +609,12 @@ static void update_name_cache(const char *name, const char *owner)
 {
 	GSList *l;
 
-	for (l = listeners; l != NULL; l = l->next) {
-		struct filter_data *data = l->data;
+	if (listeners_names == NULL)
+		return;
 
-		if (g_strcmp0(data->name, name) != 0)
-			continue;
+	for (l = g_hash_table_lookup(listeners_names, name); l != NULL;
+								l = l->next) {
+		struct filter_data *data = l->data;
 
 		g_free(data->owner);
 		data->owner = g_strdup(owner);
@@ -452,16 +625,14 @@ static const char *check_name_cache(const char *name)
 {
 	GSList *l;
 
-	for (l = listeners; l != NULL; l = l->next) {
-		struct filter_data *data = l->data;
-
-		if (g_strcmp0(data->name, name) != 0)
-			continue;
+	if (listeners_names == NULL)
+		return NULL;
 
-		return data->owner;
-	}
+	l = g_hash_table_lookup(listeners_names, name);
+	if (l == NULL)
+		return NULL;
 
-	return NULL;
+	return ((struct filter_data *) l->data)->owner;
 }
 
 static DBusHandlerResult service_filter(DBusConnection *connection,
@@ -515,17 +686,44 @@ static DBusHandlerResult service_filter(DBusConnection *connection,
 }
 
 
+static gint filter_data_cmp_seq(gconstpointer a, gconstpointer b)
+{
+	const struct filter_data *data1 = a;
+	const struct filter_data *data2 = b;
+
+	return data1->seq < data2->seq ? -1 : data1->seq > data2->seq;
+}
+
+static GSList *message_listeners(const char *iface, const char *member,
+							const char *arg)
+{
+	char key[DBUS_MAXIMUM_MATCH_RULE_LENGTH];
+	GSList *list = NULL;
+
+	if (arg && format_key(key, sizeof(key), iface, member, arg))
+		list = g_slist_copy(g_hash_table_lookup(listeners_index, key));
+
+	if (format_key(key, sizeof(key), iface, member, NULL))
+		list = g_slist_concat(list, g_slist_copy(
+				g_hash_table_lookup(listeners_index, key)));
+
+	return g_slist_concat(list, g_slist_copy(listeners_any));
+}
+
 static DBusHandlerResult message_filter(DBusConnection *connection,
 					DBusMessage *message, void *user_data)
 {
 	struct filter_data *data;
 	const char *sender, *path, *iface, *member, *arg = NULL;
-	GSList *current, *delete_listener = NULL;
+	GSList *current, *matched = NULL;
 
 	/* Only filter signals */
 	if (dbus_message_get_type(message) != DBUS_MESSAGE_TYPE_SIGNAL)
 		return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
 
+	if (listeners_index == NULL)
+		return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+
 	sender = dbus_message_get_sender(message);
 	path = dbus_message_get_path(message);
 	iface = dbus_message_get_interface(message);
@@ -534,7 +732,8 @@ static DBusHandlerResult message_filter(DBusConnection *connection,
 
 	/* If sender != NULL it is always the owner */
 
-	for (current = listeners; current != NULL; current = current->next) {
+	for (current = message_listeners(iface, member, arg); current != NULL;
+				current = g_slist_delete_link(current, current)) {
 		data = current->data;
 
 		if (connection != data->connection)
@@ -560,42 +759,41 @@ static DBusHandlerResult message_filter(DBusConnection *connection,
 						data->argument) == FALSE)
 			continue;
 
-		if (data->handle_func) {
-			data->lock = TRUE;
+		/* Lock every listener to be called so none of them can be
+		 * freed by the callbacks of the others.
+		 */
+		data->lock = TRUE;
+		matched = g_slist_prepend(matched, data);
+	}
 
-			data->handle_func(connection, message, data);
+	/* Keep the order in which listeners were added */
+	matched = g_slist_sort(matched, filter_data_cmp_seq);
 
-			data->callbacks = data->processed;
-			data->processed = NULL;
-			data->lock = FALSE;
-		}
+	for (current = matched; current != NULL; current = current->next) {
+		data = current->data;
 
-		if (!data->callbacks)
-			delete_listener = g_slist_prepend(delete_listener,
-								current);
+		if (data->handle_func)
+			data->handle_func(connection, message, data);
 	}
 
-	if (delete_listener == NULL)
-		return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
-
-	for (current = delete_listener; current != NULL;
-					current = delete_listener->next) {
-		GSList *l = current->data;
+	for (current = matched; current != NULL;
+				current = g_slist_delete_link(current, current)) {
+		data = current->data;
 
-		data = l->data;
+		data->callbacks = g_slist_concat(data->callbacks,
+							data->processed);
+		data->processed = NULL;
+		data->lock = FALSE;
 
-		/* Has any other callback added callbacks back to this data? */
 		if (data->callbacks != NULL)
 			continue;
 
 		remove_match(data);
-		listeners = g_slist_delete_link(listeners, l);
+		listeners_remove(data);
 
 		filter_data_free(data);
 	}
 
-	g_slist_free(delete_listener);
-
 	return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
 }
 
@@ -798,22 +996,21 @@ gboolean g_dbus_remove_watch(DBusConnection *connection, guint id)
 {
 	struct filter_data *data;
 	struct filter_callback *cb;
-	GSList *ldata;
 
-	if (id == 0)
+	if (id == 0 || callbacks_index == NULL)
+		return FALSE;
+
+	data = g_hash_table_lookup(callbacks_index, GUINT_TO_POINTER(id));
+	if (data == NULL)
 		return FALSE;
 
-	for (ldata = listeners; ldata; ldata = ldata->next) {
-		data = ldata->data;
+	cb = filter_data_find_callback(data, id);
+	if (cb == NULL)
+		return FALSE;
 
-		cb = filter_data_find_callback(data, id);
-		if (cb) {
-			filter_data_remove_callback(data, cb);
-			return TRUE;
-		}
-	}
+	filter_data_remove_callback(data, cb);
 
-	return FALSE;
+	return TRUE;
 }
 
 void g_dbus_remove_all_watches(DBusConnection *connection)
@@ -821,7 +1018,9 @@ void g_dbus_remove_all_watches(DBusConnection *connection)
 	struct filter_data *data;
 
 	while ((data = filter_data_find(connection))) {
-		listeners = g_slist_remove(listeners, data);
+		listeners_remove(data);
 		filter_data_call_and_free(data);
 	}
+
+	flush_pending_removes();
 }
@@ -34,8 +34,122 @@ struct mesh_app_key {
 	uint8_t key_aid;
 	uint8_t new_key[16];
 	uint8_t new_key_aid;
+	struct l_aead_cipher *ccm[2];
+	struct l_aead_cipher *new_ccm[2];
 };
 
+/* One candidate per key phase, ordered as in the App Key list */
+struct aid_slot {
+	struct mesh_app_key *key;
+	bool new_key;
+};
+
+#define AID_BUCKETS	64
+
+struct mesh_aid_index {
+	struct l_queue *buckets[AID_BUCKETS];
+};
+
+static void free_ciphers(struct l_aead_cipher **ccm)
+{
+	l_aead_cipher_free(ccm[0]);
+	l_aead_cipher_free(ccm[1]);
+	ccm[0] = NULL;
+	ccm[1] = NULL;
+}
+
+void appkey_aid_index_free(struct mesh_aid_index *index)
+{
+	int i;
+
+	if (!index)
+		return;
+
+	for (i = 0; i < AID_BUCKETS; i++)
+		l_queue_destroy(index->buckets[i], l_free);
+
+	l_free(index);
+}
+
+static void invalidate_aid_index(struct mesh_net *net)
+{
+	appkey_aid_index_free(mesh_net_get_aid_index(net));
+	mesh_net_set_aid_index(net, NULL);
+}
+
+static void add_aid_slot(struct mesh_aid_index *index,
+				struct mesh_app_key *key, bool new_key)
+{
+	uint8_t aid = new_key ? key->new_key_aid : key->key_aid;
+	struct aid_slot *slot;
+	struct l_queue **bucket;
+
+	if (aid == APP_AID_INVALID)
+		return;
+
+	bucket = &index->buckets[aid & (AID_BUCKETS - 1)];
+	if (!*bucket)
+		*bucket = l_queue_new();
+
+	slot = l_new(struct aid_slot, 1);
+	slot->key = key;
+	slot->new_key = new_key;
+	l_queue_push_tail(*bucket, slot);
+}
+
+struct l_queue *appkey_get_aid_keys(struct mesh_net *net, uint8_t key_aid)
+{
+	struct mesh_aid_index *index;
+	const struct l_queue_entry *entry;
+
+	index = mesh_net_get_aid_index(net);
+	if (!index) {
+		index = l_new(struct mesh_aid_index, 1);
+
+		entry = l_queue_get_entries(mesh_net_get_app_keys(net));
+		for (; entry; entry = entry->next) {
+			add_aid_slot(index, entry->data, false);
+			add_aid_slot(index, entry->data, true);
+		}
+
+		mesh_net_set_aid_index(net, index);
+	}
+
+	return index->buckets[key_aid & (AID_BUCKETS - 1)];
+}
+
+int appkey_get_aid_cipher(void *data, uint8_t key_aid, bool szmict,
+						const uint8_t **key,
+						struct l_aead_cipher **cipher)
+{
+	struct aid_slot *slot = data;
+	struct mesh_app_key *app_key = slot->key;
+	struct l_aead_cipher **ccm;
+	const uint8_t *value;
+
+	if (slot->new_key) {
+		if (app_key->new_key_aid != key_aid)
+			return -1;
+
+		value = app_key->new_key;
+		ccm = &app_key->new_ccm[szmict];
+	} else {
+		if (app_key->key_aid != key_aid)
+			return -1;
+
+		value = app_key->key;
+		ccm = &app_key->ccm[szmict];
+	}
+
+	if (!*ccm)
+		*ccm = mesh_crypto_payload_cipher_new(value, szmict);
+
+	*key = value;
+	*cipher = *ccm;
+
+	return app_key->app_idx;
+}
+
 static bool match_key_index(const void *a, const void *b)
 {
 	const struct mesh_app_key *key = a;
@@ -68,6 +182,12 @@ static void finalize_key(void *a, void *b)
 	key->new_key_aid = APP_AID_INVALID;
 
 	memcpy(key->key, key->new_key, 16);
+
+	free_ciphers(key->ccm);
+	key->ccm[0] = key->new_ccm[0];
+	key->ccm[1] = key->new_ccm[1];
+	key->new_ccm[0] = NULL;
+	key->new_ccm[1] = NULL;
 }
 
 void appkey_finalize(struct mesh_net *net, uint16_t net_idx)
@@ -79,6 +199,7 @@ void appkey_finalize(struct mesh_net *net, uint16_t net_idx)
 		return;
 
 	l_queue_foreach(app_keys, finalize_key, L_UINT_TO_PTR(net_idx));
+	invalidate_aid_index(net);
 }
 
 static struct mesh_app_key *app_key_new(void)
@@ -104,6 +225,7 @@ static bool set_key(struct mesh_app_key *key, uint16_t app_idx,
 		key->new_key_aid = key_aid;
 
 	memcpy(is_new ? key->new_key : key->key, key_value, 16);
+	free_ciphers(is_new ? key->new_ccm : key->ccm);
 
 	return true;
 }
@@ -115,6 +237,8 @@ void appkey_key_free(void *data)
 	if (!key)
 		return;
 
+	free_ciphers(key->ccm);
+	free_ciphers(key->new_ccm);
 	l_free(key);
 }
 
@@ -152,6 +276,7 @@ bool appkey_key_init(struct mesh_net *net, uint16_t net_idx, uint16_t app_idx,
 	}
 
 	l_queue_push_tail(app_keys, key);
+	invalidate_aid_index(net);
 
 	return true;
 }
@@ -276,6 +401,8 @@ int appkey_key_update(struct mesh_net *net, uint16_t net_idx, uint16_t app_idx,
 	if (!set_key(key, app_idx, new_key, true))
 		return MESH_STATUS_INSUFF_RESOURCES;
 
+	invalidate_aid_index(net);
+
 	node = mesh_net_node_get(net);
 
 	if (!mesh_config_app_key_update(node_config_get(node), app_idx,
@@ -330,6 +457,7 @@ int appkey_key_add(struct mesh_net *net, uint16_t net_idx, uint16_t app_idx,
 	key->net_idx = net_idx;
 	key->app_idx = app_idx;
 	l_queue_push_tail(app_keys, key);
+	invalidate_aid_index(net);
 
 	return MESH_STATUS_SUCCESS;
 }
@@ -358,6 +486,7 @@ int appkey_key_delete(struct mesh_net *net, uint16_t net_idx,
 	node_app_key_delete(node, net_idx, app_idx);
 
 	l_queue_remove(app_keys, key);
+	invalidate_aid_index(net);
 	appkey_key_free(key);
 
 	if (!mesh_config_app_key_del(node_config_get(node), net_idx, app_idx))
@@ -377,6 +506,7 @@ void appkey_delete_bound_keys(struct mesh_net *net, uint16_t net_idx)
 		return;
 
 	node = mesh_net_node_get(net);
+	invalidate_aid_index(net);
 
 	key = l_queue_remove_if(app_keys, match_bound_key,
 					L_UINT_TO_PTR(net_idx));
@@ -12,6 +12,8 @@
 #define MAX_APP_KEYS	32
 
 struct mesh_app_key;
+struct mesh_aid_index;
+struct l_aead_cipher;
 
 bool appkey_key_init(struct mesh_net *net, uint16_t net_idx, uint16_t app_idx,
 				uint8_t *key_value, uint8_t *new_key_value);
@@ -22,6 +24,11 @@ const uint8_t *appkey_get_key(struct mesh_net *net, uint16_t app_idx,
 int appkey_get_key_idx(struct mesh_app_key *app_key,
 				const uint8_t **key, uint8_t *key_aid,
 				const uint8_t **new_key, uint8_t *new_key_aid);
+struct l_queue *appkey_get_aid_keys(struct mesh_net *net, uint8_t key_aid);
+int appkey_get_aid_cipher(void *data, uint8_t key_aid, bool szmict,
+						const uint8_t **key,
+						struct l_aead_cipher **cipher);
+void appkey_aid_index_free(struct mesh_aid_index *index);
 bool appkey_have_key(struct mesh_net *net, uint16_t app_idx);
 uint16_t appkey_net_idx(struct mesh_net *net, uint16_t app_idx);
 int appkey_key_add(struct mesh_net *net, uint16_t net_idx, uint16_t app_idx,
@@ -99,18 +99,16 @@ bool mesh_crypto_aes_ccm_encrypt(const uint8_t nonce[13], const uint8_t key[16],
 	return result;
 }
 
-bool mesh_crypto_aes_ccm_decrypt(const uint8_t nonce[13], const uint8_t key[16],
+static bool ccm_decrypt(struct l_aead_cipher *cipher,
+				const uint8_t nonce[13],
 				const uint8_t *aad, uint16_t aad_len,
 				const void *enc_msg, uint16_t enc_msg_len,
 				void *out_msg,
 				void *out_mic, size_t mic_size)
 {
-	void *cipher;
 	bool result;
 	size_t out_msg_len = enc_msg_len - mic_size;
 
-	cipher = l_aead_cipher_new(L_AEAD_CIPHER_AES_CCM, key, 16, mic_size);
-
 	result = l_aead_cipher_decrypt(cipher, enc_msg, enc_msg_len,
 							aad, aad_len, nonce, 13,
 							out_msg, out_msg_len);
@@ -124,6 +122,23 @@ bool mesh_crypto_aes_ccm_decrypt(const uint8_t nonce[13], const uint8_t key[16],
 				l_get_be64(enc_msg + enc_msg_len - mic_size);
 	}
 
+	return result;
+}
+
+bool mesh_crypto_aes_ccm_decrypt(const uint8_t nonce[13], const uint8_t key[16],
+				const uint8_t *aad, uint16_t aad_len,
+				const void *enc_msg, uint16_t enc_msg_len,
+				void *out_msg,
+				void *out_mic, size_t mic_size)
+{
+	struct l_aead_cipher *cipher;
+	bool result;
+
+	cipher = l_aead_cipher_new(L_AEAD_CIPHER_AES_CCM, key, 16, mic_size);
+
+	result = ccm_decrypt(cipher, nonce, aad, aad_len, enc_msg, enc_msg_len,
+						out_msg, out_mic, mic_size);
+
 	l_aead_cipher_free(cipher);
 
 	return result;
@@ -747,19 +762,19 @@ bool mesh_crypto_payload_encrypt(uint8_t *aad, const uint8_t *payload,
 	return true;
 }
 
-bool mesh_crypto_payload_decrypt(uint8_t *aad, uint16_t aad_len,
+static bool payload_decrypt(struct l_aead_cipher *cipher,
+				uint8_t *aad, uint16_t aad_len,
 				const uint8_t *payload, uint16_t payload_len,
 				bool aszmic,
 				uint16_t src, uint16_t dst,
 				uint8_t key_aid, uint32_t seq,
-				uint32_t iv_index, uint8_t *out,
-				const uint8_t app_key[16])
+				uint32_t iv_index, uint8_t *out)
 {
 	uint8_t nonce[13];
 	uint32_t mic32;
 	uint64_t mic64;
 
-	if (payload_len < 5 || !out)
+	if (payload_len < 5 || !out || !cipher)
 		return false;
 
 	if (key_aid == APP_AID_DEV)
@@ -772,7 +787,7 @@ bool mesh_crypto_payload_decrypt(uint8_t *aad, uint16_t aad_len,
 	memcpy(out, payload, payload_len);
 
 	if (aszmic) {
-		if (!mesh_crypto_aes_ccm_decrypt(nonce, app_key,
+		if (!ccm_decrypt(cipher, nonce,
 					aad, aad_len,
 					payload, payload_len,
 					out, &mic64, sizeof(mic64)))
@@ -784,7 +799,7 @@ bool mesh_crypto_payload_decrypt(uint8_t *aad, uint16_t aad_len,
 		if (mic64)
 			return false;
 	} else {
-		if (!mesh_crypto_aes_ccm_decrypt(nonce, app_key,
+		if (!ccm_decrypt(cipher, nonce,
 					aad, aad_len,
 					payload, payload_len,
 					out, &mic32, sizeof(mic32)))
@@ -800,6 +815,54 @@ bool mesh_crypto_payload_decrypt(uint8_t *aad, uint16_t aad_len,
 	return true;
 }
 
+bool mesh_crypto_payload_decrypt(uint8_t *aad, uint16_t aad_len,
+				const uint8_t *payload, uint16_t payload_len,
+				bool aszmic,
+				uint16_t src, uint16_t dst,
+				uint8_t key_aid, uint32_t seq,
+				uint32_t iv_index, uint8_t *out,
+				const uint8_t app_key[16])
+{
+	struct l_aead_cipher *cipher;
+	bool result;
+
+	cipher = l_aead_cipher_new(L_AEAD_CIPHER_AES_CCM, app_key, 16,
+							aszmic ? 8 : 4);
+
+	result = payload_decrypt(cipher, aad, aad_len, payload, payload_len,
+					aszmic, src, dst, key_aid, seq,
+					iv_index, out);
+
+	l_aead_cipher_free(cipher);
+
+	return result;
+}
+
+/*
+ * Same as mesh_crypto_payload_decrypt() using an AES-CCM cipher from
+ * mesh_crypto_payload_cipher_new(), so that the key schedule is reused
+ * when decrypting many payloads with the same key
+ */
+bool mesh_crypto_payload_decrypt_cipher(struct l_aead_cipher *cipher,
+				uint8_t *aad, uint16_t aad_len,
+				const uint8_t *payload, uint16_t payload_len,
+				bool aszmic,
+				uint16_t src, uint16_t dst,
+				uint8_t key_aid, uint32_t seq,
+				uint32_t iv_index, uint8_t *out)
+{
+	return payload_decrypt(cipher, aad, aad_len, payload, payload_len,
+					aszmic, src, dst, key_aid, seq,
+					iv_index, out);
+}
+
+struct l_aead_cipher *mesh_crypto_payload_cipher_new(
+					const uint8_t app_key[16], bool aszmic)
+{
+	return l_aead_cipher_new(L_AEAD_CIPHER_AES_CCM, app_key, 16,
+							aszmic ? 8 : 4);
+}
+
 static bool mesh_crypto_packet_encrypt(uint8_t *packet, uint8_t packet_len,
 				const uint8_t network_key[16],
 				uint32_t iv_index, bool proxy,
@@ -12,6 +12,8 @@
 #include <stdint.h>
 #include <stdlib.h>
 
+struct l_aead_cipher;
+
 bool mesh_crypto_aes_ccm_encrypt(const uint8_t nonce[13], const uint8_t key[16],
 					const uint8_t *aad, uint16_t aad_len,
 					const void *msg, uint16_t msg_len,
@@ -87,6 +89,16 @@ bool mesh_crypto_payload_decrypt(uint8_t *aad, uint16_t aad_len,
 				uint32_t seq_num, uint32_t iv_index,
 				uint8_t *out,
 				const uint8_t application_key[16]);
+struct l_aead_cipher *mesh_crypto_payload_cipher_new(
+					const uint8_t application_key[16],
+					bool szmict);
+bool mesh_crypto_payload_decrypt_cipher(struct l_aead_cipher *cipher,
+				uint8_t *aad, uint16_t aad_len,
+				const uint8_t *payload, uint16_t payload_len,
+				bool szmict,
+				uint16_t src, uint16_t dst, uint8_t key_aid,
+				uint32_t seq_num, uint32_t iv_index,
+				uint8_t *out);
 bool mesh_crypto_packet_encode(uint8_t *packet, uint8_t packet_len,
 				uint32_t iv_index,
 				const uint8_t network_key[16],
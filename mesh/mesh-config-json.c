@@ -40,6 +40,9 @@
 
 #define CHECK_KEY_IDX_RANGE(x) ((x) <= 4095)
 
+/* Window over which configuration changes are coalesced into one write */
+#define SAVE_DELAY_MS		500
+
 struct mesh_config {
 	json_object *jnode;
 	char *node_dir_path;
@@ -47,6 +50,7 @@ struct mesh_config {
 	uint32_t write_seq;
 	struct timeval write_time;
 	struct l_queue *idles;
+	struct l_timeout *save_timeout;
 };
 
 struct write_info {
@@ -86,30 +90,119 @@ static const char *disabled = "disabled";
 static const char *unsupported = "unsupported";
 
 
-static bool save_config(json_object *jnode, const char *fname)
+static bool write_config(json_object *jnode, const char *fname)
 {
-	FILE *outfile;
 	const char *str;
-	bool result = false;
+	size_t len, written = 0;
+	int fd;
 
-	outfile = fopen(fname, "w");
-	if (!outfile) {
-		l_error("Failed to save configuration to %s", fname);
+	fd = open(fname, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	if (fd < 0)
 		return false;
-	}
 
-	str = json_object_to_json_string_ext(jnode, JSON_C_TO_STRING_PRETTY);
+	str = json_object_to_json_string_ext(jnode, JSON_C_TO_STRING_PLAIN);
+	len = strlen(str);
+
+	while (written < len) {
+		ssize_t ret = write(fd, str + written, len - written);
+
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+
+			break;
+		}
+
+		written += ret;
+	}
 
-	if (fwrite(str, sizeof(char), strlen(str), outfile) < strlen(str))
+	if (written < len || fsync(fd) < 0) {
 		l_warn("Incomplete write of mesh configuration");
-	else
-		result = true;
+		close(fd);
+		return false;
+	}
 
-	fclose(outfile);
+	return close(fd) == 0;
+}
+
+static void sync_dir(const char *fname)
+{
+	char *dir = l_strdup(fname);
+	int fd;
+
+	fd = open(dirname(dir), O_RDONLY | O_DIRECTORY);
+	if (fd >= 0) {
+		fsync(fd);
+		close(fd);
+	}
+
+	l_free(dir);
+}
+
+/*
+ * The new configuration is written and synced to a temporary file before
+ * replacing node.json, the previous version being kept as node.json.bak so
+ * that loading can fall back to it if interrupted at any point.
+ */
+static bool save_config(struct mesh_config *cfg)
+{
+	char *fname_tmp, *fname_bak, *fname_cfg;
+	bool result;
+
+	l_timeout_remove(cfg->save_timeout);
+	cfg->save_timeout = NULL;
+
+	fname_cfg = cfg->node_dir_path;
+	fname_tmp = l_strdup_printf("%s%s", fname_cfg, tmp_ext);
+	fname_bak = l_strdup_printf("%s%s", fname_cfg, bak_ext);
+	remove(fname_tmp);
+
+	result = write_config(cfg->jnode, fname_tmp);
+
+	if (result) {
+		remove(fname_bak);
+
+		if (rename(fname_cfg, fname_bak) < 0 && errno != ENOENT)
+			result = false;
+		else if (rename(fname_tmp, fname_cfg) < 0)
+			result = false;
+		else
+			sync_dir(fname_cfg);
+	}
+
+	remove(fname_tmp);
+
+	l_free(fname_tmp);
+	l_free(fname_bak);
+
+	if (!result)
+		l_error("Failed to save configuration to %s", fname_cfg);
 
 	return result;
 }
 
+static void save_timeout(struct l_timeout *timeout, void *user_data)
+{
+	struct mesh_config *cfg = user_data;
+
+	save_config(cfg);
+	gettimeofday(&cfg->write_time, NULL);
+}
+
+/* Marks the configuration dirty, the write happens when the window closes */
+static bool save_deferred(struct mesh_config *cfg)
+{
+	if (cfg->save_timeout)
+		return true;
+
+	cfg->save_timeout = l_timeout_create_ms(SAVE_DELAY_MS, save_timeout,
+								cfg, NULL);
+	if (!cfg->save_timeout)
+		return save_config(cfg);
+
+	return true;
+}
+
 static bool get_int(json_object *jobj, const char *keyword, int *value)
 {
 	json_object *jvalue;
@@ -674,7 +767,7 @@ bool mesh_config_net_key_add(struct mesh_config *cfg, uint16_t idx,
 
 	json_object_array_add(jarray, jentry);
 
-	return save_config(jnode, cfg->node_dir_path);
+	return save_deferred(cfg);
 
 fail:
 	if (jentry)
@@ -716,7 +809,7 @@ bool mesh_config_net_key_update(struct mesh_config *cfg, uint16_t idx,
 	json_object_object_add(jentry, keyRefresh,
 				json_object_new_int(KEY_REFRESH_PHASE_ONE));
 
-	return save_config(jnode, cfg->node_dir_path);
+	return save_deferred(cfg);
 }
 
 bool mesh_config_net_key_del(struct mesh_config *cfg, uint16_t idx)
@@ -736,7 +829,7 @@ bool mesh_config_net_key_del(struct mesh_config *cfg, uint16_t idx)
 	if (!json_object_array_length(jarray))
 		json_object_object_del(jnode, netKeys);
 
-	return save_config(jnode, cfg->node_dir_path);
+	return save_deferred(cfg);
 }
 
 bool mesh_config_write_device_key(struct mesh_config *cfg, const uint8_t *key)
@@ -744,7 +837,7 @@ bool mesh_config_write_device_key(struct mesh_config *cfg, const uint8_t *key)
 	if (!cfg || !add_key_value(cfg->jnode, deviceKey, key))
 		return false;
 
-	return save_config(cfg->jnode, cfg->node_dir_path);
+	return save_deferred(cfg);
 }
 
 bool mesh_config_write_candidate(struct mesh_config *cfg, const uint8_t *key)
@@ -752,7 +845,7 @@ bool mesh_config_write_candidate(struct mesh_config *cfg, const uint8_t *key)
 	if (!cfg || !add_key_value(cfg->jnode, deviceCan, key))
 		return false;
 
-	return save_config(cfg->jnode, cfg->node_dir_path);
+	return save_deferred(cfg);
 }
 
 bool mesh_config_read_candidate(struct mesh_config *cfg, uint8_t *key)
@@ -779,7 +872,7 @@ bool mesh_config_finalize_candidate(struct mesh_config *cfg)
 	if (!add_key_value(cfg->jnode, deviceKey, key))
 		return false;
 
-	return save_config(cfg->jnode, cfg->node_dir_path);
+	return save_deferred(cfg);
 }
 
 bool mesh_config_write_token(struct mesh_config *cfg, const uint8_t *token)
@@ -787,7 +880,7 @@ bool mesh_config_write_token(struct mesh_config *cfg, const uint8_t *token)
 	if (!cfg || !add_u64_value(cfg->jnode, "token", token))
 		return false;
 
-	return save_config(cfg->jnode, cfg->node_dir_path);
+	return save_deferred(cfg);
 }
 
 bool mesh_config_app_key_add(struct mesh_config *cfg, uint16_t net_idx,
@@ -830,7 +923,7 @@ bool mesh_config_app_key_add(struct mesh_config *cfg, uint16_t net_idx,
 
 	json_object_array_add(jarray, jentry);
 
-	return save_config(jnode, cfg->node_dir_path);
+	return save_deferred(cfg);
 
 fail:
 
@@ -872,7 +965,7 @@ bool mesh_config_app_key_update(struct mesh_config *cfg, uint16_t app_idx,
 	if (!add_key_value(jentry, "key", key))
 		return false;
 
-	return save_config(jnode, cfg->node_dir_path);
+	return save_deferred(cfg);
 }
 
 bool mesh_config_app_key_del(struct mesh_config *cfg, uint16_t net_idx,
@@ -893,7 +986,7 @@ bool mesh_config_app_key_del(struct mesh_config *cfg, uint16_t net_idx,
 	if (!json_object_array_length(jarray))
 		json_object_object_del(jnode, appKeys);
 
-	return save_config(jnode, cfg->node_dir_path);
+	return save_deferred(cfg);
 }
 
 bool mesh_config_model_binding_add(struct mesh_config *cfg, uint16_t ele_addr,
@@ -940,7 +1033,7 @@ bool mesh_config_model_binding_add(struct mesh_config *cfg, uint16_t ele_addr,
 
 	json_object_array_add(jarray, jstring);
 
-	return save_config(jnode, cfg->node_dir_path);
+	return save_deferred(cfg);
 }
 
 bool mesh_config_model_binding_del(struct mesh_config *cfg, uint16_t ele_addr,
@@ -976,7 +1069,7 @@ bool mesh_config_model_binding_del(struct mesh_config *cfg, uint16_t ele_addr,
 	if (!json_object_array_length(jarray))
 		json_object_object_del(jmodel, bind);
 
-	return save_config(jnode, cfg->node_dir_path);
+	return save_deferred(cfg);
 }
 
 static void free_model(void *data)
@@ -1587,7 +1680,7 @@ bool mesh_config_write_mode(struct mesh_config *cfg, const char *keyword,
 	if (!cfg || !write_mode(cfg->jnode, keyword, value))
 		return false;
 
-	return save_config(cfg->jnode, cfg->node_dir_path);
+	return save_deferred(cfg);
 }
 
 bool mesh_config_write_mode_ex(struct mesh_config *cfg, const char *keyword,
@@ -1635,7 +1728,7 @@ bool mesh_config_write_unicast(struct mesh_config *cfg, uint16_t unicast)
 	if (!cfg || !write_uint16_hex(cfg->jnode, unicastAddress, unicast))
 		return false;
 
-	return save_config(cfg->jnode, cfg->node_dir_path);
+	return save_deferred(cfg);
 }
 
 bool mesh_config_write_relay_mode(struct mesh_config *cfg, uint8_t mode,
@@ -1645,7 +1738,7 @@ bool mesh_config_write_relay_mode(struct mesh_config *cfg, uint8_t mode,
 	if (!cfg || !write_relay_mode(cfg->jnode, mode, count, interval))
 		return false;
 
-	return save_config(cfg->jnode, cfg->node_dir_path);
+	return save_deferred(cfg);
 }
 
 bool mesh_config_write_mpb(struct mesh_config *cfg, uint8_t mode,
@@ -1660,7 +1753,7 @@ bool mesh_config_write_mpb(struct mesh_config *cfg, uint8_t mode,
 			return false;
 	}
 
-	return save_config(cfg->jnode, cfg->node_dir_path);
+	return save_deferred(cfg);
 }
 
 bool mesh_config_write_net_transmit(struct mesh_config *cfg, uint8_t cnt,
@@ -1686,7 +1779,7 @@ bool mesh_config_write_net_transmit(struct mesh_config *cfg, uint8_t cnt,
 	json_object_object_del(jnode, retransmit);
 	json_object_object_add(jnode, retransmit, jrtx);
 
-	return save_config(cfg->jnode, cfg->node_dir_path);
+	return save_deferred(cfg);
 
 fail:
 	json_object_put(jrtx);
@@ -1711,7 +1804,8 @@ bool mesh_config_write_iv_index(struct mesh_config *cfg, uint32_t idx,
 	if (!write_int(jnode, "IVupdate", tmp))
 		return false;
 
-	return save_config(jnode, cfg->node_dir_path);
+	/* IV Index changes are written through immediately */
+	return save_config(cfg);
 }
 
 static void add_model(void *a, void *b)
@@ -2000,7 +2094,7 @@ bool mesh_config_net_key_set_phase(struct mesh_config *cfg, uint16_t idx,
 		finish_key_refresh(jnode, idx);
 	}
 
-	return save_config(jnode, cfg->node_dir_path);
+	return save_deferred(cfg);
 }
 
 bool mesh_config_model_pub_add(struct mesh_config *cfg, uint16_t ele_addr,
@@ -2063,7 +2157,7 @@ bool mesh_config_model_pub_add(struct mesh_config *cfg, uint16_t ele_addr,
 	json_object_object_add(jpub, retransmit, jrtx);
 	json_object_object_add(jmodel, publish, jpub);
 
-	return save_config(jnode, cfg->node_dir_path);
+	return save_deferred(cfg);
 
 fail:
 	json_object_put(jpub);
@@ -2096,7 +2190,7 @@ bool mesh_config_model_pub_del(struct mesh_config *cfg, uint16_t addr,
 								publish))
 		return false;
 
-	return save_config(cfg->jnode, cfg->node_dir_path);
+	return save_deferred(cfg);
 }
 
 static bool del_page(json_object *jarray, uint8_t page)
@@ -2142,7 +2236,7 @@ void mesh_config_comp_page_del(struct mesh_config *cfg, uint8_t page)
 	json_object_object_get_ex(jnode, "pages", &jarray);
 
 	if (del_page(jarray, page))
-		save_config(jnode, cfg->node_dir_path);
+		save_deferred(cfg);
 }
 
 bool mesh_config_comp_page_add(struct mesh_config *cfg, uint8_t page,
@@ -2182,7 +2276,7 @@ bool mesh_config_comp_page_add(struct mesh_config *cfg, uint8_t page,
 	json_object_array_add(jarray, jstring);
 	l_free(buf);
 
-	return save_config(jnode, cfg->node_dir_path);
+	return save_deferred(cfg);
 }
 
 bool mesh_config_model_sub_add(struct mesh_config *cfg, uint16_t ele_addr,
@@ -2234,7 +2328,7 @@ bool mesh_config_model_sub_add(struct mesh_config *cfg, uint16_t ele_addr,
 
 	json_object_array_add(jarray, jstring);
 
-	return save_config(jnode, cfg->node_dir_path);
+	return save_deferred(cfg);
 }
 
 bool mesh_config_model_sub_del(struct mesh_config *cfg, uint16_t ele_addr,
@@ -2275,7 +2369,7 @@ bool mesh_config_model_sub_del(struct mesh_config *cfg, uint16_t ele_addr,
 	if (!json_object_array_length(jarray))
 		json_object_object_del(jmodel, subscribe);
 
-	return save_config(jnode, cfg->node_dir_path);
+	return save_deferred(cfg);
 }
 
 bool mesh_config_model_sub_del_all(struct mesh_config *cfg, uint16_t addr,
@@ -2285,7 +2379,7 @@ bool mesh_config_model_sub_del_all(struct mesh_config *cfg, uint16_t addr,
 								subscribe))
 		return false;
 
-	return save_config(cfg->jnode, cfg->node_dir_path);
+	return save_deferred(cfg);
 }
 
 bool mesh_config_model_pub_enable(struct mesh_config *cfg, uint16_t ele_addr,
@@ -2314,7 +2408,7 @@ bool mesh_config_model_pub_enable(struct mesh_config *cfg, uint16_t ele_addr,
 	if (!enable)
 		json_object_object_del(jmodel, publish);
 
-	return save_config(cfg->jnode, cfg->node_dir_path);
+	return save_deferred(cfg);
 }
 
 bool mesh_config_model_sub_enable(struct mesh_config *cfg, uint16_t ele_addr,
@@ -2343,7 +2437,7 @@ bool mesh_config_model_sub_enable(struct mesh_config *cfg, uint16_t ele_addr,
 	if (!enable)
 		json_object_object_del(jmodel, subscribe);
 
-	return save_config(cfg->jnode, cfg->node_dir_path);
+	return save_deferred(cfg);
 }
 
 bool mesh_config_write_seq_number(struct mesh_config *cfg, uint32_t seq,
@@ -2427,7 +2521,7 @@ bool mesh_config_write_ttl(struct mesh_config *cfg, uint8_t ttl)
 	if (!cfg || !write_int(cfg->jnode, defaultTTL, ttl))
 		return false;
 
-	return save_config(cfg->jnode, cfg->node_dir_path);
+	return save_deferred(cfg);
 }
 
 bool mesh_config_update_company_id(struct mesh_config *cfg, uint16_t cid)
@@ -2435,7 +2529,7 @@ bool mesh_config_update_company_id(struct mesh_config *cfg, uint16_t cid)
 	if (!cfg || !write_uint16_hex(cfg->jnode, "cid", cid))
 		return false;
 
-	return save_config(cfg->jnode, cfg->node_dir_path);
+	return save_deferred(cfg);
 }
 
 bool mesh_config_update_product_id(struct mesh_config *cfg, uint16_t pid)
@@ -2443,7 +2537,7 @@ bool mesh_config_update_product_id(struct mesh_config *cfg, uint16_t pid)
 	if (!cfg || !write_uint16_hex(cfg->jnode, "pid", pid))
 		return false;
 
-	return save_config(cfg->jnode, cfg->node_dir_path);
+	return save_deferred(cfg);
 }
 
 bool mesh_config_update_version_id(struct mesh_config *cfg, uint16_t vid)
@@ -2451,7 +2545,7 @@ bool mesh_config_update_version_id(struct mesh_config *cfg, uint16_t vid)
 	if (!cfg || !write_uint16_hex(cfg->jnode, "vid", vid))
 		return false;
 
-	return save_config(cfg->jnode, cfg->node_dir_path);
+	return save_deferred(cfg);
 }
 
 bool mesh_config_update_crpl(struct mesh_config *cfg, uint16_t crpl)
@@ -2459,7 +2553,7 @@ bool mesh_config_update_crpl(struct mesh_config *cfg, uint16_t crpl)
 	if (!cfg || !write_uint16_hex(cfg->jnode, "crpl", crpl))
 		return false;
 
-	return save_config(cfg->jnode, cfg->node_dir_path);
+	return save_deferred(cfg);
 }
 
 static bool load_node(const char *fname, const uint8_t uuid[16],
@@ -2565,6 +2659,10 @@ void mesh_config_release(struct mesh_config *cfg)
 
 	l_queue_destroy(cfg->idles, release_idle);
 
+	/* Flush any pending changes */
+	if (cfg->save_timeout)
+		save_config(cfg);
+
 	l_free(cfg->node_dir_path);
 	json_object_put(cfg->jnode);
 	l_free(cfg);
@@ -2573,28 +2671,9 @@ void mesh_config_release(struct mesh_config *cfg)
 static void idle_save_config(struct l_idle *idle, void *user_data)
 {
 	struct write_info *info = user_data;
-	char *fname_tmp, *fname_bak, *fname_cfg;
-	bool result = false;
-
-	fname_cfg = info->cfg->node_dir_path;
-	fname_tmp = l_strdup_printf("%s%s", fname_cfg, tmp_ext);
-	fname_bak = l_strdup_printf("%s%s", fname_cfg, bak_ext);
-	remove(fname_tmp);
-
-	result = save_config(info->cfg->jnode, fname_tmp);
-
-	if (result) {
-		remove(fname_bak);
-
-		if (rename(fname_cfg, fname_bak) < 0 ||
-					rename(fname_tmp, fname_cfg) < 0)
-			result = false;
-	}
-
-	remove(fname_tmp);
+	bool result;
 
-	l_free(fname_tmp);
-	l_free(fname_bak);
+	result = save_config(info->cfg);
 
 	gettimeofday(&info->cfg->write_time, NULL);
 
@@ -2702,6 +2781,9 @@ void mesh_config_destroy_nvm(struct mesh_config *cfg)
 	if (!cfg)
 		return;
 
+	l_timeout_remove(cfg->save_timeout);
+	cfg->save_timeout = NULL;
+
 	node_dir = dirname(cfg->node_dir_path);
 	l_debug("Delete node config %s", node_dir);
 
@@ -73,8 +73,29 @@ struct mod_forward {
 	bool done;
 };
 
+/* Models of an element subscribed to a destination */
+struct sub_target {
+	uint8_t ele_idx;
+	struct mesh_model *mod;
+};
+
+/*
+ * Per node map from a group address, or the mesh_virtual of a label,
+ * to the models subscribed to it, in element and model order
+ */
+struct mesh_sub_index {
+	struct l_hashmap *targets;
+	uint32_t generation;
+};
+
 static struct l_queue *mesh_virtuals;
 
+/* Virtual labels sharing a 16-bit hash, keyed by virtual address */
+static struct l_hashmap *virt_by_addr;
+
+/* Bumped on any subscription change to invalidate all indexes */
+static uint32_t sub_generation = 1;
+
 static bool is_internal(uint32_t id)
 {
 	if (id == CONFIG_SRV_MODEL || id == CONFIG_CLI_MODEL)
@@ -89,6 +110,45 @@ static bool is_internal(uint32_t id)
 	return false;
 }
 
+static void subs_changed(void)
+{
+	sub_generation++;
+}
+
+static void virt_addr_add(struct mesh_virtual *virt)
+{
+	void *key = L_UINT_TO_PTR(virt->addr);
+	struct l_queue *virts = l_hashmap_lookup(virt_by_addr, key);
+
+	if (!virts) {
+		virts = l_queue_new();
+		l_hashmap_insert(virt_by_addr, key, virts);
+	}
+
+	l_queue_push_head(virts, virt);
+}
+
+static void virt_addr_remove(struct mesh_virtual *virt)
+{
+	void *key = L_UINT_TO_PTR(virt->addr);
+	struct l_queue *virts = l_hashmap_lookup(virt_by_addr, key);
+
+	if (!virts)
+		return;
+
+	l_queue_remove(virts, virt);
+
+	if (l_queue_isempty(virts)) {
+		l_hashmap_remove(virt_by_addr, key);
+		l_queue_destroy(virts, NULL);
+	}
+}
+
+static void free_virt_addr(void *data)
+{
+	l_queue_destroy(data, NULL);
+}
+
 static void unref_virt(void *data)
 {
 	struct mesh_virtual *virt = data;
@@ -100,6 +160,7 @@ static void unref_virt(void *data)
 		return;
 
 	l_queue_remove(mesh_virtuals, virt);
+	virt_addr_remove(virt);
 	l_free(virt);
 }
 
@@ -349,17 +410,41 @@ static void cfg_update_model_subs(struct mesh_node *node, uint16_t ele_idx,
 	l_dbus_send(dbus, msg);
 }
 
+static void deliver_model(struct mesh_model *mod, struct mod_forward *fwd,
+								uint16_t dst)
+{
+	bool result;
+
+	/* Return, if this is not a internal model */
+	if (!mod->cbs)
+		return;
+
+	result = false;
+
+	if (mod->cbs->recv)
+		result = mod->cbs->recv(fwd->src, dst, fwd->app_idx,
+				fwd->net_idx,
+				fwd->data, fwd->size, mod->user_data);
+
+	if (dst == fwd->unicast && result)
+		fwd->done = true;
+}
+
+static bool model_bound(struct mesh_model *mod, struct mod_forward *fwd)
+{
+	return fwd->app_idx == APP_IDX_DEV_LOCAL ||
+				fwd->app_idx == APP_IDX_DEV_REMOTE ||
+				has_binding(mod->bindings, fwd->app_idx);
+}
+
 static void forward_model(void *a, void *b)
 {
 	struct mesh_model *mod = a;
 	struct mod_forward *fwd = b;
 	struct mesh_virtual *virt;
 	uint16_t dst;
-	bool result;
 
-	if (fwd->app_idx != APP_IDX_DEV_LOCAL &&
-				fwd->app_idx != APP_IDX_DEV_REMOTE &&
-				!has_binding(mod->bindings, fwd->app_idx))
+	if (!model_bound(mod, fwd))
 		return;
 
 	dst = fwd->dst;
@@ -380,19 +465,7 @@ static void forward_model(void *a, void *b)
 	if (!fwd->has_dst)
 		return;
 
-	/* Return, if this is not a internal model */
-	if (!mod->cbs)
-		return;
-
-	result = false;
-
-	if (mod->cbs->recv)
-		result = mod->cbs->recv(fwd->src, dst, fwd->app_idx,
-				fwd->net_idx,
-				fwd->data, fwd->size, mod->user_data);
-
-	if (dst == fwd->unicast && result)
-		fwd->done = true;
+	deliver_model(mod, fwd, dst);
 }
 
 static int app_packet_decrypt(struct mesh_net *net, const uint8_t *data,
@@ -407,45 +480,30 @@ static int app_packet_decrypt(struct mesh_net *net, const uint8_t *data,
 	if (!app_keys)
 		return -1;
 
-	for (entry = l_queue_get_entries(app_keys); entry;
-							entry = entry->next) {
-		const uint8_t *old_key = NULL, *new_key = NULL;
-		uint8_t old_key_aid, new_key_aid;
+	/* Only keys whose AID (old or new phase) matches are tried */
+	entry = l_queue_get_entries(appkey_get_aid_keys(net, key_aid));
+
+	for (; entry; entry = entry->next) {
+		const uint8_t *key;
+		struct l_aead_cipher *cipher;
 		int app_idx;
 		bool decrypted;
 
-		app_idx = appkey_get_key_idx(entry->data,
-							&old_key, &old_key_aid,
-							&new_key, &new_key_aid);
-
+		app_idx = appkey_get_aid_cipher(entry->data, key_aid, szmict,
+								&key, &cipher);
 		if (app_idx < 0)
 			continue;
 
-		if (old_key && old_key_aid == key_aid) {
-			decrypted = mesh_crypto_payload_decrypt(virt, virt_size,
-					data, size, szmict, src, dst, key_aid,
-						seq, iv_idx, out, old_key);
-
-			if (decrypted) {
-				print_packet("Used App Key", old_key, 16);
-				return app_idx;
-			}
+		decrypted = mesh_crypto_payload_decrypt_cipher(cipher,
+					virt, virt_size, data, size, szmict,
+					src, dst, key_aid, seq, iv_idx, out);
 
-			print_packet("Failed App Key", old_key, 16);
+		if (decrypted) {
+			print_packet("Used App Key", key, 16);
+			return app_idx;
 		}
 
-		if (new_key && new_key_aid == key_aid) {
-			decrypted = mesh_crypto_payload_decrypt(virt, virt_size,
-					data, size, szmict, src, dst, key_aid,
-						seq, iv_idx, out, new_key);
-
-			if (decrypted) {
-				print_packet("Used App Key", new_key, 16);
-				return app_idx;
-			}
-
-			print_packet("Failed App Key", new_key, 16);
-		}
+		print_packet("Failed App Key", key, 16);
 	}
 
 	return -1;
@@ -497,14 +555,14 @@ static int virt_packet_decrypt(struct mesh_net *net, const uint8_t *data,
 				struct mesh_virtual **decrypt_virt)
 {
 	const struct l_queue_entry *v;
+	struct l_queue *virts;
 
-	for (v = l_queue_get_entries(mesh_virtuals); v; v = v->next) {
+	virts = l_hashmap_lookup(virt_by_addr, L_UINT_TO_PTR(dst));
+
+	for (v = l_queue_get_entries(virts); v; v = v->next) {
 		struct mesh_virtual *virt = v->data;
 		int decrypt_idx;
 
-		if (virt->addr != dst)
-			continue;
-
 		decrypt_idx = app_packet_decrypt(net, data, size, szmict, src,
 							dst, virt->label, 16,
 							key_aid, seq, iv_idx,
@@ -712,6 +770,7 @@ static struct mesh_virtual *add_virtual(const uint8_t *v)
 	memcpy(virt->label, v, 16);
 	virt->ref_cnt = 1;
 	l_queue_push_head(mesh_virtuals, virt);
+	virt_addr_add(virt);
 
 	return virt;
 }
@@ -764,6 +823,7 @@ static int add_virt_sub(struct mesh_net *net, struct mesh_model *mod,
 			return MESH_STATUS_INSUFF_RESOURCES;
 
 		l_queue_push_head(mod->virtuals, virt);
+		subs_changed();
 		mesh_net_dst_reg(net, virt->addr);
 		l_debug("Added virtual sub addr %4.4x", virt->addr);
 	}
@@ -788,6 +848,7 @@ static int add_sub(struct mesh_net *net, struct mesh_model *mod,
 		return MESH_STATUS_INSUFF_RESOURCES;
 
 	l_queue_push_tail(mod->subs, L_UINT_TO_PTR(addr));
+	subs_changed();
 	mesh_net_dst_reg(net, addr);
 	l_debug("Added group subscription %4.4x", addr);
 
@@ -875,6 +936,150 @@ static void send_msg_rcvd(struct mesh_node *node, uint8_t ele_idx,
 	l_dbus_send(dbus, msg);
 }
 
+static bool forward_element(struct mesh_node *node, uint8_t ele_idx,
+						struct mod_forward *fwd)
+{
+	/*
+	 * Cycle through external models if the message has not been
+	 * handled by internal models
+	 */
+	if (fwd->has_dst && !fwd->done) {
+		if ((fwd->app_idx & APP_IDX_MASK) == fwd->app_idx)
+			send_msg_rcvd(node, ele_idx, fwd->src, fwd->dst,
+						fwd->virt, fwd->app_idx,
+						fwd->size, fwd->data);
+		else if (fwd->app_idx == APP_IDX_DEV_REMOTE ||
+					fwd->app_idx == APP_IDX_DEV_LOCAL)
+			send_dev_key_msg_rcvd(node, ele_idx, fwd->src,
+						fwd->app_idx, fwd->net_idx,
+						fwd->size, fwd->data);
+	}
+
+	/*
+	 * Either the message has been processed internally or
+	 * has been passed on to an external model.
+	 */
+	return fwd->has_dst | fwd->done;
+}
+
+static void add_sub_target(struct mesh_sub_index *index, void *key,
+					uint8_t ele_idx, struct mesh_model *mod)
+{
+	struct l_queue *targets = l_hashmap_lookup(index->targets, key);
+	struct sub_target *target;
+
+	if (!targets) {
+		targets = l_queue_new();
+		l_hashmap_insert(index->targets, key, targets);
+	}
+
+	target = l_new(struct sub_target, 1);
+	target->ele_idx = ele_idx;
+	target->mod = mod;
+	l_queue_push_tail(targets, target);
+}
+
+static void free_sub_targets(void *data)
+{
+	l_queue_destroy(data, l_free);
+}
+
+void mesh_model_sub_index_free(struct mesh_sub_index *index)
+{
+	if (!index)
+		return;
+
+	l_hashmap_destroy(index->targets, free_sub_targets);
+	l_free(index);
+}
+
+static struct mesh_sub_index *get_sub_index(struct mesh_node *node)
+{
+	struct mesh_sub_index *index = node_get_sub_index(node);
+	uint8_t num_ele = node_get_num_elements(node);
+	const struct l_queue_entry *m, *s;
+	int i;
+
+	if (index && index->generation == sub_generation)
+		return index;
+
+	if (!index) {
+		index = l_new(struct mesh_sub_index, 1);
+		node_set_sub_index(node, index);
+	} else
+		l_hashmap_destroy(index->targets, free_sub_targets);
+
+	index->targets = l_hashmap_new();
+
+	for (i = 0; i < num_ele; i++) {
+		m = l_queue_get_entries(node_get_element_models(node, i));
+
+		for (; m; m = m->next) {
+			struct mesh_model *mod = m->data;
+
+			for (s = l_queue_get_entries(mod->subs); s; s = s->next)
+				add_sub_target(index, s->data, i, mod);
+
+			/* Virtual labels are keyed by their mesh_virtual */
+			for (s = l_queue_get_entries(mod->virtuals); s;
+								s = s->next)
+				add_sub_target(index, s->data, i, mod);
+		}
+	}
+
+	index->generation = sub_generation;
+
+	return index;
+}
+
+static bool forward_subscribers(struct mesh_node *node,
+				struct mod_forward *fwd, uint16_t primary)
+{
+	struct mesh_sub_index *index = get_sub_index(node);
+	const struct l_queue_entry *entry;
+	struct l_queue *targets;
+	struct sub_target *list;
+	unsigned int i, j, len;
+	bool result = false;
+
+	if (fwd->virt)
+		targets = l_hashmap_lookup(index->targets, fwd->virt);
+	else
+		targets = l_hashmap_lookup(index->targets,
+						L_UINT_TO_PTR(fwd->dst));
+
+	len = l_queue_length(targets);
+	if (!len)
+		return false;
+
+	/* Models may change subscriptions while handling the message */
+	list = l_new(struct sub_target, len);
+	entry = l_queue_get_entries(targets);
+	for (i = 0; entry; entry = entry->next)
+		list[i++] = *(struct sub_target *) entry->data;
+
+	for (i = 0; i < len; i = j) {
+		uint8_t ele_idx = list[i].ele_idx;
+
+		fwd->unicast = primary + ele_idx;
+		fwd->has_dst = false;
+
+		for (j = i; j < len && list[j].ele_idx == ele_idx; j++) {
+			if (!model_bound(list[j].mod, fwd))
+				continue;
+
+			fwd->has_dst = true;
+			deliver_model(list[j].mod, fwd, fwd->dst);
+		}
+
+		result |= forward_element(node, ele_idx, fwd);
+	}
+
+	l_free(list);
+
+	return result;
+}
+
 bool mesh_model_rx(struct mesh_node *node, bool szmict, uint32_t seq0,
 			uint32_t iv_index, uint16_t net_idx, uint16_t src,
 			uint16_t dst, uint8_t key_aid, const uint8_t *data,
@@ -947,6 +1152,12 @@ bool mesh_model_rx(struct mesh_node *node, bool szmict, uint32_t seq0,
 
 	is_subscription = !(IS_UNICAST(dst));
 
+	/* Group and virtual destinations only reach subscribed models */
+	if (is_subscription && !IS_FIXED_GROUP_ADDRESS(dst)) {
+		result = forward_subscribers(node, &forward, addr);
+		goto done;
+	}
+
 	for (i = 0; i < num_ele; i++) {
 		struct l_queue *models;
 
@@ -961,27 +1172,7 @@ bool mesh_model_rx(struct mesh_node *node, bool szmict, uint32_t seq0,
 		/* Internal models */
 		l_queue_foreach(models, forward_model, &forward);
 
-		/*
-		 * Cycle through external models if the message has not been
-		 * handled by internal models
-		 */
-		if (forward.has_dst && !forward.done) {
-			if ((decrypt_idx & APP_IDX_MASK) == decrypt_idx)
-				send_msg_rcvd(node, i, src, dst, decrypt_virt,
-						forward.app_idx, forward.size,
-						forward.data);
-			else if (decrypt_idx == APP_IDX_DEV_REMOTE ||
-				 decrypt_idx == APP_IDX_DEV_LOCAL)
-				send_dev_key_msg_rcvd(node, i, src, decrypt_idx,
-							net_idx, forward.size,
-								forward.data);
-		}
-
-		/*
-		 * Either the message has been processed internally or
-		 * has been passed on to an external model.
-		 */
-		result |= forward.has_dst | forward.done;
+		result |= forward_element(node, i, &forward);
 
 		/* If the message was to unicast address, we are done */
 		if (!is_subscription && ele_idx == i)
@@ -1169,6 +1360,8 @@ void mesh_model_free(void *data)
 	l_queue_destroy(mod->virtuals, unref_virt);
 	l_free(mod->pub);
 	l_free(mod);
+
+	subs_changed();
 }
 
 static void remove_subs(struct mesh_node *node, struct mesh_model *mod)
@@ -1183,6 +1376,7 @@ static void remove_subs(struct mesh_node *node, struct mesh_model *mod)
 
 	l_queue_clear(mod->subs, NULL);
 	l_queue_clear(mod->virtuals, unref_virt);
+	subs_changed();
 }
 
 static struct mesh_model *model_new(uint32_t id)
@@ -1516,6 +1710,7 @@ int mesh_model_sub_ovrt(struct mesh_node *node, uint16_t ele_addr, uint32_t id,
 
 	l_queue_clear(mod->subs, NULL);
 	l_queue_clear(mod->virtuals, unref_virt);
+	subs_changed();
 
 	add_sub(node_get_net(node), mod, addr);
 
@@ -1545,6 +1740,7 @@ int mesh_model_virt_sub_ovrt(struct mesh_node *node, uint16_t ele_addr,
 
 	l_queue_clear(mod->subs, NULL);
 	l_queue_clear(mod->virtuals, unref_virt);
+	subs_changed();
 
 	status = add_virt_sub(node_get_net(node), mod, label, addr);
 
@@ -1572,6 +1768,7 @@ int mesh_model_sub_del(struct mesh_node *node, uint16_t ele_addr, uint32_t id,
 		return MESH_STATUS_NOT_SUB_MOD;
 
 	if (l_queue_remove(mod->subs, L_UINT_TO_PTR(addr))) {
+		subs_changed();
 		mesh_net_dst_unreg(node_get_net(node), addr);
 
 		if (!mod->cbs)
@@ -1605,6 +1802,7 @@ int mesh_model_virt_sub_del(struct mesh_node *node, uint16_t ele_addr,
 	if (virt) {
 		*addr = virt->addr;
 		unref_virt(virt);
+		subs_changed();
 	} else {
 		*addr = UNASSIGNED_ADDRESS;
 		return MESH_STATUS_SUCCESS;
@@ -1985,10 +2183,13 @@ done:
 void mesh_model_init(void)
 {
 	mesh_virtuals = l_queue_new();
+	virt_by_addr = l_hashmap_new();
 }
 
 void mesh_model_cleanup(void)
 {
+	l_hashmap_destroy(virt_by_addr, free_virt_addr);
+	virt_by_addr = NULL;
 	l_queue_destroy(mesh_virtuals, l_free);
 	mesh_virtuals = NULL;
 }
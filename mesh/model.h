@@ -9,6 +9,7 @@
  */
 
 struct mesh_model;
+struct mesh_sub_index;
 
 #define MAX_MODEL_BINDINGS	10
 #define MAX_MODEL_SUBS		10
@@ -60,6 +61,7 @@ struct mesh_model_ops {
 bool mesh_model_add(struct mesh_node *node, struct l_queue *mods,
 			uint32_t id, struct l_dbus_message_iter *opts);
 void mesh_model_free(void *data);
+void mesh_model_sub_index_free(struct mesh_sub_index *index);
 bool mesh_model_register(struct mesh_node *node, uint8_t ele_idx,
 			uint32_t id, const struct mesh_model_ops *cbs,
 							void *user_data);
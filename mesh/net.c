@@ -91,6 +91,7 @@ struct mesh_net {
 	struct mesh_node *node;
 	struct mesh_prov *prov;
 	struct l_queue *app_keys;
+	struct mesh_aid_index *aid_index;
 	unsigned int pkt_id;
 	unsigned int bea_id;
 	unsigned int beacon_id;
@@ -661,6 +662,7 @@ void mesh_net_free(void *user_data)
 	l_queue_destroy(net->friends, mesh_friend_free);
 	l_queue_destroy(net->negotiations, mesh_friend_free);
 	l_queue_destroy(net->destinations, l_free);
+	appkey_aid_index_free(net->aid_index);
 	l_queue_destroy(net->app_keys, appkey_key_free);
 
 	l_free(net);
@@ -3617,6 +3619,16 @@ struct l_queue *mesh_net_get_app_keys(struct mesh_net *net)
 	return net->app_keys;
 }
 
+struct mesh_aid_index *mesh_net_get_aid_index(struct mesh_net *net)
+{
+	return net->aid_index;
+}
+
+void mesh_net_set_aid_index(struct mesh_net *net, struct mesh_aid_index *index)
+{
+	net->aid_index = index;
+}
+
 bool mesh_net_have_key(struct mesh_net *net, uint16_t idx)
 {
 	if (!net)
@@ -14,6 +14,7 @@
 
 struct mesh_io;
 struct mesh_node;
+struct mesh_aid_index;
 
 #define DEV_ID	0
 
@@ -250,6 +251,8 @@ bool mesh_net_get_key(struct mesh_net *net, bool new_key, uint16_t idx,
 bool mesh_net_attach(struct mesh_net *net, struct mesh_io *io);
 struct mesh_io *mesh_net_detach(struct mesh_net *net);
 struct l_queue *mesh_net_get_app_keys(struct mesh_net *net);
+struct mesh_aid_index *mesh_net_get_aid_index(struct mesh_net *net);
+void mesh_net_set_aid_index(struct mesh_net *net, struct mesh_aid_index *index);
 
 void mesh_net_transport_send(struct mesh_net *net, uint32_t net_key_id,
 				uint16_t net_idx, uint32_t iv_index,
@@ -81,6 +81,7 @@ struct mesh_node {
 	char *obj_path;
 	struct mesh_agent *agent;
 	struct mesh_config *cfg;
+	struct mesh_sub_index *sub_index;
 	char *storage_dir;
 	uint32_t disc_watch;
 	uint32_t seq_number;
@@ -300,6 +301,7 @@ static void free_node_resources(void *data)
 	free_node_dbus_resources(node);
 	l_queue_destroy(node->elements, element_free);
 	l_queue_destroy(node->pages, l_free);
+	mesh_model_sub_index_free(node->sub_index);
 	mesh_agent_remove(node->agent);
 	mesh_config_release(node->cfg);
 	mesh_net_free(node->net);
@@ -691,6 +693,16 @@ struct l_queue *node_get_element_models(struct mesh_node *node, uint8_t ele_idx)
 	return ele->models;
 }
 
+struct mesh_sub_index *node_get_sub_index(struct mesh_node *node)
+{
+	return node->sub_index;
+}
+
+void node_set_sub_index(struct mesh_node *node, struct mesh_sub_index *index)
+{
+	node->sub_index = index;
+}
+
 uint8_t node_default_ttl_get(struct mesh_node *node)
 {
 	if (!node)
@@ -24,6 +24,8 @@
 #include "src/shared/util.h"
 #include "src/shared/queue.h"
 #include "src/shared/btsnoop.h"
+#include "src/shared/rap.h"
+#include "src/shared/cs-dist.h"
 #include "monitor/bt.h"
 #include "monitor/display.h"
 #include "monitor/packet.h"
@@ -32,6 +34,9 @@
 #define TIMEVAL_MSEC(_tv) \
 	(long long)((_tv)->tv_sec * 1000 + (_tv)->tv_usec / 1000)
 
+#define SIGN_EXTEND_TO_16(val, bits) \
+	((int16_t)(((val) ^ (1U << ((bits)-1))) - (1U << ((bits)-1))))
+
 struct hci_dev {
 	uint16_t index;
 	uint8_t type;
@@ -50,6 +55,7 @@ struct hci_dev {
 	unsigned long ctrl_msg;
 	unsigned long unknown;
 	uint16_t manufacturer;
+	uint8_t cs_role;
 	struct queue *conn_list;
 };
 
@@ -111,7 +117,19 @@ struct l2cap_chan {
 	struct hci_stats tx;
 };
 
+struct cs_stats {
+	struct bt_cs_dist *dist;
+	bool done[2];
+	unsigned long num;
+	unsigned long num_failed;
+	double min;
+	double max;
+	double total;
+	double quality;
+};
+
 static struct queue *dev_list;
+static struct cs_stats cs_stats;
 
 static void tmp_write(void *data, void *user_data)
 {
@@ -1034,6 +1052,211 @@ static void evt_le_big_sync_established(struct hci_dev *dev, struct timeval *tv,
 	}
 }
 
+static void evt_le_cs_config_complete(struct hci_dev *dev, struct iovec *iov)
+{
+	const struct bt_hci_evt_le_cs_config_complete *evt;
+
+	evt = util_iov_pull_mem(iov, sizeof(*evt));
+	if (!evt || evt->status)
+		return;
+
+	dev->cs_role = evt->role;
+}
+
+static void cs_pull_iq(struct iovec *iov, struct pct_iq_sample *sample)
+{
+	uint32_t val;
+
+	if (!util_iov_pull_le24(iov, &val))
+		return;
+
+	sample->i_sample = SIGN_EXTEND_TO_16(val & 0x0fff, 12);
+	sample->q_sample = SIGN_EXTEND_TO_16((val >> 12) & 0x0fff, 12);
+}
+
+static void cs_parse_mode_one(struct iovec *iov, uint8_t role,
+					struct cs_mode_one_data *data)
+{
+	uint16_t time_val;
+
+	if (!util_iov_pull_u8(iov, &data->packet_quality) ||
+			!util_iov_pull_u8(iov, &data->packet_nadm) ||
+			!util_iov_pull_u8(iov, &data->packet_rssi_dbm) ||
+			!util_iov_pull_le16(iov, &time_val) ||
+			!util_iov_pull_u8(iov, &data->packet_ant))
+		return;
+
+	if (role == CS_REFLECTOR)
+		data->tod_toa_refl = time_val;
+	else
+		data->toa_tod_init = time_val;
+
+	cs_pull_iq(iov, &data->packet_pct1);
+	cs_pull_iq(iov, &data->packet_pct2);
+}
+
+static void cs_parse_mode_two(struct iovec *iov, uint8_t num_paths,
+					struct cs_mode_two_data *data)
+{
+	uint8_t i;
+
+	if (!util_iov_pull_u8(iov, &data->ant_perm_index))
+		return;
+
+	/* One tone per antenna path plus the tone extension slot */
+	for (i = 0; i <= num_paths && i < 5; i++) {
+		cs_pull_iq(iov, &data->tone_pct[i]);
+		util_iov_pull_u8(iov, &data->tone_quality_indicator[i]);
+	}
+}
+
+static bool cs_parse_step(struct iovec *iov, uint8_t role,
+				uint8_t num_paths, struct cs_step_data *step)
+{
+	struct cs_mode_zero_data *zero;
+	struct cs_mode_three_data *three;
+	struct iovec data, mode_two;
+	size_t len;
+
+	memset(step, 0, sizeof(*step));
+
+	if (!util_iov_pull_u8(iov, &step->step_mode) ||
+			!util_iov_pull_u8(iov, &step->step_chnl) ||
+			!util_iov_pull_u8(iov, &step->step_data_length))
+		return false;
+
+	data.iov_base = util_iov_pull_mem(iov, step->step_data_length);
+	data.iov_len = step->step_data_length;
+	if (!data.iov_base)
+		return false;
+
+	switch (step->step_mode) {
+	case CS_MODE_ZERO:
+		zero = &step->step_mode_data.mode_zero_data;
+		util_iov_pull_u8(&data, &zero->packet_quality);
+		util_iov_pull_u8(&data, &zero->packet_rssi_dbm);
+		util_iov_pull_u8(&data, &zero->packet_ant);
+		util_iov_pull_le16(&data, &zero->init_measured_freq_offset);
+		break;
+	case CS_MODE_ONE:
+		cs_parse_mode_one(&data, role,
+				&step->step_mode_data.mode_one_data);
+		break;
+	case CS_MODE_TWO:
+		cs_parse_mode_two(&data, num_paths,
+				&step->step_mode_data.mode_two_data);
+		break;
+	case CS_MODE_THREE:
+		/* The mode 2 part has a fixed size, the rest is mode 1 */
+		three = &step->step_mode_data.mode_three_data;
+		len = 1 + 4 * (num_paths + 1);
+		if (data.iov_len < len)
+			break;
+
+		mode_two.iov_base = data.iov_base + data.iov_len - len;
+		mode_two.iov_len = len;
+		data.iov_len -= len;
+
+		cs_parse_mode_one(&data, role, &three->mode_one_data);
+		cs_parse_mode_two(&mode_two, num_paths, &three->mode_two_data);
+		break;
+	}
+
+	return true;
+}
+
+static void cs_stats_update(void)
+{
+	struct bt_cs_dist_result result;
+
+	if (!bt_cs_dist_estimate(cs_stats.dist, &result)) {
+		cs_stats.num_failed++;
+		return;
+	}
+
+	if (!cs_stats.num || result.distance < cs_stats.min)
+		cs_stats.min = result.distance;
+
+	if (!cs_stats.num || result.distance > cs_stats.max)
+		cs_stats.max = result.distance;
+
+	cs_stats.total += result.distance;
+	cs_stats.quality += result.quality;
+	cs_stats.num++;
+}
+
+/* Replays the results both controllers of a trace report for a procedure
+ * through the same estimator bluetoothd uses for the local and RAS data.
+ */
+static void cs_subevent_steps(struct hci_dev *dev, uint8_t proc_done_status,
+					uint8_t num_paths, uint8_t num_steps,
+					struct iovec *iov)
+{
+	struct cs_step_data steps[CS_MAX_STEPS];
+	enum bt_cs_dist_role role;
+	uint8_t i;
+
+	if (!cs_stats.dist)
+		cs_stats.dist = bt_cs_dist_new();
+
+	if (proc_done_status == 0x0f) {
+		bt_cs_dist_reset(cs_stats.dist);
+		memset(cs_stats.done, 0, sizeof(cs_stats.done));
+		return;
+	}
+
+	role = dev->cs_role == CS_REFLECTOR ? BT_CS_DIST_REFLECTOR :
+							BT_CS_DIST_INITIATOR;
+
+	for (i = 0; i < num_steps && i < CS_MAX_STEPS; i++) {
+		if (!cs_parse_step(iov, dev->cs_role, num_paths, &steps[i]))
+			break;
+	}
+
+	bt_cs_dist_add_steps(cs_stats.dist, role, steps, i, num_paths);
+
+	if (proc_done_status != 0x00)
+		return;
+
+	cs_stats.done[role] = true;
+
+	if (!cs_stats.done[BT_CS_DIST_INITIATOR] ||
+			!cs_stats.done[BT_CS_DIST_REFLECTOR])
+		return;
+
+	cs_stats_update();
+
+	bt_cs_dist_reset(cs_stats.dist);
+	memset(cs_stats.done, 0, sizeof(cs_stats.done));
+}
+
+static void evt_le_cs_subevent_result(struct hci_dev *dev, struct iovec *iov)
+{
+	const struct bt_hci_evt_le_cs_subevent_result *evt;
+
+	evt = util_iov_pull_mem(iov, sizeof(*evt));
+	if (!evt)
+		return;
+
+	cs_subevent_steps(dev, evt->procedure_done_status,
+				evt->num_antenna_paths,
+				evt->num_steps_reported, iov);
+}
+
+static void evt_le_cs_subevent_result_cont(struct hci_dev *dev,
+						struct iovec *iov)
+{
+	const struct bt_hci_evt_le_cs_subevent_result_continue *evt;
+
+	evt = util_iov_pull_mem(iov, sizeof(*evt));
+	if (!evt)
+		return;
+
+	cs_subevent_steps(dev, evt->procedure_done_status,
+				evt->num_antenna_paths,
+				evt->num_steps_reported, iov);
+}
+
 static void evt_le_meta_event(struct hci_dev *dev, struct timeval *tv,
 					unsigned long frame,
 					const void *data, uint16_t size)
@@ -1066,6 +1289,15 @@ static void evt_le_meta_event(struct hci_dev *dev, struct timeval *tv,
 	case BT_HCI_EVT_LE_BIG_SYNC_ESTABILISHED:
 		evt_le_big_sync_established(dev, tv, frame, &iov);
 		break;
+	case BT_HCI_EVT_LE_CS_CONFIG_COMPLETE:
+		evt_le_cs_config_complete(dev, &iov);
+		break;
+	case BT_HCI_EVT_LE_CS_SUBEVENT_RESULT:
+		evt_le_cs_subevent_result(dev, &iov);
+		break;
+	case BT_HCI_EVT_LE_CS_SUBEVENT_RESULT_CONTINUE:
+		evt_le_cs_subevent_result_cont(dev, &iov);
+		break;
 	}
 }
 
@@ -1478,6 +1710,22 @@ void analyze_trace(const char *path)
 
 	printf("Trace contains %lu packets\n\n", num_packets);
 
+	if (cs_stats.num || cs_stats.num_failed) {
+		printf("Channel Sounding\n");
+		printf("  %lu distance estimates\n", cs_stats.num);
+		printf("  %lu procedures without estimate\n",
+							cs_stats.num_failed);
+		if (cs_stats.num)
+			printf("  Distance min %.2f m max %.2f m avg %.2f m "
+				"quality avg %.2f\n", cs_stats.min,
+				cs_stats.max, cs_stats.total / cs_stats.num,
+				cs_stats.quality / cs_stats.num);
+		printf("\n");
+	}
+
+	bt_cs_dist_free(cs_stats.dist);
+	memset(&cs_stats, 0, sizeof(cs_stats));
+
 	queue_destroy(dev_list, dev_destroy);
 
 done:
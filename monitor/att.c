@@ -479,7 +479,8 @@ static struct att_conn_data *att_get_conn_data(struct packet_conn_data *conn)
 }
 
 static void gatt_load_db(struct gatt_db *db, const char *filename,
-						struct timespec *mtim)
+			struct timespec *mtim,
+			int (*load)(struct gatt_db *db, const char *filename))
 {
 	struct stat st;
 
@@ -497,7 +498,7 @@ static void gatt_load_db(struct gatt_db *db, const char *filename,
 
 	*mtim = st.st_mtim;
 
-	btd_settings_gatt_db_load(db, filename);
+	load(db, filename);
 }
 
 static void load_gatt_db(struct packet_conn_data *conn)
@@ -519,10 +520,20 @@ static void load_gatt_db(struct packet_conn_data *conn)
 	}
 
 	create_filename(filename, PATH_MAX, "/%s/attributes", local);
-	gatt_load_db(data->ldb, filename, &data->ldb_mtim);
+	gatt_load_db(data->ldb, filename, &data->ldb_mtim,
+					btd_settings_gatt_db_load);
 
-	create_filename(filename, PATH_MAX, "/%s/cache/%s", local, peer);
-	gatt_load_db(data->rdb, filename, &data->rdb_mtim);
+	create_filename(filename, PATH_MAX, "/%s/cache/%s.gatt", local, peer);
+	gatt_load_db(data->rdb, filename, &data->rdb_mtim,
+					btd_settings_gatt_cache_load);
+
+	/* Fallback to caches not yet converted to the binary format */
+	if (gatt_db_isempty(data->rdb)) {
+		create_filename(filename, PATH_MAX, "/%s/cache/%s", local,
+									peer);
+		gatt_load_db(data->rdb, filename, &data->rdb_mtim,
+					btd_settings_gatt_db_load);
+	}
 
 	/* If rdb cannot be loaded from file try local cache */
 	if (gatt_db_isempty(data->rdb)) {
@@ -103,9 +103,18 @@ static const char * const filter_list[] = {
 #define STATUS_DELETE 1
 #define FILLER_BYTE 0x30
 
+/* Paged listing entries kept with all their properties, beyond this the
+ * least recently listed ones only keep their folder so that GetMessage
+ * still works for every handle listed.
+ */
+#define MAX_LISTED	1024
+
 struct map_data {
 	struct obc_session *session;
 	GHashTable *messages;
+	GHashTable *listed;	/* Paged listing entries without an object */
+	GQueue listed_order;	/* Same entries, least recently listed first */
+	GHashTable *listed_folders;	/* Folder of older listed handles */
 	int16_t mas_instance_id;
 	uint8_t supported_message_types;
 	uint32_t supported_features;
@@ -115,6 +124,7 @@ struct pending_request {
 	struct map_data *map;
 	DBusMessage *msg;
 	char *folder;
+	struct map_parser *parser;
 };
 
 #define MAP_MSG_FLAG_PRIORITY	0x01
@@ -146,11 +156,21 @@ struct map_msg {
 	char *direction;
 	char *attachment_mime_types;
 	GDBusPendingPropertySet pending;
+	GList *listed_link;
 };
 
+#define DEFAULT_PAGE_SIZE	64
+
 struct map_parser {
 	struct pending_request *request;
-	DBusMessageIter *iter;
+	GMarkupParseContext *ctxt;
+	gboolean failed;
+	const char *signature;
+	DBusMessage *reply;
+	DBusMessageIter iter;
+	DBusMessageIter array;
+	uint16_t page_size;	/* Entries per MessagesListed, 0 if none */
+	uint16_t count;
 };
 
 static DBusConnection *conn = NULL;
@@ -167,10 +187,23 @@ static struct pending_request *pending_request_new(struct map_data *map,
 	return p;
 }
 
+static void map_parser_free(struct map_parser *parser)
+{
+	g_markup_parse_context_free(parser->ctxt);
+
+	if (parser->reply)
+		dbus_message_unref(parser->reply);
+
+	g_free(parser);
+}
+
 static void pending_request_free(struct pending_request *p)
 {
 	dbus_message_unref(p->msg);
 
+	if (p->parser)
+		map_parser_free(p->parser);
+
 	g_free(p->folder);
 	g_free(p);
 }
@@ -223,17 +256,139 @@ static DBusMessage *map_setpath(DBusConnection *connection,
 	return NULL;
 }
 
+static struct map_parser *map_parser_new(struct pending_request *request,
+						const GMarkupParser *markup,
+						const char *signature)
+{
+	struct map_parser *parser;
+
+	parser = g_new0(struct map_parser, 1);
+	parser->request = request;
+	parser->signature = signature;
+	parser->ctxt = g_markup_parse_context_new(markup, 0, parser, NULL);
+
+	request->parser = parser;
+
+	return parser;
+}
+
+static DBusMessageIter *map_parser_open(struct map_parser *parser)
+{
+	struct pending_request *request = parser->request;
+	const char *path, *folder;
+
+	if (parser->reply)
+		return &parser->array;
+
+	if (parser->page_size) {
+		path = obc_session_get_path(request->map->session);
+		parser->reply = dbus_message_new_signal(path, MAP_INTERFACE,
+							"MessagesListed");
+	} else
+		parser->reply = dbus_message_new_method_return(request->msg);
+
+	if (parser->reply == NULL)
+		return NULL;
+
+	dbus_message_iter_init_append(parser->reply, &parser->iter);
+
+	/* Pages only go to the client which asked for the listing */
+	if (parser->page_size) {
+		dbus_message_set_destination(parser->reply,
+					dbus_message_get_sender(request->msg));
+		folder = request->folder;
+		dbus_message_iter_append_basic(&parser->iter, DBUS_TYPE_STRING,
+								&folder);
+	}
+
+	dbus_message_iter_open_container(&parser->iter, DBUS_TYPE_ARRAY,
+					parser->signature, &parser->array);
+	parser->count = 0;
+
+	return &parser->array;
+}
+
+static DBusMessage *map_parser_close(struct map_parser *parser)
+{
+	DBusMessage *reply;
+
+	if (map_parser_open(parser) == NULL)
+		return NULL;
+
+	dbus_message_iter_close_container(&parser->iter, &parser->array);
+
+	reply = parser->reply;
+	parser->reply = NULL;
+
+	return reply;
+}
+
+static gboolean listing_data(struct obc_transfer *transfer, const void *buf,
+						size_t len, void *user_data)
+{
+	struct map_parser *parser = user_data;
+
+	/* Like a listing parsed in one go, keep what came before an error */
+	if (parser->failed)
+		return TRUE;
+
+	if (!g_markup_parse_context_parse(parser->ctxt, buf, len, NULL)) {
+		DBG("Unable to parse listing");
+		parser->failed = TRUE;
+	}
+
+	return TRUE;
+}
+
+static void listing_cb(struct obc_session *session,
+						struct obc_transfer *transfer,
+						GError *err, void *user_data)
+{
+	struct pending_request *request = user_data;
+	struct map_parser *parser = request->parser;
+	DBusMessage *reply;
+
+	if (err != NULL) {
+		reply = g_dbus_create_error(request->msg,
+						ERROR_INTERFACE ".Failed",
+						"%s", err->message);
+		goto done;
+	}
+
+	if (parser->page_size == 0) {
+		reply = map_parser_close(parser);
+		goto done;
+	}
+
+	/* Flush the last page before completing the method call */
+	if (parser->reply)
+		g_dbus_send_message(conn, map_parser_close(parser));
+
+	reply = dbus_message_new_method_return(request->msg);
+
+done:
+	if (reply != NULL)
+		g_dbus_send_message(conn, reply);
+
+	pending_request_free(request);
+}
+
 static void folder_element(GMarkupParseContext *ctxt, const char *element,
 				const char **names, const char **values,
 				gpointer user_data, GError **gerr)
 {
-	DBusMessageIter dict, *iter = user_data;
+	struct map_parser *parser = user_data;
+	DBusMessageIter dict, *iter;
 	const char *key;
 	int i;
 
 	if (strcasecmp("folder", element) != 0)
 		return;
 
+	iter = map_parser_open(parser);
+	if (iter == NULL)
+		return;
+
 	dbus_message_iter_open_container(iter, DBUS_TYPE_ARRAY,
 			DBUS_DICT_ENTRY_BEGIN_CHAR_AS_STRING
 			DBUS_TYPE_STRING_AS_STRING DBUS_TYPE_VARIANT_AS_STRING
@@ -257,58 +412,6 @@ static const GMarkupParser folder_parser = {
 	NULL
 };
 
-static void folder_listing_cb(struct obc_session *session,
-						struct obc_transfer *transfer,
-						GError *err, void *user_data)
-{
-	struct pending_request *request = user_data;
-	GMarkupParseContext *ctxt;
-	DBusMessage *reply;
-	DBusMessageIter iter, array;
-	char *contents;
-	size_t size;
-	int perr;
-
-	if (err != NULL) {
-		reply = g_dbus_create_error(request->msg,
-						ERROR_INTERFACE ".Failed",
-						"%s", err->message);
-		goto done;
-	}
-
-	perr = obc_transfer_get_contents(transfer, &contents, &size);
-	if (perr < 0) {
-		reply = g_dbus_create_error(request->msg,
-						ERROR_INTERFACE ".Failed",
-						"Error reading contents: %s",
-						strerror(-perr));
-		goto done;
-	}
-
-	reply = dbus_message_new_method_return(request->msg);
-	if (reply == NULL) {
-		g_free(contents);
-		goto clean;
-	}
-
-	dbus_message_iter_init_append(reply, &iter);
-	dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY,
-			DBUS_TYPE_ARRAY_AS_STRING
-			DBUS_DICT_ENTRY_BEGIN_CHAR_AS_STRING
-			DBUS_TYPE_STRING_AS_STRING DBUS_TYPE_VARIANT_AS_STRING
-			DBUS_DICT_ENTRY_END_CHAR_AS_STRING, &array);
-	ctxt = g_markup_parse_context_new(&folder_parser, 0, &array, NULL);
-	g_markup_parse_context_parse(ctxt, contents, size, NULL);
-	g_markup_parse_context_free(ctxt);
-	dbus_message_iter_close_container(&iter, &array);
-	g_free(contents);
-
-done:
-	g_dbus_send_message(conn, reply);
-clean:
-	pending_request_free(request);
-}
-
 static DBusMessage *get_folder_listing(struct map_data *map,
 							DBusMessage *message,
 							GObexApparam *apparam)
@@ -327,8 +430,14 @@ static DBusMessage *get_folder_listing(struct map_data *map,
 	obc_transfer_set_apparam(transfer, apparam);
 
 	request = pending_request_new(map, message);
+	map_parser_new(request, &folder_parser,
+			DBUS_TYPE_ARRAY_AS_STRING
+			DBUS_DICT_ENTRY_BEGIN_CHAR_AS_STRING
+			DBUS_TYPE_STRING_AS_STRING DBUS_TYPE_VARIANT_AS_STRING
+			DBUS_DICT_ENTRY_END_CHAR_AS_STRING);
+	obc_transfer_set_data_func(transfer, listing_data, request->parser);
 
-	if (!obc_session_queue(map->session, transfer, folder_listing_cb,
+	if (!obc_session_queue(map->session, transfer, listing_cb,
 							request, &err)) {
 		pending_request_free(request);
 		goto fail;
@@ -933,6 +1042,15 @@ static const GDBusPropertyTable map_msg_properties[] = {
 	{ }
 };
 
+static void msg_property_changed(struct map_msg *msg, const char *name)
+{
+	/* Entries from a paged listing have no object until requested */
+	if (msg->path == NULL)
+		return;
+
+	g_dbus_emit_property_changed(conn, msg->path, MAP_MSG_INTERFACE, name);
+}
+
 static void parse_type(struct map_msg *msg, const char *value)
 {
 	const char *type = NULL;
@@ -952,39 +1070,160 @@ static void parse_type(struct map_msg *msg, const char *value)
 	g_free(msg->type);
 	msg->type = g_strdup(type);
 
-	g_dbus_emit_property_changed(conn, msg->path,
-						MAP_MSG_INTERFACE, "Type");
+	msg_property_changed(msg, "Type");
 }
 
-static struct map_msg *map_msg_create(struct map_data *data, uint64_t handle,
-					const char *folder, const char *type)
+static struct map_msg *map_msg_new(struct map_data *data, uint64_t handle,
+							const char *folder)
 {
 	struct map_msg *msg;
 
 	msg = g_new0(struct map_msg, 1);
 	msg->data = data;
 	msg->handle = handle;
+	msg->folder = g_strdup(folder);
+
+	return msg;
+}
+
+static bool map_msg_register(struct map_data *data, struct map_msg *msg)
+{
 	msg->path = g_strdup_printf("%s/message%" PRIu64,
 					obc_session_get_path(data->session),
 					msg->handle);
-	msg->folder = g_strdup(folder);
 
 	if (!g_dbus_register_interface(conn, msg->path, MAP_MSG_INTERFACE,
 						map_msg_methods, NULL,
 						map_msg_properties,
 						msg, map_msg_free)) {
 		map_msg_free(msg);
-		return NULL;
+		return false;
 	}
 
 	g_hash_table_insert(data->messages, &msg->handle, msg);
 
+	return true;
+}
+
+static struct map_msg *map_msg_create(struct map_data *data, uint64_t handle,
+					const char *folder, const char *type)
+{
+	struct map_msg *msg;
+
+	msg = map_msg_new(data, handle, folder);
+	if (!map_msg_register(data, msg))
+		return NULL;
+
 	if (type)
 		parse_type(msg, type);
 
 	return msg;
 }
 
+static void map_msg_unlist(void *data)
+{
+	struct map_msg *msg = data;
+
+	g_queue_delete_link(&msg->data->listed_order, msg->listed_link);
+	msg->listed_link = NULL;
+
+	map_msg_free(msg);
+}
+
+static void map_msg_listed(struct map_data *data, struct map_msg *msg)
+{
+	struct map_msg *old;
+	uint64_t *handle;
+
+	if (msg->listed_link) {
+		g_queue_unlink(&data->listed_order, msg->listed_link);
+		g_queue_push_tail_link(&data->listed_order, msg->listed_link);
+		return;
+	}
+
+	g_hash_table_insert(data->listed, &msg->handle, msg);
+	g_queue_push_tail(&data->listed_order, msg);
+	msg->listed_link = g_queue_peek_tail_link(&data->listed_order);
+
+	while (g_queue_get_length(&data->listed_order) > MAX_LISTED) {
+		old = g_queue_peek_head(&data->listed_order);
+		handle = g_new(uint64_t, 1);
+		*handle = old->handle;
+		g_hash_table_insert(data->listed_folders, handle,
+					(void *) g_intern_string(old->folder));
+		g_hash_table_remove(data->listed, &old->handle);
+	}
+}
+
+static bool map_msg_publish(struct map_data *data, struct map_msg *msg)
+{
+	if (msg->listed_link) {
+		g_hash_table_steal(data->listed, &msg->handle);
+		g_queue_delete_link(&data->listed_order, msg->listed_link);
+		msg->listed_link = NULL;
+	}
+
+	return map_msg_register(data, msg);
+}
+
+static void append_msg_properties(struct map_msg *msg, DBusMessageIter *iter)
+{
+	const GDBusPropertyTable *p;
+	DBusMessageIter dict;
+
+	dbus_message_iter_open_container(iter, DBUS_TYPE_ARRAY,
+			DBUS_DICT_ENTRY_BEGIN_CHAR_AS_STRING
+			DBUS_TYPE_STRING_AS_STRING DBUS_TYPE_VARIANT_AS_STRING
+			DBUS_DICT_ENTRY_END_CHAR_AS_STRING, &dict);
+
+	for (p = map_msg_properties; p->name; p++) {
+		DBusMessageIter entry, value;
+
+		if (p->get == NULL)
+			continue;
+
+		if (p->exists != NULL && !p->exists(p, msg))
+			continue;
+
+		dbus_message_iter_open_container(&dict, DBUS_TYPE_DICT_ENTRY,
+								NULL, &entry);
+		dbus_message_iter_append_basic(&entry, DBUS_TYPE_STRING,
+								&p->name);
+		dbus_message_iter_open_container(&entry, DBUS_TYPE_VARIANT,
+							p->type, &value);
+		p->get(p, &value, msg);
+		dbus_message_iter_close_container(&entry, &value);
+		dbus_message_iter_close_container(&dict, &entry);
+	}
+
+	dbus_message_iter_close_container(iter, &dict);
+}
+
+static struct map_msg *map_msg_lookup(struct map_data *data, uint64_t handle)
+{
+	struct map_msg *msg;
+	const char *folder;
+
+	msg = g_hash_table_lookup(data->messages, &handle);
+	if (msg)
+		return msg;
+
+	msg = g_hash_table_lookup(data->listed, &handle);
+	if (msg)
+		return msg;
+
+	folder = g_hash_table_lookup(data->listed_folders, &handle);
+	if (folder == NULL)
+		return NULL;
+
+	/* Bring back an entry dropped from a long paged listing */
+	msg = map_msg_new(data, handle, folder);
+	g_hash_table_remove(data->listed_folders, &handle);
+	map_msg_listed(data, msg);
+
+	return msg;
+}
+
 static void parse_subject(struct map_msg *msg, const char *value)
 {
 	if (g_strcmp0(msg->subject, value) == 0)
@@ -993,8 +1232,7 @@ static void parse_subject(struct map_msg *msg, const char *value)
 	g_free(msg->subject);
 	msg->subject = g_strdup(value);
 
-	g_dbus_emit_property_changed(conn, msg->path,
-						MAP_MSG_INTERFACE, "Subject");
+	msg_property_changed(msg, "Subject");
 }
 
 static void parse_datetime(struct map_msg *msg, const char *value)
@@ -1005,8 +1243,7 @@ static void parse_datetime(struct map_msg *msg, const char *value)
 	g_free(msg->timestamp);
 	msg->timestamp = g_strdup(value);
 
-	g_dbus_emit_property_changed(conn, msg->path,
-						MAP_MSG_INTERFACE, "Timestamp");
+	msg_property_changed(msg, "Timestamp");
 }
 
 static void parse_sender(struct map_msg *msg, const char *value)
@@ -1017,8 +1254,7 @@ static void parse_sender(struct map_msg *msg, const char *value)
 	g_free(msg->sender);
 	msg->sender = g_strdup(value);
 
-	g_dbus_emit_property_changed(conn, msg->path,
-						MAP_MSG_INTERFACE, "Sender");
+	msg_property_changed(msg, "Sender");
 }
 
 static void parse_sender_address(struct map_msg *msg, const char *value)
@@ -1029,8 +1265,7 @@ static void parse_sender_address(struct map_msg *msg, const char *value)
 	g_free(msg->sender_address);
 	msg->sender_address = g_strdup(value);
 
-	g_dbus_emit_property_changed(conn, msg->path,
-					MAP_MSG_INTERFACE, "SenderAddress");
+	msg_property_changed(msg, "SenderAddress");
 }
 
 static void parse_replyto(struct map_msg *msg, const char *value)
@@ -1041,8 +1276,7 @@ static void parse_replyto(struct map_msg *msg, const char *value)
 	g_free(msg->replyto);
 	msg->replyto = g_strdup(value);
 
-	g_dbus_emit_property_changed(conn, msg->path,
-						MAP_MSG_INTERFACE, "ReplyTo");
+	msg_property_changed(msg, "ReplyTo");
 }
 
 static void parse_recipient(struct map_msg *msg, const char *value)
@@ -1053,8 +1287,7 @@ static void parse_recipient(struct map_msg *msg, const char *value)
 	g_free(msg->recipient);
 	msg->recipient = g_strdup(value);
 
-	g_dbus_emit_property_changed(conn, msg->path,
-						MAP_MSG_INTERFACE, "Recipient");
+	msg_property_changed(msg, "Recipient");
 }
 
 static void parse_recipient_address(struct map_msg *msg, const char *value)
@@ -1065,8 +1298,7 @@ static void parse_recipient_address(struct map_msg *msg, const char *value)
 	g_free(msg->recipient_address);
 	msg->recipient_address = g_strdup(value);
 
-	g_dbus_emit_property_changed(conn, msg->path,
-					MAP_MSG_INTERFACE, "RecipientAddress");
+	msg_property_changed(msg, "RecipientAddress");
 }
 
 static void parse_size(struct map_msg *msg, const char *value)
@@ -1078,8 +1310,7 @@ static void parse_size(struct map_msg *msg, const char *value)
 
 	msg->size = size;
 
-	g_dbus_emit_property_changed(conn, msg->path,
-						MAP_MSG_INTERFACE, "Size");
+	msg_property_changed(msg, "Size");
 }
 
 static void parse_text(struct map_msg *msg, const char *value)
@@ -1093,8 +1324,7 @@ static void parse_text(struct map_msg *msg, const char *value)
 		msg->flags &= ~MAP_MSG_FLAG_TEXT;
 
 	if (msg->flags != oldflags)
-		g_dbus_emit_property_changed(conn, msg->path,
-						MAP_MSG_INTERFACE, "Text");
+		msg_property_changed(msg, "Text");
 }
 
 static void parse_status(struct map_msg *msg, const char *value)
@@ -1105,8 +1335,7 @@ static void parse_status(struct map_msg *msg, const char *value)
 	g_free(msg->status);
 	msg->status = g_strdup(value);
 
-	g_dbus_emit_property_changed(conn, msg->path,
-						MAP_MSG_INTERFACE, "Status");
+	msg_property_changed(msg, "Status");
 }
 
 static void parse_attachment_size(struct map_msg *msg, const char *value)
@@ -1118,8 +1347,7 @@ static void parse_attachment_size(struct map_msg *msg, const char *value)
 
 	msg->attachment_size = attachment_size;
 
-	g_dbus_emit_property_changed(conn, msg->path,
-					MAP_MSG_INTERFACE, "AttachmentSize");
+	msg_property_changed(msg, "AttachmentSize");
 }
 
 static void parse_priority(struct map_msg *msg, const char *value)
@@ -1133,8 +1361,7 @@ static void parse_priority(struct map_msg *msg, const char *value)
 		msg->flags &= ~MAP_MSG_FLAG_PRIORITY;
 
 	if (msg->flags != oldflags)
-		g_dbus_emit_property_changed(conn, msg->path,
-						MAP_MSG_INTERFACE, "Priority");
+		msg_property_changed(msg, "Priority");
 }
 
 static void parse_read(struct map_msg *msg, const char *value)
@@ -1148,8 +1375,7 @@ static void parse_read(struct map_msg *msg, const char *value)
 		msg->flags &= ~MAP_MSG_FLAG_READ;
 
 	if (msg->flags != oldflags)
-		g_dbus_emit_property_changed(conn, msg->path,
-						MAP_MSG_INTERFACE, "Read");
+		msg_property_changed(msg, "Read");
 }
 
 static void parse_sent(struct map_msg *msg, const char *value)
@@ -1163,8 +1389,7 @@ static void parse_sent(struct map_msg *msg, const char *value)
 		msg->flags &= ~MAP_MSG_FLAG_SENT;
 
 	if (msg->flags != oldflags)
-		g_dbus_emit_property_changed(conn, msg->path,
-						MAP_MSG_INTERFACE, "Sent");
+		msg_property_changed(msg, "Sent");
 }
 
 static void parse_protected(struct map_msg *msg, const char *value)
@@ -1178,8 +1403,7 @@ static void parse_protected(struct map_msg *msg, const char *value)
 		msg->flags &= ~MAP_MSG_FLAG_PROTECTED;
 
 	if (msg->flags != oldflags)
-		g_dbus_emit_property_changed(conn, msg->path,
-						MAP_MSG_INTERFACE, "Protected");
+		msg_property_changed(msg, "Protected");
 }
 
 static void parse_delivery_status(struct map_msg *msg, const char *value)
@@ -1190,8 +1414,7 @@ static void parse_delivery_status(struct map_msg *msg, const char *value)
 	g_free(msg->delivery_status);
 	msg->delivery_status = g_strdup(value);
 
-	g_dbus_emit_property_changed(conn, msg->path,
-					MAP_MSG_INTERFACE, "DeliveryStatus");
+	msg_property_changed(msg, "DeliveryStatus");
 }
 
 static void parse_conversation_id(struct map_msg *msg, const char *value)
@@ -1203,8 +1426,7 @@ static void parse_conversation_id(struct map_msg *msg, const char *value)
 
 	msg->conversation_id = conversation_id;
 
-	g_dbus_emit_property_changed(conn, msg->path, MAP_MSG_INTERFACE,
-						"ConversationId");
+	msg_property_changed(msg, "ConversationId");
 }
 
 static void parse_conversation_name(struct map_msg *msg, const char *value)
@@ -1215,8 +1437,7 @@ static void parse_conversation_name(struct map_msg *msg, const char *value)
 	g_free(msg->conversation_name);
 	msg->conversation_name = g_strdup(value);
 
-	g_dbus_emit_property_changed(conn, msg->path, MAP_MSG_INTERFACE,
-						"ConversationName");
+	msg_property_changed(msg, "ConversationName");
 }
 
 static void parse_direction(struct map_msg *msg, const char *value)
@@ -1227,8 +1448,7 @@ static void parse_direction(struct map_msg *msg, const char *value)
 	g_free(msg->direction);
 	msg->direction = g_strdup(value);
 
-	g_dbus_emit_property_changed(conn, msg->path, MAP_MSG_INTERFACE,
-						"Direction");
+	msg_property_changed(msg, "Direction");
 }
 
 static void parse_mime_types(struct map_msg *msg, const char *value)
@@ -1239,8 +1459,7 @@ static void parse_mime_types(struct map_msg *msg, const char *value)
 	g_free(msg->attachment_mime_types);
 	msg->attachment_mime_types = g_strdup(value);
 
-	g_dbus_emit_property_changed(conn, msg->path, MAP_MSG_INTERFACE,
-						"AttachmentMimeTypes");
+	msg_property_changed(msg, "AttachmentMimeTypes");
 }
 
 static const struct map_msg_parser {
@@ -1277,11 +1496,12 @@ static void msg_element(GMarkupParseContext *ctxt, const char *element,
 {
 	struct map_parser *parser = user_data;
 	struct map_data *data = parser->request->map;
-	DBusMessageIter entry, *iter = parser->iter;
+	DBusMessageIter entry, *iter;
 	struct map_msg *msg;
 	const char *key;
 	int i;
 	uint64_t handle;
+	char hstr[17], *name = hstr;
 
 	if (strcasecmp("msg", element) != 0)
 		return;
@@ -1291,21 +1511,22 @@ static void msg_element(GMarkupParseContext *ctxt, const char *element,
 			break;
 	}
 
+	if (key == NULL)
+		return;
+
 	handle = strtoull(values[i], NULL, 16);
 
-	msg = g_hash_table_lookup(data->messages, &handle);
-	if (msg == NULL) {
-		msg = map_msg_create(data, handle, parser->request->folder,
-									NULL);
-		if (msg == NULL)
-			return;
-	}
+	msg = map_msg_lookup(data, handle);
+	if (msg == NULL)
+		msg = map_msg_new(data, handle, parser->request->folder);
 
-	dbus_message_iter_open_container(iter, DBUS_TYPE_DICT_ENTRY, NULL,
-								&entry);
+	if (msg->path == NULL && parser->page_size)
+		map_msg_listed(data, msg);
 
-	dbus_message_iter_append_basic(&entry, DBUS_TYPE_OBJECT_PATH,
-								&msg->path);
+	/* Paged listings only create objects on GetMessage */
+	if (msg->path == NULL && !parser->page_size &&
+					!map_msg_publish(data, msg))
+		return;
 
 	for (i = 0, key = names[i]; key; key = names[++i]) {
 		const struct map_msg_parser *parser;
@@ -1319,9 +1540,31 @@ static void msg_element(GMarkupParseContext *ctxt, const char *element,
 		}
 	}
 
-	g_dbus_get_properties(conn, msg->path, MAP_MSG_INTERFACE, &entry);
+	iter = map_parser_open(parser);
+	if (iter == NULL)
+		return;
+
+	dbus_message_iter_open_container(iter, DBUS_TYPE_DICT_ENTRY, NULL,
+								&entry);
+
+	if (parser->page_size) {
+		snprintf(hstr, sizeof(hstr), "%" PRIx64, msg->handle);
+		dbus_message_iter_append_basic(&entry, DBUS_TYPE_STRING,
+								&name);
+	} else
+		dbus_message_iter_append_basic(&entry, DBUS_TYPE_OBJECT_PATH,
+								&msg->path);
+
+	if (msg->path)
+		g_dbus_get_properties(conn, msg->path, MAP_MSG_INTERFACE,
+								&entry);
+	else
+		append_msg_properties(msg, &entry);
 
 	dbus_message_iter_close_container(iter, &entry);
+
+	if (parser->page_size && ++parser->count == parser->page_size)
+		g_dbus_send_message(conn, map_parser_close(parser));
 }
 
 static const GMarkupParser msg_parser = {
@@ -1332,70 +1575,6 @@ static const GMarkupParser msg_parser = {
 	NULL
 };
 
-static void message_listing_cb(struct obc_session *session,
-						struct obc_transfer *transfer,
-						GError *err, void *user_data)
-{
-	struct pending_request *request = user_data;
-	struct map_parser *parser;
-	GMarkupParseContext *ctxt;
-	DBusMessage *reply;
-	DBusMessageIter iter, array;
-	char *contents;
-	size_t size;
-	int perr;
-
-	if (err != NULL) {
-		reply = g_dbus_create_error(request->msg,
-						ERROR_INTERFACE ".Failed",
-						"%s", err->message);
-		goto done;
-	}
-
-	perr = obc_transfer_get_contents(transfer, &contents, &size);
-	if (perr < 0) {
-		reply = g_dbus_create_error(request->msg,
-						ERROR_INTERFACE ".Failed",
-						"Error reading contents: %s",
-						strerror(-perr));
-		goto done;
-	}
-
-	reply = dbus_message_new_method_return(request->msg);
-	if (reply == NULL) {
-		g_free(contents);
-		goto clean;
-	}
-
-	dbus_message_iter_init_append(reply, &iter);
-	dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY,
-					DBUS_DICT_ENTRY_BEGIN_CHAR_AS_STRING
-					DBUS_TYPE_OBJECT_PATH_AS_STRING
-					DBUS_TYPE_ARRAY_AS_STRING
-					DBUS_DICT_ENTRY_BEGIN_CHAR_AS_STRING
-					DBUS_TYPE_STRING_AS_STRING
-					DBUS_TYPE_VARIANT_AS_STRING
-					DBUS_DICT_ENTRY_END_CHAR_AS_STRING
-					DBUS_DICT_ENTRY_END_CHAR_AS_STRING,
-					&array);
-
-	parser = g_new(struct map_parser, 1);
-	parser->request = request;
-	parser->iter = &array;
-
-	ctxt = g_markup_parse_context_new(&msg_parser, 0, parser, NULL);
-	g_markup_parse_context_parse(ctxt, contents, size, NULL);
-	g_markup_parse_context_free(ctxt);
-	dbus_message_iter_close_container(&iter, &array);
-	g_free(contents);
-	g_free(parser);
-
-done:
-	g_dbus_send_message(conn, reply);
-clean:
-	pending_request_free(request);
-}
-
 static char *get_absolute_folder(struct map_data *map, const char *subfolder)
 {
 	const char *root = obc_session_get_folder(map->session);
@@ -1411,9 +1590,11 @@ static char *get_absolute_folder(struct map_data *map, const char *subfolder)
 static DBusMessage *get_message_listing(struct map_data *map,
 							DBusMessage *message,
 							const char *folder,
-							GObexApparam *apparam)
+							GObexApparam *apparam,
+							uint16_t page_size)
 {
 	struct pending_request *request;
+	struct map_parser *parser;
 	struct obc_transfer *transfer;
 	GError *err = NULL;
 	DBusMessage *reply;
@@ -1429,7 +1610,27 @@ static DBusMessage *get_message_listing(struct map_data *map,
 	request = pending_request_new(map, message);
 	request->folder = get_absolute_folder(map, folder);
 
-	if (!obc_session_queue(map->session, transfer, message_listing_cb,
+	parser = map_parser_new(request, &msg_parser, page_size ?
+					DBUS_DICT_ENTRY_BEGIN_CHAR_AS_STRING
+					DBUS_TYPE_STRING_AS_STRING
+					DBUS_TYPE_ARRAY_AS_STRING
+					DBUS_DICT_ENTRY_BEGIN_CHAR_AS_STRING
+					DBUS_TYPE_STRING_AS_STRING
+					DBUS_TYPE_VARIANT_AS_STRING
+					DBUS_DICT_ENTRY_END_CHAR_AS_STRING
+					DBUS_DICT_ENTRY_END_CHAR_AS_STRING :
+					DBUS_DICT_ENTRY_BEGIN_CHAR_AS_STRING
+					DBUS_TYPE_OBJECT_PATH_AS_STRING
+					DBUS_TYPE_ARRAY_AS_STRING
+					DBUS_DICT_ENTRY_BEGIN_CHAR_AS_STRING
+					DBUS_TYPE_STRING_AS_STRING
+					DBUS_TYPE_VARIANT_AS_STRING
+					DBUS_DICT_ENTRY_END_CHAR_AS_STRING
+					DBUS_DICT_ENTRY_END_CHAR_AS_STRING);
+	parser->page_size = page_size;
+	obc_transfer_set_data_func(transfer, listing_data, parser);
+
+	if (!obc_session_queue(map->session, transfer, listing_cb,
 							request, &err)) {
 		pending_request_free(request);
 		goto fail;
@@ -1732,7 +1933,105 @@ static DBusMessage *map_list_messages(DBusConnection *connection,
 				ERROR_INTERFACE ".InvalidArguments", NULL);
 	}
 
-	return get_message_listing(map, message, folder, apparam);
+	return get_message_listing(map, message, folder, apparam, 0);
+}
+
+static bool parse_page_size(DBusMessageIter *iter, uint16_t *page_size)
+{
+	DBusMessageIter array;
+
+	dbus_message_iter_recurse(iter, &array);
+
+	while (dbus_message_iter_get_arg_type(&array) == DBUS_TYPE_DICT_ENTRY) {
+		const char *key;
+		DBusMessageIter value, entry;
+
+		dbus_message_iter_recurse(&array, &entry);
+		dbus_message_iter_get_basic(&entry, &key);
+
+		dbus_message_iter_next(&entry);
+		dbus_message_iter_recurse(&entry, &value);
+
+		if (strcasecmp(key, "PageSize") == 0) {
+			if (dbus_message_iter_get_arg_type(&value) !=
+							DBUS_TYPE_UINT16)
+				return false;
+
+			dbus_message_iter_get_basic(&value, page_size);
+			if (*page_size == 0)
+				return false;
+		}
+
+		dbus_message_iter_next(&array);
+	}
+
+	return true;
+}
+
+static DBusMessage *map_list_messages_paged(DBusConnection *connection,
+					DBusMessage *message, void *user_data)
+{
+	struct map_data *map = user_data;
+	const char *folder;
+	GObexApparam *apparam;
+	DBusMessageIter args;
+	uint16_t page_size = DEFAULT_PAGE_SIZE;
+
+	dbus_message_iter_init(message, &args);
+
+	if (dbus_message_iter_get_arg_type(&args) != DBUS_TYPE_STRING)
+		return g_dbus_create_error(message,
+				ERROR_INTERFACE ".InvalidArguments", NULL);
+
+	dbus_message_iter_get_basic(&args, &folder);
+
+	apparam = g_obex_apparam_set_uint16(NULL, MAP_AP_MAXLISTCOUNT,
+							DEFAULT_COUNT);
+	apparam = g_obex_apparam_set_uint16(apparam, MAP_AP_STARTOFFSET,
+							DEFAULT_OFFSET);
+
+	dbus_message_iter_next(&args);
+
+	if (parse_message_filters(apparam, &args) == NULL ||
+					!parse_page_size(&args, &page_size)) {
+		g_obex_apparam_free(apparam);
+		return g_dbus_create_error(message,
+				ERROR_INTERFACE ".InvalidArguments", NULL);
+	}
+
+	return get_message_listing(map, message, folder, apparam, page_size);
+}
+
+static DBusMessage *map_get_message(DBusConnection *connection,
+					DBusMessage *message, void *user_data)
+{
+	struct map_data *map = user_data;
+	struct map_msg *msg;
+	const char *handle;
+	uint64_t value;
+	char *end;
+
+	if (dbus_message_get_args(message, NULL, DBUS_TYPE_STRING, &handle,
+						DBUS_TYPE_INVALID) == FALSE)
+		return g_dbus_create_error(message,
+				ERROR_INTERFACE ".InvalidArguments", NULL);
+
+	value = strtoull(handle, &end, 16);
+	if (*handle == '\0' || *end != '\0')
+		return g_dbus_create_error(message,
+				ERROR_INTERFACE ".InvalidArguments", NULL);
+
+	msg = map_msg_lookup(map, value);
+	if (msg == NULL)
+		return g_dbus_create_error(message,
+				ERROR_INTERFACE ".DoesNotExist", NULL);
+
+	if (msg->path == NULL && !map_msg_publish(map, msg))
+		return g_dbus_create_error(message,
+				ERROR_INTERFACE ".Failed", NULL);
+
+	return g_dbus_create_reply(message, DBUS_TYPE_OBJECT_PATH, &msg->path,
+							DBUS_TYPE_INVALID);
 }
 
 static char **get_filter_strs(uint64_t filter, int *size)
@@ -1992,6 +2291,14 @@ static const GDBusMethodTable map_methods[] = {
 			GDBUS_ARGS({ "folder", "s" }, { "filter", "a{sv}" }),
 			GDBUS_ARGS({ "messages", "a{oa{sv}}" }),
 			map_list_messages) },
+	{ GDBUS_ASYNC_METHOD("ListMessagesPaged",
+			GDBUS_ARGS({ "folder", "s" }, { "filter", "a{sv}" }),
+			NULL,
+			map_list_messages_paged) },
+	{ GDBUS_METHOD("GetMessage",
+			GDBUS_ARGS({ "handle", "s" }),
+			GDBUS_ARGS({ "message", "o" }),
+			map_get_message) },
 	{ GDBUS_METHOD("ListFilterFields",
 			NULL,
 			GDBUS_ARGS({ "fields", "as" }),
@@ -2009,6 +2316,13 @@ static const GDBusMethodTable map_methods[] = {
 	{ }
 };
 
+static const GDBusSignalTable map_signals[] = {
+	{ GDBUS_SIGNAL("MessagesListed",
+			GDBUS_ARGS({ "folder", "s" },
+					{ "messages", "a{sa{sv}}" })) },
+	{ }
+};
+
 static gboolean get_supported_types(const GDBusPropertyTable *property,
 					DBusMessageIter *iter, void *user_data)
 {
@@ -2069,6 +2383,9 @@ static void map_handle_new_message(struct map_data *map,
 	if (msg)
 		g_hash_table_remove(map->messages, &event->handle);
 
+	g_hash_table_remove(map->listed, &event->handle);
+	g_hash_table_remove(map->listed_folders, &event->handle);
+
 	map_msg_create(map, event->handle, event->folder, event->msg_type);
 }
 
@@ -2078,7 +2395,7 @@ static void map_handle_status_changed(struct map_data *map,
 {
 	struct map_msg *msg;
 
-	msg = g_hash_table_lookup(map->messages, &event->handle);
+	msg = map_msg_lookup(map, event->handle);
 	if (msg == NULL)
 		return;
 
@@ -2088,8 +2405,7 @@ static void map_handle_status_changed(struct map_data *map,
 	g_free(msg->status);
 	msg->status = g_strdup(status);
 
-	g_dbus_emit_property_changed(conn, msg->path, MAP_MSG_INTERFACE,
-								"Status");
+	msg_property_changed(msg, "Status");
 }
 
 static void map_handle_folder_changed(struct map_data *map,
@@ -2101,7 +2417,7 @@ static void map_handle_folder_changed(struct map_data *map,
 	if (!folder)
 		return;
 
-	msg = g_hash_table_lookup(map->messages, &event->handle);
+	msg = map_msg_lookup(map, event->handle);
 	if (!msg)
 		return;
 
@@ -2111,8 +2427,7 @@ static void map_handle_folder_changed(struct map_data *map,
 	g_free(msg->folder);
 	msg->folder = g_strdup(folder);
 
-	g_dbus_emit_property_changed(conn, msg->path, MAP_MSG_INTERFACE,
-								"Folder");
+	msg_property_changed(msg, "Folder");
 }
 
 static void map_handle_notification(struct map_event *event, void *user_data)
@@ -2202,6 +2517,8 @@ static void map_free(void *data)
 
 	obc_session_unref(map->session);
 	g_hash_table_unref(map->messages);
+	g_hash_table_unref(map->listed);
+	g_hash_table_unref(map->listed_folders);
 	g_free(map);
 }
 
@@ -2278,6 +2595,11 @@ static int map_probe(struct obc_session *session)
 	map->session = obc_session_ref(session);
 	map->messages = g_hash_table_new_full(g_int64_hash, g_int64_equal, NULL,
 								map_msg_remove);
+	map->listed = g_hash_table_new_full(g_int64_hash, g_int64_equal, NULL,
+								map_msg_unlist);
+	g_queue_init(&map->listed_order);
+	map->listed_folders = g_hash_table_new_full(g_int64_hash,
+						g_int64_equal, g_free, NULL);
 
 	parse_service_record(map);
 
@@ -2286,7 +2608,8 @@ static int map_probe(struct obc_session *session)
 	set_notification_registration(map, true);
 
 	if (!g_dbus_register_interface(conn, path, MAP_INTERFACE, map_methods,
-					NULL, map_properties, map, map_free)) {
+					map_signals, map_properties, map,
+					map_free)) {
 		map_free(map);
 
 		return -ENOMEM;
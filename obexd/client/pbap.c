@@ -138,6 +138,11 @@ struct pbap_data {
 struct pending_request {
 	struct pbap_data *pbap;
 	DBusMessage *msg;
+	GMarkupParseContext *ctxt;
+	gboolean failed;
+	DBusMessage *reply;
+	DBusMessageIter iter;
+	DBusMessageIter array;
 };
 
 static DBusConnection *conn = NULL;
@@ -161,6 +166,12 @@ static struct pending_request *pending_request_new(struct pbap_data *pbap,
 static void pending_request_free(struct pending_request *p)
 {
 	dbus_message_unref(p->msg);
+
+	if (p->ctxt)
+		g_markup_parse_context_free(p->ctxt);
+
+	if (p->reply)
+		dbus_message_unref(p->reply);
 	g_free(p);
 }
 
@@ -171,7 +182,8 @@ static void listing_element(GMarkupParseContext *ctxt,
 				gpointer user_data,
 				GError **gerr)
 {
-	DBusMessageIter *item = user_data, entry;
+	struct pending_request *request = user_data;
+	DBusMessageIter *item = &request->array, entry;
 	char **key;
 	const char *handle = NULL, *vcardname = NULL;
 
@@ -394,17 +406,30 @@ send:
 	pending_request_free(request);
 }
 
+static gboolean pull_vcard_listing_data(struct obc_transfer *transfer,
+						const void *buf, size_t len,
+						void *user_data)
+{
+	struct pending_request *request = user_data;
+
+	/* Like a listing parsed in one go, keep what came before an error */
+	if (request->failed)
+		return TRUE;
+
+	if (!g_markup_parse_context_parse(request->ctxt, buf, len, NULL)) {
+		DBG("Unable to parse vcard listing");
+		request->failed = TRUE;
+	}
+
+	return TRUE;
+}
+
 static void pull_vcard_listing_callback(struct obc_session *session,
 						struct obc_transfer *transfer,
 						GError *err, void *user_data)
 {
 	struct pending_request *request = user_data;
-	GMarkupParseContext *ctxt;
 	DBusMessage *reply;
-	DBusMessageIter iter, array;
-	char *contents;
-	size_t size;
-	int perr;
 
 	if (err) {
 		reply = g_dbus_create_error(request->msg,
@@ -413,27 +438,9 @@ static void pull_vcard_listing_callback(struct obc_session *session,
 		goto send;
 	}
 
-	perr = obc_transfer_get_contents(transfer, &contents, &size);
-	if (perr < 0) {
-		reply = g_dbus_create_error(request->msg,
-						ERROR_INTERFACE ".Failed",
-						"Error reading contents: %s",
-						strerror(-perr));
-		goto send;
-	}
-
-	reply = dbus_message_new_method_return(request->msg);
-
-	dbus_message_iter_init_append(reply, &iter);
-	dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY,
-			DBUS_STRUCT_BEGIN_CHAR_AS_STRING
-			DBUS_TYPE_STRING_AS_STRING DBUS_TYPE_STRING_AS_STRING
-			DBUS_STRUCT_END_CHAR_AS_STRING, &array);
-	ctxt = g_markup_parse_context_new(&listing_parser, 0, &array, NULL);
-	g_markup_parse_context_parse(ctxt, contents, size, NULL);
-	g_markup_parse_context_free(ctxt);
-	dbus_message_iter_close_container(&iter, &array);
-	g_free(contents);
+	dbus_message_iter_close_container(&request->iter, &request->array);
+	reply = request->reply;
+	request->reply = NULL;
 
 send:
 	g_dbus_send_message(conn, reply);
@@ -693,6 +700,18 @@ static DBusMessage *pull_vcard_listing(struct pbap_data *pbap,
 	obc_transfer_set_apparam(transfer, apparam);
 
 	request = pending_request_new(pbap, message);
+
+	/* Entries are appended to the reply as the listing arrives */
+	request->reply = dbus_message_new_method_return(message);
+	dbus_message_iter_init_append(request->reply, &request->iter);
+	dbus_message_iter_open_container(&request->iter, DBUS_TYPE_ARRAY,
+			DBUS_STRUCT_BEGIN_CHAR_AS_STRING
+			DBUS_TYPE_STRING_AS_STRING DBUS_TYPE_STRING_AS_STRING
+			DBUS_STRUCT_END_CHAR_AS_STRING, &request->array);
+	request->ctxt = g_markup_parse_context_new(&listing_parser, 0, request,
+									NULL);
+	obc_transfer_set_data_func(transfer, pull_vcard_listing_data, request);
+
 	if (obc_session_queue(pbap->session, transfer,
 				pull_vcard_listing_callback, request, &err))
 		return NULL;
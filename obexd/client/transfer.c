@@ -60,6 +60,8 @@ struct obc_transfer {
 	GSList *headers;
 	guint8 op;
 	struct transfer_callback *callback;
+	transfer_data_func_t data_func;
+	void *data_user;
 	DBusConnection *conn;
 	DBusMessage *msg;
 	char *session;		/* Session path */
@@ -641,6 +643,16 @@ static gboolean get_xfer_progress(const void *buf, gsize len,
 {
 	struct obc_transfer *transfer = user_data;
 
+	/* Consumers parsing the body as it arrives don't need a copy of it */
+	if (transfer->data_func) {
+		if (!transfer->data_func(transfer, buf, len,
+							transfer->data_user))
+			return FALSE;
+
+		transfer->transferred += len;
+		return TRUE;
+	}
+
 	if (transfer->fd > 0) {
 		int w;
 
@@ -731,8 +743,13 @@ static void get_xfer_progress_first(GObex *obex, GError *err, GObexPacket *rsp,
 	hdr = g_obex_packet_get_body(rsp);
 	if (hdr) {
 		g_obex_header_get_bytes(hdr, &buf, &len);
-		if (len != 0)
-			get_xfer_progress(buf, len, transfer);
+		if (len != 0 && !get_xfer_progress(buf, len, transfer)) {
+			err = g_error_new(OBC_TRANSFER_ERROR, -EIO,
+						"Unable to process data");
+			xfer_complete(obex, err, transfer);
+			g_error_free(err);
+			return;
+		}
 	}
 
 	if (rspcode == G_OBEX_RSP_SUCCESS) {
@@ -786,6 +803,19 @@ gboolean obc_transfer_set_callback(struct obc_transfer *transfer,
 	return TRUE;
 }
 
+gboolean obc_transfer_set_data_func(struct obc_transfer *transfer,
+					transfer_data_func_t func,
+					void *user_data)
+{
+	if (transfer->op != G_OBEX_OP_GET || transfer->data_func != NULL)
+		return FALSE;
+
+	transfer->data_func = func;
+	transfer->data_user = user_data;
+
+	return TRUE;
+}
+
 static gboolean report_progress(gpointer data)
 {
 	struct obc_transfer *transfer = data;
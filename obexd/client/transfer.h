@@ -13,6 +13,9 @@ struct obc_transfer;
 
 typedef void (*transfer_callback_t) (struct obc_transfer *transfer,
 					GError *err, void *user_data);
+typedef gboolean (*transfer_data_func_t) (struct obc_transfer *transfer,
+					const void *buf, size_t len,
+					void *user_data);
 
 struct obc_transfer *obc_transfer_get(const char *type, const char *name,
 					const char *filename, GError **err);
@@ -33,6 +36,10 @@ gboolean obc_transfer_set_callback(struct obc_transfer *transfer,
 					transfer_callback_t func,
 					void *user_data);
 
+gboolean obc_transfer_set_data_func(struct obc_transfer *transfer,
+					transfer_data_func_t func,
+					void *user_data);
+
 gboolean obc_transfer_start(struct obc_transfer *transfer, void *obex,
 								GError **err);
 guint8 obc_transfer_get_operation(struct obc_transfer *transfer);
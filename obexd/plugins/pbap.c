@@ -52,34 +52,68 @@
 #define PHONEBOOKSIZE_TAG	0X08
 #define NEWMISSEDCALLS_TAG	0X09
 
+/*
+ * Next part of a phonebook pull is requested from the back-end once the
+ * buffered data drops below this, so that at most one part is fetched
+ * while the previous one is being sent.
+ */
+#define PULL_LOW_WATERMARK	8192
+
+#define ORDER_INDEXED		0x00
+#define ORDER_ALPHANUMERIC	0x01
+#define ORDER_PHONETIC		0x02
+#define ORDER_MAX		ORDER_PHONETIC
+
+/*
+ * With back-ends able to report changes, folder caches are shared by all
+ * PBAP sessions and survive disconnections. They are checked against the
+ * back-end before being used and only dropped when the folder contents
+ * have changed. Otherwise each session keeps its own caches, dropped on
+ * SetPhoneBook and disconnection.
+ */
 struct cache {
 	gboolean valid;
+	gboolean changed;	/* Changed while being fetched */
 	uint32_t index;
 	gchar *path;
-	GSList *entries;
+	GPtrArray *entries;
+	GHashTable *handles;
+	GPtrArray *orders[ORDER_MAX + 1];
+	void *request;
+	GSList *waiting;
 };
 
 struct cache_entry {
 	uint32_t handle;
 	char *id;
 	char *name;
+	char *name_lower;
 	char *sound;
 	char *tel;
 };
 
+struct pbap_session;
+
+typedef void (*cache_ready_f) (struct pbap_session *pbap);
+
 struct pbap_session {
 	struct apparam_field *params;
 	char *folder;
 	uint32_t find_handle;
-	struct cache cache;
+	GHashTable *caches;
+	struct cache *cache;
+	cache_ready_f cache_ready;
 	struct pbap_object *obj;
 };
 
 struct pbap_object {
 	GString *buffer;
+	gsize offset;
 	GObexApparam *apparam;
 	gboolean firstpacket;
 	gboolean lastpart;
+	gboolean pending;
+	int err;
 	struct pbap_session *session;
 	void *request;
 };
@@ -88,6 +122,9 @@ static const uint8_t PBAP_TARGET[TARGET_SIZE] = {
 			0x79, 0x61, 0x35, 0xF0,  0xF0, 0xC5, 0x11, 0xD8,
 			0x09, 0x66, 0x08, 0x00,  0x20, 0x0C, 0x9A, 0x66  };
 
+static GHashTable *caches = NULL;
+static gboolean track_changes = FALSE;
+
 typedef int (*cache_entry_find_f) (const struct cache_entry *entry,
 			const char *value);
 
@@ -97,6 +134,7 @@ static void cache_entry_free(void *data)
 
 	g_free(entry->id);
 	g_free(entry->name);
+	g_free(entry->name_lower);
 	g_free(entry->sound);
 	g_free(entry->tel);
 	g_free(entry);
@@ -105,20 +143,13 @@ static void cache_entry_free(void *data)
 static gboolean entry_name_find(const struct cache_entry *entry,
 		const char *value)
 {
-	char *name;
-	gboolean ret;
-
-	if (!entry->name)
+	if (!entry->name_lower)
 		return FALSE;
 
 	if (strlen(value) == 0)
 		return TRUE;
 
-	name = g_utf8_strdown(entry->name, -1);
-	ret = (g_strstr_len(name, -1, value) ? TRUE : FALSE);
-	g_free(name);
-
-	return ret;
+	return (g_strstr_len(entry->name_lower, -1, value) ? TRUE : FALSE);
 }
 
 static gboolean entry_sound_find(const struct cache_entry *entry,
@@ -141,27 +172,117 @@ static gboolean entry_tel_find(const struct cache_entry *entry,
 
 static const char *cache_find(struct cache *cache, uint32_t handle)
 {
-	GSList *l;
+	struct cache_entry *entry;
 
-	for (l = cache->entries; l; l = l->next) {
-		struct cache_entry *entry = l->data;
+	entry = g_hash_table_lookup(cache->handles, GUINT_TO_POINTER(handle));
+	if (!entry)
+		return NULL;
 
-		if (entry->handle == handle)
-			return entry->id;
-	}
-
-	return NULL;
+	return entry->id;
 }
 
-static void invalidate_cache(struct cache *cache)
+static void cache_clear(struct cache *cache)
 {
-	DBG("invalidating cache (path %s)", cache->path ? cache->path : "<null>");
+	int i;
+
 	cache->valid = FALSE;
 	cache->index = 0;
+
+	for (i = 0; i <= ORDER_MAX; i++) {
+		if (!cache->orders[i])
+			continue;
+
+		g_ptr_array_free(cache->orders[i], TRUE);
+		cache->orders[i] = NULL;
+	}
+
+	g_hash_table_remove_all(cache->handles);
+	g_ptr_array_set_size(cache->entries, 0);
+}
+
+static struct cache *cache_new(const char *path)
+{
+	struct cache *cache;
+
+	cache = g_new0(struct cache, 1);
+	cache->path = g_strdup(path);
+	cache->entries = g_ptr_array_new_with_free_func(cache_entry_free);
+	cache->handles = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+	return cache;
+}
+
+static void cache_free(void *data)
+{
+	struct cache *cache = data;
+
+	if (cache->request)
+		phonebook_req_finalize(cache->request);
+
+	cache_clear(cache);
+	g_slist_free(cache->waiting);
+	g_hash_table_destroy(cache->handles);
+	g_ptr_array_free(cache->entries, TRUE);
 	g_free(cache->path);
-	cache->path = NULL;
-	g_slist_free_full(cache->entries, cache_entry_free);
-	cache->entries = NULL;
+	g_free(cache);
+}
+
+static GHashTable *caches_new(void)
+{
+	return g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+								cache_free);
+}
+
+static struct cache *cache_get(struct pbap_session *pbap, const char *path)
+{
+	struct cache *cache;
+
+	cache = g_hash_table_lookup(pbap->caches, path);
+	if (cache)
+		return cache;
+
+	cache = cache_new(path);
+	g_hash_table_insert(pbap->caches, cache->path, cache);
+
+	return cache;
+}
+
+static void invalidate_cache(struct cache *cache)
+{
+	/*
+	 * Entries being fetched may predate the change, drop them once
+	 * the sessions waiting for them have been served.
+	 */
+	if (!cache->valid) {
+		if (cache->request)
+			cache->changed = TRUE;
+		return;
+	}
+
+	DBG("invalidating cache (path %s)", cache->path);
+	cache_clear(cache);
+}
+
+static void phonebook_changed(const char *folder, void *user_data)
+{
+	struct cache *cache;
+
+	DBG("folder %s", folder ? folder : "<all>");
+
+	if (folder == NULL) {
+		GHashTableIter iter;
+		gpointer value;
+
+		g_hash_table_iter_init(&iter, caches);
+		while (g_hash_table_iter_next(&iter, NULL, &value))
+			invalidate_cache(value);
+
+		return;
+	}
+
+	cache = g_hash_table_lookup(caches, folder);
+	if (cache)
+		invalidate_cache(cache);
 }
 
 static void phonebook_size_result(const char *buffer, size_t bufsize,
@@ -212,17 +333,23 @@ static void query_result(const char *buffer, size_t bufsize, int vcards,
 	}
 
 	pbap->obj->lastpart = lastpart;
+	pbap->obj->pending = FALSE;
 
 	if (vcards < 0) {
+		pbap->obj->err = -ENOENT;
 		obex_object_set_io_flags(pbap->obj, G_IO_ERR, -ENOENT);
 		return;
 	}
 
 	if (!pbap->obj->buffer)
 		pbap->obj->buffer = g_string_new_len(buffer, bufsize);
-	else
+	else {
+		/* Drop what has already been sent before growing */
+		g_string_erase(pbap->obj->buffer, 0, pbap->obj->offset);
+		pbap->obj->offset = 0;
 		pbap->obj->buffer = g_string_append_len(pbap->obj->buffer,
 							buffer,	bufsize);
+	}
 
 	if (missed > 0)	{
 		DBG("missed %d", missed);
@@ -241,43 +368,48 @@ static void cache_entry_notify(const char *id, uint32_t handle,
 					const char *name, const char *sound,
 					const char *tel, void *user_data)
 {
-	struct pbap_session *pbap = user_data;
+	struct cache *cache = user_data;
 	struct cache_entry *entry = g_new0(struct cache_entry, 1);
-	struct cache *cache = &pbap->cache;
 
 	if (handle != PHONEBOOK_INVALID_HANDLE)
 		entry->handle = handle;
 	else
-		entry->handle = ++pbap->cache.index;
+		entry->handle = ++cache->index;
 
 	entry->id = g_strdup(id);
 	entry->name = g_strdup(name);
+	entry->name_lower = name ? g_utf8_strdown(name, -1) : NULL;
 	entry->sound = g_strdup(sound);
 	entry->tel = g_strdup(tel);
 
-	cache->entries = g_slist_append(cache->entries, entry);
+	g_ptr_array_add(cache->entries, entry);
+	g_hash_table_insert(cache->handles, GUINT_TO_POINTER(entry->handle),
+									entry);
 }
 
 static int alpha_sort(gconstpointer a, gconstpointer b)
 {
-	const struct cache_entry *e1 = a;
-	const struct cache_entry *e2 = b;
+	const struct cache_entry *e1 = *(struct cache_entry * const *) a;
+	const struct cache_entry *e2 = *(struct cache_entry * const *) b;
 
 	return g_strcmp0(e1->name, e2->name);
 }
 
 static int indexed_sort(gconstpointer a, gconstpointer b)
 {
-	const struct cache_entry *e1 = a;
-	const struct cache_entry *e2 = b;
+	const struct cache_entry *e1 = *(struct cache_entry * const *) a;
+	const struct cache_entry *e2 = *(struct cache_entry * const *) b;
 
-	return (e1->handle - e2->handle);
+	if (e1->handle == e2->handle)
+		return 0;
+
+	return e1->handle < e2->handle ? -1 : 1;
 }
 
 static int phonetical_sort(gconstpointer a, gconstpointer b)
 {
-	const struct cache_entry *e1 = a;
-	const struct cache_entry *e2 = b;
+	const struct cache_entry *e1 = *(struct cache_entry * const *) a;
+	const struct cache_entry *e2 = *(struct cache_entry * const *) b;
 
 	/* SOUND attribute is optional. Use Indexed sort if not present. */
 	if (!e1->sound || !e2->sound)
@@ -286,13 +418,16 @@ static int phonetical_sort(gconstpointer a, gconstpointer b)
 	return g_strcmp0(e1->sound, e2->sound);
 }
 
-static GSList *sort_entries(GSList *l, uint8_t order, uint8_t search_attrib,
-							const char *value)
+/*
+ * Sorted views are built on first use and kept until the cache is
+ * invalidated, so following listings only need to walk the requested
+ * window.
+ */
+static GPtrArray *cache_get_order(struct cache *cache, uint8_t order)
 {
-	GSList *sorted = NULL;
-	cache_entry_find_f find;
 	GCompareFunc sort;
-	char *searchval;
+	GPtrArray *sorted;
+	guint i;
 
 	/*
 	 * Default sorter is "Indexed". Some backends doesn't inform the index,
@@ -302,23 +437,89 @@ static GSList *sort_entries(GSList *l, uint8_t order, uint8_t search_attrib,
 	 * 0x02 = phonetic
 	 */
 	switch (order) {
-	case 0x01:
+	case ORDER_ALPHANUMERIC:
 		sort = alpha_sort;
 		break;
-	case 0x02:
+	case ORDER_PHONETIC:
 		sort = phonetical_sort;
 		break;
 	default:
+		order = ORDER_INDEXED;
 		sort = indexed_sort;
 		break;
 	}
 
+	if (cache->orders[order])
+		return cache->orders[order];
+
+	sorted = g_ptr_array_sized_new(cache->entries->len);
+	for (i = 0; i < cache->entries->len; i++)
+		g_ptr_array_add(sorted, g_ptr_array_index(cache->entries, i));
+
+	g_ptr_array_sort(sorted, sort);
+	cache->orders[order] = sorted;
+
+	return sorted;
+}
+
+static void append_listing(GString *buffer, const struct cache_entry *entry)
+{
+	char *escaped_name = g_markup_escape_text(entry->name, -1);
+
+	g_string_append_printf(buffer, VCARD_LISTING_ELEMENT, entry->handle,
+								escaped_name);
+
+	g_free(escaped_name);
+}
+
+static int generate_response(void *user_data)
+{
+	struct pbap_session *pbap = user_data;
+	struct cache *cache = pbap->cache;
+	GPtrArray *sorted;
+	cache_entry_find_f find;
+	char *searchval;
+	guint i;
+	uint16_t max = pbap->params->maxlistcount;
+	uint16_t offset = pbap->params->liststartoffset;
+
+	DBG("");
+
+	if (max == 0) {
+		/* Ignore all other parameter and return PhoneBookSize */
+		uint16_t size = cache->entries->len;
+
+		pbap->obj->firstpacket = TRUE;
+		pbap->obj->apparam = g_obex_apparam_set_uint16(
+							pbap->obj->apparam,
+							PHONEBOOKSIZE_TAG,
+							size);
+
+		return 0;
+	}
+
+	/*
+	 * Don't free the sorted list content: this list contains
+	 * only the reference for the "real" cache entry.
+	 */
+	sorted = cache_get_order(cache, pbap->params->order);
+
+	pbap->obj->buffer = g_string_new(VCARD_LISTING_BEGIN);
+
+	if (!pbap->params->searchval) {
+		/* Computing offset considering first entry of the phonebook */
+		for (i = offset; i < sorted->len && max; i++, max--)
+			append_listing(pbap->obj->buffer,
+					g_ptr_array_index(sorted, i));
+		goto done;
+	}
+
 	/*
 	 * This implementation checks if the given field CONTAINS the
 	 * search value(case insensitive). Name is the default field
 	 * when the attribute is not provided.
 	 */
-	switch (search_attrib) {
+	switch (pbap->params->searchattrib) {
 		/* Number */
 		case 1:
 			find = entry_tel_find;
@@ -332,105 +533,191 @@ static GSList *sort_entries(GSList *l, uint8_t order, uint8_t search_attrib,
 			break;
 	}
 
-	searchval = value ? g_utf8_strdown(value, -1) : NULL;
-	for (; l; l = l->next) {
-		struct cache_entry *entry = l->data;
+	searchval = g_utf8_strdown(pbap->params->searchval, -1);
+
+	/* Offset applies to the filtered result */
+	for (i = 0; i < sorted->len && max; i++) {
+		const struct cache_entry *entry = g_ptr_array_index(sorted, i);
 
-		if (searchval && !find(entry, (const char *) searchval))
+		if (!find(entry, searchval))
 			continue;
 
-		sorted = g_slist_insert_sorted(sorted, entry, sort);
+		if (offset) {
+			offset--;
+			continue;
+		}
+
+		append_listing(pbap->obj->buffer, entry);
+		max--;
 	}
 
 	g_free(searchval);
 
-	return sorted;
+done:
+	pbap->obj->buffer = g_string_append(pbap->obj->buffer,
+							VCARD_LISTING_END);
+
+	return 0;
 }
 
-static int generate_response(void *user_data)
+static void cache_notify_waiting(struct cache *cache)
 {
-	struct pbap_session *pbap = user_data;
-	GSList *sorted;
-	GSList *l;
-	uint16_t max = pbap->params->maxlistcount;
+	GSList *waiting, *l;
 
-	DBG("");
+	waiting = cache->waiting;
+	cache->waiting = NULL;
 
-	if (max == 0) {
-		/* Ignore all other parameter and return PhoneBookSize */
-		uint16_t size = g_slist_length(pbap->cache.entries);
+	for (l = waiting; l; l = l->next) {
+		struct pbap_session *pbap = l->data;
+		cache_ready_f cb = pbap->cache_ready;
 
-		pbap->obj->firstpacket = TRUE;
-		pbap->obj->apparam = g_obex_apparam_set_uint16(
-							pbap->obj->apparam,
-							PHONEBOOKSIZE_TAG,
-							size);
+		pbap->cache_ready = NULL;
+		cb(pbap);
+	}
 
-		return 0;
+	g_slist_free(waiting);
+}
+
+static void cache_ready_notify(void *user_data)
+{
+	struct cache *cache = user_data;
+
+	DBG("path %s entries %u", cache->path, cache->entries->len);
+
+	if (cache->request) {
+		phonebook_req_finalize(cache->request);
+		cache->request = NULL;
 	}
 
+	cache->valid = TRUE;
+
+	cache_notify_waiting(cache);
+
 	/*
-	 * Don't free the sorted list content: this list contains
-	 * only the reference for the "real" cache entry.
+	 * Empty results are not kept: they may come from a back-end
+	 * failure and are cheap to fetch again anyway.
 	 */
-	sorted = sort_entries(pbap->cache.entries, pbap->params->order,
-				pbap->params->searchattrib,
-				(const char *) pbap->params->searchval);
+	if (cache->entries->len == 0 || cache->changed) {
+		cache->changed = FALSE;
+		cache_clear(cache);
+	}
+}
 
-	/* Computing offset considering first entry of the phonebook */
-	l = g_slist_nth(sorted, pbap->params->liststartoffset);
+static int cache_fill(struct cache *cache)
+{
+	int ret = 0;
 
-	pbap->obj->buffer = g_string_new(VCARD_LISTING_BEGIN);
-	for (; l && max; l = l->next, max--) {
-		const struct cache_entry *entry = l->data;
-		char *escaped_name = g_markup_escape_text(entry->name, -1);
+	cache->changed = FALSE;
+	cache->request = phonebook_create_cache(cache->path,
+					cache_entry_notify, cache_ready_notify,
+					cache, &ret);
+	if (ret < 0)
+		cache->request = NULL;
+
+	return ret;
+}
+
+static int cache_request(struct cache *cache, struct pbap_session *pbap,
+							cache_ready_f cb)
+{
+	int ret;
 
-		g_string_append_printf(pbap->obj->buffer,
-			VCARD_LISTING_ELEMENT, entry->handle, escaped_name);
+	pbap->cache = cache;
+	pbap->cache_ready = cb;
+	cache->waiting = g_slist_prepend(cache->waiting, pbap);
 
-		g_free(escaped_name);
+	/* Someone else is already filling the cache, wait for it */
+	if (cache->request)
+		return 0;
+
+	ret = cache_fill(cache);
+	if (ret < 0) {
+		cache->waiting = g_slist_remove(cache->waiting, pbap);
+		pbap->cache_ready = NULL;
 	}
 
-	pbap->obj->buffer = g_string_append(pbap->obj->buffer,
-							VCARD_LISTING_END);
-	g_slist_free(sorted);
+	return ret;
+}
 
-	return 0;
+static void cache_checked(void *user_data)
+{
+	struct cache *cache = user_data;
+
+	DBG("path %s valid %d", cache->path, cache->valid);
+
+	phonebook_req_finalize(cache->request);
+	cache->request = NULL;
+
+	if (cache->valid) {
+		cache_notify_waiting(cache);
+		return;
+	}
+
+	/* Folder changed, fetch it again for the sessions waiting */
+	if (cache_fill(cache) < 0)
+		cache_ready_notify(cache);
 }
 
-static void cache_ready_notify(void *user_data)
+/*
+ * Shared caches may be outdated if the back-end storage changed since the
+ * last request, so the back-end is asked to check before they are used.
+ * Returns TRUE if the session has to wait for the check to complete.
+ */
+static gboolean cache_check(struct cache *cache, struct pbap_session *pbap,
+							cache_ready_f cb)
 {
-	struct pbap_session *pbap = user_data;
+	int ret = 0;
 
-	DBG("");
+	pbap->cache = cache;
+
+	if (track_changes && !cache->request) {
+		cache->request = phonebook_check_cache(cache->path,
+						cache_checked, cache, &ret);
+		if (ret < 0)
+			cache->request = NULL;
+	}
+
+	if (!cache->request)
+		return FALSE;
+
+	pbap->cache_ready = cb;
+	cache->waiting = g_slist_prepend(cache->waiting, pbap);
+
+	return TRUE;
+}
 
-	phonebook_req_finalize(pbap->obj->request);
-	pbap->obj->request = NULL;
+static void cache_cancel(struct pbap_session *pbap)
+{
+	if (!pbap->cache || !pbap->cache_ready)
+		return;
+
+	/* Cache request itself is kept: the result is useful for others */
+	pbap->cache->waiting = g_slist_remove(pbap->cache->waiting, pbap);
+	pbap->cache_ready = NULL;
+}
 
-	pbap->cache.valid = TRUE;
+static void cache_list_ready(struct pbap_session *pbap)
+{
+	DBG("");
 
 	generate_response(pbap);
 	obex_object_set_io_flags(pbap->obj, G_IO_IN, 0);
 }
 
-static void cache_entry_done(void *user_data)
+static void cache_entry_done(struct pbap_session *pbap)
 {
-	struct pbap_session *pbap = user_data;
 	const char *id;
 	int ret;
 
 	DBG("");
 
-	pbap->cache.valid = TRUE;
-
-	id = cache_find(&pbap->cache, pbap->find_handle);
+	id = cache_find(pbap->cache, pbap->find_handle);
 	if (id == NULL) {
 		DBG("Entry %d not found on cache", pbap->find_handle);
 		obex_object_set_io_flags(pbap->obj, G_IO_ERR, -ENOENT);
 		return;
 	}
 
-	phonebook_req_finalize(pbap->obj->request);
 	pbap->obj->request = phonebook_get_entry(pbap->folder, id,
 				pbap->params, query_result, pbap, &ret);
 	if (ret < 0)
@@ -483,6 +770,7 @@ static void *pbap_connect(struct obex_session *os, int *err)
 	pbap = g_new0(struct pbap_session, 1);
 	pbap->folder = g_strdup("/");
 	pbap->find_handle = PHONEBOOK_INVALID_HANDLE;
+	pbap->caches = track_changes ? g_hash_table_ref(caches) : caches_new();
 
 	if (err)
 		*err = 0;
@@ -540,12 +828,6 @@ static int pbap_get(struct obex_session *os, void *user_data)
 
 	pbap->params = params;
 
-	DBG("cache check NAME='%s', FOLDER='%s', CACHEPATH='%s', VALID=%s",
-		name,
-		pbap->folder ? pbap->folder : "<null>",
-		pbap->cache.path ? pbap->cache.path : "<null>",
-		pbap->cache.valid ? "yes" : "no");
-
 	if (g_ascii_strcasecmp(type, PHONEBOOK_TYPE) == 0) {
 		/* Always contains the absolute path */
 		if (g_path_is_absolute(name))
@@ -553,14 +835,6 @@ static int pbap_get(struct obex_session *os, void *user_data)
 		else
 			path = g_build_filename("/", name, NULL);
 
-		if (!pbap->cache.valid) {
-			g_free(pbap->cache.path);
-			pbap->cache.path = g_strdup(path);
-		} else if (g_strcmp0(path, pbap->cache.path)) {
-			invalidate_cache(&pbap->cache);
-			pbap->cache.path = g_strdup(path);
-		}
-
 	} else if (g_ascii_strcasecmp(type, VCARDLISTING_TYPE) == 0) {
 		/* Always relative */
 		if (!name || strlen(name) == 0) {
@@ -571,26 +845,10 @@ static int pbap_get(struct obex_session *os, void *user_data)
 			path = g_build_filename(pbap->folder, name, NULL);
 		}
 
-		if (!pbap->cache.valid) {
-			g_free(pbap->cache.path);
-			pbap->cache.path = g_strdup(path);
-		} else if (g_strcmp0(path, pbap->cache.path)) {
-			invalidate_cache(&pbap->cache);
-			pbap->cache.path = g_strdup(path);
-		}
-
 	} else if (g_ascii_strcasecmp(type, VCARDENTRY_TYPE) == 0) {
 		/* File name only */
 		path = g_strdup(name);
 
-		if (!pbap->cache.valid) {
-			g_free(pbap->cache.path);
-			pbap->cache.path = g_strdup(pbap->folder);
-		} else if (g_strcmp0(pbap->folder, pbap->cache.path)) {
-			invalidate_cache(&pbap->cache);
-			pbap->cache.path = g_strdup(pbap->folder);
-		}
-
 	} else
 		return -EBADR;
 
@@ -604,6 +862,12 @@ static int pbap_get(struct obex_session *os, void *user_data)
 	return ret;
 }
 
+static void invalidate_session_cache(gpointer key, gpointer value,
+							gpointer user_data)
+{
+	invalidate_cache(value);
+}
+
 static int pbap_setpath(struct obex_session *os, void *user_data)
 {
 	struct pbap_session *pbap = user_data;
@@ -629,10 +893,10 @@ static int pbap_setpath(struct obex_session *os, void *user_data)
 	g_free(pbap->folder);
 	pbap->folder = fullname;
 
-	/*
-	 * FIXME: Define a criteria to mark the cache as invalid
-	 */
-	invalidate_cache(&pbap->cache);
+	/* Without change notifications the folder may have been updated */
+	if (!track_changes)
+		g_hash_table_foreach(pbap->caches, invalidate_session_cache,
+									NULL);
 
 	return 0;
 }
@@ -643,6 +907,8 @@ static void pbap_disconnect(struct obex_session *os, void *user_data)
 
 	manager_unregister_session(os);
 
+	cache_cancel(pbap);
+
 	if (pbap->obj) {
 		if (pbap->obj->request) {
 			phonebook_req_finalize(pbap->obj->request);
@@ -656,7 +922,7 @@ static void pbap_disconnect(struct obex_session *os, void *user_data)
 		g_free(pbap->params);
 	}
 
-	invalidate_cache(&pbap->cache);
+	g_hash_table_unref(pbap->caches);
 	g_free(pbap->folder);
 	g_free(pbap);
 }
@@ -696,6 +962,7 @@ static void *vobject_pull_open(const char *name, int oflag, mode_t mode,
 				void *context, size_t *size, int *err)
 {
 	struct pbap_session *pbap = context;
+	struct pbap_object *obj;
 	phonebook_cb cb;
 	int ret = 0;
 	void *request;
@@ -731,7 +998,10 @@ static void *vobject_pull_open(const char *name, int oflag, mode_t mode,
 	if (err)
 		*err = 0;
 
-	return vobject_create(pbap, request);
+	obj = vobject_create(pbap, request);
+	obj->pending = TRUE;
+
+	return obj;
 
 fail:
 	if (err)
@@ -746,8 +1016,10 @@ static int vobject_close(void *object)
 
 	DBG("");
 
-	if (obj->session)
+	if (obj->session) {
+		cache_cancel(obj->session);
 		obj->session->obj = NULL;
+	}
 
 	if (obj->buffer) {
 		g_string_free(obj->buffer, TRUE);
@@ -774,32 +1046,33 @@ static void *vobject_list_open(const char *name, int oflag, mode_t mode,
 {
 	struct pbap_session *pbap = context;
 	struct pbap_object *obj = NULL;
+	struct cache *cache;
 	int ret;
-	void *request;
 
 	if (name == NULL) {
 		ret = -EBADR;
 		goto fail;
 	}
 
-	DBG("name %s context %p valid %d", name, context, pbap->cache.valid);
-
 	if (oflag != O_RDONLY) {
 		ret = -EPERM;
 		goto fail;
 	}
 
+	cache = cache_get(pbap, name);
+
+	DBG("name %s context %p valid %d", name, context, cache->valid);
+
 	/* PullvCardListing always get the contacts from the cache */
+	obj = vobject_create(pbap, NULL);
 
-	if (pbap->cache.valid) {
-		obj = vobject_create(pbap, NULL);
+	if (!cache->valid)
+		ret = cache_request(cache, pbap, cache_list_ready);
+	else if (cache_check(cache, pbap, cache_list_ready))
+		ret = 0;
+	else
 		ret = generate_response(pbap);
-	} else {
-		request = phonebook_create_cache(name, cache_entry_notify,
-					cache_ready_notify, pbap, &ret);
-		if (ret == 0)
-			obj = vobject_create(pbap, request);
-	}
+
 	if (ret < 0)
 		goto fail;
 
@@ -822,13 +1095,12 @@ static void *vobject_vcard_open(const char *name, int oflag, mode_t mode,
 					void *context, size_t *size, int *err)
 {
 	struct pbap_session *pbap = context;
+	struct cache *cache;
 	const char *id;
 	uint32_t handle;
 	int ret;
 	void *request;
 
-	DBG("name %s context %p valid %d", name, context, pbap->cache.valid);
-
 	if (oflag != O_RDONLY) {
 		ret = -EPERM;
 		goto fail;
@@ -839,14 +1111,25 @@ static void *vobject_vcard_open(const char *name, int oflag, mode_t mode,
 		goto fail;
 	}
 
-	if (pbap->cache.valid == FALSE) {
-		pbap->find_handle = handle;
-		request = phonebook_create_cache(pbap->folder,
-			cache_entry_notify, cache_entry_done, pbap, &ret);
+	cache = cache_get(pbap, pbap->folder);
+
+	DBG("name %s context %p valid %d", name, context, cache->valid);
+
+	pbap->find_handle = handle;
+
+	if (cache->valid == FALSE) {
+		ret = cache_request(cache, pbap, cache_entry_done);
+		request = NULL;
+		goto done;
+	}
+
+	if (cache_check(cache, pbap, cache_entry_done)) {
+		ret = 0;
+		request = NULL;
 		goto done;
 	}
 
-	id = cache_find(&pbap->cache, handle);
+	id = cache_find(cache, handle);
 	if (!id) {
 		ret = -ENOENT;
 		goto fail;
@@ -890,15 +1173,40 @@ static ssize_t vobject_pull_get_next_header(void *object, void *buf, size_t mtu,
 	return 0;
 }
 
+static ssize_t buffer_read(struct pbap_object *obj, void *buf, size_t count)
+{
+	size_t len;
+
+	/*
+	 * Consumed data is only dropped when a new part is appended or the
+	 * buffer is drained, instead of moving the remaining data on every
+	 * read.
+	 */
+	len = MIN(obj->buffer->len - obj->offset, count);
+	memcpy(buf, obj->buffer->str + obj->offset, len);
+	obj->offset += len;
+
+	if (obj->offset == obj->buffer->len) {
+		g_string_truncate(obj->buffer, 0);
+		obj->offset = 0;
+	}
+
+	return len;
+}
+
 static ssize_t vobject_pull_read(void *object, void *buf, size_t count)
 {
 	struct pbap_object *obj = object;
 	struct pbap_session *pbap = obj->session;
-	int len, ret;
+	ssize_t len;
+	int ret;
 
 	DBG("buffer %p maxlistcount %d", obj->buffer,
 						pbap->params->maxlistcount);
 
+	if (obj->err < 0)
+		return obj->err;
+
 	if (!obj->buffer) {
 		if (pbap->params->maxlistcount == 0)
 			return -ENOSTR;
@@ -906,19 +1214,26 @@ static ssize_t vobject_pull_read(void *object, void *buf, size_t count)
 		return -EAGAIN;
 	}
 
-	len = string_read(obj->buffer, buf, count);
-	if (len == 0 && !obj->lastpart) {
-		/* in case when buffer is empty and we know that more
-		 * data is still available in backend, requesting new
-		 * data part via phonebook_pull_read and returning
-		 * -EAGAIN to suspend request for now */
+	len = buffer_read(obj, buf, count);
+
+	/*
+	 * Request the next part from the back-end while the buffered data
+	 * is still being sent, so the transfer doesn't stall waiting for
+	 * it and no more than one part is kept in memory.
+	 */
+	if (!obj->lastpart && !obj->pending &&
+			obj->buffer->len - obj->offset < PULL_LOW_WATERMARK) {
 		ret = phonebook_pull_read(obj->request);
 		if (ret)
 			return -EPERM;
 
-		return -EAGAIN;
+		obj->pending = TRUE;
 	}
 
+	/* Suspend the request until more data is available */
+	if (len == 0 && !obj->lastpart)
+		return -EAGAIN;
+
 	return len;
 }
 
@@ -926,10 +1241,9 @@ static ssize_t vobject_list_get_next_header(void *object, void *buf, size_t mtu,
 								uint8_t *hi)
 {
 	struct pbap_object *obj = object;
-	struct pbap_session *pbap = obj->session;
 
 	/* Backend still busy reading contacts */
-	if (!pbap->cache.valid)
+	if (!obj->buffer && !obj->apparam)
 		return -EAGAIN;
 
 	*hi = G_OBEX_HDR_APPARAM;
@@ -947,7 +1261,7 @@ static ssize_t vobject_list_read(void *object, void *buf, size_t count)
 	struct pbap_object *obj = object;
 	struct pbap_session *pbap = obj->session;
 
-	DBG("valid %d maxlistcount %d", pbap->cache.valid,
+	DBG("buffer %p maxlistcount %d", obj->buffer,
 						pbap->params->maxlistcount);
 
 	if (pbap->params->maxlistcount == 0)
@@ -1026,6 +1340,9 @@ init:
 	if (err < 0)
 		return err;
 
+	caches = caches_new();
+	track_changes = phonebook_set_changed_cb(phonebook_changed, NULL);
+
 	err = obex_mime_type_driver_register(&mime_pull);
 	if (err < 0)
 		goto fail_mime_pull;
@@ -1051,6 +1368,9 @@ fail_mime_vcard:
 fail_mime_list:
 	obex_mime_type_driver_unregister(&mime_pull);
 fail_mime_pull:
+	phonebook_set_changed_cb(NULL, NULL);
+	g_hash_table_destroy(caches);
+	caches = NULL;
 	phonebook_exit();
 
 	return err;
@@ -1062,6 +1382,9 @@ static void pbap_exit(void)
 	obex_mime_type_driver_unregister(&mime_pull);
 	obex_mime_type_driver_unregister(&mime_list);
 	obex_mime_type_driver_unregister(&mime_vcard);
+	phonebook_set_changed_cb(NULL, NULL);
+	g_hash_table_destroy(caches);
+	caches = NULL;
 	phonebook_exit();
 }
 
@@ -90,6 +90,12 @@ void phonebook_exit(void)
 	root_folder = NULL;
 }
 
+gboolean phonebook_set_changed_cb(phonebook_changed_cb cb, void *user_data)
+{
+	/* Changes in the storage are not tracked by this back-end */
+	return FALSE;
+}
+
 static int handle_cmp(gconstpointer a, gconstpointer b)
 {
 	const char *f1 = a;
@@ -572,3 +578,12 @@ void *phonebook_create_cache(const char *name, phonebook_entry_cb entry_cb,
 
 	return dummy;
 }
+
+void *phonebook_check_cache(const char *name,
+		phonebook_cache_ready_cb ready_cb, void *user_data, int *err)
+{
+	if (err)
+		*err = -ENOSYS;
+
+	return NULL;
+}
@@ -625,6 +625,15 @@ next:
 	return data;
 }
 
+void *phonebook_check_cache(const char *name,
+		phonebook_cache_ready_cb ready_cb, void *user_data, int *err)
+{
+	if (err)
+		*err = -ENOSYS;
+
+	return NULL;
+}
+
 int phonebook_init(void)
 {
 	EClient *client;
@@ -668,3 +677,9 @@ void phonebook_exit(void)
 	g_object_unref(address_book);
 	g_object_unref(registry);
 }
+
+gboolean phonebook_set_changed_cb(phonebook_changed_cb cb, void *user_data)
+{
+	/* Changes in the storage are not tracked by this back-end */
+	return FALSE;
+}
@@ -53,6 +53,8 @@
 #define CALLHIST_METHOD_FETCH_MANY "Fetch"
 
 #define CHUNK_LENGTH 128
+/* Kept small so that the first response can be sent without delay */
+#define FIRST_CHUNK_LENGTH 16
 
 #define VERSION_UNSET 0
 
@@ -100,6 +102,13 @@ static const char *filter_name[FILTER_BIT_MAX + 1] = {
 
 static DBusConnection *conn = NULL;
 
+static phonebook_changed_cb changed_cb = NULL;
+static void *changed_user_data = NULL;
+
+/* Last storage versions reported by the vCard and call history service */
+static guint32 contacts_version = VERSION_UNSET;
+static guint32 callhist_version = VERSION_UNSET;
+
 struct phonebook_data
 {
 	char *name;
@@ -119,7 +128,7 @@ struct phonebook_data
 	void (*process_end)(struct phonebook_data *data, gboolean last);
 
 	guint32 pull_count;
-	char *pull_buf;
+	GString *pull_buf;
 
 	guint32 newmissedcalls;
 
@@ -191,6 +200,37 @@ static const char *format_to_string(uint8_t format)
 		PB_FORMAT_NONE_STRING;
 }
 
+static void update_version(gboolean contacts, guint32 version)
+{
+	static const char *callhist_folders[] = {
+		PB_CALLS_COMBINED_FOLDER,
+		PB_CALLS_INCOMING_FOLDER,
+		PB_CALLS_MISSED_FOLDER,
+		PB_CALLS_OUTGOING_FOLDER,
+		NULL
+	};
+	guint32 *current = contacts ? &contacts_version : &callhist_version;
+	gboolean changed;
+	int i;
+
+	changed = (*current != VERSION_UNSET && *current != version);
+	*current = version;
+
+	if (!changed || !changed_cb)
+		return;
+
+	DBG("%s version changed to %u", contacts ? "Contacts" : "Call history",
+								version);
+
+	if (contacts) {
+		changed_cb(PB_CONTACTS_FOLDER, changed_user_data);
+		return;
+	}
+
+	for (i = 0; callhist_folders[i]; i++)
+		changed_cb(callhist_folders[i], changed_user_data);
+}
+
 static DBusMessage *next_chunk_request(struct phonebook_data *data,
 					const char *fmt,
 					const char *type)
@@ -276,6 +316,7 @@ static void count_cb(DBusPendingCall *pend,
 	dbus_message_iter_init(reply, &iter);
 	dbus_message_iter_get_basic(&iter, &version);
 	dbus_message_iter_next(&iter);
+	update_version(contacts_cb, version);
 	if (!contacts_cb) {
 		if (!g_strcmp0(data->name, PB_CALLS_MISSED) ||
 			!g_strcmp0(data->name, PB_CALLS_MISSED_FOLDER))
@@ -296,10 +337,45 @@ done:
 		TRUE, data->user_data);
 }
 
+static void check_cb(DBusPendingCall *pend, void *user_data)
+{
+	struct phonebook_data *data = user_data;
+	DBusMessage *reply;
+	DBusMessageIter iter;
+	gboolean contacts;
+	guint32 version;
+
+	DBG("");
+
+	contacts = !g_strcmp0(data->name, PB_CONTACTS_FOLDER);
+
+	reply = dbus_pending_call_steal_reply(data->pend);
+	dbus_pending_call_unref(data->pend);
+	data->pend = NULL;
+
+	if (reply == NULL)
+		goto done;
+
+	/* Only the storage version in front of the count matters here */
+	if (dbus_message_get_type(reply) != DBUS_MESSAGE_TYPE_ERROR &&
+			dbus_message_iter_init(reply, &iter) &&
+			dbus_message_iter_get_arg_type(&iter) ==
+							DBUS_TYPE_UINT32) {
+		dbus_message_iter_get_basic(&iter, &version);
+		update_version(contacts, version);
+	} else
+		DBG("Unable to check %s version", data->name);
+
+	dbus_message_unref(reply);
+
+done:
+	data->ready_cb(data->user_data);
+}
+
 static void pull_begin(struct phonebook_data *data)
 {
-	g_free(data->pull_buf);
-	data->pull_buf = NULL;
+	if (data->pull_buf)
+		g_string_truncate(data->pull_buf, 0);
 	data->pull_count = 0;
 }
 
@@ -311,28 +387,26 @@ static void pull_process(struct phonebook_data *data,
 {
 	data->pull_count++;
 	if (data->pull_buf == NULL)
-		data->pull_buf = g_strdup(vcard);
-	else {
-		char *oldbuf = data->pull_buf;
-		data->pull_buf = g_strconcat(oldbuf, vcard, NULL);
-		g_free(oldbuf);
-	}
+		data->pull_buf = g_string_new(vcard);
+	else
+		g_string_append(data->pull_buf, vcard);
 }
 
 static void pull_end(struct phonebook_data *data, gboolean last)
 {
-	char *buf = data->pull_buf;
+	GString *buf = data->pull_buf;
 	guint32 count = data->pull_count;
 	data->pull_buf = NULL;
 	data->pull_count = 0;
 
 	DBG("Forwarding %zu bytes, %d items (%d new missed calls).",
-		buf ? strlen(buf) : 0, count, data->newmissedcalls);
-	data->cb(buf, buf ? strlen(buf) : 0, count,
+		buf ? buf->len : 0, count, data->newmissedcalls);
+	data->cb(buf ? buf->str : NULL, buf ? buf->len : 0, count,
 		data->newmissedcalls > 0xff ? 0xff : data->newmissedcalls,
 		last, data->user_data);
 
-	g_free(buf);
+	if (buf)
+		g_string_free(buf, TRUE);
 }
 
 static void cache_begin(struct phonebook_data *data)
@@ -403,6 +477,7 @@ static void fetch_one_cb(DBusPendingCall *pend,
 	dbus_message_iter_init(reply, &iter);
 	dbus_message_iter_get_basic(&iter, &version);
 	dbus_message_iter_next(&iter);
+	update_version(contacts_cb, version);
 	if (!contacts_cb) {
 		if (!g_strcmp0(data->name, PB_CALLS_MISSED) ||
 			!g_strcmp0(data->name, PB_CALLS_MISSED_FOLDER))
@@ -475,6 +550,7 @@ static void fetch_many_cb(DBusPendingCall *pend,
 	dbus_message_iter_init(reply, &iter);
 	dbus_message_iter_get_basic(&iter, &version);
 	dbus_message_iter_next(&iter);
+	update_version(contacts_cb, version);
 	if (!contacts_cb) {
 		if (!g_strcmp0(data->name, PB_CALLS_MISSED) ||
 			!g_strcmp0(data->name, PB_CALLS_MISSED_FOLDER))
@@ -519,6 +595,8 @@ done:
 	if (results == data->chunk_length &&
 			data->chunk_offset < data->chunk_end) {
 		/* Full chunk read but not at the end -> read more later */
+		if (data->chunk_length < CHUNK_LENGTH)
+			data->chunk_length = CHUNK_LENGTH;
 		(data->process_end)(data, FALSE);
 	} else {
 		/* Everything read or error */
@@ -544,6 +622,14 @@ void phonebook_exit(void)
 	dbus_connection_unref(conn);
 }
 
+gboolean phonebook_set_changed_cb(phonebook_changed_cb cb, void *user_data)
+{
+	changed_cb = cb;
+	changed_user_data = user_data;
+
+	return TRUE;
+}
+
 char *phonebook_set_folder(const char *current_folder,
 		const char *new_folder, uint8_t flags, int *err)
 {
@@ -653,7 +739,7 @@ void *phonebook_pull(const char *name,
 	data->process_end = pull_end;
 
 	data->chunk_offset = data->params->liststartoffset;
-	data->chunk_length = CHUNK_LENGTH;
+	data->chunk_length = FIRST_CHUNK_LENGTH;
 	data->chunk_end = data->params->liststartoffset +
 				data->params->maxlistcount;
 
@@ -879,6 +965,65 @@ void *phonebook_create_cache(const char *name,
 	return data;
 }
 
+/* Storage versions only come along with replies, so ask for the cheapest
+ * one: the number of entries.
+ */
+void *phonebook_check_cache(const char *name,
+		phonebook_cache_ready_cb ready_cb, void *user_data, int *err)
+{
+	struct phonebook_data *data;
+	DBusMessage *msg;
+
+	DBG("name %s", name);
+
+	if (g_strcmp0(name, PB_CONTACTS_FOLDER) &&
+		g_strcmp0(name, PB_CALLS_INCOMING_FOLDER) &&
+		g_strcmp0(name, PB_CALLS_OUTGOING_FOLDER) &&
+		g_strcmp0(name, PB_CALLS_MISSED_FOLDER) &&
+		g_strcmp0(name, PB_CALLS_COMBINED_FOLDER)) {
+		if (err)
+			*err = -ENOENT;
+		return NULL;
+	}
+
+	data = g_new0(struct phonebook_data, 1);
+	data->name = g_strdup(name);
+	data->user_data = user_data;
+	data->ready_cb = ready_cb;
+
+	if (g_strcmp0(name, PB_CONTACTS_FOLDER) == 0) {
+		msg = dbus_message_new_method_call(CALLDATA_SERVICE,
+						CONTACTS_PATH,
+						CONTACTS_INTERFACE,
+						CONTACTS_METHOD_FETCH_COUNT);
+	} else {
+		const char *type = name_to_calltype(name);
+
+		msg = dbus_message_new_method_call(CALLDATA_SERVICE,
+						CALLHIST_PATH,
+						CALLHIST_INTERFACE,
+						CALLHIST_METHOD_FETCH_COUNT);
+		dbus_message_append_args(msg,
+					DBUS_TYPE_STRING, &type,
+					DBUS_TYPE_INVALID);
+	}
+
+	dbus_connection_send_with_reply(conn,
+					msg,
+					&data->pend,
+					DBUS_TIMEOUT_USE_DEFAULT);
+	dbus_pending_call_set_notify(data->pend,
+				check_cb,
+				data,
+				NULL);
+	dbus_message_unref(msg);
+
+	if (err)
+		*err = 0;
+
+	return data;
+}
+
 void phonebook_req_finalize(void *request)
 {
 	struct phonebook_data *data = request;
@@ -893,7 +1038,8 @@ void phonebook_req_finalize(void *request)
 		dbus_pending_call_unref(data->pend);
 	}
 
-	g_free(data->pull_buf);
+	if (data->pull_buf)
+		g_string_free(data->pull_buf, TRUE);
 	g_free(data->name);
 	g_free(data);
 }
@@ -1431,6 +1431,12 @@ void phonebook_exit(void)
 {
 }
 
+gboolean phonebook_set_changed_cb(phonebook_changed_cb cb, void *user_data)
+{
+	/* Changes in the storage are not tracked by this back-end */
+	return FALSE;
+}
+
 char *phonebook_set_folder(const char *current_folder, const char *new_folder,
 						uint8_t flags, int *err)
 {
@@ -1703,3 +1709,12 @@ void *phonebook_create_cache(const char *name, phonebook_entry_cb entry_cb,
 
 	return data;
 }
+
+void *phonebook_check_cache(const char *name,
+		phonebook_cache_ready_cb ready_cb, void *user_data, int *err)
+{
+	if (err)
+		*err = -ENOSYS;
+
+	return NULL;
+}
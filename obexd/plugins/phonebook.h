@@ -78,10 +78,27 @@ typedef void (*phonebook_entry_cb) (const char *id, uint32_t handle,
  */
 typedef void (*phonebook_cache_ready_cb) (void *user_data);
 
+/*
+ * Interface between the back-ends and the PBAP core to notify that the
+ * contents of a folder changed, so that the cached entries of that folder
+ * are dropped. A NULL folder means that every folder may have changed.
+ */
+typedef void (*phonebook_changed_cb) (const char *folder, void *user_data);
+
 
 int phonebook_init(void);
 void phonebook_exit(void);
 
+/*
+ * Registers the callback used to notify changes in the back-end storage.
+ * Passing NULL removes the callback.
+ *
+ * Returns FALSE if the back-end is unable to detect changes, in which case
+ * the PBAP core keeps its caches per session and drops them on SetPhoneBook
+ * and disconnection.
+ */
+gboolean phonebook_set_changed_cb(phonebook_changed_cb cb, void *user_data);
+
 /*
  * Changes the current folder in the phonebook back-end. The PBAP core
  * doesn't validate or restrict the possible values for the folders,
@@ -141,6 +158,18 @@ void *phonebook_get_entry(const char *folder, const char *id,
 void *phonebook_create_cache(const char *name, phonebook_entry_cb entry_cb,
 		phonebook_cache_ready_cb ready_cb, void *user_data, int *err);
 
+/*
+ * Checks whether the contents of a cached folder changed in the back-end
+ * storage. Changes found are notified through the callback registered with
+ * phonebook_set_changed_cb before ready_cb is called. Only used with
+ * back-ends able to detect changes.
+ *
+ * Return value is a pointer to asynchronous request to phonebook back-end.
+ * phonebook_req_finalize MUST always be used to free associated resources.
+ */
+void *phonebook_check_cache(const char *name,
+		phonebook_cache_ready_cb ready_cb, void *user_data, int *err);
+
 /*
  * Finalizes request to phonebook back-end and deallocates associated
  * resources. Operation is canceled if not completed. This function MUST
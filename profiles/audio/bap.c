@@ -58,6 +58,7 @@
 #include "src/service.h"
 #include "src/log.h"
 #include "src/error.h"
+#include "src/textfile.h"
 
 #include "transport.h"
 
@@ -3842,6 +3843,191 @@ static void bap_bcast_remove(struct btd_service *service)
 	bap_data_remove(data);
 }
 
+static void bap_pacs_filename(struct btd_device *device, char *filename)
+{
+	char dst_addr[18];
+
+	ba2str(device_get_address(device), dst_addr);
+
+	create_filename(filename, PATH_MAX, "/%s/cache/%s",
+			btd_adapter_get_storage_dir(device_get_adapter(device)),
+			dst_addr);
+}
+
+/* Check that a stored handle still refers to a characteristic of the same
+ * type, handles change e.g. after a firmware update of the remote.
+ */
+static bool bap_pacs_handle_valid(struct gatt_db *db, uint16_t handle,
+								uint16_t uuid)
+{
+	struct gatt_db_attribute *attr;
+	bt_uuid_t type;
+
+	attr = gatt_db_get_attribute(db, handle);
+	if (!attr)
+		return false;
+
+	bt_uuid16_create(&type, uuid);
+
+	return !bt_uuid_cmp(gatt_db_attribute_get_type(attr), &type);
+}
+
+/* Drop the values stored for handles the remote no longer has */
+static bool bap_pacs_remove_stale(struct gatt_db *db, GKeyFile *key_file)
+{
+	char **keys, **key;
+	uint16_t handle, uuid;
+	bool pruned = false;
+
+	keys = g_key_file_get_keys(key_file, "PACS", NULL, NULL);
+
+	for (key = keys; key && *key; key++) {
+		if (sscanf(*key, "%04hx:%04hx", &handle, &uuid) == 2 &&
+				bap_pacs_handle_valid(db, handle, uuid))
+			continue;
+
+		DBG("Removing stale PACS %s", *key);
+		g_key_file_remove_key(key_file, "PACS", *key, NULL);
+		pruned = true;
+	}
+
+	g_strfreev(keys);
+
+	return pruned;
+}
+
+/* Values are keyed by handle and UUID since a server may expose several
+ * Sink or Source PAC characteristics.
+ */
+static void bap_pacs_store(struct bt_bap *bap, uint16_t handle,
+					uint16_t uuid, const uint8_t *value,
+					uint16_t length, void *user_data)
+{
+	struct btd_device *device = user_data;
+	char filename[PATH_MAX];
+	char key[10];
+	GKeyFile *key_file;
+	GError *gerr = NULL;
+	char *str, *old, *data;
+	gsize len = 0;
+	uint16_t i;
+	bool pruned;
+
+	/* Only bonded devices are expected to keep the same capabilities */
+	if (!device_is_bonded(device, btd_device_get_bdaddr_type(device)))
+		return;
+
+	bap_pacs_filename(device, filename);
+
+	key_file = g_key_file_new();
+	if (!g_key_file_load_from_file(key_file, filename, 0, &gerr)) {
+		error("Unable to load key file from %s: (%s)", filename,
+								gerr->message);
+		g_clear_error(&gerr);
+	}
+
+	pruned = bap_pacs_remove_stale(btd_device_get_gatt_db(device),
+								key_file);
+
+	sprintf(key, "%04hx:%04hx", handle, uuid);
+
+	str = g_malloc0(length * 2 + 1);
+	for (i = 0; i < length; i++)
+		sprintf(str + i * 2, "%02hhx", value[i]);
+
+	/* Skip writing if nothing has changed */
+	old = g_key_file_get_string(key_file, "PACS", key, NULL);
+	if (!pruned && old && !strcmp(old, str))
+		goto done;
+
+	g_key_file_set_string(key_file, "PACS", key, str);
+
+	data = g_key_file_to_data(key_file, &len, NULL);
+	if (!g_file_set_contents(filename, data, len, &gerr)) {
+		error("Unable set contents for %s: (%s)", filename,
+								gerr->message);
+		g_error_free(gerr);
+	}
+
+	g_free(data);
+
+done:
+	g_free(old);
+	g_free(str);
+	g_key_file_free(key_file);
+}
+
+static void bap_pacs_load(struct bap_data *data)
+{
+	struct btd_device *device = data->device;
+	struct gatt_db *db = btd_device_get_gatt_db(device);
+	char filename[PATH_MAX];
+	GKeyFile *key_file;
+	char **keys, **key;
+
+	if (!device_is_bonded(device, btd_device_get_bdaddr_type(device)))
+		return;
+
+	bap_pacs_filename(device, filename);
+
+	key_file = g_key_file_new();
+	if (!g_key_file_load_from_file(key_file, filename, 0, NULL)) {
+		g_key_file_free(key_file);
+		return;
+	}
+
+	keys = g_key_file_get_keys(key_file, "PACS", NULL, NULL);
+
+	for (key = keys; key && *key; key++) {
+		uint8_t *value;
+		uint16_t handle, uuid;
+		char *str;
+		size_t i, len;
+
+		if (sscanf(*key, "%04hx:%04hx", &handle, &uuid) != 2)
+			continue;
+
+		/* Values of handles no longer in the cached database are
+		 * outdated, they are removed on the next store.
+		 */
+		if (!gatt_db_isempty(db) &&
+				!bap_pacs_handle_valid(db, handle, uuid)) {
+			DBG("Skipping stale PACS %s", *key);
+			continue;
+		}
+
+		str = g_key_file_get_string(key_file, "PACS", *key, NULL);
+		if (!str)
+			continue;
+
+		len = strlen(str);
+		if (!len || len % 2 || len / 2 > UINT16_MAX) {
+			warn("Unable to load PACS 0x%04x", uuid);
+			g_free(str);
+			continue;
+		}
+
+		value = g_malloc(len / 2);
+
+		for (i = 0; i < len; i += 2) {
+			if (sscanf(str + i, "%02hhx", &value[i / 2]) != 1)
+				break;
+		}
+
+		g_free(str);
+
+		if (i != len)
+			warn("Unable to load PACS 0x%04x", uuid);
+		else if (!bt_bap_restore_pacs(data->bap, uuid, value, len / 2))
+			DBG("Unable to restore PACS 0x%04x", uuid);
+
+		g_free(value);
+	}
+
+	g_strfreev(keys);
+	g_key_file_free(key_file);
+}
+
 static int bap_probe(struct btd_service *service)
 {
 	struct btd_device *device = btd_service_get_device(service);
@@ -3885,6 +4071,7 @@ static int bap_probe(struct btd_service *service)
 						service, NULL);
 
 	bt_bap_set_user_data(data->bap, service);
+	bt_bap_set_pacs_func(data->bap, bap_pacs_store, device);
 
 	return 0;
 }
@@ -3907,6 +4094,11 @@ static int bap_accept(struct btd_service *service)
 	data->bap_ready = false;
 	data->services_ready = false;
 
+	/* Restore capabilities of the last connection so the session can be
+	 * ready without reading them first, they are revalidated afterwards.
+	 */
+	bap_pacs_load(data);
+
 	if (!bt_bap_attach(data->bap, client)) {
 		error("BAP unable to attach");
 		return -EINVAL;
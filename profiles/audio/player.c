@@ -38,6 +38,12 @@
 #define MEDIA_FOLDER_INTERFACE "org.bluez.MediaFolder1"
 #define MEDIA_ITEM_INTERFACE "org.bluez.MediaItem1"
 
+/*
+ * Number of ListItems results kept exported per folder, older ones are
+ * unregistered so browsing large folders doesn't grow without bound.
+ */
+#define MEDIA_FOLDER_MAX_PAGES 4
+
 struct player_callback {
 	const struct media_player_callback *cbs;
 	void *user_data;
@@ -58,6 +64,11 @@ struct media_item {
 	bool			playable;	/* Item playable flag */
 	uint64_t		uid;		/* Item uid */
 	GHashTable		*metadata;	/* Item metadata */
+	unsigned int		pages;		/* Pages referencing item */
+};
+
+struct media_page {
+	GSList			*items;
 };
 
 struct media_folder {
@@ -66,6 +77,8 @@ struct media_folder {
 	uint32_t		number_of_items;/* Number of items */
 	GSList			*subfolders;
 	GSList			*items;
+	GHashTable		*uids;		/* Items by uid */
+	GSList			*pages;		/* Most recently listed first */
 	DBusMessage		*msg;
 };
 
@@ -659,6 +672,130 @@ static void parse_folder_list(gpointer data, gpointer user_data)
 	dbus_message_iter_close_container(array, &entry);
 }
 
+static void media_item_destroy(void *data);
+
+static void media_folder_remove_item(struct media_folder *folder,
+						struct media_item *item)
+{
+	folder->items = g_slist_remove(folder->items, item);
+
+	if (item->uid)
+		g_hash_table_remove(folder->uids, &item->uid);
+
+	media_item_destroy(item);
+}
+
+static void media_page_free(struct media_folder *folder,
+						struct media_page *page)
+{
+	GSList *l;
+
+	for (l = page->items; l; l = l->next) {
+		struct media_item *item = l->data;
+		struct media_player *mp = item->player;
+
+		if (--item->pages > 0)
+			continue;
+
+		/* Keep the item of the current track exported */
+		if (mp->track == item->metadata)
+			continue;
+
+		media_folder_remove_item(folder, item);
+	}
+
+	g_slist_free(page->items);
+	g_free(page);
+}
+
+/* Drop the item of a previous track once no listed page references it */
+static void media_folder_release_track(struct media_folder *folder,
+							GHashTable *track)
+{
+	GSList *l;
+
+	for (l = folder->items; l; l = l->next) {
+		struct media_item *item = l->data;
+
+		if (item->metadata != track)
+			continue;
+
+		if (item->pages == 0)
+			media_folder_remove_item(folder, item);
+
+		return;
+	}
+}
+
+static void media_folder_add_page(struct media_folder *folder, GSList *items)
+{
+	struct media_page *page;
+	struct media_item *first = NULL;
+	GSList *l;
+
+	page = g_new0(struct media_page, 1);
+
+	for (l = items; l; l = l->next) {
+		struct media_item *item = l->data;
+
+		/* Folders are kept as long as the player exists */
+		if (item->type == PLAYER_ITEM_TYPE_FOLDER)
+			continue;
+
+		if (!first)
+			first = item;
+
+		item->pages++;
+		page->items = g_slist_prepend(page->items, item);
+	}
+
+	if (!page->items) {
+		g_free(page);
+		return;
+	}
+
+	/* Listing the same range again replaces the previous page */
+	for (l = folder->pages; l; l = l->next) {
+		struct media_page *old = l->data;
+
+		if (g_slist_last(old->items)->data != first)
+			continue;
+
+		folder->pages = g_slist_delete_link(folder->pages, l);
+		media_page_free(folder, old);
+		break;
+	}
+
+	folder->pages = g_slist_prepend(folder->pages, page);
+
+	while (g_slist_length(folder->pages) > MEDIA_FOLDER_MAX_PAGES) {
+		l = g_slist_last(folder->pages);
+		page = l->data;
+		folder->pages = g_slist_delete_link(folder->pages, l);
+		media_page_free(folder, page);
+	}
+}
+
+static void media_page_destroy(void *data)
+{
+	struct media_page *page = data;
+
+	g_slist_free(page->items);
+	g_free(page);
+}
+
+static void media_folder_clear_items(struct media_folder *folder)
+{
+	g_slist_free_full(folder->pages, media_page_destroy);
+	folder->pages = NULL;
+
+	if (folder->uids)
+		g_hash_table_remove_all(folder->uids);
+
+	g_slist_free_full(folder->items, media_item_destroy);
+	folder->items = NULL;
+}
+
 void media_player_list_complete(struct media_player *mp, GSList *items,
 								int err)
 {
@@ -692,6 +829,8 @@ void media_player_list_complete(struct media_player *mp, GSList *items,
 	g_slist_foreach(items, parse_folder_list, &array);
 	dbus_message_iter_close_container(&iter, &array);
 
+	media_folder_add_page(folder, items);
+
 done:
 	g_dbus_send_message(btd_get_dbus_connection(), reply);
 	dbus_message_unref(folder->msg);
@@ -951,7 +1090,10 @@ static void media_folder_destroy(void *data)
 	struct media_folder *folder = data;
 
 	g_slist_free_full(folder->subfolders, media_folder_destroy);
-	g_slist_free_full(folder->items, media_item_destroy);
+	media_folder_clear_items(folder);
+
+	if (folder->uids)
+		g_hash_table_destroy(folder->uids);
 
 	if (folder->msg != NULL)
 		dbus_message_unref(folder->msg);
@@ -982,8 +1124,7 @@ static void media_player_change_scope(struct media_player *mp,
 		goto done;
 
 cleanup:
-	g_slist_free_full(mp->scope->items, media_item_destroy);
-	mp->scope->items = NULL;
+	media_folder_clear_items(mp->scope);
 
 	/* Destroy search folder if it exists and is not being set as scope */
 	if (mp->search != NULL && folder != mp->search) {
@@ -1593,19 +1734,10 @@ void media_player_set_playlist(struct media_player *mp, const char *name)
 static struct media_item *media_folder_find_item(struct media_folder *folder,
 								uint64_t uid)
 {
-	GSList *l;
-
-	if (uid == 0)
+	if (uid == 0 || folder->uids == NULL)
 		return NULL;
 
-	for (l = folder->items; l; l = l->next) {
-		struct media_item *item = l->data;
-
-		if (item->uid == uid)
-			return item;
-	}
-
-	return NULL;
+	return g_hash_table_lookup(folder->uids, &uid);
 }
 
 static DBusMessage *media_item_play(DBusConnection *conn, DBusMessage *msg,
@@ -1915,6 +2047,14 @@ static struct media_item *media_folder_create_item(struct media_player *mp,
 
 	if (type != PLAYER_ITEM_TYPE_FOLDER) {
 		folder->items = g_slist_prepend(folder->items, item);
+
+		if (folder->uids == NULL)
+			folder->uids = g_hash_table_new(g_int64_hash,
+							g_int64_equal);
+
+		if (uid)
+			g_hash_table_insert(folder->uids, &item->uid, item);
+
 		item->metadata = g_hash_table_new_full(g_str_hash, g_str_equal,
 							g_free, g_free);
 	}
@@ -2015,8 +2155,11 @@ struct media_item *media_player_set_playlist_item(struct media_player *mp,
 	media_item_set_playable(item, true);
 
 	if (mp->track != item->metadata) {
-		g_hash_table_unref(mp->track);
+		GHashTable *track = mp->track;
+
 		mp->track = g_hash_table_ref(item->metadata);
+		media_folder_release_track(folder, track);
+		g_hash_table_unref(track);
 	}
 
 	path = g_hash_table_lookup(mp->track, "Item");
@@ -2030,10 +2173,8 @@ struct media_item *media_player_set_playlist_item(struct media_player *mp,
 
 void media_player_clear_playlist(struct media_player *mp)
 {
-	if (mp->playlist) {
-		g_slist_free_full(mp->playlist->items, media_item_destroy);
-		mp->playlist->items = NULL;
-	}
+	if (mp->playlist)
+		media_folder_clear_items(mp->playlist);
 
 	g_dbus_emit_property_changed(btd_get_dbus_connection(), mp->path,
 					MEDIA_PLAYER_INTERFACE, "Playlist");
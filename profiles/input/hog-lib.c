@@ -22,8 +22,11 @@
 #include <ctype.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <sys/time.h>
 #include <fcntl.h>
 #include <inttypes.h>
+#include <linux/sockios.h>
 
 #include <glib.h>
 
@@ -36,6 +39,7 @@
 #include "src/shared/queue.h"
 #include "src/shared/att.h"
 #include "src/shared/gatt-db.h"
+#include "src/shared/gatt-client.h"
 #include "src/log.h"
 
 #include "attrib/att.h"
@@ -67,6 +71,13 @@
 #define HID_INFO_SIZE			4
 #define ATT_NOTIFICATION_HEADER_SIZE	3
 
+/* Number of input reports summarized per latency log line */
+#define HOG_LATENCY_REPORTS		1000
+
+#ifndef SIOCGSTAMP_OLD
+#define SIOCGSTAMP_OLD SIOCGSTAMP
+#endif
+
 struct bt_hog {
 	int			ref_count;
 	char			*name;
@@ -98,6 +109,9 @@ struct bt_hog {
 	struct queue		*gatt_op;
 	struct gatt_db		*gatt_db;
 	struct gatt_db_attribute	*report_map_attr;
+	unsigned int		latency_count;
+	uint64_t		latency_total;
+	uint64_t		latency_max;
 };
 
 struct report {
@@ -110,6 +124,7 @@ struct report {
 	uint8_t			properties;
 	uint16_t		ccc_handle;
 	guint			notifyid;
+	bool			notify_client;
 	uint16_t		len;
 	uint8_t			*value;
 };
@@ -320,12 +335,82 @@ static void find_included(struct bt_hog *hog, GAttrib *attrib,
 	}
 }
 
-static void report_value_cb(const guint8 *pdu, guint16 len, gpointer user_data)
+static bool latency_stats;
+
+void bt_hog_set_latency_stats(bool enable)
+{
+	latency_stats = enable;
+}
+
+static uint64_t latency_now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+
+	return tv.tv_sec * 1000000ULL + tv.tv_usec;
+}
+
+/* Kernel receive time of the last PDU read from the ATT socket */
+static uint64_t latency_rx_time(struct bt_hog *hog)
+{
+	struct timeval tv;
+	int fd;
+
+	fd = bt_att_get_fd(g_attrib_get_att(hog->attrib));
+	if (fd < 0 || ioctl(fd, SIOCGSTAMP_OLD, &tv) < 0)
+		return latency_now();
+
+	return tv.tv_sec * 1000000ULL + tv.tv_usec;
+}
+
+static void latency_update(struct bt_hog *hog, uint64_t start)
+{
+	uint64_t now = latency_now();
+	uint64_t delta = now > start ? now - start : 0;
+
+	hog->latency_total += delta;
+	if (delta > hog->latency_max)
+		hog->latency_max = delta;
+
+	if (++hog->latency_count < HOG_LATENCY_REPORTS)
+		return;
+
+	info("hog %s: input report latency avg %" PRIu64 " us max %" PRIu64
+			" us over %u reports", hog->name,
+			hog->latency_total / hog->latency_count,
+			hog->latency_max, hog->latency_count);
+
+	hog->latency_count = 0;
+	hog->latency_total = 0;
+	hog->latency_max = 0;
+}
+
+static void report_input(struct report *report, const uint8_t *value,
+							uint16_t len)
 {
-	struct report *report = user_data;
 	struct bt_hog *hog = report->hog;
+	uint64_t start = 0;
 	int err;
 
+	if (latency_stats)
+		start = latency_rx_time(hog);
+
+	err = bt_uhid_input(hog->uhid, report->numbered ? report->id : 0,
+							value, len);
+	if (err < 0) {
+		error("bt_uhid_input: %s (%d)", strerror(-err), -err);
+		return;
+	}
+
+	if (latency_stats)
+		latency_update(hog, start);
+}
+
+static void report_value_cb(const guint8 *pdu, guint16 len, gpointer user_data)
+{
+	struct report *report = user_data;
+
 	if (len < ATT_NOTIFICATION_HEADER_SIZE) {
 		error("Malformed ATT notification");
 		return;
@@ -334,10 +419,13 @@ static void report_value_cb(const guint8 *pdu, guint16 len, gpointer user_data)
 	pdu += ATT_NOTIFICATION_HEADER_SIZE;
 	len -= ATT_NOTIFICATION_HEADER_SIZE;
 
-	err = bt_uhid_input(hog->uhid, report->numbered ? report->id : 0, pdu,
-				len);
-	if (err < 0)
-		error("bt_uhid_input: %s (%d)", strerror(-err), -err);
+	report_input(report, pdu, len);
+}
+
+static void report_notify_cb(uint16_t value_handle, const uint8_t *value,
+					uint16_t length, void *user_data)
+{
+	report_input(user_data, value, length);
 }
 
 static void report_notify_destroy(void *user_data)
@@ -349,6 +437,65 @@ static void report_notify_destroy(void *user_data)
 	report->notifyid = 0;
 }
 
+static void report_notify_registered(uint16_t att_ecode, void *user_data)
+{
+	struct report *report = user_data;
+
+	if (att_ecode)
+		error("Enabling report 0x%04x notification failed: %s",
+				report->value_handle, att_ecode2str(att_ecode));
+}
+
+/*
+ * Input reports are taken straight from bt_gatt_client when available,
+ * bypassing the GAttrib notification wrapper and its PDU copy.
+ *
+ * Unregistering the last handler disables the CCC, so unless it has just
+ * been written have bt_gatt_client enable it again.
+ */
+static unsigned int report_register(struct bt_hog *hog, struct report *report,
+							bool enable_ccc)
+{
+	struct bt_gatt_client *client = g_attrib_get_client(hog->attrib);
+
+	report->notify_client = false;
+
+	if (client) {
+		unsigned int id;
+
+		id = bt_gatt_client_register_notify(client,
+					report->value_handle,
+					enable_ccc ? report_notify_registered :
+									NULL,
+					report_notify_cb, report,
+					report_notify_destroy);
+		if (id) {
+			report->notify_client = true;
+			return id;
+		}
+	}
+
+	return g_attrib_register(hog->attrib, ATT_OP_HANDLE_NOTIFY,
+					report->value_handle,
+					report_value_cb, report,
+					report_notify_destroy);
+}
+
+static void report_unregister(struct bt_hog *hog, struct report *report)
+{
+	if (!report->notifyid)
+		return;
+
+	if (report->notify_client)
+		bt_gatt_client_unregister_notify(
+					g_attrib_get_client(hog->attrib),
+					report->notifyid);
+	else
+		g_attrib_unregister(hog->attrib, report->notifyid);
+
+	report->notifyid = 0;
+}
+
 static void report_ccc_written_cb(guint8 status, const guint8 *pdu,
 					guint16 plen, gpointer user_data)
 {
@@ -365,11 +512,7 @@ static void report_ccc_written_cb(guint8 status, const guint8 *pdu,
 	if (report->notifyid)
 		goto remove;
 
-	report->notifyid = g_attrib_register(hog->attrib,
-					ATT_OP_HANDLE_NOTIFY,
-					report->value_handle,
-					report_value_cb, report,
-					report_notify_destroy);
+	report->notifyid = report_register(hog, report, false);
 	if (!report->notifyid) {
 		error("Unable to register report notification: handle 0x%04x",
 					report->value_handle);
@@ -1741,11 +1884,7 @@ bool bt_hog_attach(struct bt_hog *hog, void *gatt)
 		if (r->notifyid)
 			continue;
 
-		r->notifyid = g_attrib_register(hog->attrib,
-					ATT_OP_HANDLE_NOTIFY,
-					r->value_handle,
-					report_value_cb, r,
-					report_notify_destroy);
+		r->notifyid = report_register(hog, r, true);
 		if (!r->notifyid)
 			error("Unable to register report notification: "
 				"handle 0x%04x", r->value_handle);
@@ -1780,10 +1919,7 @@ void bt_hog_detach(struct bt_hog *hog, bool force)
 	for (l = hog->reports; l; l = l->next) {
 		struct report *r = l->data;
 
-		if (r->notifyid > 0) {
-			g_attrib_unregister(hog->attrib, r->notifyid);
-			r->notifyid = 0;
-		}
+		report_unregister(hog, r);
 	}
 
 	if (hog->scpp)
@@ -24,5 +24,7 @@ void bt_hog_unref(struct bt_hog *hog);
 bool bt_hog_attach(struct bt_hog *hog, void *gatt);
 void bt_hog_detach(struct bt_hog *hog, bool force);
 
+void bt_hog_set_latency_stats(bool enable);
+
 int bt_hog_set_control_point(struct bt_hog *hog, bool suspend);
 int bt_hog_send_report(struct bt_hog *hog, void *data, size_t size, int type);
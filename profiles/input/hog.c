@@ -230,6 +230,7 @@ static void hog_read_config(void)
 	GKeyFile *config;
 	GError *err = NULL;
 	bool config_auto_sec;
+	bool latency_stats;
 	char *uhid_enabled;
 
 	config = g_key_file_new();
@@ -264,6 +265,15 @@ static void hog_read_config(void)
 	} else
 		g_clear_error(&err);
 
+	latency_stats = g_key_file_get_boolean(config, "General",
+					"ReportLatencyStats", &err);
+	if (!err) {
+		DBG("input.conf: ReportLatencyStats=%s",
+				latency_stats ? "true" : "false");
+		bt_hog_set_latency_stats(latency_stats);
+	} else
+		g_clear_error(&err);
+
 	g_key_file_free(config);
 }
 
@@ -78,6 +78,31 @@ inline static void append_timestamp_low(struct midi_write_parser *parser)
 {
 	const uint8_t timestamp_low = 0x80 | (parser->rtime & 0x7F);
 	buffer_append_byte(&parser->midi_stream, timestamp_low);
+	parser->ltime = parser->rtime;
+}
+
+/* Advances the writer's time for the next event. A packet can only express
+   a timestampLow wrap of once between two consecutive timestamps, so the
+   current packet is sent first if the event is too far ahead of it.
+ */
+inline static void update_write_time(struct midi_write_parser *parser,
+                                     midi_read_ev_cb write_cb, void *user_data)
+{
+	int64_t rtime;
+
+	if (!midi_write_has_data(parser))
+		return;
+
+	/* convert µs to ms */
+	rtime = g_get_monotonic_time() / 1000;
+
+	if (rtime - parser->ltime > 0x7F) {
+		write_cb(parser, user_data);
+		midi_write_reset(parser);
+		return;
+	}
+
+	parser->rtime = rtime;
 }
 
 int midi_write_init(struct midi_write_parser *parser, size_t buffer_size)
@@ -85,6 +110,7 @@ int midi_write_init(struct midi_write_parser *parser, size_t buffer_size)
 	int err;
 
 	parser->rtime = 0;
+	parser->ltime = 0;
 	parser->rstatus = SND_SEQ_EVENT_NONE;
 	parser->stream_size = buffer_size;
 
@@ -111,6 +137,7 @@ int midi_read_init(struct midi_read_parser *parser)
 	parser->timestamp_low = 0;
 	parser->timestamp_high = 0;
 	parser->timestamp_high_set = false;
+	parser->ev_timestamp = 0;
 
 	parser->sysex_stream.data = malloc(MIDI_SYSEX_MAX_SIZE);
 	if (!parser->sysex_stream.data)
@@ -192,12 +219,17 @@ static void read_ev_others(struct midi_write_parser *parser, const snd_seq_event
                            midi_read_ev_cb write_cb, void *user_data)
 {
 	int length;
+	bool timestamp_added = true;
 
 	/* check for running status */
 	if (parser->rstatus != ev->type) {
 		snd_midi_event_reset_decode(parser->midi_ev);
 		append_timestamp_low(parser);
-	}
+	} else if (parser->ltime != parser->rtime)
+		/* running status data with its own timestampLow */
+		append_timestamp_low(parser);
+	else
+		timestamp_added = false;
 
 	/* each midi message has timestampLow byte to follow */
 	length = snd_midi_event_decode(parser->midi_ev,
@@ -208,7 +240,7 @@ static void read_ev_others(struct midi_write_parser *parser, const snd_seq_event
 
 	if (length == -ENOMEM) {
 		/* remove previously added timestampLow */
-		if (parser->rstatus != ev->type)
+		if (timestamp_added)
 			parser->midi_stream.len--;
 		write_cb(parser, user_data);
 		/* cleanup state for next packet */
@@ -232,6 +264,7 @@ void midi_read_ev(struct midi_write_parser *parser, const snd_seq_event_t *ev,
 {
 	MIDI_ASSERT(write_cb);
 
+	update_write_time(parser, write_cb, user_data);
 	append_timestamp_high_maybe(parser);
 
 	/* SysEx is special case:
@@ -262,6 +295,8 @@ static void update_ev_timestamp(struct midi_read_parser *parser,
 	if (parser->timestamp_low > ts_low)
 		parser->timestamp_high++;
 
+	parser->timestamp_low = ts_low;
+
 	timestamp = (parser->timestamp_high << 7) | parser->timestamp_low;
 
 	rtime_current = g_get_monotonic_time() / 1000; /* convert µs to ms */
@@ -295,8 +330,8 @@ static void update_ev_timestamp(struct midi_read_parser *parser,
 	if (parser->timestamp > MIDI_MAX_TIMESTAMP)
 		parser->timestamp %= MIDI_MAX_TIMESTAMP + 1;
 
-	/* set event timestamp */
-	/* TODO: update event timestamp here! */
+	/* keep the event timestamp for clock recovery */
+	parser->ev_timestamp = timestamp & MIDI_MAX_TIMESTAMP;
 }
 
 static size_t handle_end_of_sysex(struct midi_read_parser *parser,
@@ -482,3 +517,50 @@ _finish:
 
 	return i + midi_size;
 }
+
+/* Clock recovery:
+   Packets are delayed by a fixed transport latency plus up to a connection
+   interval of batching, so the smallest (arrival - timestamp) seen is the best
+   estimate of the offset between both clocks. The estimate is allowed to grow
+   by MIDI_CLOCK_DRIFT_PPM to follow a remote clock running slower than ours,
+   while a faster remote clock lowers it immediately.
+*/
+#define MIDI_CLOCK_DRIFT_PPM 500
+#define MIDI_CLOCK_RESYNC_US (4 * 1000 * 1000)
+
+int64_t midi_clock_update(struct midi_clock *clock, int64_t arrival,
+                          uint16_t timestamp)
+{
+	int64_t sample;
+	int delta;
+
+	timestamp &= MIDI_MAX_TIMESTAMP;
+
+	/* Gaps longer than half the timestamp range cannot be unwrapped */
+	if (!clock->valid || arrival - clock->arrival > MIDI_CLOCK_RESYNC_US) {
+		clock->valid = true;
+		clock->remote = timestamp;
+		clock->arrival = arrival;
+		clock->offset = arrival - clock->remote * 1000;
+		return arrival;
+	}
+
+	delta = (timestamp - clock->remote) & MIDI_MAX_TIMESTAMP;
+
+	/* Timestamps slightly in the past are reordered, not wrapped */
+	if (delta > (MIDI_MAX_TIMESTAMP + 1) / 2)
+		delta -= MIDI_MAX_TIMESTAMP + 1;
+
+	clock->remote += delta;
+
+	sample = arrival - clock->remote * 1000;
+
+	clock->offset += (arrival - clock->arrival) * MIDI_CLOCK_DRIFT_PPM /
+	                                                        1000000;
+	if (sample < clock->offset)
+		clock->offset = sample;
+
+	clock->arrival = arrival;
+
+	return clock->remote * 1000 + clock->offset;
+}
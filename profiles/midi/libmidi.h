@@ -31,6 +31,7 @@ struct midi_buffer {
 
 struct midi_write_parser {
 	int64_t rtime;                  /* last writer's real time */
+	int64_t ltime;                  /* real time of last timestampLow written */
 	snd_seq_event_type_t rstatus;   /* running status event type */
 	struct midi_buffer midi_stream; /* MIDI I/O byte stream */
 	size_t stream_size;             /* what is the maximum size of the midi_stream array */
@@ -84,6 +85,7 @@ struct midi_read_parser {
 	int8_t timestamp_low;            /* MIDI-BLE timestampLow from the current packet */
 	int8_t timestamp_high;           /* MIDI-BLE timestampHigh from the current packet */
 	bool timestamp_high_set;         /* timestampHigh read */
+	uint16_t ev_timestamp;           /* MIDI-BLE timestamp of the last event */
 	struct midi_buffer sysex_stream; /* SysEx stream */
 	snd_midi_event_t *midi_ev;       /* midi<->seq event */
 };
@@ -110,4 +112,24 @@ static inline void midi_read_reset(struct midi_read_parser *parser)
 size_t midi_read_raw(struct midi_read_parser *parser, const uint8_t *data,
                      size_t size, snd_seq_event_t *ev /* OUT */);
 
+/* BLE-MIDI clock recovery */
+
+struct midi_clock {
+	bool valid;                      /* offset estimated */
+	int64_t remote;                  /* unwrapped remote timestamp (ms) */
+	int64_t offset;                  /* local minus remote time (µs) */
+	int64_t arrival;                 /* local arrival of last packet (µs) */
+};
+
+static inline void midi_clock_reset(struct midi_clock *clock)
+{
+	clock->valid = false;
+}
+
+/* Maps a 13-bit BLE-MIDI timestamp received at local time arrival (µs) onto
+   the local timeline, returning the local time (µs) the event was sent at.
+ */
+int64_t midi_clock_update(struct midi_clock *clock, int64_t arrival,
+                          uint16_t timestamp);
+
 #endif /* LIBMIDI_H */
@@ -30,11 +30,20 @@
 #include "src/shared/gatt-db.h"
 #include "src/shared/gatt-client.h"
 #include "src/shared/io.h"
+#include "src/shared/timeout.h"
 #include "src/log.h"
 #include "attrib/att.h"
 
 #include "libmidi.h"
 
+/* Fixed latency applied to received events, covering connection interval
+ * batching so that they keep their relative timing on the ALSA queue.
+ */
+#define MIDI_RX_LATENCY_US	15000
+
+/* Time given to further ALSA events to fill a partial BLE-MIDI packet */
+#define MIDI_TX_COALESCE_MS	2
+
 struct midi {
 	struct btd_device *dev;
 	struct gatt_db *db;
@@ -47,6 +56,10 @@ struct midi {
 	snd_seq_t *seq_handle;
 	int seq_client_id;
 	int seq_port_id;
+	int seq_queue;
+	int64_t seq_queue_start;
+	struct midi_clock clock;
+	unsigned int tx_timeout;
 
 	/* MIDI parser*/
 	struct midi_read_parser midi_in;
@@ -63,6 +76,28 @@ static void foreach_cb(const struct midi_write_parser *parser, void *user_data)
 						midi_write_data_size(parser));
 }
 
+static void midi_write_flush(struct midi *midi)
+{
+	if (midi_write_has_data(&midi->midi_out))
+		bt_gatt_client_write_without_response(midi->client,
+					midi->midi_io_handle,
+					false,
+					midi_write_data(&midi->midi_out),
+					midi_write_data_size(&midi->midi_out));
+
+	midi_write_reset(&midi->midi_out);
+}
+
+static bool midi_write_timeout(void *user_data)
+{
+	struct midi *midi = user_data;
+
+	midi->tx_timeout = 0;
+	midi_write_flush(midi);
+
+	return false;
+}
+
 static bool midi_write_cb(struct io *io, void *user_data)
 {
 	struct midi *midi = user_data;
@@ -80,24 +115,52 @@ static bool midi_write_cb(struct io *io, void *user_data)
 
 	} while (err > 0);
 
-	if (midi_write_has_data(&midi->midi_out))
-		bt_gatt_client_write_without_response(midi->client,
-					midi->midi_io_handle,
-					false,
-					midi_write_data(&midi->midi_out),
-					midi_write_data_size(&midi->midi_out));
+	/* Full packets are already sent, hold a partial one briefly so that
+	 * events following shortly after share the same packet.
+	 */
+	if (midi_write_has_data(&midi->midi_out) && !midi->tx_timeout)
+		midi->tx_timeout = timeout_add(MIDI_TX_COALESCE_MS,
+						midi_write_timeout, midi, NULL);
 
-	midi_write_reset(&midi->midi_out);
+	if (!midi->tx_timeout)
+		midi_write_flush(midi);
 
 	return true;
 }
 
+/* Schedules an event at its recovered send time plus a fixed latency */
+static void midi_output_event(struct midi *midi, snd_seq_event_t *ev,
+							int64_t time)
+{
+	snd_seq_real_time_t rtime;
+	int64_t due;
+
+	if (midi->seq_queue < 0)
+		goto direct;
+
+	due = time + MIDI_RX_LATENCY_US - midi->seq_queue_start;
+	if (due <= g_get_monotonic_time() - midi->seq_queue_start)
+		goto direct;
+
+	rtime.tv_sec = due / 1000000;
+	rtime.tv_nsec = (due % 1000000) * 1000;
+	snd_seq_ev_schedule_real(ev, midi->seq_queue, 0, &rtime);
+
+	if (snd_seq_event_output(midi->seq_handle, ev) >= 0)
+		return;
+
+direct:
+	snd_seq_ev_set_direct(ev);
+	snd_seq_event_output_direct(midi->seq_handle, ev);
+}
+
 static void midi_io_value_cb(uint16_t value_handle, const uint8_t *value,
                              uint16_t length, void *user_data)
 {
 	struct midi *midi = user_data;
 	snd_seq_event_t ev;
 	unsigned int i = 0;
+	int64_t arrival = g_get_monotonic_time();
 
 	if (length < 3) {
 		warn("MIDI I/O: Wrong packet format: length is %u bytes but it should "
@@ -119,11 +182,15 @@ static void midi_io_value_cb(uint16_t value_handle, const uint8_t *value,
 			goto _err;
 
 		if (ev.type != SND_SEQ_EVENT_NONE)
-			snd_seq_event_output_direct(midi->seq_handle, &ev);
+			midi_output_event(midi, &ev,
+				midi_clock_update(&midi->clock, arrival,
+						midi->midi_in.ev_timestamp));
 
 		i += count;
 	}
 
+	snd_seq_drain_output(midi->seq_handle);
+
 	return;
 
 _err:
@@ -257,9 +324,13 @@ static void midi_device_remove(struct btd_service *service)
 	}
 
 	if (midi->seq_handle) {
+		timeout_remove(midi->tx_timeout);
+		midi->tx_timeout = 0;
 		midi_read_free(&midi->midi_in);
 		midi_write_free(&midi->midi_out);
 		io_destroy(midi->io);
+		if (midi->seq_queue >= 0)
+			snd_seq_free_queue(midi->seq_handle, midi->seq_queue);
 		snd_seq_delete_simple_port(midi->seq_handle, midi->seq_port_id);
 		midi->seq_port_id = 0;
 		snd_seq_close(midi->seq_handle);
@@ -374,6 +445,18 @@ static int midi_accept(struct btd_service *service)
 	if (err < 0)
 		goto _err_port;
 
+	/* Queue used to schedule received events, direct output otherwise */
+	midi->seq_queue = snd_seq_alloc_queue(midi->seq_handle);
+	if (midi->seq_queue >= 0) {
+		snd_seq_start_queue(midi->seq_handle, midi->seq_queue, NULL);
+		snd_seq_drain_output(midi->seq_handle);
+		midi->seq_queue_start = g_get_monotonic_time();
+	} else
+		DBG("Could not allocate ALSA queue: %s",
+					snd_strerror(midi->seq_queue));
+
+	midi_clock_reset(&midi->clock);
+
 
 	/* Input file descriptors */
 	snd_seq_poll_descriptors(midi->seq_handle, &pfd, 1, POLLIN);
@@ -438,9 +521,13 @@ static int midi_disconnect(struct btd_service *service)
 		return -ENODEV;
 	}
 
+	timeout_remove(midi->tx_timeout);
+	midi->tx_timeout = 0;
 	midi_read_free(&midi->midi_in);
 	midi_write_free(&midi->midi_out);
 	io_destroy(midi->io);
+	if (midi->seq_queue >= 0)
+		snd_seq_free_queue(midi->seq_handle, midi->seq_queue);
 	snd_seq_delete_simple_port(midi->seq_handle, midi->seq_port_id);
 	midi->seq_port_id = 0;
 	snd_seq_close(midi->seq_handle);
@@ -33,6 +33,7 @@
 #include "src/shared/gatt-db.h"
 #include "src/shared/gatt-client.h"
 #include "src/shared/rap.h"
+#include "src/shared/cs-dist.h"
 #include "attrib/att.h"
 #include "src/log.h"
 #include "src/btd.h"
@@ -261,6 +262,20 @@ static void rap_ready(struct bt_rap *rap, void *user_data)
 	DBG("%p", rap);
 }
 
+static void rap_distance(struct bt_rap *rap,
+				const struct bt_cs_dist_result *result,
+				void *user_data)
+{
+	struct btd_service *service = user_data;
+	struct btd_device *device = btd_service_get_device(service);
+	char addr[18];
+
+	ba2str(device_get_address(device), addr);
+
+	DBG("%s distance %.2f m quality %.2f", addr, result->distance,
+							result->quality);
+}
+
 static void rap_attached(struct bt_rap *rap, void *user_data)
 {
 	struct rap_data *data;
@@ -328,6 +343,7 @@ static int rap_probe(struct btd_service *service)
 								NULL);
 
 	bt_rap_set_user_data(data->rap, service);
+	bt_rap_set_distance_func(data->rap, rap_distance, service, NULL);
 
 	return 0;
 }
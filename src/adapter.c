@@ -25,6 +25,7 @@
 #include <sys/stat.h>
 #include <dirent.h>
 #include <limits.h>
+#include <time.h>
 
 #include <glib.h>
 #include <dbus/dbus.h>
@@ -67,6 +68,7 @@
 #include "adv_monitor.h"
 #include "eir.h"
 #include "battery.h"
+#include "set.h"
 
 #define MODE_OFF		0x00
 #define MODE_CONNECTABLE	0x01
@@ -78,6 +80,8 @@
 #define TEMP_DEV_TIMEOUT (3 * 60)
 #define BONDING_TIMEOUT (2 * 60)
 
+#define EXPIRY_SLOTS 64
+
 #define SCAN_TYPE_BREDR (1 << BDADDR_BREDR)
 #define SCAN_TYPE_LE ((1 << BDADDR_LE_PUBLIC) | (1 << BDADDR_LE_RANDOM))
 #define SCAN_TYPE_DUAL (SCAN_TYPE_BREDR | SCAN_TYPE_LE)
@@ -224,6 +228,34 @@ struct discovery_client {
 	struct discovery_filter *discovery_filter;
 };
 
+#define DISCOVERY_MATCH_BITS	(sizeof(unsigned long) * 8)
+
+struct discovery_match_client {
+	int16_t rssi;			/* Lowest RSSI accepted */
+	uint16_t pathloss;		/* Highest pathloss accepted */
+};
+
+struct discovery_match_uuid {
+	bool used;
+	uint128_t uuid;			/* 128-bit UUID in big endian */
+	unsigned long *clients;		/* Clients filtering on uuid */
+};
+
+/* Filters of discovery_list compiled for matching advertising reports, with
+ * one bit per filtered client.
+ */
+struct discovery_match {
+	bool all;			/* Some client wants every report */
+	unsigned int num_clients;
+	unsigned int num_words;
+	struct discovery_match_client *clients;
+	unsigned long *any_uuid;	/* Clients without UUID filter */
+	unsigned long *matched;		/* Scratch bitmask for a report */
+	unsigned int uuid_mask;		/* Hash set size minus one */
+	struct discovery_match_uuid *uuids;
+	unsigned long *masks;		/* Storage for uuids client bits */
+};
+
 struct service_auth {
 	guint id;
 	unsigned int svc_id;
@@ -293,6 +325,7 @@ struct btd_adapter {
 	bool discovery_suspended;	/* discovery has been suspended */
 	bool discovery_discoverable;	/* discoverable while discovering */
 	GSList *discovery_list;		/* list of discovery clients */
+	struct discovery_match *discovery_match; /* discovery_list compiled */
 	GSList *set_filter_list;	/* list of clients that specified
 					 * filter, but don't scan yet
 					 */
@@ -306,6 +339,14 @@ struct btd_adapter {
 					      */
 	unsigned int passive_scan_timeout; /* timeout between passive scans */
 
+	/* Temporary devices by the second they expire at, modulo
+	 * EXPIRY_SLOTS, swept once per second while any are queued.
+	 */
+	struct queue *expiry_slots[EXPIRY_SLOTS];
+	unsigned int expiry_count;
+	unsigned int expiry_timer;
+	time_t expiry_swept;		/* Last second swept */
+
 	unsigned int pairable_timeout_id;	/* pairable timeout id */
 	guint auth_idle_id;		/* Pending authorization dequeue */
 	GQueue *auths;			/* Ongoing and pending auths */
@@ -1457,6 +1498,153 @@ void btd_adapter_remove_device(struct btd_adapter *adapter,
 	device_remove(dev, TRUE);
 }
 
+struct device_expiry {
+	struct btd_device *device;
+	time_t expire;			/* Second the device expires at */
+	time_t slot;			/* Second whose slot holds the entry */
+};
+
+static time_t expiry_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec;
+}
+
+static void expiry_queue(struct btd_adapter *adapter,
+					struct device_expiry *expiry)
+{
+	struct queue **slot = &adapter->expiry_slots[expiry->expire %
+								EXPIRY_SLOTS];
+
+	if (!*slot)
+		*slot = queue_new();
+
+	expiry->slot = expiry->expire;
+	queue_push_tail(*slot, expiry);
+}
+
+static void expiry_sweep_slot(struct btd_adapter *adapter, time_t second,
+					time_t now, struct queue *expired)
+{
+	struct queue *slot = adapter->expiry_slots[second % EXPIRY_SLOTS];
+	struct device_expiry *expiry;
+	unsigned int count;
+
+	/* Entries put back in the same slot go after the ones checked */
+	for (count = queue_length(slot); count; count--) {
+		expiry = queue_pop_head(slot);
+
+		/* Seen again since it was queued, or due on a later lap */
+		if (expiry->expire > now) {
+			expiry_queue(adapter, expiry);
+			continue;
+		}
+
+		if (!device_disappeared(expiry->device)) {
+			expiry->expire = now + btd_opts.tmpto;
+			expiry_queue(adapter, expiry);
+			continue;
+		}
+
+		queue_push_tail(expired, expiry->device);
+		adapter->expiry_count--;
+		free(expiry);
+	}
+}
+
+static void remove_expired(void *data, void *user_data)
+{
+	struct btd_device *dev = data;
+	struct btd_adapter *adapter = user_data;
+
+	btd_adapter_remove_device(adapter, dev);
+}
+
+static bool expiry_sweep(gpointer user_data)
+{
+	struct btd_adapter *adapter = user_data;
+	struct queue *expired = queue_new();
+	time_t now = expiry_now();
+
+	/* Every slot gets checked if the timer was held up for a lap */
+	if (now - adapter->expiry_swept > EXPIRY_SLOTS)
+		adapter->expiry_swept = now - EXPIRY_SLOTS;
+
+	while (adapter->expiry_swept < now)
+		expiry_sweep_slot(adapter, ++adapter->expiry_swept, now,
+								expired);
+
+	/* Removing the devices together keeps their InterfacesRemoved
+	 * signals in one burst per sweep.
+	 */
+	queue_foreach(expired, remove_expired, adapter);
+	queue_destroy(expired, NULL);
+
+	if (adapter->expiry_count)
+		return true;
+
+	adapter->expiry_timer = 0;
+
+	return false;
+}
+
+struct device_expiry *adapter_expiry_add(struct btd_adapter *adapter,
+						struct btd_device *dev,
+						unsigned int timeout)
+{
+	struct device_expiry *expiry;
+	time_t now = expiry_now();
+
+	if (!adapter->expiry_timer) {
+		adapter->expiry_swept = now;
+		adapter->expiry_timer = timeout_add_seconds(1, expiry_sweep,
+								adapter, NULL);
+	}
+
+	expiry = new0(struct device_expiry, 1);
+	expiry->device = dev;
+	expiry->expire = now + timeout;
+
+	expiry_queue(adapter, expiry);
+	adapter->expiry_count++;
+
+	return expiry;
+}
+
+void adapter_expiry_refresh(struct btd_adapter *adapter,
+					struct device_expiry *expiry,
+					unsigned int timeout)
+{
+	expiry->expire = expiry_now() + timeout;
+
+	/* A later expiry is picked up when the current slot gets swept, so
+	 * devices refreshed by every advertising report stay where they are.
+	 */
+	if (expiry->expire >= expiry->slot)
+		return;
+
+	queue_remove(adapter->expiry_slots[expiry->slot % EXPIRY_SLOTS],
+								expiry);
+	expiry_queue(adapter, expiry);
+}
+
+void adapter_expiry_remove(struct btd_adapter *adapter,
+					struct device_expiry *expiry)
+{
+	queue_remove(adapter->expiry_slots[expiry->slot % EXPIRY_SLOTS],
+								expiry);
+	free(expiry);
+
+	if (--adapter->expiry_count || !adapter->expiry_timer)
+		return;
+
+	timeout_remove(adapter->expiry_timer);
+	adapter->expiry_timer = 0;
+}
+
 struct btd_device *btd_adapter_get_device(struct btd_adapter *adapter,
 					const bdaddr_t *addr,
 					uint8_t addr_type)
@@ -1744,6 +1932,152 @@ static void discovery_cleanup(struct btd_adapter *adapter, int timeout)
 	}
 }
 
+static void discovery_match_free(struct discovery_match *match)
+{
+	if (!match)
+		return;
+
+	g_free(match->clients);
+	g_free(match->any_uuid);
+	g_free(match->matched);
+	g_free(match->uuids);
+	g_free(match->masks);
+	g_free(match);
+}
+
+static unsigned int discovery_match_hash(const uint128_t *uuid)
+{
+	unsigned int hash = 2166136261u;
+	unsigned int i;
+
+	/* FNV-1a, UUIDs derived from the Bluetooth Base UUID only differ on
+	 * their first 4 bytes so every byte needs to be taken into account.
+	 */
+	for (i = 0; i < sizeof(uuid->data); i++) {
+		hash ^= uuid->data[i];
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+static struct discovery_match_uuid *discovery_match_lookup(
+					struct discovery_match *match,
+					const uint128_t *uuid)
+{
+	unsigned int i = discovery_match_hash(uuid) & match->uuid_mask;
+
+	while (match->uuids[i].used) {
+		if (!memcmp(&match->uuids[i].uuid, uuid, sizeof(*uuid)))
+			break;
+
+		i = (i + 1) & match->uuid_mask;
+	}
+
+	return &match->uuids[i];
+}
+
+static void discovery_match_add_uuid(struct discovery_match *match,
+					const char *str, unsigned int client)
+{
+	struct discovery_match_uuid *entry;
+	bt_uuid_t uuid, u128;
+
+	if (bt_string_to_uuid(&uuid, str))
+		return;
+
+	bt_uuid_to_uuid128(&uuid, &u128);
+
+	entry = discovery_match_lookup(match, &u128.value.u128);
+	if (!entry->used) {
+		entry->used = true;
+		entry->uuid = u128.value.u128;
+	}
+
+	entry->clients[client / DISCOVERY_MATCH_BITS] |=
+					1UL << (client % DISCOVERY_MATCH_BITS);
+}
+
+/*
+ * Merges the filters of every discovery client so advertising reports can be
+ * matched in a single pass over their UUIDs instead of once per client.
+ * Returns NULL if no discovery client is left.
+ */
+static struct discovery_match *discovery_match_new(GSList *list)
+{
+	struct discovery_match *match;
+	unsigned int num_uuids = 0, size = 4, i;
+	GSList *l;
+
+	if (!list)
+		return NULL;
+
+	match = g_new0(struct discovery_match, 1);
+
+	for (l = list; l; l = g_slist_next(l)) {
+		struct discovery_client *client = l->data;
+
+		match->num_clients++;
+
+		if (client->discovery_filter)
+			num_uuids += g_slist_length(
+					client->discovery_filter->uuids);
+	}
+
+	while (size < num_uuids * 2)
+		size <<= 1;
+
+	match->num_words = (match->num_clients + DISCOVERY_MATCH_BITS - 1) /
+							DISCOVERY_MATCH_BITS;
+	match->clients = g_new0(struct discovery_match_client,
+							match->num_clients);
+	match->any_uuid = g_new0(unsigned long, match->num_words);
+	match->matched = g_new0(unsigned long, match->num_words);
+	match->uuid_mask = size - 1;
+	match->uuids = g_new0(struct discovery_match_uuid, size);
+	match->masks = g_new0(unsigned long, size * match->num_words);
+
+	for (i = 0; i < size; i++)
+		match->uuids[i].clients = match->masks + i * match->num_words;
+
+	for (l = list, i = 0; l; l = g_slist_next(l), i++) {
+		struct discovery_client *client = l->data;
+		struct discovery_filter *filter = client->discovery_filter;
+		GSList *m;
+
+		/* A regular discovery reports every device found */
+		if (!filter) {
+			match->all = true;
+			continue;
+		}
+
+		match->clients[i].rssi = filter->rssi;
+		match->clients[i].pathloss = filter->pathloss;
+
+		if (!filter->uuids) {
+			/* Nothing left to check without a proximity filter */
+			if (filter->rssi == DISTANCE_VAL_INVALID &&
+				filter->pathloss == DISTANCE_VAL_INVALID)
+				match->all = true;
+
+			match->any_uuid[i / DISCOVERY_MATCH_BITS] |=
+					1UL << (i % DISCOVERY_MATCH_BITS);
+			continue;
+		}
+
+		for (m = filter->uuids; m; m = g_slist_next(m))
+			discovery_match_add_uuid(match, m->data, i);
+	}
+
+	return match;
+}
+
+static void update_discovery_match(struct btd_adapter *adapter)
+{
+	discovery_match_free(adapter->discovery_match);
+	adapter->discovery_match = discovery_match_new(adapter->discovery_list);
+}
+
 static void discovery_free(void *user_data)
 {
 	struct discovery_client *client = user_data;
@@ -1783,6 +2117,7 @@ static void discovery_remove(struct discovery_client *client)
 
 	adapter->discovery_list = g_slist_remove(adapter->discovery_list,
 								client);
+	update_discovery_match(adapter);
 
 	if (adapter->client == client)
 		adapter->client = NULL;
@@ -2385,6 +2720,8 @@ static int update_discovery_filter(struct btd_adapter *adapter)
 
 	DBG("");
 
+	update_discovery_match(adapter);
+
 	if (discovery_filter_to_mgmt_cp(adapter, &sd_cp)) {
 		btd_error(adapter->dev_id,
 				"discovery_filter_to_mgmt_cp returned error");
@@ -5946,6 +6283,8 @@ static void remove_discovery_list(struct btd_adapter *adapter)
 
 	g_slist_free_full(adapter->discovery_list, discovery_free);
 	adapter->discovery_list = NULL;
+
+	update_discovery_match(adapter);
 }
 
 static void cancel_exp_pending(void *data)
@@ -5961,6 +6300,7 @@ static void cancel_exp_pending(void *data)
 static void adapter_free(gpointer user_data)
 {
 	struct btd_adapter *adapter = user_data;
+	unsigned int i;
 
 	DBG("%p", adapter);
 
@@ -5979,6 +6319,14 @@ static void adapter_free(gpointer user_data)
 		adapter->passive_scan_timeout = 0;
 	}
 
+	if (adapter->expiry_timer > 0) {
+		timeout_remove(adapter->expiry_timer);
+		adapter->expiry_timer = 0;
+	}
+
+	for (i = 0; i < EXPIRY_SLOTS; i++)
+		queue_destroy(adapter->expiry_slots[i], free);
+
 	if (adapter->auth_idle_id)
 		g_source_remove(adapter->auth_idle_id);
 
@@ -7185,58 +7533,121 @@ static void adapter_msd_notify(struct btd_adapter *adapter,
 	}
 }
 
-static bool is_filter_match(GSList *discovery_filter, struct eir_data *eir_data,
-								int8_t rssi)
+static void discovery_match_uuids(struct discovery_match *match,
+					uint8_t type, const uint8_t *data,
+					uint8_t len)
 {
-	GSList *l, *m;
-	bool got_match = false;
+	struct discovery_match_uuid *entry;
+	bt_uuid_t uuid, u128;
+	unsigned int i, k, size;
 
-	for (l = discovery_filter; l != NULL && got_match != true;
-							l = g_slist_next(l)) {
-		struct discovery_client *client = l->data;
-		struct discovery_filter *item = client->discovery_filter;
+	switch (type) {
+	case EIR_UUID16_SOME:
+	case EIR_UUID16_ALL:
+		size = 2;
+		break;
+	case EIR_UUID32_SOME:
+	case EIR_UUID32_ALL:
+		size = 4;
+		break;
+	case EIR_UUID128_SOME:
+	case EIR_UUID128_ALL:
+		size = 16;
+		break;
+	default:
+		return;
+	}
 
-		/*
-		 * If one of currently running scans is regular scan, then
-		 * return all devices as matches
-		 */
-		if (!item) {
-			got_match = true;
-			continue;
+	for (; len >= size; data += size, len -= size) {
+		switch (size) {
+		case 2:
+			bt_uuid16_create(&uuid, get_le16(data));
+			bt_uuid_to_uuid128(&uuid, &u128);
+			break;
+		case 4:
+			bt_uuid32_create(&uuid, get_le32(data));
+			bt_uuid_to_uuid128(&uuid, &u128);
+			break;
+		default:
+			for (k = 0; k < 16; k++)
+				u128.value.u128.data[k] = data[16 - k - 1];
+			break;
 		}
 
-		/* if someone started discovery with empty uuids, he wants all
-		 * devices in given proximity.
-		 */
-		if (!item->uuids)
-			got_match = true;
-		else {
-			for (m = item->uuids; m != NULL && got_match != true;
-							m = g_slist_next(m)) {
-				/* m->data contains string representation of
-				 * uuid.
-				 */
-				if (queue_find(eir_data->services,
-							m->data,
-							g_strcmp) != NULL)
-					got_match = true;
-			}
-		}
+		entry = discovery_match_lookup(match, &u128.value.u128);
+		if (!entry->used)
+			continue;
 
-		if (got_match) {
-			/* we have service match, check proximity */
-			if (item->rssi == DISTANCE_VAL_INVALID ||
-			    item->rssi <= rssi ||
-			    item->pathloss == DISTANCE_VAL_INVALID ||
-			    (eir_data->tx_power != 127 &&
-			     eir_data->tx_power - rssi <= item->pathloss))
-				return true;
+		for (i = 0; i < match->num_words; i++)
+			match->matched[i] |= entry->clients[i];
+	}
+}
+
+static bool discovery_match_proximity(struct discovery_match_client *client,
+					int8_t rssi, int8_t tx_power)
+{
+	if (client->rssi != DISTANCE_VAL_INVALID)
+		return client->rssi <= rssi;
+
+	if (client->pathloss != DISTANCE_VAL_INVALID)
+		return tx_power != 127 && tx_power - rssi <= client->pathloss;
+
+	return true;
+}
+
+/*
+ * Matches the raw advertising data against the filters of all discovery
+ * clients at once, service UUIDs are looked up in binary form directly from
+ * the AD structures instead of the strings built by eir_parse().
+ */
+static bool is_filter_match(struct discovery_match *match,
+					const uint8_t *data, uint8_t data_len,
+					int8_t tx_power, int8_t rssi)
+{
+	unsigned int len = 0, i;
+
+	if (!match)
+		return false;
 
-			got_match = false;
+	if (match->all)
+		return true;
+
+	memcpy(match->matched, match->any_uuid,
+				match->num_words * sizeof(*match->matched));
+
+	/* Same bounds as eir_parse() so both agree on the UUIDs found */
+	while (data && len + 1 < data_len) {
+		uint8_t field_len = data[0];
+
+		if (field_len == 0)
+			break;
+
+		len += field_len + 1;
+
+		if (len > data_len)
+			break;
+
+		discovery_match_uuids(match, data[1], &data[2], field_len - 1);
+
+		data += field_len + 1;
+	}
+
+	for (i = 0; i < match->num_words; i++) {
+		unsigned long bits = match->matched[i];
+
+		while (bits) {
+			unsigned int bit = ffsl(bits) - 1;
+			unsigned int client = i * DISCOVERY_MATCH_BITS + bit;
+
+			bits &= bits - 1;
+
+			if (discovery_match_proximity(&match->clients[client],
+							rssi, tx_power))
+				return true;
 		}
 	}
 
-	return got_match;
+	return false;
 }
 
 static void filter_duplicate_data(void *data, void *user_data)
@@ -7304,6 +7715,17 @@ static bool device_is_discoverable(struct btd_adapter *adapter,
 	return discoverable;
 }
 
+static void resolve_rsi(void *data, void *user_data)
+{
+	struct eir_ad *ad = data;
+	struct btd_device *dev = user_data;
+
+	if (ad->type != EIR_CSIP_RSI || ad->len < 6)
+		return;
+
+	btd_set_resolve_rsi(dev, ad->data);
+}
+
 void btd_adapter_device_found(struct btd_adapter *adapter,
 					const bdaddr_t *bdaddr,
 					uint8_t bdaddr_type, int8_t rssi,
@@ -7312,7 +7734,6 @@ void btd_adapter_device_found(struct btd_adapter *adapter,
 					bool monitoring)
 {
 	struct btd_device *dev;
-	struct bt_ad *ad = NULL;
 	struct eir_data eir_data;
 	bool name_known, discoverable;
 	char addr[18];
@@ -7334,18 +7755,13 @@ void btd_adapter_device_found(struct btd_adapter *adapter,
 	if (!btd_adv_monitor_offload_enabled(adapter->adv_monitor_manager) ||
 				(MGMT_VERSION(mgmt_version, mgmt_revision) <
 							MGMT_VERSION(1, 22))) {
-		if (bdaddr_type != BDADDR_BREDR)
-			ad = bt_ad_new_with_data(data_len, data);
-
 		/* During the background scanning, update the device only when
 		 * the data match at least one Adv monitor
 		 */
-		if (ad) {
+		if (bdaddr_type != BDADDR_BREDR) {
 			matched_monitors = btd_adv_monitor_content_filter(
 						adapter->adv_monitor_manager,
-						ad);
-			bt_ad_unref(ad);
-			ad = NULL;
+						data, data_len);
 			monitoring = matched_monitors ? true : false;
 		}
 	}
@@ -7436,7 +7852,8 @@ void btd_adapter_device_found(struct btd_adapter *adapter,
 	 */
 	if (!eir_data.rsi && !monitoring && (!discoverable ||
 		(adapter->filtered_discovery && !is_filter_match(
-				adapter->discovery_list, &eir_data, rssi)))) {
+				adapter->discovery_match, data, data_len,
+				eir_data.tx_power, rssi)))) {
 		eir_data_free(&eir_data);
 		return;
 	}
@@ -7491,6 +7908,9 @@ void btd_adapter_device_found(struct btd_adapter *adapter,
 	if (eir_data.data_list)
 		device_set_data(dev, eir_data.data_list, duplicate);
 
+	if (eir_data.rsi)
+		queue_foreach(eir_data.data_list, resolve_rsi, dev);
+
 	if (bdaddr_type != BDADDR_BREDR)
 		device_set_flags(dev, eir_data.flags);
 
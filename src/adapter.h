@@ -256,6 +256,17 @@ void adapter_accept_list_add(struct btd_adapter *adapter,
 void adapter_accept_list_remove(struct btd_adapter *adapter,
 						struct btd_device *dev);
 
+struct device_expiry;
+
+struct device_expiry *adapter_expiry_add(struct btd_adapter *adapter,
+						struct btd_device *dev,
+						unsigned int timeout);
+void adapter_expiry_refresh(struct btd_adapter *adapter,
+					struct device_expiry *expiry,
+					unsigned int timeout);
+void adapter_expiry_remove(struct btd_adapter *adapter,
+					struct device_expiry *expiry);
+
 void btd_adapter_set_oob_handler(struct btd_adapter *adapter,
 						struct oob_handler *handler);
 gboolean btd_adapter_check_oob_handler(struct btd_adapter *adapter);
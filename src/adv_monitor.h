@@ -31,7 +31,7 @@ bool btd_adv_monitor_offload_enabled(struct btd_adv_monitor_manager *manager);
 
 struct queue *btd_adv_monitor_content_filter(
 				struct btd_adv_monitor_manager *manager,
-				struct bt_ad *ad);
+				const uint8_t *data, uint8_t len);
 
 void btd_adv_monitor_notify_monitors(struct btd_adv_monitor_manager *manager,
 					struct btd_device *device, int8_t rssi,
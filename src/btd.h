@@ -151,6 +151,8 @@ struct btd_opts {
 	bool		experimental;
 	bool		testing;
 	bool		filter_discoverable;
+	uint32_t	prop_interval;
+	uint32_t	prop_limit;
 	struct queue	*kernel;
 
 	uint16_t	did_source;
@@ -257,7 +257,7 @@ struct btd_device {
 	bool		cable_pairing;
 	unsigned int	disconn_timer;
 	unsigned int	discov_timer;
-	unsigned int	temporary_timer;	/* Temporary/disappear timer */
+	struct device_expiry *temporary_expiry;	/* Temporary/disappear timer */
 	struct browse_req *browse;		/* service discover request */
 	struct bonding_req *bonding;
 	struct authentication_req *authr;	/* authentication request */
@@ -937,8 +937,9 @@ static void device_free(gpointer user_data)
 	if (device->discov_timer)
 		timeout_remove(device->discov_timer);
 
-	if (device->temporary_timer)
-		timeout_remove(device->temporary_timer);
+	if (device->temporary_expiry)
+		adapter_expiry_remove(device->adapter,
+						device->temporary_expiry);
 
 	if (device->connect)
 		dbus_message_unref(device->connect);
@@ -3051,7 +3052,8 @@ static void store_services(struct btd_device *device)
 	g_key_file_free(key_file);
 }
 
-static void store_gatt_db(struct btd_device *device)
+static void store_gatt_db_range(struct btd_device *device, uint16_t start,
+							uint16_t end)
 {
 	char filename[PATH_MAX];
 	char dst_addr[18];
@@ -3067,12 +3069,16 @@ static void store_gatt_db(struct btd_device *device)
 
 	ba2str(&device->bdaddr, dst_addr);
 
-	create_filename(filename, PATH_MAX, "/%s/cache/%s",
+	create_filename(filename, PATH_MAX, "/%s/cache/%s.gatt",
 				btd_adapter_get_storage_dir(device->adapter),
 				dst_addr);
-	create_file(filename, 0600);
 
-	btd_settings_gatt_db_store(device->db, filename);
+	btd_settings_gatt_cache_store(device->db, filename, start, end);
+}
+
+static void store_gatt_db(struct btd_device *device)
+{
+	store_gatt_db_range(device, 0x0001, 0xffff);
 }
 
 static void browse_request_complete(struct browse_req *req, uint8_t type,
@@ -3765,6 +3771,11 @@ bool btd_device_bearer_is_connected(struct btd_device *dev)
 	return dev->bredr_state.connected || dev->le_state.connected;
 }
 
+bool btd_device_is_blocked(struct btd_device *dev)
+{
+	return dev->blocked;
+}
+
 bool btd_device_bdaddr_type_connected(struct btd_device *dev, uint8_t type)
 {
 	if (type == BDADDR_BREDR)
@@ -3775,9 +3786,9 @@ bool btd_device_bdaddr_type_connected(struct btd_device *dev, uint8_t type)
 
 static void clear_temporary_timer(struct btd_device *dev)
 {
-	if (dev->temporary_timer) {
-		timeout_remove(dev->temporary_timer);
-		dev->temporary_timer = 0;
+	if (dev->temporary_expiry) {
+		adapter_expiry_remove(dev->adapter, dev->temporary_expiry);
+		dev->temporary_expiry = NULL;
 	}
 }
 
@@ -3868,32 +3879,35 @@ static bool device_service_connected(struct btd_device *dev)
 					BTD_SERVICE_STATE_CONNECTED);
 }
 
-static bool device_disappeared(gpointer user_data)
+/* Called by the adapter once the temporary timer expires, returns true if
+ * the device is to be removed.
+ */
+bool device_disappeared(struct btd_device *dev)
 {
-	struct btd_device *dev = user_data;
-
 	/* If there are services connected restart the timer to give more time
 	 * for the service to either complete the connection or disconnect.
 	 */
 	if (device_service_connected(dev))
-		return TRUE;
-
-	dev->temporary_timer = 0;
+		return false;
 
-	btd_adapter_remove_device(dev->adapter, dev);
+	dev->temporary_expiry = NULL;
 
-	return FALSE;
+	return true;
 }
 
 static void set_temporary_timer(struct btd_device *dev, unsigned int timeout)
 {
-	clear_temporary_timer(dev);
-
-	if (!timeout)
+	if (!timeout) {
+		clear_temporary_timer(dev);
 		return;
+	}
 
-	dev->temporary_timer = timeout_add_seconds(timeout, device_disappeared,
-								dev, NULL);
+	if (dev->temporary_expiry)
+		adapter_expiry_refresh(dev->adapter, dev->temporary_expiry,
+								timeout);
+	else
+		dev->temporary_expiry = adapter_expiry_add(dev->adapter, dev,
+								timeout);
 }
 
 static void device_disconnected(struct btd_device *device, uint8_t reason)
@@ -4642,9 +4656,25 @@ static void load_gatt_db(struct btd_device *device, const char *local,
 
 	DBG("Restoring %s gatt database from file", peer);
 
-	create_filename(filename, PATH_MAX, "/%s/cache/%s", local, peer);
+	create_filename(filename, PATH_MAX, "/%s/cache/%s.gatt", local, peer);
+
+	err = btd_settings_gatt_cache_load(device->db, filename);
+	if (err == -ENOENT) {
+		char legacy[PATH_MAX];
+
+		/* Convert a database stored by older versions to the binary
+		 * cache, dropping it from the text file afterwards.
+		 */
+		create_filename(legacy, PATH_MAX, "/%s/cache/%s", local, peer);
+
+		err = btd_settings_gatt_db_load(device->db, legacy);
+		if (!err) {
+			btd_settings_gatt_cache_store(device->db, filename,
+							0x0001, 0xffff);
+			btd_settings_gatt_db_remove(legacy);
+		}
+	}
 
-	err = btd_settings_gatt_db_load(device->db, filename);
 	if (err < 0) {
 		if (err == -ENOENT)
 			return;
@@ -5456,6 +5486,11 @@ static void device_remove_stored(struct btd_device *device)
 				device_addr);
 	delete_folder_tree(filename);
 
+	create_filename(filename, PATH_MAX, "/%s/cache/%s.gatt",
+				btd_adapter_get_storage_dir(device->adapter),
+				device_addr);
+	unlink(filename);
+
 	create_filename(filename, PATH_MAX, "/%s/cache/%s",
 				btd_adapter_get_storage_dir(device->adapter),
 				device_addr);
@@ -5469,6 +5504,7 @@ static void device_remove_stored(struct btd_device *device)
 	g_key_file_remove_group(key_file, "ServiceRecords", NULL);
 	g_key_file_remove_group(key_file, "Attributes", NULL);
 	g_key_file_remove_group(key_file, "Endpoints", NULL);
+	g_key_file_remove_group(key_file, "PACS", NULL);
 
 	data = g_key_file_to_data(key_file, &length, NULL);
 	if (length > 0) {
@@ -6382,7 +6418,7 @@ static void gatt_client_service_changed(uint16_t start_handle,
 
 	DBG("start 0x%04x, end: 0x%04x", start_handle, end_handle);
 
-	store_gatt_db(device);
+	store_gatt_db_range(device, start_handle, end_handle);
 }
 
 static void gatt_debug(const char *str, void *user_data)
@@ -92,6 +92,8 @@ static const char *supported_options[] = {
 	"KernelExperimental",
 	"RemoteNameRequestRetryDelay",
 	"FilterDiscoverable",
+	"PropertyChangedInterval",
+	"PropertyChangedLimit",
 	NULL
 };
 
@@ -1116,6 +1118,12 @@ static void parse_general(GKeyFile *config)
 					0, UINT32_MAX);
 	parse_config_bool(config, "General", "FilterDiscoverable",
 						&btd_opts.filter_discoverable);
+	parse_config_u32(config, "General", "PropertyChangedInterval",
+						&btd_opts.prop_interval,
+						0, UINT32_MAX);
+	parse_config_u32(config, "General", "PropertyChangedLimit",
+						&btd_opts.prop_limit,
+						0, UINT32_MAX);
 }
 
 static void parse_gatt_cache(GKeyFile *config)
@@ -1521,6 +1529,7 @@ static void disconnect_dbus(void)
 	if (!conn || !dbus_connection_get_is_connected(conn))
 		return;
 
+	g_dbus_detach_delta_manager(conn);
 	g_dbus_detach_object_manager(conn);
 	set_dbus_connection(NULL);
 
@@ -1538,6 +1547,32 @@ static void dbus_debug(const char *str, void *data)
 	DBG_IDX(0xffff, "%s", str);
 }
 
+static void set_property_intervals(void)
+{
+	/* Properties which may change on every received advertisement */
+	static const struct {
+		const char *interface;
+		const char *name;
+	} props[] = {
+		{ "org.bluez.Device1", "RSSI" },
+		{ "org.bluez.Device1", "TxPower" },
+		{ "org.bluez.Device1", "ManufacturerData" },
+		{ "org.bluez.Device1", "ServiceData" },
+		{ "org.bluez.MediaTransport1", "Volume" },
+	};
+	size_t i;
+
+	if (!btd_opts.prop_interval && !btd_opts.prop_limit)
+		return;
+
+	/* The limit applies to these properties even without an interval */
+	for (i = 0; i < ARRAY_SIZE(props); i++)
+		g_dbus_set_property_interval(props[i].interface, props[i].name,
+							btd_opts.prop_interval);
+
+	g_dbus_set_property_budget(btd_opts.prop_limit);
+}
+
 static int connect_dbus(void)
 {
 	DBusConnection *conn;
@@ -1559,6 +1594,7 @@ static int connect_dbus(void)
 
 	g_dbus_set_disconnect_function(conn, disconnected_dbus, NULL, NULL);
 	g_dbus_attach_object_manager(conn);
+	g_dbus_attach_delta_manager(conn, BLUEZ_NAME ".ObjectManager1");
 	g_dbus_set_debug(dbus_debug, NULL, NULL);
 
 	return 0;
@@ -1665,6 +1701,8 @@ int main(int argc, char *argv[])
 
 	g_dbus_set_flags(gdbus_flags);
 
+	set_property_intervals();
+
 	if (adapter_init() < 0) {
 		error("Adapter handling initialization failed");
 		exit(1);
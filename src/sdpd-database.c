@@ -16,12 +16,15 @@
 #endif
 
 #include <stdlib.h>
+#include <string.h>
 #include <stdbool.h>
 
 #include "bluetooth/bluetooth.h"
 #include "bluetooth/sdp.h"
 #include "bluetooth/sdp_lib.h"
 
+#include "src/shared/util.h"
+
 #include "sdpd.h"
 #include "log.h"
 
@@ -69,6 +72,348 @@ static void access_free(void *p)
 	free(p);
 }
 
+/*
+ * Lookup structures derived from the repository: an index from each
+ * 128-bit UUID found in a record pattern to the records containing it,
+ * and the serialized attributes of each record. Both are rebuilt lazily
+ * after the repository has changed.
+ */
+struct uuid_index {
+	uuid_t uuid;
+	sdp_record_t **records;
+	unsigned int count;
+};
+
+static struct uuid_index *uuid_index;
+static unsigned int uuid_index_len;
+static bool uuid_index_valid;
+
+struct pdu_cache_entry {
+	sdp_record_t *rec;
+	struct sdp_record_pdu *pdu;
+};
+
+static struct pdu_cache_entry *pdu_cache;
+static unsigned int pdu_cache_len;
+static bool pdu_cache_valid;
+
+static void uuid_index_free(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < uuid_index_len; i++)
+		free(uuid_index[i].records);
+
+	free(uuid_index);
+	uuid_index = NULL;
+	uuid_index_len = 0;
+	uuid_index_valid = false;
+}
+
+static void record_pdu_free(struct sdp_record_pdu *pdu)
+{
+	if (!pdu)
+		return;
+
+	free(pdu->buf.data);
+	free(pdu->attrs);
+	free(pdu);
+}
+
+static void pdu_cache_free(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < pdu_cache_len; i++)
+		record_pdu_free(pdu_cache[i].pdu);
+
+	free(pdu_cache);
+	pdu_cache = NULL;
+	pdu_cache_len = 0;
+	pdu_cache_valid = false;
+}
+
+/*
+ * Drop the lookup structures, to be called whenever a record in the
+ * repository has been added, removed or modified
+ */
+void sdp_svcdb_invalidate(void)
+{
+	uuid_index_free();
+	pdu_cache_free();
+}
+
+static int uuid_index_cmp(const void *key, const void *entry)
+{
+	const struct uuid_index *index = entry;
+
+	return sdp_uuid128_cmp(key, &index->uuid);
+}
+
+static struct uuid_index *uuid_index_find(const uuid_t *uuid128)
+{
+	if (!uuid_index_len)
+		return NULL;
+
+	return bsearch(uuid128, uuid_index, uuid_index_len,
+					sizeof(*uuid_index), uuid_index_cmp);
+}
+
+static bool uuid_index_add(const uuid_t *uuid128, sdp_record_t *rec)
+{
+	struct uuid_index *index;
+	sdp_record_t **records;
+	unsigned int i;
+
+	index = uuid_index_find(uuid128);
+	if (!index) {
+		index = realloc(uuid_index,
+				(uuid_index_len + 1) * sizeof(*uuid_index));
+		if (!index)
+			return false;
+
+		uuid_index = index;
+
+		/* Keep the index sorted so it can be searched in place */
+		for (i = 0; i < uuid_index_len; i++) {
+			if (sdp_uuid128_cmp(uuid128, &uuid_index[i].uuid) < 0)
+				break;
+		}
+
+		memmove(&uuid_index[i + 1], &uuid_index[i],
+				(uuid_index_len - i) * sizeof(*uuid_index));
+		uuid_index_len++;
+
+		index = &uuid_index[i];
+		memset(index, 0, sizeof(*index));
+		memcpy(&index->uuid, uuid128, sizeof(index->uuid));
+	}
+
+	records = realloc(index->records,
+				(index->count + 1) * sizeof(*records));
+	if (!records)
+		return false;
+
+	records[index->count++] = rec;
+	index->records = records;
+
+	return true;
+}
+
+static bool uuid_index_build(void)
+{
+	sdp_list_t *p, *u;
+
+	/* Records are visited in handle order so each entry stays sorted */
+	for (p = service_db; p; p = p->next) {
+		sdp_record_t *rec = p->data;
+
+		for (u = rec->pattern; u; u = u->next) {
+			if (u->data == NULL)
+				continue;
+
+			if (!uuid_index_add(u->data, rec)) {
+				uuid_index_free();
+				return false;
+			}
+		}
+	}
+
+	uuid_index_valid = true;
+
+	return true;
+}
+
+/*
+ * Return the records which may match every UUID of the search pattern,
+ * in handle order. Since a record must contain all UUIDs this is the
+ * shortest record list among the UUIDs of the search pattern, so the
+ * caller still has to match each candidate.
+ */
+sdp_record_t **sdp_svcdb_lookup(sdp_list_t *search, unsigned int *count)
+{
+	struct uuid_index *best = NULL;
+
+	*count = 0;
+
+	if (!uuid_index_valid && !uuid_index_build())
+		return NULL;
+
+	for (; search; search = search->next) {
+		struct uuid_index *index;
+		uuid_t *uuid128;
+
+		if (search->data == NULL)
+			return NULL;
+
+		uuid128 = sdp_uuid_to_uuid128(search->data);
+		index = uuid_index_find(uuid128);
+		bt_free(uuid128);
+
+		if (!index)
+			return NULL;
+
+		if (!best || index->count < best->count)
+			best = index;
+	}
+
+	if (!best)
+		return NULL;
+
+	*count = best->count;
+
+	return best->records;
+}
+
+static int element_size(const uint8_t *p, size_t len)
+{
+	static const uint8_t fixed[] = { 1, 2, 4, 8, 16 };
+	uint8_t index;
+	uint32_t size;
+
+	if (len < 1)
+		return -1;
+
+	index = p[0] & 0x07;
+
+	/* Nil is the only type without a value */
+	if (p[0] == SDP_DATA_NIL)
+		return 1;
+
+	if (index < sizeof(fixed)) {
+		size = 1 + fixed[index];
+	} else if (index == 5) {
+		if (len < 2)
+			return -1;
+		size = 2 + p[1];
+	} else if (index == 6) {
+		if (len < 3)
+			return -1;
+		size = 3 + get_be16(p + 1);
+	} else {
+		if (len < 5)
+			return -1;
+		size = 5 + get_be32(p + 1);
+	}
+
+	if (size > len)
+		return -1;
+
+	return size;
+}
+
+static struct sdp_record_pdu *record_pdu_new(const sdp_record_t *rec)
+{
+	struct sdp_record_pdu *pdu;
+	unsigned int max_attrs;
+	uint32_t offset;
+
+	pdu = calloc(1, sizeof(*pdu));
+	if (!pdu)
+		return NULL;
+
+	if (sdp_gen_record_pdu(rec, &pdu->buf) < 0)
+		goto failed;
+
+	max_attrs = sdp_list_len(rec->attrlist);
+	pdu->attrs = calloc(max_attrs + 1, sizeof(*pdu->attrs));
+	if (!pdu->attrs)
+		goto failed;
+
+	if (pdu->buf.data_size == 0)
+		return pdu;
+
+	/* Skip the header of the sequence wrapping the attributes */
+	switch (pdu->buf.data[0]) {
+	case SDP_SEQ8:
+		offset = 2;
+		break;
+	case SDP_SEQ16:
+		offset = 3;
+		break;
+	default:
+		offset = 5;
+		break;
+	}
+
+	/* Each attribute is an UINT16 id followed by its value */
+	while (offset + 3 <= pdu->buf.data_size) {
+		struct sdp_attr_slice *attr;
+		int size;
+
+		if (pdu->buf.data[offset] != SDP_UINT16 ||
+						pdu->num_attrs == max_attrs)
+			goto failed;
+
+		attr = &pdu->attrs[pdu->num_attrs];
+
+		size = element_size(pdu->buf.data + offset + 3,
+					pdu->buf.data_size - offset - 3);
+		if (size < 0)
+			goto failed;
+
+		attr->id = get_be16(pdu->buf.data + offset + 1);
+		attr->offset = offset;
+		attr->len = size + 3;
+
+		offset += attr->len;
+		pdu->num_attrs++;
+	}
+
+	return pdu;
+
+failed:
+	error("Unable to serialize record 0x%x", rec->handle);
+	record_pdu_free(pdu);
+	return NULL;
+}
+
+static int pdu_cache_cmp(const void *key, const void *entry)
+{
+	const uint32_t *handle = key;
+	const struct pdu_cache_entry *e = entry;
+
+	if (*handle < e->rec->handle)
+		return -1;
+
+	return *handle > e->rec->handle;
+}
+
+/*
+ * Return the serialized attributes of a record in the repository. The
+ * result remains valid until the repository is changed.
+ */
+const struct sdp_record_pdu *sdp_record_get_pdu(const sdp_record_t *rec)
+{
+	struct pdu_cache_entry *e;
+	sdp_list_t *p;
+	unsigned int i;
+
+	if (!pdu_cache_valid) {
+		pdu_cache_len = sdp_list_len(service_db);
+		pdu_cache = calloc(pdu_cache_len + 1, sizeof(*pdu_cache));
+		if (!pdu_cache) {
+			pdu_cache_len = 0;
+			return NULL;
+		}
+
+		for (p = service_db, i = 0; p; p = p->next, i++)
+			pdu_cache[i].rec = p->data;
+
+		pdu_cache_valid = true;
+	}
+
+	e = bsearch(&rec->handle, pdu_cache, pdu_cache_len,
+					sizeof(*pdu_cache), pdu_cache_cmp);
+	if (!e || e->rec != rec)
+		return NULL;
+
+	if (!e->pdu)
+		e->pdu = record_pdu_new(rec);
+
+	return e->pdu;
+}
+
 /*
  * Reset the service repository by deleting its contents
  */
@@ -79,6 +424,8 @@ void sdp_svcdb_reset(void)
 
 	sdp_list_free(access_db, access_free);
 	access_db = NULL;
+
+	sdp_svcdb_invalidate();
 }
 
 typedef struct _indexed {
@@ -167,6 +514,7 @@ void sdp_record_add(const bdaddr_t *device, sdp_record_t *rec)
 	SDPDBG("with handle : 0x%x", rec->handle);
 
 	service_db = sdp_list_insert_sorted(service_db, rec, record_sort);
+	sdp_svcdb_invalidate();
 
 	dev = malloc(sizeof(*dev));
 	if (!dev)
@@ -241,6 +589,8 @@ int sdp_record_remove(uint32_t handle)
 	if (r)
 		service_db = sdp_list_remove(service_db, r);
 
+	sdp_svcdb_invalidate();
+
 	p = access_locate(handle);
 	if (p == NULL || p->data == NULL)
 		return 0;
@@ -459,12 +459,15 @@ static int service_search_req(sdp_req_t *req, sdp_buf_t *buf)
 	buf->data_size += sizeof(uint16_t);
 
 	if (cstate == NULL) {
-		/* for every record in the DB, do a pattern search */
-		sdp_list_t *list = sdp_get_record_list();
+		/* only records containing the search UUIDs are candidates */
+		sdp_record_t **records;
+		unsigned int count, n;
+
+		records = sdp_svcdb_lookup(pattern, &count);
 
 		handleSize = 0;
-		for (; list && rsp_count < expected; list = list->next) {
-			sdp_record_t *rec = list->data;
+		for (n = 0; n < count && rsp_count < expected; n++) {
+			sdp_record_t *rec = records[n];
 
 			SDPDBG("Checking svcRec : 0x%x", rec->handle);
 
@@ -585,6 +588,33 @@ done:
 	return status;
 }
 
+/* Append the serialized attributes of a record within the id range */
+static void append_attrs(sdp_buf_t *buf, const struct sdp_record_pdu *pdu,
+						uint16_t low, uint16_t high)
+{
+	unsigned int first = 0, last = pdu->num_attrs;
+
+	/* Attributes are sorted by id, look for the first one in range */
+	while (first < last) {
+		unsigned int mid = (first + last) / 2;
+
+		if (pdu->attrs[mid].id < low)
+			first = mid + 1;
+		else
+			last = mid;
+	}
+
+	for (; first < pdu->num_attrs; first++) {
+		const struct sdp_attr_slice *attr = &pdu->attrs[first];
+
+		if (attr->id > high)
+			break;
+
+		sdp_append_to_buf(buf, pdu->buf.data + attr->offset,
+								attr->len);
+	}
+}
+
 /*
  * Extract attribute identifiers from the request PDU.
  * Clients could request a subset of attributes (by id)
@@ -594,7 +624,7 @@ done:
  */
 static int extract_attrs(sdp_record_t *rec, sdp_list_t *seq, sdp_buf_t *buf)
 {
-	sdp_buf_t pdu;
+	const struct sdp_record_pdu *pdu;
 
 	if (!rec)
 		return SDP_INVALID_RECORD_HANDLE;
@@ -606,7 +636,10 @@ static int extract_attrs(sdp_record_t *rec, sdp_list_t *seq, sdp_buf_t *buf)
 
 	SDPDBG("Entries in attr seq : %d", sdp_list_len(seq));
 
-	sdp_gen_record_pdu(rec, &pdu);
+	/* Attributes are copied from the serialized record */
+	pdu = sdp_record_get_pdu(rec);
+	if (!pdu)
+		return SDP_INVALID_RECORD_HANDLE;
 
 	for (; seq; seq = seq->next) {
 		struct attrid *aid = seq->data;
@@ -615,45 +648,40 @@ static int extract_attrs(sdp_record_t *rec, sdp_list_t *seq, sdp_buf_t *buf)
 
 		if (aid->dtd == SDP_UINT16) {
 			uint16_t attr = aid->uint16;
-			sdp_data_t *a = sdp_data_get(rec, attr);
-			if (a)
-				sdp_append_to_pdu(buf, a);
+
+			append_attrs(buf, pdu, attr, attr);
 		} else if (aid->dtd == SDP_UINT32) {
 			uint32_t range = aid->uint32;
-			uint16_t attr;
 			uint16_t low = (0xffff0000 & range) >> 16;
 			uint16_t high = 0x0000ffff & range;
-			sdp_data_t *data;
 
 			SDPDBG("attr range : 0x%x", range);
 			SDPDBG("Low id : 0x%x", low);
 			SDPDBG("High id : 0x%x", high);
 
-			if (low == 0x0000 && high == 0xffff && pdu.data_size <= buf->buf_size) {
+			if (low == 0x0000 && high == 0xffff &&
+					pdu->buf.data_size <= buf->buf_size) {
 				/* copy it */
-				memcpy(buf->data, pdu.data, pdu.data_size);
-				buf->data_size = pdu.data_size;
+				memcpy(buf->data, pdu->buf.data,
+							pdu->buf.data_size);
+				buf->data_size = pdu->buf.data_size;
 				break;
 			}
-			/* (else) sub-range of attributes */
-			for (attr = low; attr < high; attr++) {
-				data = sdp_data_get(rec, attr);
-				if (data)
-					sdp_append_to_pdu(buf, data);
-			}
-			data = sdp_data_get(rec, high);
-			if (data)
-				sdp_append_to_pdu(buf, data);
+
+			/* (else) sub-range of attributes, an inverted range
+			 * only ever matched its upper bound
+			 */
+			if (low > high)
+				low = high;
+
+			append_attrs(buf, pdu, low, high);
 		} else {
 			error("Unexpected data type : 0x%x", aid->dtd);
 			error("Expect uint16_t or uint32_t");
-			free(pdu.data);
 			return SDP_INVALID_SYNTAX;
 		}
 	}
 
-	free(pdu.data);
-
 	return 0;
 }
 
@@ -839,7 +867,7 @@ static int service_search_attr_req(sdp_req_t *req, sdp_buf_t *buf)
 	uint8_t *pdata;
 	unsigned int max;
 	int scanned, rsp_count = 0;
-	sdp_list_t *pattern = NULL, *seq = NULL, *svcList;
+	sdp_list_t *pattern = NULL, *seq = NULL;
 	sdp_cont_state_t *cstate = NULL;
 	sdp_cont_info_t *cinfo = NULL;
 	short cstate_size = 0;
@@ -906,8 +934,6 @@ static int service_search_attr_req(sdp_req_t *req, sdp_buf_t *buf)
 		goto done;
 	}
 
-	svcList = sdp_get_record_list();
-
 	tmpbuf.data = malloc(USHRT_MAX);
 	tmpbuf.data_size = 0;
 	tmpbuf.buf_size = USHRT_MAX;
@@ -925,9 +951,13 @@ static int service_search_attr_req(sdp_req_t *req, sdp_buf_t *buf)
 
 	if (cstate == NULL) {
 		/* no continuation state -> create new response */
-		sdp_list_t *p;
-		for (p = svcList; p; p = p->next) {
-			sdp_record_t *rec = p->data;
+		sdp_record_t **records;
+		unsigned int count, n;
+
+		records = sdp_svcdb_lookup(pattern, &count);
+
+		for (n = 0; n < count; n++) {
+			sdp_record_t *rec = records[n];
 			if (sdp_match_uuid(pattern, rec->pattern) > 0 &&
 					sdp_check_access(rec->handle, &req->device)) {
 				rsp_count++;
@@ -942,8 +972,9 @@ static int service_search_attr_req(sdp_req_t *req, sdp_buf_t *buf)
 				if (buf->data_size + tmpbuf.data_size < buf->buf_size) {
 					/* to be sure no relocations */
 					sdp_append_to_buf(buf, tmpbuf.data, tmpbuf.data_size);
+					/* only the used part needs clearing */
+					memset(tmpbuf.data, 0, tmpbuf.data_size);
 					tmpbuf.data_size = 0;
-					memset(tmpbuf.data, 0, USHRT_MAX);
 				} else {
 					error("Relocation needed");
 					break;
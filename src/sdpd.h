@@ -49,6 +49,18 @@ void register_mps(bool mpmd);
 void update_device_id(uint16_t source, uint16_t vendor,
 					uint16_t product, uint16_t version);
 
+struct sdp_attr_slice {
+	uint16_t id;
+	uint32_t offset;
+	uint32_t len;
+};
+
+struct sdp_record_pdu {
+	sdp_buf_t buf;
+	struct sdp_attr_slice *attrs;
+	unsigned int num_attrs;
+};
+
 int record_sort(const void *r1, const void *r2);
 void sdp_svcdb_reset(void);
 void sdp_svcdb_collect_all(int sock);
@@ -60,6 +72,9 @@ int sdp_record_remove(uint32_t handle);
 sdp_list_t *sdp_get_record_list(void);
 int sdp_check_access(uint32_t handle, bdaddr_t *device);
 uint32_t sdp_next_handle(void);
+void sdp_svcdb_invalidate(void);
+sdp_record_t **sdp_svcdb_lookup(sdp_list_t *search, unsigned int *count);
+const struct sdp_record_pdu *sdp_record_get_pdu(const sdp_record_t *rec);
 
 uint32_t sdp_get_time(void);
 
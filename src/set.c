@@ -19,6 +19,7 @@
 #include <fcntl.h>
 #include <stdbool.h>
 #include <errno.h>
+#include <time.h>
 
 #include <glib.h>
 #include <dbus/dbus.h>
@@ -38,7 +39,19 @@
 #include "dbus-common.h"
 #include "set.h"
 
+/* Number of recently seen RSIs remembered per adapter, the cache is indexed
+ * by the RSI itself so it has to be a power of two.
+ */
+#define RSI_CACHE_SIZE	512
+
+/* Delay before retrying to connect a member which didn't join the set,
+ * doubled on every further attempt.
+ */
+#define CONNECT_BACKOFF_MIN	2
+#define CONNECT_BACKOFF_MAX	64
+
 static struct queue *set_list;
+static struct queue *resolvers;
 
 struct btd_device_set {
 	struct btd_adapter *adapter;
@@ -47,7 +60,34 @@ struct btd_device_set {
 	uint8_t size;
 	bool auto_connect;
 	struct queue *devices;
-	struct btd_device *device;
+	struct queue *attempts;
+	struct bt_crypto_key *key;
+};
+
+/* Connection attempt to a device found advertising a set RSI, kept until
+ * the device joins the set.
+ */
+struct set_attempt {
+	bdaddr_t bdaddr;
+	uint8_t bdaddr_type;
+	unsigned int count;
+	time_t last;
+};
+
+struct rsi_cache_entry {
+	uint8_t rsi[6];
+	bool valid;
+	struct btd_device_set *set;
+};
+
+/* Per adapter RSI resolver: holds the sets of the adapter, each with its SIRK
+ * already loaded into a keyed AES context, plus the outcome of recent
+ * resolutions so repeated advertisements cost no AES at all.
+ */
+struct set_resolver {
+	struct btd_adapter *adapter;
+	struct queue *sets;
+	struct rsi_cache_entry cache[RSI_CACHE_SIZE];
 };
 
 static DBusMessage *set_disconnect(DBusConnection *conn, DBusMessage *msg,
@@ -168,14 +208,117 @@ static void set_free(void *data)
 	struct btd_device_set *set = data;
 
 	queue_destroy(set->devices, NULL);
+	queue_destroy(set->attempts, free);
+	bt_crypto_key_free(set->key);
 	g_free(set->path);
 	free(set);
 }
 
+static bool match_resolver(const void *data, const void *match_data)
+{
+	const struct set_resolver *resolver = data;
+
+	return resolver->adapter == match_data;
+}
+
+static struct set_resolver *resolver_get(struct btd_adapter *adapter,
+								bool create)
+{
+	struct set_resolver *resolver;
+
+	resolver = queue_find(resolvers, match_resolver, adapter);
+	if (resolver || !create)
+		return resolver;
+
+	resolver = new0(struct set_resolver, 1);
+	resolver->adapter = adapter;
+	resolver->sets = queue_new();
+
+	if (!resolvers)
+		resolvers = queue_new();
+
+	queue_push_tail(resolvers, resolver);
+
+	return resolver;
+}
+
+static void resolver_flush(struct set_resolver *resolver)
+{
+	memset(resolver->cache, 0, sizeof(resolver->cache));
+}
+
+static void resolver_add(struct btd_device_set *set)
+{
+	struct set_resolver *resolver = resolver_get(set->adapter, true);
+
+	queue_push_tail(resolver->sets, set);
+
+	/* Cached misses may now resolve to the new set */
+	resolver_flush(resolver);
+}
+
+static void resolver_remove(struct btd_device_set *set)
+{
+	struct set_resolver *resolver = resolver_get(set->adapter, false);
+
+	if (!resolver)
+		return;
+
+	queue_remove(resolver->sets, set);
+	resolver_flush(resolver);
+
+	if (!queue_isempty(resolver->sets))
+		return;
+
+	queue_remove(resolvers, resolver);
+	queue_destroy(resolver->sets, NULL);
+	free(resolver);
+}
+
+static struct btd_device_set *resolver_lookup(struct set_resolver *resolver,
+						const uint8_t rsi[6])
+{
+	struct rsi_cache_entry *cache;
+	const struct queue_entry *entry;
+	struct btd_device_set *found = NULL;
+
+	/* Both the hash and prand parts are random, so the low bytes of the
+	 * RSI are a good enough index. Colliding RSIs just replace each other.
+	 */
+	cache = &resolver->cache[get_le16(rsi) & (RSI_CACHE_SIZE - 1)];
+	if (cache->valid && !memcmp(cache->rsi, rsi, sizeof(cache->rsi)))
+		return cache->set;
+
+	/* RSI = hash || prand, check the hash against every SIRK */
+	for (entry = queue_get_entries(resolver->sets); entry;
+						entry = entry->next) {
+		struct btd_device_set *set = entry->data;
+		uint8_t hash[3];
+
+		if (!bt_crypto_key_sih(set->key, rsi + 3, hash))
+			continue;
+
+		if (!memcmp(rsi, hash, sizeof(hash))) {
+			found = set;
+			break;
+		}
+	}
+
+	/* Misses are cached as well since non-members keep advertising the
+	 * same RSI until it is rotated.
+	 */
+	memcpy(cache->rsi, rsi, sizeof(cache->rsi));
+	cache->valid = true;
+	cache->set = found;
+
+	return found;
+}
+
 static struct btd_device_set *set_new(struct btd_device *device,
 					const uint8_t sirk[16], uint8_t size)
 {
 	struct btd_device_set *set;
+	struct bt_crypto *crypto;
 
 	set = new0(struct btd_device_set, 1);
 	set->adapter = device_get_adapter(device);
@@ -183,7 +326,18 @@ static struct btd_device_set *set_new(struct btd_device *device,
 	set->size = size;
 	set->auto_connect = true;
 	set->devices = queue_new();
+	set->attempts = queue_new();
 	queue_push_tail(set->devices, device);
+
+	crypto = bt_crypto_new();
+	set->key = bt_crypto_key_new(crypto, sirk);
+	bt_crypto_unref(crypto);
+	if (!set->key) {
+		error("Unable to setup SIRK key");
+		set_free(set);
+		return NULL;
+	}
+
 	set->path = g_strdup_printf("%s/set_%02x%02x%02x%02x%02x%02x%02x%02x"
 					"%02x%02x%02x%02x%02x%02x%02x%02x",
 					adapter_get_path(set->adapter),
@@ -240,6 +394,15 @@ static void set_connect_next(struct btd_device_set *set)
 	}
 }
 
+static bool match_attempt(const void *data, const void *match_data)
+{
+	const struct set_attempt *attempt = data;
+	struct btd_device *device = (void *) match_data;
+
+	return attempt->bdaddr_type == btd_device_get_bdaddr_type(device) &&
+		!bacmp(&attempt->bdaddr, device_get_address(device));
+}
+
 static void set_add(struct btd_device_set *set, struct btd_device *device)
 {
 	/* Check if device is already part of the set then skip to connect */
@@ -248,6 +411,8 @@ static void set_add(struct btd_device_set *set, struct btd_device *device)
 
 	DBG("set %s device %s", set->path, device_get_path(device));
 
+	free(queue_remove_if(set->attempts, match_attempt, device));
+
 	queue_push_tail(set->devices, device);
 	g_dbus_emit_property_changed(btd_get_dbus_connection(), set->path,
 					BTD_DEVICE_SET_INTERFACE, "Devices");
@@ -258,29 +423,48 @@ done:
 		set_connect_next(set);
 }
 
-static void foreach_rsi(void *data, void *user_data)
+/* Members advertise continuously, so this is called for every
+ * advertising report: only attempt to connect when the set is marked to
+ * auto-connect and no earlier attempt is still pending or backing off.
+ */
+static void set_connect_member(struct btd_device_set *set,
+						struct btd_device *device)
 {
-	struct bt_ad_data *ad = data;
-	struct btd_device_set *set = user_data;
-	struct bt_crypto *crypto;
-	uint8_t res[3];
+	struct set_attempt *attempt;
+	struct timespec now;
+	unsigned int delay;
+	int err;
 
-	if (ad->type != BT_AD_CSIP_RSI || ad->len < 6)
+	/* Check if device is already part of the set then skip */
+	if (queue_find(set->devices, NULL, device))
 		return;
 
-	crypto = bt_crypto_new();
-	if (!crypto)
+	if (!set->auto_connect || btd_device_is_blocked(device))
 		return;
 
-	if (!bt_crypto_sih(crypto, set->sirk, ad->data + 3, res)) {
-		bt_crypto_unref(crypto);
+	if (btd_device_is_connected(device) || device_is_connecting(device))
 		return;
-	}
 
-	bt_crypto_unref(crypto);
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	attempt = queue_find(set->attempts, match_attempt, device);
+	if (attempt) {
+		/* Devices never connected before are only retried at the
+		 * slowest rate.
+		 */
+		if (device_is_temporary(device))
+			delay = CONNECT_BACKOFF_MAX;
+		else
+			delay = MIN(CONNECT_BACKOFF_MIN <<
+					MIN(attempt->count - 1, 5),
+					CONNECT_BACKOFF_MAX);
+
+		if (now.tv_sec - attempt->last < delay)
+			return;
 
-	if (memcmp(ad->data, res, sizeof(res)))
-		return;
+		DBG("set %s retrying device %s (attempt %u)", set->path,
+				device_get_path(device), attempt->count + 1);
+	}
 
 	/* Attempt to use existing gatt_db from set if device has never been
 	 * connected before.
@@ -288,28 +472,60 @@ static void foreach_rsi(void *data, void *user_data)
 	 * If dbs don't really match bt_gatt_client will attempt to rediscover
 	 * the ranges that don't match.
 	 */
-	if (gatt_db_isempty(btd_device_get_gatt_db(set->device))) {
-		struct btd_device *device;
+	if (gatt_db_isempty(btd_device_get_gatt_db(device))) {
+		struct btd_device *member;
+
+		member = queue_get_entries(set->devices)->data;
+		btd_device_set_gatt_db(device, btd_device_get_gatt_db(member));
+	}
+
+	err = device_connect_le(device);
+	if (err == -EALREADY)
+		return;
 
-		device = queue_get_entries(set->devices)->data;
-		btd_device_set_gatt_db(set->device,
-					btd_device_get_gatt_db(device));
+	if (!attempt) {
+		attempt = new0(struct set_attempt, 1);
+		bacpy(&attempt->bdaddr, device_get_address(device));
+		attempt->bdaddr_type = btd_device_get_bdaddr_type(device);
+		queue_push_tail(set->attempts, attempt);
 	}
 
-	device_connect_le(set->device);
+	attempt->count++;
+	attempt->last = now.tv_sec;
+}
+
+struct rsi_match {
+	struct btd_device_set *set;
+	struct btd_device *device;
+};
+
+static void foreach_rsi(void *data, void *user_data)
+{
+	struct bt_ad_data *ad = data;
+	struct rsi_match *match = user_data;
+	uint8_t res[3];
+
+	if (ad->type != BT_AD_CSIP_RSI || ad->len < 6)
+		return;
+
+	if (!bt_crypto_key_sih(match->set->key, ad->data + 3, res))
+		return;
+
+	if (memcmp(ad->data, res, sizeof(res)))
+		return;
+
+	set_connect_member(match->set, match->device);
 }
 
 static void foreach_device(struct btd_device *device, void *data)
 {
-	struct btd_device_set *set = data;
+	struct rsi_match match = { data, device };
 
 	/* Check if device is already part of the set then skip */
-	if (queue_find(set->devices, NULL, device))
+	if (queue_find(match.set->devices, NULL, device))
 		return;
 
-	set->device = device;
-
-	btd_device_foreach_ad(device, foreach_rsi, set);
+	btd_device_foreach_ad(device, foreach_rsi, &match);
 }
 
 struct btd_device_set *btd_set_add_device(struct btd_device *device,
@@ -339,8 +555,10 @@ struct btd_device_set *btd_set_add_device(struct btd_device *device,
 	set = set_find(device, sirk);
 	if (set) {
 		set_add(set, device);
-		/* Check if there are new devices with RSI found */
-		goto done;
+		/* Members advertising from now on are resolved as their
+		 * advertisements arrive, see btd_set_resolve_rsi.
+		 */
+		return set;
 	}
 
 	set = set_new(device, sirk, size);
@@ -351,9 +569,9 @@ struct btd_device_set *btd_set_add_device(struct btd_device *device,
 		set_list = queue_new();
 
 	queue_push_tail(set_list, set);
+	resolver_add(set);
 
-done:
-	/* Attempt to add devices which have matching RSI */
+	/* Attempt to add devices already found which have matching RSI */
 	btd_adapter_for_each_device(device_get_adapter(device), foreach_device,
 									set);
 
@@ -380,6 +598,8 @@ bool btd_set_remove_device(struct btd_device_set *set,
 	if (!queue_remove(set_list, set))
 		return false;
 
+	resolver_remove(set);
+
 	/* Unregister if there are no devices left in the set */
 	g_dbus_unregister_interface(btd_get_dbus_connection(), set->path,
 						BTD_DEVICE_SET_INTERFACE);
@@ -387,6 +607,24 @@ bool btd_set_remove_device(struct btd_device_set *set,
 	return true;
 }
 
+bool btd_set_resolve_rsi(struct btd_device *device, const uint8_t rsi[6])
+{
+	struct set_resolver *resolver;
+	struct btd_device_set *set;
+
+	resolver = resolver_get(device_get_adapter(device), false);
+	if (!resolver)
+		return false;
+
+	set = resolver_lookup(resolver, rsi);
+	if (!set)
+		return false;
+
+	set_connect_member(set, device);
+
+	return true;
+}
+
 const char *btd_set_get_path(struct btd_device_set *set)
 {
 	return set->path;
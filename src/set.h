@@ -18,4 +18,5 @@ struct btd_device_set *btd_set_add_device(struct btd_device *device,
 						uint8_t size);
 bool btd_set_remove_device(struct btd_device_set *set,
 						struct btd_device *device);
+bool btd_set_resolve_rsi(struct btd_device *device, const uint8_t rsi[6]);
 const char *btd_set_get_path(struct btd_device_set *set);
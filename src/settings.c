@@ -13,6 +13,11 @@
 
 #include <stdbool.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include <glib.h>
 
@@ -20,6 +25,7 @@
 #include "bluetooth/uuid.h"
 
 #include "log.h"
+#include "src/shared/util.h"
 #include "src/shared/queue.h"
 #include "src/shared/att.h"
 #include "src/shared/gatt-db.h"
@@ -30,6 +36,27 @@
 #define GATT_INCLUDE_UUID_STR "2802"
 #define GATT_CHARAC_UUID_STR "2803"
 
+/* Binary cache layout, all values little endian:
+ *
+ * Header: magic "BZGC", version, flags, number of services, DB hash
+ * Service: record length, start, end, primary, UUID, then attributes
+ * Include: type 0x01, handle, start, end
+ * Characteristic: type 0x02, handle, value handle, properties, UUID,
+ *		   value length, value
+ * Descriptor: type 0x03, handle, UUID, value
+ *
+ * UUIDs are stored as their length in bytes followed by the value.
+ */
+#define GATT_CACHE_VERSION	0x01
+#define GATT_CACHE_HASH		0x01
+#define GATT_CACHE_HDR_SIZE	24
+
+#define GATT_CACHE_INCL		0x01
+#define GATT_CACHE_CHRC		0x02
+#define GATT_CACHE_DESC		0x03
+
+static const uint8_t gatt_cache_magic[4] = { 'B', 'Z', 'G', 'C' };
+
 static ssize_t str2val(const char *str, uint8_t *val, size_t len)
 {
 	const char *pos = str;
@@ -49,14 +76,63 @@ static void load_desc_value(struct gatt_db_attribute *attrib, int err,
 {
 }
 
+static int insert_desc(struct gatt_db_attribute *service, uint16_t handle,
+					const bt_uuid_t *uuid, uint16_t val)
+{
+	struct gatt_db_attribute *att;
+	bt_uuid_t ext_uuid;
+
+	bt_uuid16_create(&ext_uuid, GATT_CHARAC_EXT_PROPER_UUID);
+
+	/* If it is CEP then it must contain the value */
+	if (!bt_uuid_cmp(uuid, &ext_uuid) && !val)
+		return -EIO;
+
+	att = gatt_db_service_insert_descriptor(service, handle, uuid,
+							0, NULL, NULL, NULL);
+	if (!att || gatt_db_attribute_get_handle(att) != handle)
+		return -EIO;
+
+	if (val) {
+		if (!gatt_db_attribute_write(att, 0, (uint8_t *)&val,
+						sizeof(val), 0, NULL,
+						load_desc_value, NULL))
+			return -EIO;
+	}
+
+	return 0;
+}
+
+static int insert_chrc(struct gatt_db_attribute *service, uint16_t handle,
+				uint16_t value_handle, uint8_t properties,
+				const bt_uuid_t *uuid, const uint8_t *val,
+				size_t val_len)
+{
+	struct gatt_db_attribute *att;
+
+	att = gatt_db_service_insert_characteristic(service, handle,
+							value_handle,
+							uuid, 0, properties,
+							NULL, NULL, NULL);
+	if (!att || gatt_db_attribute_get_handle(att) != value_handle)
+		return -EIO;
+
+	if (val_len) {
+		if (!gatt_db_attribute_write(att, 0, val, val_len, 0, NULL,
+						load_desc_value, NULL))
+			return -EIO;
+	}
+
+	return 0;
+}
+
 static int load_desc(struct gatt_db *db, char *handle, char *value,
 					struct gatt_db_attribute *service)
 {
 	char uuid_str[MAX_LEN_UUID_STR];
-	struct gatt_db_attribute *att;
 	uint16_t handle_int;
 	uint16_t val;
-	bt_uuid_t uuid, ext_uuid;
+	bt_uuid_t uuid;
 
 	if (sscanf(handle, "%04hx", &handle_int) != 1) {
 		DBG("Failed to parse handle: %s", handle);
@@ -76,25 +152,8 @@ static int load_desc(struct gatt_db *db, char *handle, char *value,
 						handle_int, val, uuid_str);
 
 	bt_string_to_uuid(&uuid, uuid_str);
-	bt_uuid16_create(&ext_uuid, GATT_CHARAC_EXT_PROPER_UUID);
 
-	/* If it is CEP then it must contain the value */
-	if (!bt_uuid_cmp(&uuid, &ext_uuid) && !val)
-		return -EIO;
-
-	att = gatt_db_service_insert_descriptor(service, handle_int, &uuid,
-							0, NULL, NULL, NULL);
-	if (!att || gatt_db_attribute_get_handle(att) != handle_int)
-		return -EIO;
-
-	if (val) {
-		if (!gatt_db_attribute_write(att, 0, (uint8_t *)&val,
-						sizeof(val), 0, NULL,
-						load_desc_value, NULL))
-			return -EIO;
-	}
-
-	return 0;
+	return insert_desc(service, handle_int, &uuid, val);
 }
 
 static int load_chrc(struct gatt_db *db, char *handle, char *value,
@@ -102,7 +161,6 @@ static int load_chrc(struct gatt_db *db, char *handle, char *value,
 {
 	uint16_t properties, value_handle, handle_int;
 	char uuid_str[MAX_LEN_UUID_STR];
-	struct gatt_db_attribute *att;
 	char val_str[33];
 	uint8_t val[16];
 	size_t val_len;
@@ -131,20 +189,8 @@ static int load_chrc(struct gatt_db *db, char *handle, char *value,
 				handle_int, value_handle,
 				properties, val_len ? val_str : "", uuid_str);
 
-	att = gatt_db_service_insert_characteristic(service, handle_int,
-							value_handle,
-							&uuid, 0, properties,
-							NULL, NULL, NULL);
-	if (!att || gatt_db_attribute_get_handle(att) != value_handle)
-		return -EIO;
-
-	if (val_len) {
-		if (!gatt_db_attribute_write(att, 0, val, val_len, 0, NULL,
-						load_desc_value, NULL))
-			return -EIO;
-	}
-
-	return 0;
+	return insert_chrc(service, handle_int, value_handle, properties,
+							&uuid, val, val_len);
 }
 
 static int load_incl(struct gatt_db *db, char *handle, char *value,
@@ -524,3 +570,631 @@ void btd_settings_gatt_db_store(struct gatt_db *db, const char *filename)
 	g_free(data);
 	g_key_file_free(key_file);
 }
+
+void btd_settings_gatt_db_remove(const char *filename)
+{
+	GKeyFile *key_file;
+	GError *gerr = NULL;
+	char *data;
+	gsize length = 0;
+
+	key_file = g_key_file_new();
+	if (!g_key_file_load_from_file(key_file, filename, 0, &gerr)) {
+		g_error_free(gerr);
+		g_key_file_free(key_file);
+		return;
+	}
+
+	if (!g_key_file_remove_group(key_file, "Attributes", NULL)) {
+		g_key_file_free(key_file);
+		return;
+	}
+
+	data = g_key_file_to_data(key_file, &length, NULL);
+	if (!g_file_set_contents(filename, data, length, &gerr)) {
+		DBG("Unable set contents for %s: (%s)", filename,
+								gerr->message);
+		g_error_free(gerr);
+	}
+
+	g_free(data);
+	g_key_file_free(key_file);
+}
+
+struct gatt_cache {
+	void *addr;
+	size_t len;
+	struct iovec records;
+	uint16_t num_services;
+	uint8_t flags;
+	const uint8_t *hash;
+};
+
+static bool gatt_cache_open(struct gatt_cache *cache, const char *filename)
+{
+	struct iovec iov;
+	struct stat st;
+	const uint8_t *magic;
+	uint8_t version;
+	int fd;
+
+	memset(cache, 0, sizeof(*cache));
+
+	fd = open(filename, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return false;
+
+	if (fstat(fd, &st) < 0 || st.st_size < GATT_CACHE_HDR_SIZE) {
+		close(fd);
+		/* An empty file left by older versions has nothing stored */
+		errno = st.st_size ? EIO : ENOENT;
+		return false;
+	}
+
+	cache->addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (cache->addr == MAP_FAILED) {
+		cache->addr = NULL;
+		return false;
+	}
+
+	cache->len = st.st_size;
+
+	iov.iov_base = cache->addr;
+	iov.iov_len = cache->len;
+
+	magic = util_iov_pull_mem(&iov, sizeof(gatt_cache_magic));
+	util_iov_pull_u8(&iov, &version);
+	util_iov_pull_u8(&iov, &cache->flags);
+	util_iov_pull_le16(&iov, &cache->num_services);
+	cache->hash = util_iov_pull_mem(&iov, 16);
+
+	if (memcmp(magic, gatt_cache_magic, sizeof(gatt_cache_magic)) ||
+					version != GATT_CACHE_VERSION) {
+		DBG("Unsupported cache format in %s", filename);
+		munmap(cache->addr, cache->len);
+		cache->addr = NULL;
+		errno = EIO;
+		return false;
+	}
+
+	cache->records = iov;
+
+	return true;
+}
+
+static void gatt_cache_close(struct gatt_cache *cache)
+{
+	if (cache->addr)
+		munmap(cache->addr, cache->len);
+
+	cache->addr = NULL;
+}
+
+/* Returns the next service record, including its length field */
+static bool gatt_cache_next(struct iovec *records, struct iovec *record)
+{
+	uint16_t len;
+
+	if (!records->iov_len)
+		return false;
+
+	record->iov_base = records->iov_base;
+
+	if (!util_iov_pull_le16(records, &len) ||
+				!util_iov_pull(records, len))
+		return false;
+
+	record->iov_len = len + sizeof(len);
+
+	return true;
+}
+
+static bool pull_uuid(struct iovec *iov, bt_uuid_t *uuid)
+{
+	uint128_t u128;
+	uint32_t u32;
+	uint16_t u16;
+	uint8_t len;
+	void *val;
+
+	if (!util_iov_pull_u8(iov, &len))
+		return false;
+
+	switch (len) {
+	case 2:
+		if (!util_iov_pull_le16(iov, &u16))
+			return false;
+		bt_uuid16_create(uuid, u16);
+		return true;
+	case 4:
+		if (!util_iov_pull_le32(iov, &u32))
+			return false;
+		bt_uuid32_create(uuid, u32);
+		return true;
+	case 16:
+		val = util_iov_pull_mem(iov, sizeof(u128));
+		if (!val)
+			return false;
+		memcpy(&u128, val, sizeof(u128));
+		bt_uuid128_create(uuid, u128);
+		return true;
+	}
+
+	return false;
+}
+
+static bool pull_service(struct iovec *record, uint16_t *start,
+				uint16_t *end, uint8_t *primary,
+				bt_uuid_t *uuid)
+{
+	uint16_t len;
+
+	return util_iov_pull_le16(record, &len) &&
+			util_iov_pull_le16(record, start) &&
+			util_iov_pull_le16(record, end) &&
+			util_iov_pull_u8(record, primary) &&
+			pull_uuid(record, uuid) && *end >= *start;
+}
+
+static int cache_load_service(struct gatt_db *db, struct iovec *record)
+{
+	struct gatt_db_attribute *att;
+	uint16_t start, end;
+	uint8_t primary;
+	bt_uuid_t uuid;
+
+	if (!pull_service(record, &start, &end, &primary, &uuid))
+		return -EIO;
+
+	att = gatt_db_insert_service(db, start, &uuid, primary,
+							end - start + 1);
+	if (!att) {
+		DBG("Unable load service into db!");
+		return -EIO;
+	}
+
+	return 0;
+}
+
+static int cache_load_attr(struct gatt_db *db, struct iovec *record,
+					struct gatt_db_attribute *service)
+{
+	struct gatt_db_attribute *att;
+	uint16_t handle, value_handle, start, end, val;
+	uint8_t type, properties, len;
+	const uint8_t *value;
+	bt_uuid_t uuid;
+
+	if (!util_iov_pull_u8(record, &type) ||
+			!util_iov_pull_le16(record, &handle))
+		return -EIO;
+
+	switch (type) {
+	case GATT_CACHE_INCL:
+		if (!util_iov_pull_le16(record, &start) ||
+				!util_iov_pull_le16(record, &end))
+			return -EIO;
+
+		att = gatt_db_get_attribute(db, start);
+		if (!att || !gatt_db_service_add_included(service, att))
+			return -EIO;
+
+		return 0;
+	case GATT_CACHE_CHRC:
+		if (!util_iov_pull_le16(record, &value_handle) ||
+				!util_iov_pull_u8(record, &properties) ||
+				!pull_uuid(record, &uuid) ||
+				!util_iov_pull_u8(record, &len))
+			return -EIO;
+
+		value = util_iov_pull_mem(record, len);
+		if (len && !value)
+			return -EIO;
+
+		return insert_chrc(service, handle, value_handle, properties,
+							&uuid, value, len);
+	case GATT_CACHE_DESC:
+		if (!pull_uuid(record, &uuid) ||
+				!util_iov_pull_le16(record, &val))
+			return -EIO;
+
+		return insert_desc(service, handle, &uuid, val);
+	}
+
+	return -EIO;
+}
+
+static int cache_load(struct gatt_db *db, struct gatt_cache *cache)
+{
+	struct gatt_db_attribute *service;
+	struct iovec records, record;
+	uint16_t start, end;
+	uint8_t primary;
+	bt_uuid_t uuid;
+	int ret;
+
+	/* First insert all services so includes can be resolved */
+	records = cache->records;
+	while (gatt_cache_next(&records, &record)) {
+		ret = cache_load_service(db, &record);
+		if (ret)
+			return ret;
+	}
+
+	if (records.iov_len)
+		return -EIO;
+
+	/* Then fill them with the attributes following their header */
+	records = cache->records;
+	while (gatt_cache_next(&records, &record)) {
+		pull_service(&record, &start, &end, &primary, &uuid);
+
+		service = gatt_db_get_attribute(db, start);
+		if (!service)
+			return -EIO;
+
+		while (record.iov_len) {
+			ret = cache_load_attr(db, &record, service);
+			if (ret)
+				return ret;
+		}
+
+		gatt_db_service_set_active(service, true);
+	}
+
+	return 0;
+}
+
+int btd_settings_gatt_cache_load(struct gatt_db *db, const char *filename)
+{
+	struct gatt_cache cache;
+	int err;
+
+	if (!gatt_cache_open(&cache, filename)) {
+		err = -errno;
+		if (err != -ENOENT)
+			DBG("Unable to open cache %s: %s", filename,
+							strerror(-err));
+		return err;
+	}
+
+	err = cache_load(db, &cache);
+	if (err)
+		gatt_db_clear(db);
+
+	gatt_cache_close(&cache);
+
+	return err;
+}
+
+struct gatt_cache_saver {
+	struct gatt_db *db;
+	GByteArray *buf;
+	uint16_t ext_props;
+	uint16_t start;
+	uint16_t end;
+	uint16_t hash_handle;
+	uint16_t num_services;
+	struct iovec old;
+};
+
+static void push_u8(GByteArray *buf, uint8_t val)
+{
+	g_byte_array_append(buf, &val, sizeof(val));
+}
+
+static void push_le16(GByteArray *buf, uint16_t val)
+{
+	uint8_t data[2];
+
+	put_le16(val, data);
+	g_byte_array_append(buf, data, sizeof(data));
+}
+
+static void push_uuid(GByteArray *buf, const bt_uuid_t *uuid)
+{
+	uint8_t data[4];
+
+	switch (uuid->type) {
+	case BT_UUID16:
+		push_u8(buf, 2);
+		push_le16(buf, uuid->value.u16);
+		break;
+	case BT_UUID32:
+		push_u8(buf, 4);
+		put_le32(uuid->value.u32, data);
+		g_byte_array_append(buf, data, 4);
+		break;
+	default:
+		push_u8(buf, 16);
+		g_byte_array_append(buf, (uint8_t *) &uuid->value.u128,
+						sizeof(uuid->value.u128));
+		break;
+	}
+}
+
+static void cache_store_desc(struct gatt_db_attribute *attr,
+							void *user_data)
+{
+	struct gatt_cache_saver *saver = user_data;
+	const bt_uuid_t *uuid;
+	bt_uuid_t ext_uuid;
+
+	uuid = gatt_db_attribute_get_type(attr);
+	bt_uuid16_create(&ext_uuid, GATT_CHARAC_EXT_PROPER_UUID);
+
+	push_u8(saver->buf, GATT_CACHE_DESC);
+	push_le16(saver->buf, gatt_db_attribute_get_handle(attr));
+	push_uuid(saver->buf, uuid);
+	push_le16(saver->buf, bt_uuid_cmp(uuid, &ext_uuid) ? 0 :
+							saver->ext_props);
+}
+
+static void cache_store_chrc(struct gatt_db_attribute *attr,
+							void *user_data)
+{
+	struct gatt_cache_saver *saver = user_data;
+	const uint8_t *hash = NULL;
+	uint16_t handle, value_handle;
+	uint8_t properties;
+	bt_uuid_t uuid;
+
+	if (!gatt_db_attribute_get_char_data(attr, &handle, &value_handle,
+						&properties, &saver->ext_props,
+						&uuid)) {
+		DBG("Unable to locate Characteristic data");
+		return;
+	}
+
+	push_u8(saver->buf, GATT_CACHE_CHRC);
+	push_le16(saver->buf, handle);
+	push_le16(saver->buf, value_handle);
+	push_u8(saver->buf, properties);
+	push_uuid(saver->buf, &uuid);
+
+	/* Store Database Hash value if available */
+	if (bt_uuid16_cmp(&uuid, GATT_CHARAC_DB_HASH))
+		gatt_db_attribute_read(gatt_db_get_attribute(saver->db,
+							value_handle),
+					0, BT_ATT_OP_READ_REQ, NULL,
+					db_hash_read_value_cb, &hash);
+
+	if (hash) {
+		push_u8(saver->buf, 16);
+		g_byte_array_append(saver->buf, hash, 16);
+	} else
+		push_u8(saver->buf, 0);
+
+	gatt_db_service_foreach_desc(attr, cache_store_desc, saver);
+}
+
+static void cache_store_incl(struct gatt_db_attribute *attr,
+							void *user_data)
+{
+	struct gatt_cache_saver *saver = user_data;
+	uint16_t handle, start, end;
+
+	if (!gatt_db_attribute_get_incl_data(attr, &handle, &start, &end)) {
+		DBG("Unable to locate Included data");
+		return;
+	}
+
+	push_u8(saver->buf, GATT_CACHE_INCL);
+	push_le16(saver->buf, handle);
+	push_le16(saver->buf, start);
+	push_le16(saver->buf, end);
+}
+
+/* Looks up the record stored for exactly this service, records are sorted
+ * by handle so the old cache is walked along with the database.
+ */
+static bool cache_find_record(struct gatt_cache_saver *saver, uint16_t start,
+					uint16_t end, struct iovec *record)
+{
+	struct iovec next;
+	uint16_t rec_start, rec_end;
+
+	while (gatt_cache_next(&saver->old, &next)) {
+		rec_start = get_le16(next.iov_base + 2);
+		rec_end = get_le16(next.iov_base + 4);
+
+		if (rec_start < start)
+			continue;
+
+		if (rec_start != start || rec_end != end) {
+			/* Leave it for the services that follow */
+			saver->old.iov_base -= next.iov_len;
+			saver->old.iov_len += next.iov_len;
+			return false;
+		}
+
+		*record = next;
+		return true;
+	}
+
+	return false;
+}
+
+static void cache_store_service(struct gatt_db_attribute *attr,
+							void *user_data)
+{
+	struct gatt_cache_saver *saver = user_data;
+	struct iovec record;
+	uint16_t start, end;
+	bt_uuid_t uuid;
+	bool primary;
+	guint offset;
+
+	if (!gatt_db_attribute_get_service_data(attr, &start, &end, &primary,
+								&uuid)) {
+		DBG("Unable to locate Service data");
+		return;
+	}
+
+	saver->num_services++;
+
+	/* Services outside of the changed range are copied as stored, except
+	 * the one with the Database Hash whose value changes along with it.
+	 */
+	if ((end < saver->start || start > saver->end) &&
+			(saver->hash_handle < start ||
+			saver->hash_handle > end) &&
+			cache_find_record(saver, start, end, &record)) {
+		g_byte_array_append(saver->buf, record.iov_base,
+							record.iov_len);
+		return;
+	}
+
+	offset = saver->buf->len;
+
+	push_le16(saver->buf, 0);
+	push_le16(saver->buf, start);
+	push_le16(saver->buf, end);
+	push_u8(saver->buf, primary);
+	push_uuid(saver->buf, &uuid);
+
+	gatt_db_service_foreach_incl(attr, cache_store_incl, saver);
+	gatt_db_service_foreach_char(attr, cache_store_chrc, saver);
+
+	put_le16(saver->buf->len - offset - 2, saver->buf->data + offset);
+}
+
+static void find_db_hash(struct gatt_db_attribute *attr, void *user_data)
+{
+	struct gatt_db_attribute **hash_attr = user_data;
+
+	*hash_attr = attr;
+}
+
+/* The cache is written to a temporary file renamed into place once
+ * complete, so a load never finds a partially written file.
+ */
+static void gatt_cache_write(const char *filename, const uint8_t *data,
+								size_t len)
+{
+	char *dir, *tmp;
+	ssize_t written;
+	int fd, err;
+
+	dir = g_path_get_dirname(filename);
+	g_mkdir_with_parents(dir, 0700);
+	g_free(dir);
+
+	tmp = g_strconcat(filename, ".tmp", NULL);
+
+	fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+	if (fd < 0) {
+		DBG("Unable to create %s: %s", tmp, strerror(errno));
+		goto done;
+	}
+
+	while (len) {
+		written = write(fd, data, len);
+		if (written < 0) {
+			if (errno == EINTR)
+				continue;
+
+			DBG("Unable to write %s: %s", tmp, strerror(errno));
+			close(fd);
+			unlink(tmp);
+			goto done;
+		}
+
+		data += written;
+		len -= written;
+	}
+
+	err = fsync(fd);
+	if (close(fd) < 0)
+		err = -1;
+
+	if (err < 0 || rename(tmp, filename) < 0) {
+		DBG("Unable to store %s: %s", filename, strerror(errno));
+		unlink(tmp);
+	}
+
+done:
+	g_free(tmp);
+}
+
+static void count_service(struct gatt_db_attribute *attr, void *user_data)
+{
+	uint16_t *count = user_data;
+
+	(*count)++;
+}
+
+void btd_settings_gatt_cache_store(struct gatt_db *db, const char *filename,
+						uint16_t start, uint16_t end)
+{
+	struct gatt_cache_saver saver;
+	struct gatt_cache cache;
+	struct gatt_db_attribute *hash_attr = NULL;
+	const uint8_t *hash = NULL;
+	uint16_t count = 0;
+	bt_uuid_t uuid;
+	uint8_t *hdr;
+
+	bt_uuid16_create(&uuid, GATT_CHARAC_DB_HASH);
+	gatt_db_find_by_type(db, 0x0001, 0xffff, &uuid, find_db_hash,
+								&hash_attr);
+	if (hash_attr)
+		gatt_db_attribute_read(hash_attr, 0, BT_ATT_OP_READ_REQ, NULL,
+					db_hash_read_value_cb, &hash);
+
+	if (!gatt_cache_open(&cache, filename)) {
+		/* Nothing stored that could be reused */
+		start = 0x0001;
+		end = 0xffff;
+	}
+
+	/* A full store of a database with the hash it was stored with has
+	 * nothing to update, which is the common case on reconnection.
+	 */
+	if (cache.addr && hash && (cache.flags & GATT_CACHE_HASH) &&
+			start == 0x0001 && end == 0xffff &&
+			!memcmp(cache.hash, hash, 16)) {
+		gatt_db_foreach_service(db, NULL, count_service, &count);
+		if (count == cache.num_services) {
+			DBG("Cache %s is up to date", filename);
+			gatt_cache_close(&cache);
+			return;
+		}
+	}
+
+	memset(&saver, 0, sizeof(saver));
+	saver.db = db;
+	saver.buf = g_byte_array_sized_new(cache.len ? cache.len : 1024);
+	saver.start = start;
+	saver.end = end;
+	saver.hash_handle = hash ? gatt_db_attribute_get_handle(hash_attr) : 0;
+	saver.old = cache.records;
+
+	g_byte_array_set_size(saver.buf, GATT_CACHE_HDR_SIZE);
+	memset(saver.buf->data, 0, GATT_CACHE_HDR_SIZE);
+
+	gatt_db_foreach_service(db, NULL, cache_store_service, &saver);
+
+	hdr = saver.buf->data;
+	memcpy(hdr, gatt_cache_magic, sizeof(gatt_cache_magic));
+	hdr[4] = GATT_CACHE_VERSION;
+	hdr[5] = hash ? GATT_CACHE_HASH : 0;
+	put_le16(saver.num_services, hdr + 6);
+	if (hash)
+		memcpy(hdr + 8, hash, 16);
+
+	/* Avoid rewriting the file if nothing has changed */
+	if (cache.len == saver.buf->len &&
+			!memcmp(cache.addr, saver.buf->data, cache.len)) {
+		DBG("Cache %s is up to date", filename);
+		goto done;
+	}
+
+	gatt_cache_write(filename, saver.buf->data, saver.buf->len);
+
+done:
+	g_byte_array_free(saver.buf, TRUE);
+	gatt_cache_close(&cache);
+}
@@ -9,3 +9,8 @@
 
 int btd_settings_gatt_db_load(struct gatt_db *db, const char *filename);
 void btd_settings_gatt_db_store(struct gatt_db *db, const char *filename);
+void btd_settings_gatt_db_remove(const char *filename);
+
+int btd_settings_gatt_cache_load(struct gatt_db *db, const char *filename);
+void btd_settings_gatt_cache_store(struct gatt_db *db, const char *filename,
+						uint16_t start, uint16_t end);
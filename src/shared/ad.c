@@ -1479,3 +1479,325 @@ struct bt_ad_pattern *bt_ad_pattern_match(struct bt_ad *ad,
 
 	return info.matched_pattern;
 }
+
+/* The matcher indexes patterns by AD type, then by offset and the first byte
+ * expected at that offset, so each AD element of a report only has to look
+ * at the patterns that could possibly match it.
+ */
+struct ad_matcher_entry {
+	struct bt_ad_pattern pattern;
+	struct ad_matcher_slot *slot;
+	struct ad_matcher_owner *owner;
+	struct ad_matcher_entry *next;
+};
+
+struct ad_matcher_slot {
+	uint8_t type;
+	uint8_t offset;
+	unsigned int count;
+	struct ad_matcher_entry *entries[256];
+};
+
+struct ad_matcher_owner {
+	void *data;
+	unsigned int generation;
+	struct queue *entries;
+};
+
+struct bt_ad_matcher {
+	struct queue *types[256];	/* Lists of ad_matcher_slot */
+	struct queue *owners;
+	unsigned int generation;
+};
+
+/* Service data patterns match the data following the UUID regardless of the
+ * UUID size, see match_service().
+ */
+static uint8_t matcher_type(uint8_t type)
+{
+	switch (type) {
+	case BT_AD_SERVICE_DATA32:
+	case BT_AD_SERVICE_DATA128:
+		return BT_AD_SERVICE_DATA16;
+	}
+
+	return type;
+}
+
+static size_t matcher_skip(uint8_t type)
+{
+	switch (type) {
+	case BT_AD_SERVICE_DATA16:
+		return sizeof(uint16_t);
+	case BT_AD_SERVICE_DATA32:
+		return sizeof(uint32_t);
+	case BT_AD_SERVICE_DATA128:
+		return sizeof(uint128_t);
+	}
+
+	return 0;
+}
+
+static bool match_slot_offset(const void *data, const void *user_data)
+{
+	const struct ad_matcher_slot *slot = data;
+
+	return slot->offset == PTR_TO_UINT(user_data);
+}
+
+static bool match_owner(const void *data, const void *user_data)
+{
+	const struct ad_matcher_owner *owner = data;
+
+	return owner->data == user_data;
+}
+
+static void matcher_unlink(void *data, void *user_data)
+{
+	struct ad_matcher_entry *entry = data;
+	struct bt_ad_matcher *matcher = user_data;
+	struct ad_matcher_slot *slot = entry->slot;
+	struct ad_matcher_entry **e;
+
+	for (e = &slot->entries[entry->pattern.data[0]]; *e; e = &(*e)->next) {
+		if (*e == entry) {
+			*e = entry->next;
+			break;
+		}
+	}
+
+	free(entry);
+
+	if (--slot->count)
+		return;
+
+	queue_remove(matcher->types[slot->type], slot);
+
+	if (queue_isempty(matcher->types[slot->type])) {
+		queue_destroy(matcher->types[slot->type], NULL);
+		matcher->types[slot->type] = NULL;
+	}
+
+	free(slot);
+}
+
+static void matcher_link(void *data, void *user_data)
+{
+	struct bt_ad_pattern *pattern = data;
+	struct ad_matcher_owner *owner = user_data;
+	struct ad_matcher_entry *entry;
+
+	entry = new0(struct ad_matcher_entry, 1);
+	memcpy(&entry->pattern, pattern, sizeof(*pattern));
+	entry->owner = owner;
+
+	queue_push_tail(owner->entries, entry);
+}
+
+struct bt_ad_matcher *bt_ad_matcher_new(void)
+{
+	struct bt_ad_matcher *matcher;
+
+	matcher = new0(struct bt_ad_matcher, 1);
+	matcher->owners = queue_new();
+
+	return matcher;
+}
+
+static void matcher_owner_free(struct ad_matcher_owner *owner)
+{
+	queue_destroy(owner->entries, NULL);
+	free(owner);
+}
+
+void bt_ad_matcher_free(struct bt_ad_matcher *matcher)
+{
+	struct ad_matcher_owner *owner;
+
+	if (!matcher)
+		return;
+
+	while ((owner = queue_pop_head(matcher->owners))) {
+		queue_foreach(owner->entries, matcher_unlink, matcher);
+		matcher_owner_free(owner);
+	}
+
+	queue_destroy(matcher->owners, NULL);
+	free(matcher);
+}
+
+bool bt_ad_matcher_add(struct bt_ad_matcher *matcher, struct queue *patterns,
+							void *match_data)
+{
+	struct ad_matcher_owner *owner;
+	const struct queue_entry *qe;
+
+	if (!matcher || queue_isempty(patterns))
+		return false;
+
+	if (queue_find(matcher->owners, match_owner, match_data))
+		return false;
+
+	owner = new0(struct ad_matcher_owner, 1);
+	owner->data = match_data;
+	owner->generation = matcher->generation;
+	owner->entries = queue_new();
+
+	queue_foreach(patterns, matcher_link, owner);
+
+	for (qe = queue_get_entries(owner->entries); qe; qe = qe->next) {
+		struct ad_matcher_entry *entry = qe->data;
+		struct bt_ad_pattern *pattern = &entry->pattern;
+		uint8_t type = matcher_type(pattern->type);
+		struct ad_matcher_slot *slot;
+
+		if (!matcher->types[type])
+			matcher->types[type] = queue_new();
+
+		slot = queue_find(matcher->types[type], match_slot_offset,
+						UINT_TO_PTR(pattern->offset));
+		if (!slot) {
+			slot = new0(struct ad_matcher_slot, 1);
+			slot->type = type;
+			slot->offset = pattern->offset;
+			queue_push_tail(matcher->types[type], slot);
+		}
+
+		entry->slot = slot;
+		entry->next = slot->entries[pattern->data[0]];
+		slot->entries[pattern->data[0]] = entry;
+		slot->count++;
+	}
+
+	queue_push_tail(matcher->owners, owner);
+
+	return true;
+}
+
+bool bt_ad_matcher_remove(struct bt_ad_matcher *matcher, void *match_data)
+{
+	struct ad_matcher_owner *owner;
+
+	if (!matcher)
+		return false;
+
+	owner = queue_remove_if(matcher->owners, match_owner, match_data);
+	if (!owner)
+		return false;
+
+	queue_foreach(owner->entries, matcher_unlink, matcher);
+	matcher_owner_free(owner);
+
+	return true;
+}
+
+struct matcher_data {
+	struct bt_ad_matcher *matcher;
+	const uint8_t *data;
+	size_t len;
+	bt_ad_matcher_func_t func;
+	void *user_data;
+	unsigned int count;
+};
+
+static void match_slot(void *data, void *user_data)
+{
+	struct ad_matcher_slot *slot = data;
+	struct matcher_data *match = user_data;
+	struct ad_matcher_entry *entry;
+
+	if (slot->offset >= match->len)
+		return;
+
+	for (entry = slot->entries[match->data[slot->offset]]; entry;
+							entry = entry->next) {
+		struct bt_ad_pattern *pattern = &entry->pattern;
+		struct ad_matcher_owner *owner = entry->owner;
+
+		if (owner->generation == match->matcher->generation)
+			continue;
+
+		if (match->len < pattern->offset + pattern->len)
+			continue;
+
+		if (memcmp(match->data + pattern->offset, pattern->data,
+							pattern->len))
+			continue;
+
+		/* Report each owner only once per advertisement */
+		owner->generation = match->matcher->generation;
+		match->count++;
+
+		if (match->func)
+			match->func(owner->data, match->user_data);
+	}
+}
+
+/* Matches the raw AD/EIR data against every pattern added, calling func once
+ * for each set of patterns with at least one pattern matching. Returns the
+ * number of matching sets.
+ */
+unsigned int bt_ad_matcher_match(struct bt_ad_matcher *matcher,
+					const uint8_t *data, size_t len,
+					bt_ad_matcher_func_t func,
+					void *user_data)
+{
+	struct matcher_data match;
+	struct iovec iov = {
+		.iov_base = (void *)data,
+		.iov_len = len,
+	};
+	uint8_t elen;
+
+	if (!matcher || !data || queue_isempty(matcher->owners))
+		return 0;
+
+	/* Owners last matched by an earlier generation are eligible again */
+	if (!++matcher->generation) {
+		const struct queue_entry *qe;
+
+		for (qe = queue_get_entries(matcher->owners); qe;
+							qe = qe->next) {
+			struct ad_matcher_owner *owner = qe->data;
+
+			owner->generation = 0;
+		}
+
+		matcher->generation++;
+	}
+
+	memset(&match, 0, sizeof(match));
+	match.matcher = matcher;
+	match.func = func;
+	match.user_data = user_data;
+
+	while (util_iov_pull_u8(&iov, &elen)) {
+		uint8_t type;
+		size_t skip;
+
+		if (elen == 0 || elen > iov.iov_len)
+			break;
+
+		util_iov_pull_u8(&iov, &type);
+		elen--;
+
+		match.data = util_iov_pull_mem(&iov, elen);
+		match.len = elen;
+
+		if (!ad_is_type_valid(type) ||
+					!matcher->types[matcher_type(type)])
+			continue;
+
+		skip = matcher_skip(type);
+		if (match.len < skip)
+			continue;
+
+		match.data += skip;
+		match.len -= skip;
+
+		queue_foreach(matcher->types[matcher_type(type)], match_slot,
+									&match);
+	}
+
+	return match.count;
+}
@@ -203,6 +203,12 @@ struct bt_bap {
 	struct queue *bis_cbs;
 	struct queue *bcode_cbs;
 
+	bt_bap_pacs_func_t pacs_func;
+	void *pacs_data;
+	bool pacs_restored;
+	unsigned int pacs_revalidating;
+	bool pacs_keep;
+
 	bt_bap_debug_func_t debug_func;
 	bt_bap_destroy_func_t debug_destroy;
 	void *debug_data;
@@ -220,6 +226,7 @@ struct bt_bap_pac {
 	struct queue *channels;
 	struct bt_bap_pac_ops *ops;
 	void *user_data;
+	bool stale;		/* Not read again since revalidation started */
 };
 
 struct bt_bap_endpoint {
@@ -4919,8 +4926,18 @@ static void bap_parse_pacs(struct bt_bap *bap, uint8_t type,
 		DBG(bap, "PAC #%u: type %u codec 0x%02x cc_len %u meta_len %u",
 			i, type, p->codec.id, p->cc_len, meta->len);
 
-		/* Check if there is already a PAC record for the codec */
+		/* Check if there is already a PAC record for the codec, a
+		 * record being revalidated is replaced by the first one read.
+		 */
 		pac = bap_pac_find(bap->rdb, type, &p->codec);
+		if (pac && pac->stale) {
+			pac->stale = false;
+			util_iov_free(pac->data, 1);
+			util_iov_free(pac->metadata, 1);
+			pac->data = NULL;
+			pac->metadata = NULL;
+		}
+
 		if (pac) {
 			bap_pac_merge(pac, &data, &metadata);
 			continue;
@@ -4932,42 +4949,242 @@ static void bap_parse_pacs(struct bt_bap *bap, uint8_t type,
 			continue;
 
 		queue_push_tail(queue, pac);
+
+		/* Records found while revalidating are new to the owner */
+		if (bap->pacs_revalidating)
+			queue_foreach(bap->pac_cbs, notify_pac_added, pac);
+	}
+}
+
+static bool bap_parse_pac_loc(struct bt_bap *bap, uint32_t *loc,
+					const char *name, const uint8_t *value,
+					uint16_t length)
+{
+	if (length != sizeof(uint32_t)) {
+		DBG(bap, "Invalid %s PAC Location size: %d", name, length);
+		return false;
+	}
+
+	*loc = get_le32(value);
+
+	DBG(bap, "PACS %s Locations: 0x%08x", name, *loc);
+
+	return true;
+}
+
+static bool bap_parse_pac_context(struct bt_bap *bap, uint16_t *snk,
+					uint16_t *src, const char *name,
+					const uint8_t *value, uint16_t length)
+{
+	const struct bt_pacs_context *ctx = (void *)value;
+
+	if (length != sizeof(*ctx)) {
+		DBG(bap, "Invalid PAC %s size: %d", name, length);
+		return false;
+	}
+
+	*snk = le16_to_cpu(ctx->snk);
+	*src = le16_to_cpu(ctx->src);
+
+	DBG(bap, "PACS Sink %s: 0x%04x", name, *snk);
+	DBG(bap, "PACS Source %s: 0x%04x", name, *src);
+
+	return true;
+}
+
+/* Parse the value of a remote PACS characteristic, either as just read or as
+ * restored from a previous connection.
+ */
+static bool bap_parse_pacs_value(struct bt_bap *bap, uint16_t uuid,
+					const uint8_t *value, uint16_t length)
+{
+	struct bt_pacs *pacs = bap_get_pacs(bap);
+
+	if (!pacs)
+		return false;
+
+	switch (uuid) {
+	case PAC_SINK_CHRC_UUID:
+		bap_parse_pacs(bap, BT_BAP_SINK, bap->rdb->sinks, value,
+								length);
+		return true;
+	case PAC_SOURCE_CHRC_UUID:
+		bap_parse_pacs(bap, BT_BAP_SOURCE, bap->rdb->sources, value,
+								length);
+		return true;
+	case PAC_SINK_LOC_CHRC_UUID:
+		return bap_parse_pac_loc(bap, &pacs->sink_loc_value, "Sink",
+							value, length);
+	case PAC_SOURCE_LOC_CHRC_UUID:
+		return bap_parse_pac_loc(bap, &pacs->source_loc_value,
+						"Source", value, length);
+	case PAC_CONTEXT:
+		return bap_parse_pac_context(bap, &pacs->sink_context_value,
+						&pacs->source_context_value,
+						"Context", value, length);
+	case PAC_SUPPORTED_CONTEXT:
+		return bap_parse_pac_context(bap,
+					&pacs->supported_sink_context_value,
+					&pacs->supported_source_context_value,
+					"Supported Context", value, length);
 	}
+
+	return false;
+}
+
+struct bap_pacs_read {
+	struct bt_bap *bap;
+	uint16_t handle;
+	bt_gatt_client_read_callback_t func;
+	bool revalidate;
+};
+
+static bool bap_read_pacs_value(struct bap_pacs_read *read, uint16_t uuid,
+					const uint8_t *value, uint16_t length)
+{
+	struct bt_bap *bap = read->bap;
+
+	if (!bap_parse_pacs_value(bap, uuid, value, length))
+		return false;
+
+	if (bap->pacs_func)
+		bap->pacs_func(bap, read->handle, uuid, value, length,
+							bap->pacs_data);
+
+	return true;
+}
+
+static bool match_stream_rpac(const void *data, const void *match_data)
+{
+	const struct bt_bap_stream *stream = data;
+
+	return stream->rpac == match_data;
+}
+
+static bool match_pac_removed(const void *data, const void *match_data)
+{
+	const struct bt_bap_pac *pac = data;
+	const struct bt_bap *bap = match_data;
+
+	/* Keep records in use by a stream until it is released */
+	return pac->stale && !queue_find(bap->streams, match_stream_rpac, pac);
+}
+
+static void pac_clear_stale(void *data, void *user_data)
+{
+	struct bt_bap_pac *pac = data;
+
+	pac->stale = false;
+}
+
+static void bap_pacs_prune(struct bt_bap *bap, struct queue *queue)
+{
+	struct bt_bap_pac *pac;
+
+	if (bap->pacs_keep)
+		goto done;
+
+	while ((pac = queue_remove_if(queue, match_pac_removed, bap))) {
+		DBG(bap, "PAC %p codec 0x%02x no longer present", pac,
+							pac->codec.id);
+		queue_foreach(bap->pac_cbs, notify_pac_removed, pac);
+		bap_pac_free(pac);
+	}
+
+done:
+	queue_foreach(queue, pac_clear_stale, NULL);
+}
+
+/* Once every PACS value has been read again, drop the records which were
+ * restored but are no longer reported by the remote.
+ */
+static void bap_revalidate_complete(struct bt_bap *bap)
+{
+	if (!bap->pacs_revalidating || --bap->pacs_revalidating)
+		return;
+
+	bap_pacs_prune(bap, bap->rdb->sinks);
+	bap_pacs_prune(bap, bap->rdb->sources);
+	bap->pacs_keep = false;
+}
+
+static void read_pacs_cb(bool success, uint8_t att_ecode,
+				const uint8_t *value, uint16_t length,
+				void *user_data)
+{
+	struct bap_pacs_read *read = user_data;
+	struct bt_bap *bap = read->bap;
+
+	read->func(success, att_ecode, value, length, read);
+
+	if (!read->revalidate)
+		return;
+
+	/* Don't drop anything based on a partial read */
+	if (!success)
+		bap->pacs_keep = true;
+
+	bap_revalidate_complete(bap);
+}
+
+static void bap_pacs_read(struct bt_bap *bap, uint16_t value_handle,
+					bt_gatt_client_read_callback_t func,
+					bool revalidate)
+{
+	struct bap_pacs_read *read;
+
+	read = new0(struct bap_pacs_read, 1);
+	read->bap = bap;
+	read->handle = value_handle;
+	read->func = func;
+	read->revalidate = revalidate;
+
+	if (!bt_gatt_client_read_value(bap->client, value_handle,
+					read_pacs_cb, read, free)) {
+		free(read);
+		return;
+	}
+
+	if (revalidate)
+		bap->pacs_revalidating++;
 }
 
 static void read_source_pac(bool success, uint8_t att_ecode,
 				const uint8_t *value, uint16_t length,
 				void *user_data)
 {
-	struct bt_bap *bap = user_data;
+	struct bap_pacs_read *read = user_data;
+	struct bt_bap *bap = read->bap;
 
 	if (!success) {
 		DBG(bap, "Unable to read Source PAC: error 0x%02x", att_ecode);
 		return;
 	}
 
-	bap_parse_pacs(bap, BT_BAP_SOURCE, bap->rdb->sources, value, length);
+	bap_read_pacs_value(read, PAC_SOURCE_CHRC_UUID, value, length);
 }
 
 static void read_sink_pac(bool success, uint8_t att_ecode,
 				const uint8_t *value, uint16_t length,
 				void *user_data)
 {
-	struct bt_bap *bap = user_data;
+	struct bap_pacs_read *read = user_data;
+	struct bt_bap *bap = read->bap;
 
 	if (!success) {
 		DBG(bap, "Unable to read Sink PAC: error 0x%02x", att_ecode);
 		return;
 	}
 
-	bap_parse_pacs(bap, BT_BAP_SINK, bap->rdb->sinks, value, length);
+	bap_read_pacs_value(read, PAC_SINK_CHRC_UUID, value, length);
 }
 
 static void read_source_pac_loc(bool success, uint8_t att_ecode,
 					const uint8_t *value, uint16_t length,
 					void *user_data)
 {
-	struct bt_bap *bap = user_data;
+	struct bap_pacs_read *read = user_data;
+	struct bt_bap *bap = read->bap;
 	struct bt_pacs *pacs = bap_get_pacs(bap);
 
 	if (!success) {
@@ -4976,14 +5193,8 @@ static void read_source_pac_loc(bool success, uint8_t att_ecode,
 		return;
 	}
 
-	if (length != sizeof(uint32_t)) {
-		DBG(bap, "Invalid Source PAC Location size: %d", length);
+	if (!bap_read_pacs_value(read, PAC_SOURCE_LOC_CHRC_UUID, value, length))
 		return;
-	}
-
-	pacs->source_loc_value = get_le32(value);
-
-	DBG(bap, "PACS Source Locations: 0x%08x", pacs->source_loc_value);
 
 	/* Resume reading sinks if supported but for some reason is empty */
 	if (pacs->source && queue_isempty(bap->rdb->sources)) {
@@ -4992,9 +5203,8 @@ static void read_source_pac_loc(bool success, uint8_t att_ecode,
 		if (gatt_db_attribute_get_char_data(pacs->source,
 						NULL, &value_handle,
 						NULL, NULL, NULL))
-			bt_gatt_client_read_value(bap->client, value_handle,
-							read_source_pac, bap,
-							NULL);
+			bap_pacs_read(bap, value_handle, read_source_pac,
+							read->revalidate);
 	}
 }
 
@@ -5002,7 +5212,8 @@ static void read_sink_pac_loc(bool success, uint8_t att_ecode,
 				const uint8_t *value, uint16_t length,
 				void *user_data)
 {
-	struct bt_bap *bap = user_data;
+	struct bap_pacs_read *read = user_data;
+	struct bt_bap *bap = read->bap;
 	struct bt_pacs *pacs = bap_get_pacs(bap);
 
 	if (!success) {
@@ -5011,14 +5222,8 @@ static void read_sink_pac_loc(bool success, uint8_t att_ecode,
 		return;
 	}
 
-	if (length != sizeof(uint32_t)) {
-		DBG(bap, "Invalid Sink PAC Location size: %d", length);
+	if (!bap_read_pacs_value(read, PAC_SINK_LOC_CHRC_UUID, value, length))
 		return;
-	}
-
-	pacs->sink_loc_value = get_le32(value);
-
-	DBG(bap, "PACS Sink Locations: 0x%08x", pacs->sink_loc_value);
 
 	/* Resume reading sinks if supported but for some reason is empty */
 	if (pacs->sink && queue_isempty(bap->rdb->sinks)) {
@@ -5027,9 +5232,8 @@ static void read_sink_pac_loc(bool success, uint8_t att_ecode,
 		if (gatt_db_attribute_get_char_data(pacs->sink,
 						NULL, &value_handle,
 						NULL, NULL, NULL))
-			bt_gatt_client_read_value(bap->client, value_handle,
-							read_sink_pac, bap,
-							NULL);
+			bap_pacs_read(bap, value_handle, read_sink_pac,
+							read->revalidate);
 	}
 }
 
@@ -5037,34 +5241,23 @@ static void read_pac_context(bool success, uint8_t att_ecode,
 				const uint8_t *value, uint16_t length,
 				void *user_data)
 {
-	struct bt_bap *bap = user_data;
-	struct bt_pacs *pacs = bap_get_pacs(bap);
-	const struct bt_pacs_context *ctx = (void *)value;
+	struct bap_pacs_read *read = user_data;
+	struct bt_bap *bap = read->bap;
 
 	if (!success) {
 		DBG(bap, "Unable to read PAC Context: error 0x%02x", att_ecode);
 		return;
 	}
 
-	if (length != sizeof(*ctx)) {
-		DBG(bap, "Invalid PAC Context size: %d", length);
-		return;
-	}
-
-	pacs->sink_context_value = le16_to_cpu(ctx->snk);
-	pacs->source_context_value = le16_to_cpu(ctx->src);
-
-	DBG(bap, "PACS Sink Context: 0x%04x", pacs->sink_context_value);
-	DBG(bap, "PACS Source Context: 0x%04x", pacs->source_context_value);
+	bap_read_pacs_value(read, PAC_CONTEXT, value, length);
 }
 
 static void read_pac_supported_context(bool success, uint8_t att_ecode,
 					const uint8_t *value, uint16_t length,
 					void *user_data)
 {
-	struct bt_bap *bap = user_data;
-	struct bt_pacs *pacs = bap_get_pacs(bap);
-	const struct bt_pacs_context *ctx = (void *)value;
+	struct bap_pacs_read *read = user_data;
+	struct bt_bap *bap = read->bap;
 
 	if (!success) {
 		DBG(bap, "Unable to read PAC Supported Context: error 0x%02x",
@@ -5072,18 +5265,19 @@ static void read_pac_supported_context(bool success, uint8_t att_ecode,
 		return;
 	}
 
-	if (length != sizeof(*ctx)) {
-		DBG(bap, "Invalid PAC Supported Context size: %d", length);
-		return;
-	}
+	bap_read_pacs_value(read, PAC_SUPPORTED_CONTEXT, value, length);
+}
 
-	pacs->supported_sink_context_value = le16_to_cpu(ctx->snk);
-	pacs->supported_source_context_value = le16_to_cpu(ctx->src);
+/* Read the value of a PACS characteristic unless it has been restored, in
+ * which case it is revalidated once the session is ready.
+ */
+static void bap_read_pacs(struct bt_bap *bap, uint16_t value_handle,
+					bt_gatt_client_read_callback_t func)
+{
+	if (bap->pacs_restored)
+		return;
 
-	DBG(bap, "PACS Supported Sink Context: 0x%04x",
-					pacs->supported_sink_context_value);
-	DBG(bap, "PACS Supported Source Context: 0x%04x",
-					pacs->supported_source_context_value);
+	bap_pacs_read(bap, value_handle, func, false);
 }
 
 static void foreach_pacs_char(struct gatt_db_attribute *attr, void *user_data)
@@ -5115,8 +5309,7 @@ static void foreach_pacs_char(struct gatt_db_attribute *attr, void *user_data)
 		if (!pacs->sink)
 			pacs->sink = attr;
 
-		bt_gatt_client_read_value(bap->client, value_handle,
-						read_sink_pac, bap, NULL);
+		bap_read_pacs(bap, value_handle, read_sink_pac);
 	}
 
 	if (!bt_uuid_cmp(&uuid, &uuid_source)) {
@@ -5129,8 +5322,7 @@ static void foreach_pacs_char(struct gatt_db_attribute *attr, void *user_data)
 		if (!pacs->source)
 			pacs->source = attr;
 
-		bt_gatt_client_read_value(bap->client, value_handle,
-						read_source_pac, bap, NULL);
+		bap_read_pacs(bap, value_handle, read_source_pac);
 	}
 
 	if (!bt_uuid_cmp(&uuid, &uuid_sink_loc)) {
@@ -5142,8 +5334,7 @@ static void foreach_pacs_char(struct gatt_db_attribute *attr, void *user_data)
 			return;
 
 		pacs->sink_loc = attr;
-		bt_gatt_client_read_value(bap->client, value_handle,
-						read_sink_pac_loc, bap, NULL);
+		bap_read_pacs(bap, value_handle, read_sink_pac_loc);
 	}
 
 	if (!bt_uuid_cmp(&uuid, &uuid_source_loc)) {
@@ -5155,8 +5346,7 @@ static void foreach_pacs_char(struct gatt_db_attribute *attr, void *user_data)
 			return;
 
 		pacs->source_loc = attr;
-		bt_gatt_client_read_value(bap->client, value_handle,
-						read_source_pac_loc, bap, NULL);
+		bap_read_pacs(bap, value_handle, read_source_pac_loc);
 	}
 
 	if (!bt_uuid_cmp(&uuid, &uuid_context)) {
@@ -5167,8 +5357,7 @@ static void foreach_pacs_char(struct gatt_db_attribute *attr, void *user_data)
 			return;
 
 		pacs->context = attr;
-		bt_gatt_client_read_value(bap->client, value_handle,
-						read_pac_context, bap, NULL);
+		bap_read_pacs(bap, value_handle, read_pac_context);
 	}
 
 	if (!bt_uuid_cmp(&uuid, &uuid_supported_context)) {
@@ -5180,9 +5369,8 @@ static void foreach_pacs_char(struct gatt_db_attribute *attr, void *user_data)
 			return;
 
 		pacs->supported_context = attr;
-		bt_gatt_client_read_value(bap->client, value_handle,
-						read_pac_supported_context,
-						bap, NULL);
+		bap_read_pacs(bap, value_handle,
+						read_pac_supported_context);
 	}
 }
 
@@ -5676,13 +5864,113 @@ static void bap_attach_att(struct bt_bap *bap, struct bt_att *att)
 							bap, NULL);
 }
 
+static void foreach_pacs_revalidate(struct gatt_db_attribute *attr,
+							void *user_data)
+{
+	struct bt_bap *bap = user_data;
+	bt_gatt_client_read_callback_t func;
+	uint16_t value_handle;
+	bt_uuid_t uuid, uuid16;
+
+	if (!gatt_db_attribute_get_char_data(attr, NULL, &value_handle,
+						NULL, NULL, &uuid))
+		return;
+
+	bt_uuid16_create(&uuid16, PAC_SINK_CHRC_UUID);
+	if (!bt_uuid_cmp(&uuid, &uuid16)) {
+		func = read_sink_pac;
+		goto done;
+	}
+
+	bt_uuid16_create(&uuid16, PAC_SOURCE_CHRC_UUID);
+	if (!bt_uuid_cmp(&uuid, &uuid16)) {
+		func = read_source_pac;
+		goto done;
+	}
+
+	bt_uuid16_create(&uuid16, PAC_SINK_LOC_CHRC_UUID);
+	if (!bt_uuid_cmp(&uuid, &uuid16)) {
+		func = read_sink_pac_loc;
+		goto done;
+	}
+
+	bt_uuid16_create(&uuid16, PAC_SOURCE_LOC_CHRC_UUID);
+	if (!bt_uuid_cmp(&uuid, &uuid16)) {
+		func = read_source_pac_loc;
+		goto done;
+	}
+
+	bt_uuid16_create(&uuid16, PAC_CONTEXT);
+	if (!bt_uuid_cmp(&uuid, &uuid16)) {
+		func = read_pac_context;
+		goto done;
+	}
+
+	bt_uuid16_create(&uuid16, PAC_SUPPORTED_CONTEXT);
+	if (bt_uuid_cmp(&uuid, &uuid16))
+		return;
+
+	func = read_pac_supported_context;
+
+done:
+	DBG(bap, "Revalidating PACS handle 0x%04x", value_handle);
+
+	bap_pacs_read(bap, value_handle, func, true);
+}
+
+static void pac_set_stale(void *data, void *user_data)
+{
+	struct bt_bap_pac *pac = data;
+
+	pac->stale = true;
+}
+
+static void bap_revalidate_pacs(struct bt_bap *bap)
+{
+	struct bt_pacs *pacs = bap->rdb->pacs;
+
+	bap->pacs_restored = false;
+
+	if (!pacs || !pacs->service || !bap->client)
+		return;
+
+	/* Restored records are replaced by the values read, or dropped if
+	 * no longer present.
+	 */
+	queue_foreach(bap->rdb->sinks, pac_set_stale, NULL);
+	queue_foreach(bap->rdb->sources, pac_set_stale, NULL);
+	bap->pacs_revalidating = 0;
+	bap->pacs_keep = false;
+
+	gatt_db_service_foreach_char(pacs->service, foreach_pacs_revalidate,
+									bap);
+
+	/* Nothing could be read so keep what was restored */
+	if (!bap->pacs_revalidating) {
+		queue_foreach(bap->rdb->sinks, pac_clear_stale, NULL);
+		queue_foreach(bap->rdb->sources, pac_clear_stale, NULL);
+	}
+}
+
 static void bap_idle(void *data)
 {
 	struct bt_bap *bap = data;
 
 	bap->idle_id = 0;
 
+	if (!bt_bap_ref_safe(bap))
+		return;
+
 	bap_notify_ready(bap);
+
+	/* Values restored from a previous connection have been used to get
+	 * the session ready, now read them again in the background in case
+	 * they changed while disconnected.
+	 */
+	if (bap->pacs_restored)
+		bap_revalidate_pacs(bap);
+
+	bt_bap_unref(bap);
 }
 
 bool bt_bap_attach(struct bt_bap *bap, struct bt_gatt_client *client)
@@ -5724,7 +6012,8 @@ clone:
 	bap->idle_id = bt_gatt_client_idle_register(bap->client, bap_idle,
 								bap, NULL);
 
-	if (bap->rdb->pacs) {
+	/* PACS may exist without service if values were only restored */
+	if (bap->rdb->pacs && bap->rdb->pacs->service) {
 		uint16_t value_handle;
 		struct bt_pacs *pacs = bap->rdb->pacs;
 
@@ -5733,10 +6022,8 @@ clone:
 			if (gatt_db_attribute_get_char_data(pacs->sink,
 							NULL, &value_handle,
 							NULL, NULL, NULL)) {
-				bt_gatt_client_read_value(bap->client,
-							value_handle,
-							read_sink_pac,
-							bap, NULL);
+				bap_pacs_read(bap, value_handle,
+						read_sink_pac, false);
 			}
 		}
 
@@ -5745,10 +6032,8 @@ clone:
 			if (gatt_db_attribute_get_char_data(pacs->sink_loc,
 							NULL, &value_handle,
 							NULL, NULL, NULL)) {
-				bt_gatt_client_read_value(bap->client,
-							value_handle,
-							read_sink_pac_loc,
-							bap, NULL);
+				bap_pacs_read(bap, value_handle,
+						read_sink_pac_loc, false);
 			}
 		}
 
@@ -5757,10 +6042,8 @@ clone:
 			if (gatt_db_attribute_get_char_data(pacs->source,
 							NULL, &value_handle,
 							NULL, NULL, NULL)) {
-				bt_gatt_client_read_value(bap->client,
-							value_handle,
-							read_source_pac,
-							bap, NULL);
+				bap_pacs_read(bap, value_handle,
+						read_source_pac, false);
 			}
 		}
 
@@ -5770,10 +6053,8 @@ clone:
 			if (gatt_db_attribute_get_char_data(pacs->source_loc,
 							NULL, &value_handle,
 							NULL, NULL, NULL)) {
-				bt_gatt_client_read_value(bap->client,
-							value_handle,
-							read_source_pac_loc,
-							bap, NULL);
+				bap_pacs_read(bap, value_handle,
+						read_source_pac_loc, false);
 			}
 		}
 
@@ -5785,10 +6066,9 @@ clone:
 							pacs->supported_context,
 							NULL, &value_handle,
 							NULL, NULL, NULL)) {
-				bt_gatt_client_read_value(bap->client,
-						value_handle,
+				bap_pacs_read(bap, value_handle,
 						read_pac_supported_context,
-						bap, NULL);
+						false);
 			}
 		}
 
@@ -5799,10 +6079,8 @@ clone:
 			if (gatt_db_attribute_get_char_data(pacs->context,
 							NULL, &value_handle,
 							NULL, NULL, NULL)) {
-				bt_gatt_client_read_value(bap->client,
-							value_handle,
-							read_pac_context,
-							bap, NULL);
+				bap_pacs_read(bap, value_handle,
+						read_pac_context, false);
 			}
 		}
 
@@ -5822,6 +6100,42 @@ clone:
 	return true;
 }
 
+bool bt_bap_set_pacs_func(struct bt_bap *bap, bt_bap_pacs_func_t func,
+							void *user_data)
+{
+	if (!bap)
+		return false;
+
+	bap->pacs_func = func;
+	bap->pacs_data = user_data;
+
+	return true;
+}
+
+bool bt_bap_restore_pacs(struct bt_bap *bap, uint16_t uuid,
+					const uint8_t *value, uint16_t length)
+{
+	if (!bap || !bap->rdb || bap->client)
+		return false;
+
+	/* On reconnection the records of the previous connection are still
+	 * known, so just have them revalidated once the session is ready.
+	 */
+	if (bap->rdb->pacs && bap->rdb->pacs->service) {
+		bap->pacs_restored = true;
+		return true;
+	}
+
+	DBG(bap, "uuid 0x%04x len %u", uuid, length);
+
+	if (!bap_parse_pacs_value(bap, uuid, value, length))
+		return false;
+
+	bap->pacs_restored = true;
+
+	return true;
+}
+
 bool bt_bap_attach_broadcast(struct bt_bap *bap)
 {
 	struct bt_bap_endpoint *ep;
@@ -5879,6 +6193,13 @@ void bt_bap_detach(struct bt_bap *bap)
 	bt_gatt_client_unref(bap->client);
 	bap->client = NULL;
 
+	/* Revalidation reads have been cancelled, keep what is known */
+	if (bap->pacs_revalidating) {
+		bap->pacs_revalidating = 0;
+		queue_foreach(bap->rdb->sinks, pac_clear_stale, NULL);
+		queue_foreach(bap->rdb->sources, pac_clear_stale, NULL);
+	}
+
 	bt_att_unregister_disconnect(bap->att, bap->disconn_id);
 	bap->att = NULL;
 
@@ -39,6 +39,9 @@ typedef void (*bt_bap_stream_func_t)(struct bt_bap_stream *stream,
 					uint8_t code, uint8_t reason,
 					void *user_data);
 typedef void (*bt_bap_func_t)(struct bt_bap *bap, void *user_data);
+typedef void (*bt_bap_pacs_func_t)(struct bt_bap *bap, uint16_t handle,
+					uint16_t uuid, const uint8_t *value,
+					uint16_t length, void *user_data);
 
 typedef void (*bt_bap_bis_func_t)(uint8_t sid, uint8_t bis, uint8_t sgrp,
 				struct iovec *caps, struct iovec *meta,
@@ -143,6 +146,10 @@ struct bt_bap *bt_bap_ref(struct bt_bap *bap);
 void bt_bap_unref(struct bt_bap *bap);
 
 bool bt_bap_attach(struct bt_bap *bap, struct bt_gatt_client *client);
+bool bt_bap_set_pacs_func(struct bt_bap *bap, bt_bap_pacs_func_t func,
+							void *user_data);
+bool bt_bap_restore_pacs(struct bt_bap *bap, uint16_t uuid,
+					const uint8_t *value, uint16_t length);
 bool bt_bap_attach_broadcast(struct bt_bap *bap);
 void bt_bap_detach(struct bt_bap *bap);
 
@@ -788,6 +788,94 @@ bool bt_crypto_sih(struct bt_crypto *crypto, const uint8_t k[16],
 	return bt_crypto_ah(crypto, k, r, hash);
 }
 
+struct bt_crypto_key {
+	struct bt_crypto *crypto;
+	int fd;
+};
+
+/*
+ * Keyed security function e
+ *
+ * bt_crypto_e sets up a new AES-128 key on every call, which dominates the
+ * cost when the same key is used over and over again, e.g. when resolving
+ * RSIs against each known SIRK. A bt_crypto_key keeps the keyed operation
+ * socket around so that each encryption is a single sendmsg/read pair.
+ */
+struct bt_crypto_key *bt_crypto_key_new(struct bt_crypto *crypto,
+						const uint8_t key[16])
+{
+	struct bt_crypto_key *k;
+	uint8_t tmp[16];
+	int fd;
+
+	if (!crypto)
+		return NULL;
+
+	/* The most significant octet of key corresponds to key[0] */
+	swap_buf(key, tmp, 16);
+
+	fd = alg_new(crypto->ecb_aes, tmp, 16);
+	if (fd < 0)
+		return NULL;
+
+	k = new0(struct bt_crypto_key, 1);
+	k->crypto = bt_crypto_ref(crypto);
+	k->fd = fd;
+
+	return k;
+}
+
+void bt_crypto_key_free(struct bt_crypto_key *key)
+{
+	if (!key)
+		return;
+
+	close(key->fd);
+	bt_crypto_unref(key->crypto);
+	free(key);
+}
+
+bool bt_crypto_key_e(struct bt_crypto_key *key, const uint8_t plaintext[16],
+						uint8_t encrypted[16])
+{
+	uint8_t in[16], out[16];
+
+	if (!key)
+		return false;
+
+	/* Most significant octet of plaintextData corresponds to in[0] */
+	swap_buf(plaintext, in, 16);
+
+	if (!alg_encrypt(key->fd, in, 16, out, 16))
+		return false;
+
+	/* Most significant octet of encryptedData corresponds to out[0] */
+	swap_buf(out, encrypted, 16);
+
+	return true;
+}
+
+/* sih(k, r) using a pre-keyed context, see bt_crypto_sih */
+bool bt_crypto_key_sih(struct bt_crypto_key *key, const uint8_t r[3],
+							uint8_t hash[3])
+{
+	uint8_t rp[16];
+	uint8_t encrypted[16];
+
+	/* r' = padding || r */
+	memcpy(rp, r, 3);
+	memset(rp + 3, 0, 13);
+
+	/* e(k, r') */
+	if (!bt_crypto_key_e(key, rp, encrypted))
+		return false;
+
+	/* sih(k, r) = e(k, r') mod 2^24 */
+	memcpy(hash, encrypted, 3);
+
+	return true;
+}
+
 /*
  * The hash is generated by using the RSI hash function sih, with the input
  * parameter k set to the device’s SIRK, and the input parameter r set to
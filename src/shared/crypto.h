@@ -13,6 +13,7 @@
 #include <sys/uio.h>
 
 struct bt_crypto;
+struct bt_crypto_key;
 
 struct bt_crypto *bt_crypto_new(void);
 
@@ -62,3 +63,11 @@ bool bt_crypto_sirk(struct bt_crypto *crypto, const char *str, uint16_t vendor,
 			uint8_t sirk[16]);
 bool bt_crypto_rsi(struct bt_crypto *crypto, const uint8_t sirk[16],
 					uint8_t rsi[6]);
+
+struct bt_crypto_key *bt_crypto_key_new(struct bt_crypto *crypto,
+						const uint8_t key[16]);
+void bt_crypto_key_free(struct bt_crypto_key *key);
+bool bt_crypto_key_e(struct bt_crypto_key *key, const uint8_t plaintext[16],
+						uint8_t encrypted[16]);
+bool bt_crypto_key_sih(struct bt_crypto_key *key, const uint8_t r[3],
+							uint8_t hash[3]);
@@ -0,0 +1,391 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "bluetooth/bluetooth.h"
+
+#include "src/shared/util.h"
+#include "src/shared/rap.h"
+#include "src/shared/cs-dist.h"
+
+/* CS channels 0 to 78 are spaced 1 MHz apart, padded to a multiple of 4 */
+#define CS_DIST_CHANNELS		80
+#define CS_DIST_MAX_CHANNEL		78
+#define CS_DIST_MAX_PATHS		4
+#define CS_DIST_MAX_RTT			256
+
+#define CS_DIST_SPEED_OF_LIGHT		299792458.0
+#define CS_DIST_CHANNEL_SPACING		1000000.0
+#define CS_DIST_PI			3.14159265358979323846
+
+/* Phase slope estimates below this coherence are considered noise */
+#define CS_DIST_MIN_QUALITY		0.2
+
+/* Tone quality indicator: 0 high, 1 medium, 2 low, 3 unavailable */
+#define CS_TONE_QUALITY_MASK		0x03
+#define CS_TONE_QUALITY_MEDIUM		0x01
+
+/* Packet quality: lower nibble 0 when the access address matched */
+#define CS_PACKET_QUALITY_MASK		0x0f
+
+struct cs_dist_step {
+	uint8_t mode;
+	uint8_t channel;
+	bool rtt_valid;
+	int16_t time;
+	uint8_t tone_mask;
+	int16_t tone_i[CS_DIST_MAX_PATHS];
+	int16_t tone_q[CS_DIST_MAX_PATHS];
+};
+
+struct cs_dist_queue {
+	struct cs_dist_step *steps;
+	unsigned int len;
+	unsigned int size;
+};
+
+struct bt_cs_dist {
+	/* Steps reported by one side but not yet by the other */
+	struct cs_dist_queue pending[2];
+
+	/* Sum of the initiator and reflector tone products per antenna path
+	 * and channel. Real and imaginary parts are kept in separate arrays
+	 * so the estimation loops run over contiguous floats.
+	 */
+	float re[CS_DIST_MAX_PATHS][CS_DIST_CHANNELS];
+	float im[CS_DIST_MAX_PATHS][CS_DIST_CHANNELS];
+	unsigned int num_tones;
+
+	int32_t rtt[CS_DIST_MAX_RTT];
+	unsigned int num_rtt;
+};
+
+struct bt_cs_dist *bt_cs_dist_new(void)
+{
+	return new0(struct bt_cs_dist, 1);
+}
+
+void bt_cs_dist_free(struct bt_cs_dist *dist)
+{
+	if (!dist)
+		return;
+
+	free(dist->pending[BT_CS_DIST_INITIATOR].steps);
+	free(dist->pending[BT_CS_DIST_REFLECTOR].steps);
+	free(dist);
+}
+
+void bt_cs_dist_reset(struct bt_cs_dist *dist)
+{
+	if (!dist)
+		return;
+
+	dist->pending[BT_CS_DIST_INITIATOR].len = 0;
+	dist->pending[BT_CS_DIST_REFLECTOR].len = 0;
+
+	memset(dist->re, 0, sizeof(dist->re));
+	memset(dist->im, 0, sizeof(dist->im));
+	dist->num_tones = 0;
+	dist->num_rtt = 0;
+}
+
+static void step_convert(struct cs_dist_step *dst,
+				const struct cs_step_data *src,
+				enum bt_cs_dist_role role, uint8_t num_paths)
+{
+	const struct cs_mode_one_data *one = NULL;
+	const struct cs_mode_two_data *two = NULL;
+	uint8_t i;
+
+	memset(dst, 0, sizeof(*dst));
+	dst->mode = src->step_mode;
+	dst->channel = src->step_chnl;
+
+	switch (src->step_mode) {
+	case CS_MODE_ONE:
+		one = &src->step_mode_data.mode_one_data;
+		break;
+	case CS_MODE_TWO:
+		two = &src->step_mode_data.mode_two_data;
+		break;
+	case CS_MODE_THREE:
+		one = &src->step_mode_data.mode_three_data.mode_one_data;
+		two = &src->step_mode_data.mode_three_data.mode_two_data;
+		break;
+	}
+
+	if (one) {
+		dst->rtt_valid = !(one->packet_quality &
+						CS_PACKET_QUALITY_MASK);
+		dst->time = role == BT_CS_DIST_INITIATOR ? one->toa_tod_init :
+							one->tod_toa_refl;
+	}
+
+	if (!two)
+		return;
+
+	for (i = 0; i < MIN(num_paths, CS_DIST_MAX_PATHS); i++) {
+		if ((two->tone_quality_indicator[i] & CS_TONE_QUALITY_MASK) >
+						CS_TONE_QUALITY_MEDIUM)
+			continue;
+
+		dst->tone_mask |= 1 << i;
+		dst->tone_i[i] = two->tone_pct[i].i_sample;
+		dst->tone_q[i] = two->tone_pct[i].q_sample;
+	}
+}
+
+static void step_fold(struct bt_cs_dist *dist, const struct cs_dist_step *a,
+					const struct cs_dist_step *b)
+{
+	uint8_t channel, mask, i;
+
+	/* Both sides report the same steps, anything else is a mismatch */
+	if (a->mode != b->mode)
+		return;
+
+	if (a->rtt_valid && b->rtt_valid && dist->num_rtt < CS_DIST_MAX_RTT)
+		dist->rtt[dist->num_rtt++] = a->time - b->time;
+
+	/* The channel is only known from the side that reported over HCI */
+	channel = a->channel <= CS_DIST_MAX_CHANNEL ? a->channel : b->channel;
+	if (channel > CS_DIST_MAX_CHANNEL)
+		return;
+
+	mask = a->tone_mask & b->tone_mask;
+
+	/* The product of both tones cancels the local oscillator offsets and
+	 * leaves the phase of the round trip at this frequency.
+	 */
+	for (i = 0; i < CS_DIST_MAX_PATHS; i++) {
+		float ai, aq, bi, bq;
+
+		if (!(mask & (1 << i)))
+			continue;
+
+		ai = a->tone_i[i];
+		aq = a->tone_q[i];
+		bi = b->tone_i[i];
+		bq = b->tone_q[i];
+
+		dist->re[i][channel] += ai * bi - aq * bq;
+		dist->im[i][channel] += ai * bq + aq * bi;
+		dist->num_tones++;
+	}
+}
+
+static bool queue_append(struct cs_dist_queue *queue,
+				const struct cs_step_data *steps,
+				uint8_t num_steps, enum bt_cs_dist_role role,
+				uint8_t num_paths)
+{
+	uint8_t i;
+
+	if (queue->len + num_steps > queue->size) {
+		unsigned int size = MAX(queue->size * 2,
+						queue->len + num_steps);
+		struct cs_dist_step *tmp;
+
+		tmp = realloc(queue->steps, size * sizeof(*tmp));
+		if (!tmp)
+			return false;
+
+		queue->steps = tmp;
+		queue->size = size;
+	}
+
+	for (i = 0; i < num_steps; i++)
+		step_convert(&queue->steps[queue->len++], &steps[i], role,
+								num_paths);
+
+	return true;
+}
+
+void bt_cs_dist_add_steps(struct bt_cs_dist *dist, enum bt_cs_dist_role role,
+				const struct cs_step_data *steps,
+				uint8_t num_steps, uint8_t num_ant_paths)
+{
+	struct cs_dist_queue *init, *refl, *rest;
+	unsigned int i, n;
+
+	if (!dist || !steps || role > BT_CS_DIST_REFLECTOR)
+		return;
+
+	if (!queue_append(&dist->pending[role], steps, num_steps, role,
+							num_ant_paths))
+		return;
+
+	init = &dist->pending[BT_CS_DIST_INITIATOR];
+	refl = &dist->pending[BT_CS_DIST_REFLECTOR];
+
+	/* Fold every step both sides have reported so far, so the work is
+	 * spread over the subevents instead of done at procedure end.
+	 */
+	n = MIN(init->len, refl->len);
+
+	for (i = 0; i < n; i++)
+		step_fold(dist, &init->steps[i], &refl->steps[i]);
+
+	rest = init->len > n ? init : refl;
+	if (rest->len > n)
+		memmove(rest->steps, rest->steps + n,
+				(rest->len - n) * sizeof(*rest->steps));
+
+	init->len -= n;
+	refl->len -= n;
+}
+
+/* Polynomial approximation with an error below 1e-5 radians, which is well
+ * under the phase noise of the measurements.
+ */
+static double cs_atan2(double y, double x)
+{
+	double ax = x < 0 ? -x : x;
+	double ay = y < 0 ? -y : y;
+	double z, z2, a;
+
+	if (ax == 0 && ay == 0)
+		return 0;
+
+	z = ay > ax ? ax / ay : ay / ax;
+	z2 = z * z;
+
+	a = z * (0.99997726 + z2 * (-0.33262347 + z2 * (0.19354346 +
+		z2 * (-0.11643287 + z2 * (0.05265332 + z2 * -0.01172120)))));
+
+	if (ay > ax)
+		a = CS_DIST_PI / 2 - a;
+
+	if (x < 0)
+		a = CS_DIST_PI - a;
+
+	return y < 0 ? -a : a;
+}
+
+static int cmp_rtt(const void *a, const void *b)
+{
+	int32_t ra = *(const int32_t *) a;
+	int32_t rb = *(const int32_t *) b;
+
+	return ra < rb ? -1 : ra > rb;
+}
+
+static bool estimate_phase(struct bt_cs_dist *dist,
+				struct bt_cs_dist_result *result)
+{
+	double sum_re = 0, sum_im = 0, power0 = 0, power1 = 0;
+	double theta, d;
+	unsigned int i, k;
+
+	/* The phase rotates by 4 pi d / c per Hz, so the product of each
+	 * channel with its lower neighbour rotates by the same angle on all
+	 * antenna paths, and summing them averages out the noise.
+	 */
+	for (i = 0; i < CS_DIST_MAX_PATHS; i++) {
+		const float *re = dist->re[i];
+		const float *im = dist->im[i];
+		float sr = 0, si = 0, p0 = 0, p1 = 0;
+
+		for (k = 0; k < CS_DIST_CHANNELS - 1; k++) {
+			float m0 = re[k] * re[k] + im[k] * im[k];
+			float m1 = re[k + 1] * re[k + 1] +
+						im[k + 1] * im[k + 1];
+			float pair = (m0 > 0) & (m1 > 0);
+
+			sr += re[k + 1] * re[k] + im[k + 1] * im[k];
+			si += im[k + 1] * re[k] - re[k + 1] * im[k];
+			p0 += pair * m0;
+			p1 += pair * m1;
+		}
+
+		sum_re += sr;
+		sum_im += si;
+		power0 += p0;
+		power1 += p1;
+	}
+
+	if (power0 <= 0 || power1 <= 0)
+		return false;
+
+	result->quality = (sum_re * sum_re + sum_im * sum_im) /
+							(power0 * power1);
+
+	theta = cs_atan2(sum_im, sum_re);
+
+	d = -theta * CS_DIST_SPEED_OF_LIGHT /
+				(4 * CS_DIST_PI * CS_DIST_CHANNEL_SPACING);
+	if (d < 0)
+		d += CS_DIST_SPEED_OF_LIGHT / (2 * CS_DIST_CHANNEL_SPACING);
+
+	result->phase_distance = d;
+
+	return result->quality >= CS_DIST_MIN_QUALITY;
+}
+
+static bool estimate_rtt(struct bt_cs_dist *dist,
+				struct bt_cs_dist_result *result)
+{
+	int32_t median;
+
+	if (!dist->num_rtt)
+		return false;
+
+	/* The median keeps a multipath outlier from skewing the estimate */
+	qsort(dist->rtt, dist->num_rtt, sizeof(*dist->rtt), cmp_rtt);
+	median = dist->rtt[dist->num_rtt / 2];
+
+	/* Time is reported in units of 0.5 ns and covers the round trip */
+	result->rtt_distance = MAX(0, median) * 0.5e-9 *
+						CS_DIST_SPEED_OF_LIGHT / 2;
+
+	return true;
+}
+
+bool bt_cs_dist_estimate(struct bt_cs_dist *dist,
+				struct bt_cs_dist_result *result)
+{
+	double ambiguity, n;
+	bool phase, rtt;
+
+	if (!dist || !result)
+		return false;
+
+	memset(result, 0, sizeof(*result));
+	result->num_tones = dist->num_tones;
+	result->num_rtt = dist->num_rtt;
+
+	phase = estimate_phase(dist, result);
+	rtt = estimate_rtt(dist, result);
+
+	if (!phase) {
+		result->distance = result->rtt_distance;
+		return rtt;
+	}
+
+	result->distance = result->phase_distance;
+
+	if (!rtt)
+		return true;
+
+	/* Phase based ranging wraps every c / 2 df, use the coarser round
+	 * trip time estimate to pick the right interval.
+	 */
+	ambiguity = CS_DIST_SPEED_OF_LIGHT / (2 * CS_DIST_CHANNEL_SPACING);
+	n = (result->rtt_distance - result->phase_distance) / ambiguity;
+
+	if (n >= 0.5)
+		result->distance += (unsigned int) (n + 0.5) * ambiguity;
+
+	return true;
+}
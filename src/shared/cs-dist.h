@@ -0,0 +1,38 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct bt_cs_dist;
+struct cs_step_data;
+
+enum bt_cs_dist_role {
+	BT_CS_DIST_INITIATOR,
+	BT_CS_DIST_REFLECTOR,
+};
+
+struct bt_cs_dist_result {
+	double distance;	/* Combined estimate in meters */
+	double phase_distance;	/* Phase based ranging estimate in meters */
+	double rtt_distance;	/* Round trip time estimate in meters */
+	double quality;		/* Phase coherence across channels, 0 to 1 */
+	unsigned int num_tones;
+	unsigned int num_rtt;
+};
+
+struct bt_cs_dist *bt_cs_dist_new(void);
+void bt_cs_dist_free(struct bt_cs_dist *dist);
+void bt_cs_dist_reset(struct bt_cs_dist *dist);
+
+void bt_cs_dist_add_steps(struct bt_cs_dist *dist, enum bt_cs_dist_role role,
+				const struct cs_step_data *steps,
+				uint8_t num_steps, uint8_t num_ant_paths);
+
+bool bt_cs_dist_estimate(struct bt_cs_dist *dist,
+				struct bt_cs_dist_result *result);
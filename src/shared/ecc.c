@@ -109,50 +109,22 @@ static bool vli_is_zero(const uint64_t *vli)
 	return true;
 }
 
-/* Returns nonzero if bit bit of vli is set. */
-static uint64_t vli_test_bit(const uint64_t *vli, unsigned int bit)
-{
-	return (vli[bit / 64] & ((uint64_t) 1 << (bit % 64)));
-}
-
-/* Counts the number of 64-bit "digits" in vli. */
-static unsigned int vli_num_digits(const uint64_t *vli)
+/* Sets dest = src. */
+static void vli_set(uint64_t *dest, const uint64_t *src)
 {
 	int i;
 
-	/* Search from the end until we find a non-zero digit.
-	 * We do it in reverse because we expect that most digits will
-	 * be nonzero.
-	 */
-	for (i = NUM_ECC_DIGITS - 1; i >= 0 && vli[i] == 0; i--);
-
-	return (i + 1);
-}
-
-/* Counts the number of bits required for vli. */
-static unsigned int vli_num_bits(const uint64_t *vli)
-{
-	unsigned int i, num_digits;
-	uint64_t digit;
-
-	num_digits = vli_num_digits(vli);
-	if (num_digits == 0)
-		return 0;
-
-	digit = vli[num_digits - 1];
-	for (i = 0; digit; i++)
-		digit >>= 1;
-
-	return ((num_digits - 1) * 64 + i);
+	for (i = 0; i < NUM_ECC_DIGITS; i++)
+		dest[i] = src[i];
 }
 
-/* Sets dest = src. */
-static void vli_set(uint64_t *dest, const uint64_t *src)
+/* Sets dest = src if mask is all ones, leaves dest as is if it is zero. */
+static void vli_select(uint64_t *dest, const uint64_t *src, uint64_t mask)
 {
 	int i;
 
 	for (i = 0; i < NUM_ECC_DIGITS; i++)
-		dest[i] = src[i];
+		dest[i] ^= (dest[i] ^ src[i]) & mask;
 }
 
 /* Returns sign of left - right. */
@@ -228,8 +200,7 @@ static uint64_t vli_add(uint64_t *result, const uint64_t *left,
 		uint64_t sum;
 
 		sum = left[i] + right[i] + carry;
-		if (sum != left[i])
-			carry = (sum < left[i]);
+		carry = (sum < left[i]) | ((sum == left[i]) & carry);
 
 		result[i] = sum;
 	}
@@ -248,8 +219,7 @@ static uint64_t vli_sub(uint64_t *result, const uint64_t *left,
 		uint64_t diff;
 
 		diff = left[i] - right[i] - borrow;
-		if (diff != left[i])
-			borrow = (diff > left[i]);
+		borrow = (diff > left[i]) | ((diff == left[i]) & borrow);
 
 		result[i] = diff;
 	}
@@ -259,6 +229,18 @@ static uint64_t vli_sub(uint64_t *result, const uint64_t *left,
 
 static uint128_t mul_64_64(uint64_t left, uint64_t right)
 {
+#ifdef __SIZEOF_INT128__
+	/* Lets the compiler use the native 64x64 multiply, which on 64-bit
+	 * ARM and x86 is one or two instructions.
+	 */
+	unsigned __int128 product = (unsigned __int128) left * right;
+	uint128_t result;
+
+	result.m_low = product;
+	result.m_high = product >> 64;
+
+	return result;
+#else
 	uint64_t a0 = left & 0xffffffffull;
 	uint64_t a1 = left >> 32;
 	uint64_t b0 = right & 0xffffffffull;
@@ -280,6 +262,7 @@ static uint128_t mul_64_64(uint64_t left, uint64_t right)
 	result.m_high = m3 + (m2 >> 32);
 
 	return result;
+#endif
 }
 
 static uint128_t add_128_128(uint128_t a, uint128_t b)
@@ -373,15 +356,16 @@ static void vli_square(uint64_t *result, const uint64_t *left)
 static void vli_mod_add(uint64_t *result, const uint64_t *left,
 				const uint64_t *right, const uint64_t *mod)
 {
-	uint64_t carry;
+	uint64_t tmp[NUM_ECC_DIGITS];
+	uint64_t carry, borrow;
 
 	carry = vli_add(result, left, right);
+	borrow = vli_sub(tmp, result, mod);
 
-	/* result > mod (result = mod + remainder), so subtract mod to
-	 * get remainder.
+	/* result >= mod (result = mod + remainder), so take the remainder.
+	 * It is always computed so the timing doesn't depend on the inputs.
 	 */
-	if (carry || vli_cmp(result, mod) >= 0)
-		vli_sub(result, result, mod);
+	vli_select(result, tmp, 0 - (carry | !borrow));
 }
 
 /* Computes result = (left - right) % mod.
@@ -390,14 +374,15 @@ static void vli_mod_add(uint64_t *result, const uint64_t *left,
 static void vli_mod_sub(uint64_t *result, const uint64_t *left,
 				const uint64_t *right, const uint64_t *mod)
 {
+	uint64_t tmp[NUM_ECC_DIGITS];
 	uint64_t borrow = vli_sub(result, left, right);
 
 	/* In this case, p_result == -diff == (max int) - diff.
 	 * Since -x % d == d - x, we can get the correct result from
 	 * result + mod (with overflow).
 	 */
-	if (borrow)
-		vli_add(result, result, mod);
+	vli_add(tmp, result, mod);
+	vli_select(result, tmp, 0 - borrow);
 }
 
 /* Computes result = product % curve_p
@@ -583,52 +568,34 @@ static bool ecc_point_is_zero(const struct ecc_point *point)
 	return (vli_is_zero(point->x) && vli_is_zero(point->y));
 }
 
-/* Point multiplication algorithm using Montgomery's ladder with co-Z
- * coordinates. From http://eprint.iacr.org/2011/338.pdf
+/* Point in Jacobian coordinates, standing for (x / z^2, y / z^3). The point
+ * at infinity has z = 0.
  */
+struct ecc_jacobian {
+	uint64_t x[NUM_ECC_DIGITS];
+	uint64_t y[NUM_ECC_DIGITS];
+	uint64_t z[NUM_ECC_DIGITS];
+};
 
-/* Double in place */
-static void ecc_point_double_jacobian(uint64_t *x1, uint64_t *y1, uint64_t *z1)
-{
-	/* t1 = x, t2 = y, t3 = z */
-	uint64_t t4[NUM_ECC_DIGITS];
-	uint64_t t5[NUM_ECC_DIGITS];
-
-	if (vli_is_zero(z1))
-		return;
+/* The scalar multiplications below only ever branch on public values. Which
+ * table entry gets added, and whether either side of an addition is the
+ * point at infinity, is resolved with masks.
+ */
 
-	vli_mod_square_fast(t4, y1);   /* t4 = y1^2 */
-	vli_mod_mult_fast(t5, x1, t4); /* t5 = x1*y1^2 = A */
-	vli_mod_square_fast(t4, t4);   /* t4 = y1^4 */
-	vli_mod_mult_fast(y1, y1, z1); /* t2 = y1*z1 = z3 */
-	vli_mod_square_fast(z1, z1);   /* t3 = z1^2 */
-
-	vli_mod_add(x1, x1, z1, curve_p); /* t1 = x1 + z1^2 */
-	vli_mod_add(z1, z1, z1, curve_p); /* t3 = 2*z1^2 */
-	vli_mod_sub(z1, x1, z1, curve_p); /* t3 = x1 - z1^2 */
-	vli_mod_mult_fast(x1, x1, z1);    /* t1 = x1^2 - z1^4 */
-
-	vli_mod_add(z1, x1, x1, curve_p); /* t3 = 2*(x1^2 - z1^4) */
-	vli_mod_add(x1, x1, z1, curve_p); /* t1 = 3*(x1^2 - z1^4) */
-	if (vli_test_bit(x1, 0)) {
-		uint64_t carry = vli_add(x1, x1, curve_p);
-		vli_rshift1(x1);
-		x1[NUM_ECC_DIGITS - 1] |= carry << 63;
-	} else {
-		vli_rshift1(x1);
-	}
-	/* t1 = 3/2*(x1^2 - z1^4) = B */
+/* Returns all ones if left == right, zero otherwise. */
+static uint64_t ct_mask_equal(uint64_t left, uint64_t right)
+{
+	uint64_t diff = left ^ right;
 
-	vli_mod_square_fast(z1, x1);      /* t3 = B^2 */
-	vli_mod_sub(z1, z1, t5, curve_p); /* t3 = B^2 - A */
-	vli_mod_sub(z1, z1, t5, curve_p); /* t3 = B^2 - 2A = x3 */
-	vli_mod_sub(t5, t5, z1, curve_p); /* t5 = A - x3 */
-	vli_mod_mult_fast(x1, x1, t5);    /* t1 = B * (A - x3) */
-	vli_mod_sub(t4, x1, t4, curve_p); /* t4 = B * (A - x3) - y1^4 = y3 */
+	return ((diff | (0 - diff)) >> 63) - 1;
+}
 
-	vli_set(x1, z1);
-	vli_set(z1, y1);
-	vli_set(y1, t4);
+static void jacobian_select(struct ecc_jacobian *dest,
+				const struct ecc_jacobian *src, uint64_t mask)
+{
+	vli_select(dest->x, src->x, mask);
+	vli_select(dest->y, src->y, mask);
+	vli_select(dest->z, src->z, mask);
 }
 
 /* Modify (x1, y1) => (x1 * z^2, y1 * z^3) */
@@ -642,132 +609,336 @@ static void apply_z(uint64_t *x1, uint64_t *y1, uint64_t *z)
 	vli_mod_mult_fast(y1, y1, t1); /* y1 * z^3 */
 }
 
-/* P = (x1, y1) => 2P, (x2, y2) => P' */
-static void xycz_initial_double(uint64_t *x1, uint64_t *y1, uint64_t *x2,
-					uint64_t *y2, uint64_t *p_initial_z)
+static void jacobian_to_affine(struct ecc_point *result,
+					const struct ecc_jacobian *point)
 {
 	uint64_t z[NUM_ECC_DIGITS];
+	uint64_t t[NUM_ECC_DIGITS];
+
+	/* The point at infinity comes out as (0, 0) */
+	vli_mod_inv(z, point->z, curve_p);	/* 1 / z */
+	vli_mod_square_fast(t, z);		/* 1 / z^2 */
+	vli_mod_mult_fast(result->x, point->x, t);
+	vli_mod_mult_fast(t, t, z);		/* 1 / z^3 */
+	vli_mod_mult_fast(result->y, point->y, t);
+}
 
-	vli_set(x2, x1);
-	vli_set(y2, y1);
-
-	vli_clear(z);
-	z[0] = 1;
-
-	if (p_initial_z)
-		vli_set(z, p_initial_z);
+/* Computes result = 2 * point using a = -3, "dbl-2001-b" from
+ * https://hyperelliptic.org/EFD/g1p/auto-shortw-jacobian-3.html
+ * Can modify in place. The point at infinity doubles to itself.
+ */
+static void jacobian_double(struct ecc_jacobian *result,
+					const struct ecc_jacobian *point)
+{
+	uint64_t delta[NUM_ECC_DIGITS];
+	uint64_t gamma[NUM_ECC_DIGITS];
+	uint64_t beta[NUM_ECC_DIGITS];
+	uint64_t alpha[NUM_ECC_DIGITS];
+	uint64_t t[NUM_ECC_DIGITS];
+
+	vli_mod_square_fast(delta, point->z);		/* delta = z1^2 */
+	vli_mod_square_fast(gamma, point->y);		/* gamma = y1^2 */
+	vli_mod_mult_fast(beta, point->x, gamma);	/* beta = x1*gamma */
+	vli_mod_sub(t, point->x, delta, curve_p);	/* t = x1 - delta */
+	vli_mod_add(alpha, point->x, delta, curve_p);	/* x1 + delta */
+	vli_mod_mult_fast(alpha, alpha, t);		/* x1^2 - delta^2 */
+	vli_mod_add(t, alpha, alpha, curve_p);
+	vli_mod_add(alpha, alpha, t, curve_p);		/* alpha */
+
+	vli_mod_add(t, point->y, point->z, curve_p);	/* y1 + z1 */
+	vli_mod_square_fast(t, t);
+	vli_mod_sub(t, t, gamma, curve_p);
+	vli_mod_sub(result->z, t, delta, curve_p);	/* z3 = 2*y1*z1 */
+
+	vli_mod_add(beta, beta, beta, curve_p);
+	vli_mod_add(beta, beta, beta, curve_p);		/* beta = 4*beta */
+	vli_mod_square_fast(t, alpha);
+	vli_mod_sub(t, t, beta, curve_p);
+	vli_mod_sub(result->x, t, beta, curve_p);	/* x3 = alpha^2 - 8*beta */
+
+	vli_mod_sub(t, beta, result->x, curve_p);	/* 4*beta - x3 */
+	vli_mod_mult_fast(t, t, alpha);
+	vli_mod_square_fast(gamma, gamma);
+	vli_mod_add(gamma, gamma, gamma, curve_p);
+	vli_mod_add(gamma, gamma, gamma, curve_p);
+	vli_mod_add(gamma, gamma, gamma, curve_p);	/* 8*gamma^2 */
+	vli_mod_sub(result->y, t, gamma, curve_p);	/* y3 */
+}
 
-	apply_z(x1, y1, z);
+/* Computes result = left + right, "add-2007-bl" from the same page.
+ * Can modify in place. Neither point may be the point at infinity and
+ * left != right.
+ */
+static void jacobian_add(struct ecc_jacobian *result,
+				const struct ecc_jacobian *left,
+				const struct ecc_jacobian *right)
+{
+	uint64_t z1z1[NUM_ECC_DIGITS];
+	uint64_t z2z2[NUM_ECC_DIGITS];
+	uint64_t u1[NUM_ECC_DIGITS];
+	uint64_t u2[NUM_ECC_DIGITS];
+	uint64_t s1[NUM_ECC_DIGITS];
+	uint64_t s2[NUM_ECC_DIGITS];
+	uint64_t h[NUM_ECC_DIGITS];
+	uint64_t i[NUM_ECC_DIGITS];
+	uint64_t j[NUM_ECC_DIGITS];
+	uint64_t r[NUM_ECC_DIGITS];
+	uint64_t v[NUM_ECC_DIGITS];
+	uint64_t t[NUM_ECC_DIGITS];
+
+	vli_mod_square_fast(z1z1, left->z);		/* z1^2 */
+	vli_mod_square_fast(z2z2, right->z);		/* z2^2 */
+	vli_mod_mult_fast(u1, left->x, z2z2);		/* u1 = x1*z2^2 */
+	vli_mod_mult_fast(u2, right->x, z1z1);		/* u2 = x2*z1^2 */
+	vli_mod_mult_fast(s1, left->y, right->z);
+	vli_mod_mult_fast(s1, s1, z2z2);		/* s1 = y1*z2^3 */
+	vli_mod_mult_fast(s2, right->y, left->z);
+	vli_mod_mult_fast(s2, s2, z1z1);		/* s2 = y2*z1^3 */
+	vli_mod_sub(h, u2, u1, curve_p);		/* h = u2 - u1 */
+	vli_mod_add(i, h, h, curve_p);
+	vli_mod_square_fast(i, i);			/* i = (2*h)^2 */
+	vli_mod_mult_fast(j, h, i);			/* j = h*i */
+	vli_mod_sub(r, s2, s1, curve_p);
+	vli_mod_add(r, r, r, curve_p);			/* r = 2*(s2 - s1) */
+	vli_mod_mult_fast(v, u1, i);			/* v = u1*i */
+
+	vli_mod_add(t, left->z, right->z, curve_p);
+	vli_mod_square_fast(t, t);
+	vli_mod_sub(t, t, z1z1, curve_p);
+	vli_mod_sub(t, t, z2z2, curve_p);		/* 2*z1*z2 */
+	vli_mod_mult_fast(result->z, t, h);		/* z3 */
+
+	vli_mod_square_fast(t, r);
+	vli_mod_sub(t, t, j, curve_p);
+	vli_mod_sub(t, t, v, curve_p);
+	vli_mod_sub(result->x, t, v, curve_p);		/* x3 = r^2 - j - 2*v */
+
+	vli_mod_sub(t, v, result->x, curve_p);
+	vli_mod_mult_fast(t, t, r);			/* r*(v - x3) */
+	vli_mod_mult_fast(s1, s1, j);
+	vli_mod_add(s1, s1, s1, curve_p);		/* 2*s1*j */
+	vli_mod_sub(result->y, t, s1, curve_p);		/* y3 */
+}
 
-	ecc_point_double_jacobian(x1, y1, z);
+/* Same as jacobian_add() for an affine right, "madd-2007-bl". */
+static void jacobian_add_affine(struct ecc_jacobian *result,
+					const struct ecc_jacobian *left,
+					const struct ecc_point *right)
+{
+	uint64_t z1z1[NUM_ECC_DIGITS];
+	uint64_t u2[NUM_ECC_DIGITS];
+	uint64_t s2[NUM_ECC_DIGITS];
+	uint64_t h[NUM_ECC_DIGITS];
+	uint64_t hh[NUM_ECC_DIGITS];
+	uint64_t i[NUM_ECC_DIGITS];
+	uint64_t j[NUM_ECC_DIGITS];
+	uint64_t r[NUM_ECC_DIGITS];
+	uint64_t v[NUM_ECC_DIGITS];
+	uint64_t t[NUM_ECC_DIGITS];
+
+	vli_mod_square_fast(z1z1, left->z);		/* z1^2 */
+	vli_mod_mult_fast(u2, right->x, z1z1);		/* u2 = x2*z1^2 */
+	vli_mod_mult_fast(s2, right->y, left->z);
+	vli_mod_mult_fast(s2, s2, z1z1);		/* s2 = y2*z1^3 */
+	vli_mod_sub(h, u2, left->x, curve_p);		/* h = u2 - x1 */
+	vli_mod_square_fast(hh, h);			/* hh = h^2 */
+	vli_mod_add(i, hh, hh, curve_p);
+	vli_mod_add(i, i, i, curve_p);			/* i = 4*hh */
+	vli_mod_mult_fast(j, h, i);			/* j = h*i */
+	vli_mod_sub(r, s2, left->y, curve_p);
+	vli_mod_add(r, r, r, curve_p);			/* r = 2*(s2 - y1) */
+	vli_mod_mult_fast(v, left->x, i);		/* v = x1*i */
+
+	vli_mod_add(t, left->z, h, curve_p);
+	vli_mod_square_fast(t, t);
+	vli_mod_sub(t, t, z1z1, curve_p);
+	vli_mod_sub(result->z, t, hh, curve_p);		/* z3 = 2*z1*h */
+
+	vli_mod_square_fast(t, r);
+	vli_mod_sub(t, t, j, curve_p);
+	vli_mod_sub(t, t, v, curve_p);
+	vli_mod_sub(result->x, t, v, curve_p);		/* x3 = r^2 - j - 2*v */
+
+	vli_mod_mult_fast(s2, left->y, j);
+	vli_mod_add(s2, s2, s2, curve_p);		/* 2*y1*j */
+	vli_mod_sub(t, v, result->x, curve_p);
+	vli_mod_mult_fast(t, t, r);			/* r*(v - x3) */
+	vli_mod_sub(result->y, t, s2, curve_p);		/* y3 */
+}
 
-	apply_z(x2, y2, z);
+static void jacobian_from_affine(struct ecc_jacobian *result,
+					const struct ecc_point *point)
+{
+	vli_set(result->x, point->x);
+	vli_set(result->y, point->y);
+	vli_clear(result->z);
+	result->z[0] = 1;
 }
 
-/* Input P = (x1, y1, Z), Q = (x2, y2, Z)
- * Output P' = (x1', y1', Z3), P + Q = (x3, y3, Z3)
- * or P => P', Q => P + Q
+/* Key generation multiplies the generator with a fixed-base comb: the
+ * scalar is cut into COMB_TEETH rows of COMB_SPACING bits and each column
+ * of bits picks one precomputed sum of the rows' multiples of G, so only
+ * COMB_SPACING doublings and additions are needed.
+ */
+#define COMB_TEETH	8
+#define COMB_SPACING	(ECC_BYTES * 8 / COMB_TEETH)
+#define COMB_SIZE	(1 << COMB_TEETH)
+
+/* Entry i holds the sum of 2^(COMB_SPACING * t) * G for each bit t set in
+ * i, entry 0 being unused.
  */
-static void xycz_add(uint64_t *x1, uint64_t *y1, uint64_t *x2, uint64_t *y2)
+static struct ecc_point comb_table[COMB_SIZE];
+static bool comb_table_ready;
+
+static void comb_table_init(void)
 {
-	/* t1 = X1, t2 = Y1, t3 = X2, t4 = Y2 */
-	uint64_t t5[NUM_ECC_DIGITS];
+	struct ecc_jacobian acc;
+	unsigned int i, t;
+
+	if (comb_table_ready)
+		return;
+
+	comb_table[1] = curve_g;
+	jacobian_from_affine(&acc, &curve_g);
+
+	for (t = 1; t < COMB_TEETH; t++) {
+		for (i = 0; i < COMB_SPACING; i++)
+			jacobian_double(&acc, &acc);
 
-	vli_mod_sub(t5, x2, x1, curve_p); /* t5 = x2 - x1 */
-	vli_mod_square_fast(t5, t5);      /* t5 = (x2 - x1)^2 = A */
-	vli_mod_mult_fast(x1, x1, t5);    /* t1 = x1*A = B */
-	vli_mod_mult_fast(x2, x2, t5);    /* t3 = x2*A = C */
-	vli_mod_sub(y2, y2, y1, curve_p); /* t4 = y2 - y1 */
-	vli_mod_square_fast(t5, y2);      /* t5 = (y2 - y1)^2 = D */
+		jacobian_to_affine(&comb_table[1 << t], &acc);
+	}
+
+	/* Every other entry is a smaller one plus its lowest tooth */
+	for (i = 3; i < COMB_SIZE; i++) {
+		unsigned int rest = i & (i - 1);
 
-	vli_mod_sub(t5, t5, x1, curve_p); /* t5 = D - B */
-	vli_mod_sub(t5, t5, x2, curve_p); /* t5 = D - B - C = x3 */
-	vli_mod_sub(x2, x2, x1, curve_p); /* t3 = C - B */
-	vli_mod_mult_fast(y1, y1, x2);    /* t2 = y1*(C - B) */
-	vli_mod_sub(x2, x1, t5, curve_p); /* t3 = B - x3 */
-	vli_mod_mult_fast(y2, y2, x2);    /* t4 = (y2 - y1)*(B - x3) */
-	vli_mod_sub(y2, y2, y1, curve_p); /* t4 = y3 */
+		if (!rest)
+			continue;
 
-	vli_set(x2, t5);
+		jacobian_from_affine(&acc, &comb_table[rest]);
+		jacobian_add_affine(&acc, &acc, &comb_table[i ^ rest]);
+		jacobian_to_affine(&comb_table[i], &acc);
+	}
+
+	comb_table_ready = true;
 }
 
-/* Input P = (x1, y1, Z), Q = (x2, y2, Z)
- * Output P + Q = (x3, y3, Z3), P - Q = (x3', y3', Z3)
- * or P => P - Q, Q => P + Q
- */
-static void xycz_add_c(uint64_t *x1, uint64_t *y1, uint64_t *x2, uint64_t *y2)
+/* Computes result = scalar * G for 0 < scalar < n. */
+static void ecc_point_mult_base(struct ecc_point *result,
+						const uint64_t *scalar)
 {
-	/* t1 = X1, t2 = Y1, t3 = X2, t4 = Y2 */
-	uint64_t t5[NUM_ECC_DIGITS];
-	uint64_t t6[NUM_ECC_DIGITS];
-	uint64_t t7[NUM_ECC_DIGITS];
+	struct ecc_jacobian acc, sum, entry;
+	struct ecc_point point;
+	uint64_t acc_zero = ~0ull;
+	int col;
+
+	comb_table_init();
+
+	memset(&acc, 0, sizeof(acc));
 
-	vli_mod_sub(t5, x2, x1, curve_p); /* t5 = x2 - x1 */
-	vli_mod_square_fast(t5, t5);      /* t5 = (x2 - x1)^2 = A */
-	vli_mod_mult_fast(x1, x1, t5);    /* t1 = x1*A = B */
-	vli_mod_mult_fast(x2, x2, t5);    /* t3 = x2*A = C */
-	vli_mod_add(t5, y2, y1, curve_p); /* t4 = y2 + y1 */
-	vli_mod_sub(y2, y2, y1, curve_p); /* t4 = y2 - y1 */
+	for (col = COMB_SPACING - 1; col >= 0; col--) {
+		uint64_t idx = 0, idx_zero;
+		unsigned int t, i;
 
-	vli_mod_sub(t6, x2, x1, curve_p); /* t6 = C - B */
-	vli_mod_mult_fast(y1, y1, t6);    /* t2 = y1 * (C - B) */
-	vli_mod_add(t6, x1, x2, curve_p); /* t6 = B + C */
-	vli_mod_square_fast(x2, y2);      /* t3 = (y2 - y1)^2 */
-	vli_mod_sub(x2, x2, t6, curve_p); /* t3 = x3 */
+		for (t = 0; t < COMB_TEETH; t++) {
+			unsigned int bit = t * COMB_SPACING + col;
 
-	vli_mod_sub(t7, x1, x2, curve_p); /* t7 = B - x3 */
-	vli_mod_mult_fast(y2, y2, t7);    /* t4 = (y2 - y1)*(B - x3) */
-	vli_mod_sub(y2, y2, y1, curve_p); /* t4 = y3 */
+			idx |= ((scalar[bit / 64] >> (bit % 64)) & 1) << t;
+		}
+
+		/* Read the whole table so the access pattern is the same for
+		 * every column.
+		 */
+		memset(&point, 0, sizeof(point));
+
+		for (i = 1; i < COMB_SIZE; i++) {
+			uint64_t mask = ct_mask_equal(i, idx);
+
+			vli_select(point.x, comb_table[i].x, mask);
+			vli_select(point.y, comb_table[i].y, mask);
+		}
+
+		idx_zero = ct_mask_equal(idx, 0);
 
-	vli_mod_square_fast(t7, t5);      /* t7 = (y2 + y1)^2 = F */
-	vli_mod_sub(t7, t7, t6, curve_p); /* t7 = x3' */
-	vli_mod_sub(t6, t7, x1, curve_p); /* t6 = x3' - B */
-	vli_mod_mult_fast(t6, t6, t5);    /* t6 = (y2 + y1)*(x3' - B) */
-	vli_mod_sub(y1, t6, y1, curve_p); /* t2 = y3' */
+		jacobian_double(&acc, &acc);
+		jacobian_add_affine(&sum, &acc, &point);
 
-	vli_set(x1, t7);
+		/* The accumulator stays at infinity until the first non-empty
+		 * column, and an empty column adds nothing. Since the scalar
+		 * is below n no other exceptional case of the addition can
+		 * occur.
+		 */
+		jacobian_from_affine(&entry, &point);
+		jacobian_select(&sum, &entry, acc_zero);
+		jacobian_select(&sum, &acc, idx_zero);
+
+		acc = sum;
+		acc_zero &= idx_zero;
+	}
+
+	jacobian_to_affine(result, &acc);
 }
 
+/* ECDH multiplies a point not known in advance, so its multiples are
+ * computed per call for a fixed window of WINDOW_BITS scalar bits.
+ */
+#define WINDOW_BITS	4
+#define WINDOW_SIZE	(1 << WINDOW_BITS)
+
+/* Computes result = scalar * point for scalar < n. The multiples of point
+ * are projected with initial_z to randomize the intermediate values.
+ */
 static void ecc_point_mult(struct ecc_point *result,
 				const struct ecc_point *point,
-				uint64_t *scalar, uint64_t *initial_z,
-				int num_bits)
+				const uint64_t *scalar, uint64_t *initial_z)
 {
-	/* R0 and R1 */
-	uint64_t rx[2][NUM_ECC_DIGITS];
-	uint64_t ry[2][NUM_ECC_DIGITS];
-	uint64_t z[NUM_ECC_DIGITS];
-	int i, nb;
+	struct ecc_jacobian table[WINDOW_SIZE];
+	struct ecc_jacobian acc, sum, entry;
+	uint64_t acc_zero = ~0ull;
+	int w;
+	unsigned int i;
+
+	jacobian_from_affine(&table[1], point);
+	vli_set(table[1].z, initial_z);
+	apply_z(table[1].x, table[1].y, table[1].z);
+
+	for (i = 2; i < WINDOW_SIZE; i++) {
+		if (i & 1)
+			jacobian_add(&table[i], &table[i - 1], &table[1]);
+		else
+			jacobian_double(&table[i], &table[i / 2]);
+	}
 
-	vli_set(rx[1], point->x);
-	vli_set(ry[1], point->y);
+	memset(&acc, 0, sizeof(acc));
 
-	xycz_initial_double(rx[1], ry[1], rx[0], ry[0], initial_z);
+	for (w = ECC_BYTES * 8 / WINDOW_BITS - 1; w >= 0; w--) {
+		unsigned int bit = w * WINDOW_BITS;
+		uint64_t digit, digit_zero;
 
-	for (i = num_bits - 2; i > 0; i--) {
-		nb = !vli_test_bit(scalar, i);
-		xycz_add_c(rx[1 - nb], ry[1 - nb], rx[nb], ry[nb]);
-		xycz_add(rx[nb], ry[nb], rx[1 - nb], ry[1 - nb]);
-	}
+		digit = (scalar[bit / 64] >> (bit % 64)) & (WINDOW_SIZE - 1);
+
+		memset(&entry, 0, sizeof(entry));
 
-	nb = !vli_test_bit(scalar, 0);
-	xycz_add_c(rx[1 - nb], ry[1 - nb], rx[nb], ry[nb]);
+		for (i = 1; i < WINDOW_SIZE; i++)
+			jacobian_select(&entry, &table[i],
+						ct_mask_equal(i, digit));
 
-	/* Find final 1/Z value. */
-	vli_mod_sub(z, rx[1], rx[0], curve_p); /* X1 - X0 */
-	vli_mod_mult_fast(z, z, ry[1 - nb]); /* Yb * (X1 - X0) */
-	vli_mod_mult_fast(z, z, point->x);   /* xP * Yb * (X1 - X0) */
-	vli_mod_inv(z, z, curve_p);          /* 1 / (xP * Yb * (X1 - X0)) */
-	vli_mod_mult_fast(z, z, point->y);   /* yP / (xP * Yb * (X1 - X0)) */
-	vli_mod_mult_fast(z, z, rx[1 - nb]); /* Xb * yP / (xP * Yb * (X1 - X0)) */
-	/* End 1/Z calculation */
+		digit_zero = ct_mask_equal(digit, 0);
 
-	xycz_add(rx[nb], ry[nb], rx[1 - nb], ry[1 - nb]);
+		for (i = 0; i < WINDOW_BITS; i++)
+			jacobian_double(&acc, &acc);
 
-	apply_z(rx[0], ry[0], z);
+		jacobian_add(&sum, &acc, &entry);
 
-	vli_set(result->x, rx[0]);
-	vli_set(result->y, ry[0]);
+		/* Same exceptional cases as for the comb */
+		jacobian_select(&sum, &entry, acc_zero);
+		jacobian_select(&sum, &acc, digit_zero);
+
+		acc = sum;
+		acc_zero &= digit_zero;
+	}
+
+	jacobian_to_affine(result, &acc);
 }
 
 static bool ecc_valid_point(const struct ecc_point *point)
@@ -853,7 +1024,7 @@ bool ecc_make_public_key(const uint8_t private_key[32], uint8_t public_key[64])
 	if (vli_cmp(curve_n, priv) != 1)
 		return false;
 
-	ecc_point_mult(&pk, &curve_g, priv, NULL, vli_num_bits(priv));
+	ecc_point_mult_base(&pk, priv);
 
 	if (ecc_point_is_zero(&pk))
 		return false;
@@ -883,7 +1054,7 @@ bool ecc_make_key(uint8_t public_key[64], uint8_t private_key[32])
 		if (vli_cmp(curve_n, priv) != 1)
 			continue;
 
-		ecc_point_mult(&pk, &curve_g, priv, NULL, vli_num_bits(priv));
+		ecc_point_mult_base(&pk, priv);
 	} while (ecc_point_is_zero(&pk));
 
 	ecc_native2bytes(priv, private_key);
@@ -909,6 +1080,8 @@ bool ecdh_shared_secret(const uint8_t public_key[64],
 {
 	uint64_t priv[NUM_ECC_DIGITS];
 	uint64_t rand[NUM_ECC_DIGITS];
+	uint64_t tmp[NUM_ECC_DIGITS];
+	uint64_t borrow;
 	struct ecc_point product, pk;
 
 	if (!get_random_number(rand))
@@ -922,7 +1095,11 @@ bool ecdh_shared_secret(const uint8_t public_key[64],
 
 	ecc_bytes2native(private_key, priv);
 
-	ecc_point_mult(&product, &pk, priv, rand, vli_num_bits(priv));
+	/* Reduce the private key modulo n without branching on it */
+	borrow = vli_sub(tmp, priv, curve_n);
+	vli_select(priv, tmp, borrow - 1);
+
+	ecc_point_mult(&product, &pk, priv, rand);
 
 	ecc_native2bytes(product.x, secret);
 
@@ -25,6 +25,7 @@
 #include "src/shared/gatt-server.h"
 #include "src/shared/gatt-client.h"
 #include "src/shared/rap.h"
+#include "src/shared/cs-dist.h"
 
 #define DBG(_rap, fmt, ...) \
 	rap_debug(_rap, "%s:%s() " fmt, __FILE__, __func__, ##__VA_ARGS__)
@@ -302,6 +303,14 @@ struct bt_rap {
 	void *user_data;
 	struct cstracker *resptracker;
 	struct cstracker *reqtracker;
+
+	/* Distance estimation when acting as initiator */
+	struct bt_cs_dist *dist;
+	bool dist_local_done;
+	bool dist_remote_done;
+	bt_rap_distance_func_t distance_func;
+	bt_rap_destroy_func_t distance_destroy;
+	void *distance_data;
 };
 
 static struct queue *rap_db;
@@ -621,6 +630,11 @@ static void rap_free(void *data)
 	queue_destroy(rap->pending, NULL);
 	queue_destroy(rap->ready_cbs, rap_ready_free);
 
+	if (rap->distance_destroy)
+		rap->distance_destroy(rap->distance_data);
+
+	bt_cs_dist_free(rap->dist);
+
 	free(rap);
 }
 
@@ -702,6 +716,90 @@ bool bt_rap_set_debug(struct bt_rap *rap, bt_rap_debug_func_t func,
 	return true;
 }
 
+bool bt_rap_set_distance_func(struct bt_rap *rap, bt_rap_distance_func_t func,
+			void *user_data, bt_rap_destroy_func_t destroy)
+{
+	if (!rap)
+		return false;
+
+	if (rap->distance_destroy)
+		rap->distance_destroy(rap->distance_data);
+
+	rap->distance_func = func;
+	rap->distance_destroy = destroy;
+	rap->distance_data = user_data;
+
+	return true;
+}
+
+static void rap_distance_reset(struct bt_rap *rap)
+{
+	bt_cs_dist_reset(rap->dist);
+	rap->dist_local_done = false;
+	rap->dist_remote_done = false;
+}
+
+static void rap_distance_update(struct bt_rap *rap)
+{
+	struct bt_cs_dist_result result;
+
+	/* Wait for the results of both sides of the procedure */
+	if (!rap->dist_local_done || !rap->dist_remote_done)
+		return;
+
+	if (bt_cs_dist_estimate(rap->dist, &result)) {
+		DBG(rap, "Distance %.2f m (phase %.2f m, rtt %.2f m, "
+			"quality %.2f)", result.distance,
+			result.phase_distance, result.rtt_distance,
+			result.quality);
+
+		if (rap->distance_func)
+			rap->distance_func(rap, &result, rap->distance_data);
+	}
+
+	rap_distance_reset(rap);
+}
+
+static void rap_distance_add_local(struct bt_rap *rap,
+				const struct cs_step_data *steps,
+				uint8_t num_steps, uint8_t num_ant_paths,
+				uint8_t proc_done_status)
+{
+	if (!rap->dist)
+		rap->dist = bt_cs_dist_new();
+
+	/* Previous procedure never got the reflector results */
+	if (rap->dist_local_done)
+		rap_distance_reset(rap);
+
+	bt_cs_dist_add_steps(rap->dist, BT_CS_DIST_INITIATOR, steps,
+						num_steps, num_ant_paths);
+
+	switch (proc_done_status) {
+	case RANGING_DONE_ALL_RESULTS_COMPLETE:
+		rap->dist_local_done = true;
+		rap_distance_update(rap);
+		break;
+	case RANGING_DONE_ABORTED:
+		rap_distance_reset(rap);
+		break;
+	}
+}
+
+static void rap_distance_add_remote(struct bt_rap *rap,
+				enum cs_role remote_role,
+				const struct cs_step_data *step,
+				uint8_t num_ant_paths)
+{
+	if (!rap->dist)
+		rap->dist = bt_cs_dist_new();
+
+	bt_cs_dist_add_steps(rap->dist, remote_role == CS_ROLE_REFLECTOR ?
+					BT_CS_DIST_REFLECTOR :
+					BT_CS_DIST_INITIATOR,
+					step, 1, num_ant_paths);
+}
+
 static void cs_tracker_init(struct cstracker *t)
 {
 	if (!t)
@@ -1814,11 +1912,15 @@ static void fill_initiator_data_from_cs_subevent_result_cont(struct bt_rap *rap,
 	if (!rap || !rap->reqtracker || !cont)
 		return;
 
-	if (length < base_len)
+	if (length < base_len + cont->num_steps_reported *
+					sizeof(struct cs_step_data))
 		return;
 
 	DBG(rap, "Received CS subevent result continue subevent: len=%u",
 		length);
+
+	rap_distance_add_local(rap, cont->step_data, cont->num_steps_reported,
+				cont->num_ant_paths, cont->proc_done_status);
 }
 
 static void fill_initiator_data_from_cs_subevent_result(struct bt_rap *rap,
@@ -1831,12 +1933,15 @@ static void fill_initiator_data_from_cs_subevent_result(struct bt_rap *rap,
 	if (!rap || !rap->reqtracker || !data)
 		return;
 
-	/* Defensive check: base header must be present */
-	if (length < base_len)
+	/* Defensive check: base header and steps must be present */
+	if (length < base_len + data->num_steps_reported *
+					sizeof(struct cs_step_data))
 		return;
 
 	DBG(rap, "Received CS subevent result subevent: len=%u", length);
-	/* TODO: Store initiator subevent result data */
+
+	rap_distance_add_local(rap, data->step_data, data->num_steps_reported,
+				data->num_ant_paths, data->proc_done_status);
 }
 
 void bt_rap_hci_cs_subevent_result_cont_callback(uint16_t length,
@@ -2122,28 +2227,23 @@ static size_t get_mode_zero_length(enum cs_role remote_role)
 }
 
 static void parse_mode_zero(struct bt_rap *rap, struct iovec *mode_iov,
-			    enum cs_role remote_role)
+			    enum cs_role remote_role,
+			    struct cs_mode_zero_data *data)
 {
-	uint8_t packet_quality;
-	int8_t packet_rssi_dbm;
-	uint8_t packet_ant;
-	uint16_t init_measured_freq_offset = 0;
-
-	if (!util_iov_pull_u8(mode_iov, &packet_quality) ||
-	    !util_iov_pull_u8(mode_iov, (uint8_t *)&packet_rssi_dbm) ||
-	    !util_iov_pull_u8(mode_iov, &packet_ant)) {
+	if (!util_iov_pull_u8(mode_iov, &data->packet_quality) ||
+	    !util_iov_pull_u8(mode_iov, &data->packet_rssi_dbm) ||
+	    !util_iov_pull_u8(mode_iov, &data->packet_ant)) {
 		DBG(rap, "Mode 0: failed to parse common fields");
 		return;
 	}
 
 	if (remote_role == CS_ROLE_INITIATOR) {
-		if (!util_iov_pull_le16(mode_iov, &init_measured_freq_offset)) {
+		if (!util_iov_pull_le16(mode_iov,
+					&data->init_measured_freq_offset)) {
 			DBG(rap, "Mode 0: failed to parse freq offset");
 			return;
 		}
 	}
-
-	/* TODO: Store this data as reflector data */
 }
 
 static size_t get_mode_one_length(bool include_pct)
@@ -2154,31 +2254,31 @@ static size_t get_mode_one_length(bool include_pct)
 }
 
 static void parse_mode_one(struct bt_rap *rap, struct iovec *mode_iov,
-			   enum cs_role remote_role, bool include_pct)
-{
-	uint8_t packet_quality;
-	uint8_t packet_nadm;
-	int8_t packet_rssi_dbm;
-	int16_t time_value;
-	uint8_t packet_ant;
-	int16_t pct1_i = 0, pct1_q = 0;
-	int16_t pct2_i = 0, pct2_q = 0;
-
-	if (!util_iov_pull_u8(mode_iov, &packet_quality) ||
-	    !util_iov_pull_u8(mode_iov, &packet_nadm) ||
-	    !util_iov_pull_u8(mode_iov, (uint8_t *)&packet_rssi_dbm) ||
-	    !util_iov_pull_le16(mode_iov, (uint16_t *)&time_value) ||
-	    !util_iov_pull_u8(mode_iov, &packet_ant)) {
+			   enum cs_role remote_role, bool include_pct,
+			   struct cs_mode_one_data *data)
+{
+	uint16_t time_value;
+
+	if (!util_iov_pull_u8(mode_iov, &data->packet_quality) ||
+	    !util_iov_pull_u8(mode_iov, &data->packet_nadm) ||
+	    !util_iov_pull_u8(mode_iov, &data->packet_rssi_dbm) ||
+	    !util_iov_pull_le16(mode_iov, &time_value) ||
+	    !util_iov_pull_u8(mode_iov, &data->packet_ant)) {
 		DBG(rap, "Mode 1: failed to parse fixed fields");
 		return;
 	}
 
+	if (remote_role == CS_ROLE_REFLECTOR)
+		data->tod_toa_refl = time_value;
+	else
+		data->toa_tod_init = time_value;
+
 	if (include_pct) {
-		parse_i_q_sample(mode_iov, &pct1_i, &pct1_q);
-		parse_i_q_sample(mode_iov, &pct2_i, &pct2_q);
+		parse_i_q_sample(mode_iov, &data->packet_pct1.i_sample,
+					&data->packet_pct1.q_sample);
+		parse_i_q_sample(mode_iov, &data->packet_pct2.i_sample,
+					&data->packet_pct2.q_sample);
 	}
-
-	/* TODO: Store this data as reflector data */
 }
 
 static size_t get_mode_two_length(uint8_t num_antenna_paths)
@@ -2189,46 +2289,40 @@ static size_t get_mode_two_length(uint8_t num_antenna_paths)
 }
 
 static void parse_mode_two(struct bt_rap *rap, struct iovec *mode_iov,
-			   uint8_t num_antenna_paths)
+			   uint8_t num_antenna_paths,
+			   struct cs_mode_two_data *data)
 {
-	uint8_t ant_perm_index;
-	int16_t tone_pct_i[5];
-	int16_t tone_pct_q[5];
-	uint8_t tone_quality[5];
+	int16_t *tone_pct_i;
+	int16_t *tone_pct_q;
+	uint8_t *tone_quality = data->tone_quality_indicator;
 	uint8_t k;
 	uint8_t num_paths = (num_antenna_paths + 1) < 5 ?
 				(num_antenna_paths + 1) : 5;
 
-	if (!util_iov_pull_u8(mode_iov, &ant_perm_index)) {
+	if (!util_iov_pull_u8(mode_iov, &data->ant_perm_index)) {
 		DBG(rap, "Mode 2: failed to parse ant_perm_index");
 		return;
 	}
 
 	for (k = 0; k < num_paths; k++) {
-		int16_t i_val, q_val;
-
 		if (mode_iov->iov_len < 4) {
 			DBG(rap, "Mode 2: insufficient PCT for "
 				"path %u (rem=%zu)",
 				k, mode_iov->iov_len);
 			break;
 		}
-		parse_i_q_sample(mode_iov, &i_val, &q_val);
-		tone_pct_i[k] = i_val;
-		tone_pct_q[k] = q_val;
+		tone_pct_i = &data->tone_pct[k].i_sample;
+		tone_pct_q = &data->tone_pct[k].q_sample;
+		parse_i_q_sample(mode_iov, tone_pct_i, tone_pct_q);
 
 		util_iov_pull_u8(mode_iov, &tone_quality[k]);
 		DBG(rap, "tone_quality_indicator : %d",
 			tone_quality[k]);
-		DBG(rap, "[i, q] : %d, %d",
-			tone_pct_i[k],
-			tone_pct_q[k]);
+		DBG(rap, "[i, q] : %d, %d", *tone_pct_i, *tone_pct_q);
 	}
 
 	DBG(rap, "    cs_mode_two_data: ant_perm_idx=%u",
-		ant_perm_index);
-
-	/* TODO: Store this data as reflector data */
+		data->ant_perm_index);
 }
 
 static size_t get_mode_three_length(uint8_t num_antenna_paths, bool include_pct)
@@ -2239,13 +2333,16 @@ static size_t get_mode_three_length(uint8_t num_antenna_paths, bool include_pct)
 
 static void parse_mode_three(struct bt_rap *rap, struct iovec *mode_iov,
 			     enum cs_role remote_role, bool include_pct,
-			     uint8_t num_antenna_paths)
+			     uint8_t num_antenna_paths,
+			     struct cs_mode_three_data *data)
 {
 	/* Mode 3 = Mode 1 + Mode 2 */
-	parse_mode_one(rap, mode_iov, remote_role, include_pct);
+	parse_mode_one(rap, mode_iov, remote_role, include_pct,
+						&data->mode_one_data);
 
 	if (mode_iov->iov_len > 0)
-		parse_mode_two(rap, mode_iov, num_antenna_paths);
+		parse_mode_two(rap, mode_iov, num_antenna_paths,
+						&data->mode_two_data);
 }
 
 static bool parse_subevent_header(struct iovec *iov,
@@ -2285,6 +2382,7 @@ static bool parse_step(struct bt_rap *rap, struct iovec *iov,
 	enum cs_role remote_role;
 	size_t step_payload_len;
 	struct iovec mode_iov;
+	struct cs_step_data step;
 	void *payload;
 
 	if (!util_iov_pull_u8(iov, &mode_byte)) {
@@ -2292,17 +2390,27 @@ static bool parse_step(struct bt_rap *rap, struct iovec *iov,
 		return false;
 	}
 
+	remote_role = (reqtracker->role == CS_ROLE_INITIATOR) ?
+			CS_ROLE_REFLECTOR : CS_ROLE_INITIATOR;
+
+	/* RAS steps carry no channel, so the step index is what pairs them
+	 * with the local results; keep it by adding a step that is skipped.
+	 */
+	memset(&step, 0, sizeof(step));
+	step.step_mode = 0xff;
+	step.step_chnl = 0xff;
+
 	if (mode_byte & RAS_STEP_ABORTED_BIT) {
 		DBG(rap, "  Step %u: mode=%u (aborted)",
 			step_idx, mode_byte & 0x03);
+		rap_distance_add_remote(rap, remote_role, &step,
+						num_antenna_paths);
 		return true;
 	}
 
 	step_mode = mode_byte & 0x03;
 	include_pct = (reqtracker->rtt_type == 0x01 ||
 			reqtracker->rtt_type == 0x02);
-	remote_role = (reqtracker->role == CS_ROLE_INITIATOR) ?
-			CS_ROLE_REFLECTOR : CS_ROLE_INITIATOR;
 
 	switch (step_mode) {
 	case CS_MODE_ZERO:
@@ -2337,24 +2445,33 @@ static bool parse_step(struct bt_rap *rap, struct iovec *iov,
 	mode_iov.iov_base = payload;
 	mode_iov.iov_len = step_payload_len;
 
+	step.step_mode = step_mode;
+	step.step_data_length = step_payload_len;
+
 	switch (step_mode) {
 	case CS_MODE_ZERO:
-		parse_mode_zero(rap, &mode_iov, remote_role);
+		parse_mode_zero(rap, &mode_iov, remote_role,
+				&step.step_mode_data.mode_zero_data);
 		break;
 	case CS_MODE_ONE:
-		parse_mode_one(rap, &mode_iov, remote_role, include_pct);
+		parse_mode_one(rap, &mode_iov, remote_role, include_pct,
+				&step.step_mode_data.mode_one_data);
 		break;
 	case CS_MODE_TWO:
-		parse_mode_two(rap, &mode_iov, num_antenna_paths);
+		parse_mode_two(rap, &mode_iov, num_antenna_paths,
+				&step.step_mode_data.mode_two_data);
 		break;
 	case CS_MODE_THREE:
 		parse_mode_three(rap, &mode_iov, remote_role, include_pct,
-						num_antenna_paths);
+				num_antenna_paths,
+				&step.step_mode_data.mode_three_data);
 		break;
 	default:
 		break;
 	}
 
+	rap_distance_add_remote(rap, remote_role, &step, num_antenna_paths);
+
 	return true;
 }
 
@@ -2406,15 +2523,22 @@ static void parse_ras_data_segments(struct bt_rap *rap,
 					num_antenna_paths,
 					hdr.num_steps_reported);
 
-		if (hdr.subevent_done_status ==
-		    SUBEVENT_DONE_ALL_RESULTS_COMPLETE ||
-		    hdr.ranging_done_status ==
+		if (hdr.ranging_done_status ==
 		    RANGING_DONE_ALL_RESULTS_COMPLETE) {
 			DBG(rap, "Ranging procedure complete");
+			rap->dist_remote_done = true;
+			break;
+		}
+
+		if (hdr.ranging_done_status == RANGING_DONE_ABORTED) {
+			DBG(rap, "Ranging procedure aborted");
+			rap_distance_reset(rap);
 			break;
 		}
 	}
 
+	rap_distance_update(rap);
+
 	free(reqtracker->segment_data.iov_base);
 	reqtracker->segment_data.iov_base = NULL;
 	reqtracker->segment_data.iov_len = 0;
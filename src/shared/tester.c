@@ -19,9 +19,12 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <string.h>
+#include <fcntl.h>
+#include <poll.h>
 #include <signal.h>
 #include <sys/signalfd.h>
 #include <sys/socket.h>
+#include <sys/wait.h>
 
 #include <glib.h>
 
@@ -79,6 +82,7 @@ enum test_stage {
 
 struct test_case {
 	char *name;
+	unsigned int index;
 	enum test_result result;
 	enum test_stage stage;
 	const void *test_data;
@@ -92,6 +96,7 @@ struct test_case {
 	tester_data_func_t io_complete_func;
 	gdouble start_time;
 	gdouble end_time;
+	gdouble stage_time[TEST_STAGE_POST_TEARDOWN + 1];
 	unsigned int timeout;
 	unsigned int timeout_id;
 	unsigned int teardown_id;
@@ -104,6 +109,8 @@ static char *tester_name;
 static GList *test_list;
 static GList *test_current;
 static GTimer *test_timer;
+static unsigned int test_count;
+static int worker_fd = -1;
 
 static gboolean option_version = FALSE;
 static gboolean option_quiet = FALSE;
@@ -112,6 +119,8 @@ static gboolean option_monitor = FALSE;
 static gboolean option_list = FALSE;
 static const char *option_prefix = NULL;
 static const char *option_string = NULL;
+static gint option_jobs = 0;
+static gboolean option_timing = FALSE;
 
 struct monitor_hdr {
 	uint16_t opcode;
@@ -126,6 +135,15 @@ struct monitor_l2cap_hdr {
 	uint16_t psm;
 } __attribute__((packed));
 
+/* Sent by a worker process to the parent once a test case is done */
+struct test_report {
+	unsigned int index;
+	enum test_result result;
+	gdouble start_time;
+	gdouble end_time;
+	gdouble stage_time[TEST_STAGE_POST_TEARDOWN + 1];
+};
+
 static void test_destroy(gpointer data)
 {
 	struct test_case *test = data;
@@ -306,6 +324,7 @@ void tester_add_full(const char *name, const void *test_data,
 
 	test = new0(struct test_case, 1);
 	test->name = strdup(name);
+	test->index = test_count++;
 	test->result = TEST_RESULT_NOT_RUN;
 	test->stage = TEST_STAGE_INVALID;
 
@@ -368,6 +387,42 @@ void *tester_get_data(void)
 	return test->user_data;
 }
 
+static void test_set_stage(struct test_case *test, enum test_stage stage)
+{
+	test->stage = stage;
+	test->stage_time[stage] = g_timer_elapsed(test_timer, NULL);
+}
+
+static gdouble test_stage_time(struct test_case *test, enum test_stage stage)
+{
+	enum test_stage next;
+
+	if (!test->stage_time[stage])
+		return 0;
+
+	/* A stage lasts until the next one that was actually entered */
+	for (next = stage + 1; next <= TEST_STAGE_POST_TEARDOWN; next++) {
+		if (test->stage_time[next])
+			return test->stage_time[next] - test->stage_time[stage];
+	}
+
+	return test->end_time - test->stage_time[stage];
+}
+
+static void print_timing(struct test_case *test)
+{
+	if (!option_timing || test->result == TEST_RESULT_NOT_RUN)
+		return;
+
+	tester_log("  pre-setup %.3f setup %.3f run %.3f teardown %.3f "
+			"post-teardown %.3f",
+			test_stage_time(test, TEST_STAGE_PRE_SETUP),
+			test_stage_time(test, TEST_STAGE_SETUP),
+			test_stage_time(test, TEST_STAGE_RUN),
+			test_stage_time(test, TEST_STAGE_TEARDOWN),
+			test_stage_time(test, TEST_STAGE_POST_TEARDOWN));
+}
+
 static int tester_summarize(void)
 {
 	unsigned int not_run = 0, passed = 0, failed = 0;
@@ -406,6 +461,8 @@ static int tester_summarize(void)
 			failed++;
 			break;
 		}
+
+		print_timing(test);
         }
 
 	tester_log("Total: %d, "
@@ -428,7 +485,7 @@ static gboolean teardown_callback(gpointer user_data)
 	struct test_case *test = user_data;
 
 	test->teardown_id = 0;
-	test->stage = TEST_STAGE_TEARDOWN;
+	test_set_stage(test, TEST_STAGE_TEARDOWN);
 
 	print_progress(test->name, COLOR_MAGENTA, "teardown");
 	test->teardown_func(test->test_data);
@@ -485,7 +542,7 @@ static void next_test_case(void)
 							test_timeout, test,
 							NULL);
 
-	test->stage = TEST_STAGE_PRE_SETUP;
+	test_set_stage(test, TEST_STAGE_PRE_SETUP);
 
 	test->pre_setup_func(test->test_data);
 }
@@ -494,7 +551,7 @@ static gboolean setup_callback(gpointer user_data)
 {
 	struct test_case *test = user_data;
 
-	test->stage = TEST_STAGE_SETUP;
+	test_set_stage(test, TEST_STAGE_SETUP);
 
 	print_progress(test->name, COLOR_BLUE, "setup");
 	test->setup_func(test->test_data);
@@ -506,7 +563,7 @@ static gboolean run_callback(gpointer user_data)
 {
 	struct test_case *test = user_data;
 
-	test->stage = TEST_STAGE_RUN;
+	test_set_stage(test, TEST_STAGE_RUN);
 
 	print_progress(test->name, COLOR_BLACK, "run");
 	test->test_func(test->test_data);
@@ -514,6 +571,22 @@ static gboolean run_callback(gpointer user_data)
 	return FALSE;
 }
 
+static void report_result(struct test_case *test)
+{
+	struct test_report report;
+
+	memset(&report, 0, sizeof(report));
+	report.index = test->index;
+	report.result = test->result;
+	report.start_time = test->start_time;
+	report.end_time = test->end_time;
+	memcpy(report.stage_time, test->stage_time, sizeof(report.stage_time));
+
+	/* Reports are smaller than PIPE_BUF so each write is atomic */
+	if (write(worker_fd, &report, sizeof(report)) < 0)
+		tester_warn("Failed to report result: %s", strerror(errno));
+}
+
 static gboolean done_callback(gpointer user_data)
 {
 	struct test_case *test = user_data;
@@ -521,6 +594,10 @@ static gboolean done_callback(gpointer user_data)
 	test->end_time = g_timer_elapsed(test_timer, NULL);
 
 	print_progress(test->name, COLOR_BLACK, "done");
+
+	if (worker_fd >= 0)
+		report_result(test);
+
 	next_test_case();
 
 	return FALSE;
@@ -624,7 +701,7 @@ void tester_setup_failed(void)
 	if (test->stage != TEST_STAGE_SETUP)
 		return;
 
-	test->stage = TEST_STAGE_POST_TEARDOWN;
+	test_set_stage(test, TEST_STAGE_POST_TEARDOWN);
 
 	if (test->timeout_id > 0) {
 		timeout_remove(test->timeout_id);
@@ -708,7 +785,7 @@ void tester_teardown_complete(void)
 	if (test->stage != TEST_STAGE_TEARDOWN)
 		return;
 
-	test->stage = TEST_STAGE_POST_TEARDOWN;
+	test_set_stage(test, TEST_STAGE_POST_TEARDOWN);
 
 	test->post_teardown_func(test->test_data);
 }
@@ -725,7 +802,7 @@ void tester_teardown_failed(void)
 	if (test->stage != TEST_STAGE_TEARDOWN)
 		return;
 
-	test->stage = TEST_STAGE_POST_TEARDOWN;
+	test_set_stage(test, TEST_STAGE_POST_TEARDOWN);
 
 	tester_post_teardown_failed();
 }
@@ -766,7 +843,9 @@ void tester_post_teardown_failed(void)
 
 static gboolean start_tester(gpointer user_data)
 {
-	test_timer = g_timer_new();
+	/* Workers share the timer started by the parent process */
+	if (!test_timer)
+		test_timer = g_timer_new();
 
 	next_test_case();
 
@@ -867,6 +946,10 @@ static GOptionEntry options[] = {
 				"Run tests matching provided prefix" },
 	{ "string", 's', 0, G_OPTION_ARG_STRING, &option_string,
 				"Run tests matching provided string" },
+	{ "jobs", 'j', 0, G_OPTION_ARG_INT, &option_jobs,
+				"Run tests in N parallel worker processes" },
+	{ "timing", 't', 0, G_OPTION_ARG_NONE, &option_timing,
+				"Show per stage execution times in summary" },
 	{ NULL },
 };
 
@@ -1071,6 +1154,220 @@ void tester_io_set_complete_func(tester_data_func_t func)
 	test->io_complete_func = func;
 }
 
+static void worker_setup(unsigned int worker, unsigned int jobs, int fd)
+{
+	GList *list, *next;
+
+	worker_fd = fd;
+
+	/* Only keep the test cases assigned to this worker */
+	for (list = test_list; list; list = next) {
+		struct test_case *test = list->data;
+
+		next = g_list_next(list);
+
+		if (test->index % jobs == worker)
+			continue;
+
+		test_list = g_list_delete_link(test_list, list);
+		test_destroy(test);
+	}
+
+	/* Keep lines of concurrent workers from being interleaved */
+	setvbuf(stdout, NULL, _IOLBF, 0);
+}
+
+static void apply_report(const struct test_report *report)
+{
+	struct test_case *test;
+
+	test = g_list_nth_data(test_list, report->index);
+	if (!test)
+		return;
+
+	test->result = report->result;
+	test->stage = TEST_STAGE_POST_TEARDOWN;
+	test->start_time = report->start_time;
+	test->end_time = report->end_time;
+	memcpy(test->stage_time, report->stage_time, sizeof(test->stage_time));
+}
+
+static void worker_failed(unsigned int worker, unsigned int jobs)
+{
+	GList *list;
+
+	/* Cases the worker never reported on are considered failed */
+	for (list = test_list; list; list = g_list_next(list)) {
+		struct test_case *test = list->data;
+
+		if (test->index % jobs != worker)
+			continue;
+
+		if (test->stage != TEST_STAGE_INVALID)
+			continue;
+
+		test->result = TEST_RESULT_FAILED;
+	}
+}
+
+static void collect_workers(struct pollfd *fds, pid_t *pids,
+					unsigned int started, unsigned int jobs)
+{
+	unsigned int i, running = started;
+
+	while (running > 0) {
+		if (poll(fds, started, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+
+			tester_warn("Failed to poll workers: %s",
+							strerror(errno));
+			break;
+		}
+
+		for (i = 0; i < started; i++) {
+			struct test_report report;
+			ssize_t len;
+
+			if (fds[i].fd < 0 || !fds[i].revents)
+				continue;
+
+			len = read(fds[i].fd, &report, sizeof(report));
+			if (len == sizeof(report)) {
+				apply_report(&report);
+				continue;
+			}
+
+			if (len < 0 && errno == EINTR)
+				continue;
+
+			close(fds[i].fd);
+			fds[i].fd = -1;
+			running--;
+		}
+	}
+
+	for (i = 0; i < started; i++) {
+		int status;
+
+		if (fds[i].fd >= 0)
+			close(fds[i].fd);
+
+		if (waitpid(pids[i], &status, 0) < 0)
+			continue;
+
+		if (WIFSIGNALED(status)) {
+			tester_warn("Worker %u terminated by signal %d", i,
+							WTERMSIG(status));
+			worker_failed(i, jobs);
+		}
+	}
+}
+
+/* Returns true in the parent process once all workers have completed, and
+ * false in the workers themselves or if no worker could be started, in which
+ * case the test cases left in test_list are to be run by this process.
+ */
+static bool start_workers(void)
+{
+	unsigned int jobs, i;
+	struct pollfd *fds;
+	sigset_t mask, oldmask;
+	pid_t *pids;
+
+	jobs = MIN((unsigned int) option_jobs, g_list_length(test_list));
+	if (jobs < 2)
+		return false;
+
+	fds = new0(struct pollfd, jobs);
+	pids = new0(pid_t, jobs);
+
+	test_timer = g_timer_new();
+
+	/* Don't let workers flush a copy of pending output */
+	fflush(stdout);
+
+	for (i = 0; i < jobs; i++) {
+		int pipefd[2];
+		pid_t pid;
+
+		if (pipe2(pipefd, O_CLOEXEC) < 0) {
+			tester_warn("Failed to create pipe: %s",
+							strerror(errno));
+			break;
+		}
+
+		pid = fork();
+		if (pid < 0) {
+			tester_warn("Failed to start worker: %s",
+							strerror(errno));
+			close(pipefd[0]);
+			close(pipefd[1]);
+			break;
+		}
+
+		if (pid == 0) {
+			unsigned int j;
+
+			for (j = 0; j < i; j++)
+				close(fds[j].fd);
+
+			close(pipefd[0]);
+			free(fds);
+			free(pids);
+
+			worker_setup(i, jobs, pipefd[1]);
+			return false;
+		}
+
+		close(pipefd[1]);
+
+		fds[i].fd = pipefd[0];
+		fds[i].events = POLLIN;
+		pids[i] = pid;
+	}
+
+	if (i == 0) {
+		free(fds);
+		free(pids);
+		return false;
+	}
+
+	/* Workers are part of the same process group and handle the signals
+	 * themselves, the parent just waits for them to report back.
+	 */
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGINT);
+	sigaddset(&mask, SIGTERM);
+	sigprocmask(SIG_BLOCK, &mask, &oldmask);
+
+	tester_log("Running %u tests in %u workers", test_count, i);
+
+	/* Test cases are already split among all the planned workers, so
+	 * those assigned to workers which could not be started never run.
+	 */
+	if (i < jobs) {
+		unsigned int j;
+
+		tester_warn("Tests of %u workers not started are failed",
+								jobs - i);
+
+		for (j = i; j < jobs; j++)
+			worker_failed(j, jobs);
+	}
+
+	collect_workers(fds, pids, i, jobs);
+
+	sigprocmask(SIG_SETMASK, &oldmask, NULL);
+
+	g_timer_stop(test_timer);
+
+	free(fds);
+	free(pids);
+
+	return true;
+}
+
 int tester_run(void)
 {
 	int ret;
@@ -1080,12 +1377,23 @@ int tester_run(void)
 		return EXIT_SUCCESS;
 	}
 
+	if (option_jobs > 1 && start_workers()) {
+		ret = tester_summarize();
+		goto done;
+	}
+
 	g_idle_add(start_tester, NULL);
 
 	mainloop_run_with_signal(signal_callback, NULL);
 
-	ret = tester_summarize();
+	if (worker_fd >= 0) {
+		/* The parent process prints the merged summary */
+		close(worker_fd);
+		ret = 0;
+	} else
+		ret = tester_summarize();
 
+done:
 	g_list_free_full(test_list, test_destroy);
 
 	if (option_monitor)
@@ -14,6 +14,7 @@
 
 #define _GNU_SOURCE
 #include <stdio.h>
+#include <stddef.h>
 #include <unistd.h>
 #include <string.h>
 #include <errno.h>
@@ -340,20 +341,26 @@ bool bt_uhid_unregister_all(struct bt_uhid *uhid)
 	return true;
 }
 
-static int uhid_send(struct bt_uhid *uhid, const struct uhid_event *ev)
+static int uhid_send_len(struct bt_uhid *uhid, const struct uhid_event *ev,
+								size_t size)
 {
 	ssize_t len;
 	struct iovec iov;
 
 	iov.iov_base = (void *) ev;
-	iov.iov_len = sizeof(*ev);
+	iov.iov_len = size;
 
 	len = io_send(uhid->io, &iov, 1);
 	if (len < 0)
 		return -errno;
 
 	/* uHID kernel driver does not handle partial writes */
-	return len != sizeof(*ev) ? -EIO : 0;
+	return len != (ssize_t) size ? -EIO : 0;
+}
+
+static int uhid_send(struct bt_uhid *uhid, const struct uhid_event *ev)
+{
+	return uhid_send_len(uhid, ev, sizeof(*ev));
 }
 
 int bt_uhid_send(struct bt_uhid *uhid, const struct uhid_event *ev)
@@ -467,7 +474,10 @@ int bt_uhid_input(struct bt_uhid *uhid, uint8_t number, const void *data,
 	if (!uhid)
 		return -EINVAL;
 
-	memset(&ev, 0, sizeof(ev));
+	/*
+	 * Only the header and the report bytes are initialized and written,
+	 * the kernel zero fills the remainder of a short UHID_INPUT2 write.
+	 */
 	ev.type = UHID_INPUT2;
 
 	if (number) {
@@ -479,16 +489,25 @@ int bt_uhid_input(struct bt_uhid *uhid, uint8_t number, const void *data,
 	if (data && size)
 		memcpy(&req->data[len], data, req->size - len);
 
+	len = offsetof(struct uhid_event, u.input2.data) + req->size;
+
 	/* Queue events if UHID_START has not been received yet */
 	if (!uhid->started) {
+		struct uhid_event *queued;
+
 		if (!uhid->input)
 			uhid->input = queue_new();
 
-		queue_push_tail(uhid->input, util_memdup(&ev, sizeof(ev)));
+		queued = new0(struct uhid_event, 1);
+		memcpy(queued, &ev, len);
+		queue_push_tail(uhid->input, queued);
 		return 0;
 	}
 
-	return bt_uhid_send(uhid, &ev);
+	if (!uhid->io)
+		return -ENOTCONN;
+
+	return uhid_send_len(uhid, &ev, len);
 }
 
 int bt_uhid_set_report_reply(struct bt_uhid *uhid, uint32_t id, uint8_t status)
@@ -0,0 +1,1067 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <time.h>
+
+#include <glib.h>
+
+#include "bluetooth/bluetooth.h"
+#include "bluetooth/l2cap.h"
+#include "bluetooth/rfcomm.h"
+#include "bluetooth/sco.h"
+#include "bluetooth/iso.h"
+#include "bluetooth/mgmt.h"
+
+#include "monitor/bt.h"
+#include "emulator/bthost.h"
+#include "emulator/hciemu.h"
+
+#include "src/shared/tester.h"
+#include "src/shared/mgmt.h"
+#include "src/shared/queue.h"
+#include "src/shared/util.h"
+
+/* Number of SDUs sent per test case */
+#define BENCH_COUNT		200
+
+/* Maximum number of SDUs in flight before waiting for the remote */
+#define BENCH_WINDOW		8
+
+/* Latency histogram buckets, bucket n counts [2^n, 2^(n+1)) usec */
+#define BENCH_HIST		20
+
+#define BENCH_TIMEOUT		10
+
+#define BENCH_L2CAP_PSM		0x1001
+#define BENCH_LE_PSM		0x0080
+#define BENCH_RFCOMM_CHANNEL	0x0c
+
+#define TS_USEC(_ts) ((uint64_t)(_ts)->tv_sec * 1000000 + \
+						(_ts)->tv_nsec / 1000)
+
+enum bench_transport {
+	BENCH_L2CAP_BREDR,
+	BENCH_L2CAP_LE,
+	BENCH_RFCOMM,
+	BENCH_SCO,
+	BENCH_ISO,
+};
+
+struct bench_data {
+	char *name;
+	enum bench_transport transport;
+	uint8_t mode;
+	uint16_t mtu;
+	uint16_t credits;
+	uint32_t phy;
+	const char *phy_str;
+};
+
+struct bench_result {
+	char *name;
+	const char *transport;
+	uint16_t mtu;
+	uint16_t credits;
+	const char *phy;
+	uint16_t sdu_len;
+	unsigned int count;
+	uint64_t bytes;
+	uint64_t usec;
+	uint32_t p50;
+	uint32_t p99;
+	uint32_t max;
+	unsigned int hist[BENCH_HIST];
+};
+
+struct test_data {
+	const struct bench_data *bench;
+	struct mgmt *mgmt;
+	uint16_t mgmt_index;
+	struct hciemu *hciemu;
+	enum hciemu_type hciemu_type;
+	GIOChannel *io;
+	unsigned int io_id;
+	int sk;
+	uint16_t sdu_len;
+	void *buf;
+	unsigned int sent;
+	unsigned int received;
+	uint64_t rx_bytes;
+	uint64_t *tx_time;
+	uint32_t *latency;
+};
+
+static struct queue *results;
+static char *option_output;
+
+static const char *transport_str[] = {
+	[BENCH_L2CAP_BREDR]	= "l2cap-bredr",
+	[BENCH_L2CAP_LE]	= "l2cap-le",
+	[BENCH_RFCOMM]		= "rfcomm",
+	[BENCH_SCO]		= "sco",
+	[BENCH_ISO]		= "iso",
+};
+
+static const uint8_t set_iso_socket_param[] = {
+	0x3e, 0xe0, 0xb4, 0xfd, 0xdd, 0xd6, 0x85, 0x98, /* UUID - ISO Socket */
+	0x6a, 0x49, 0xe0, 0x05, 0x88, 0xf1, 0xba, 0x6f,
+	0x01,						/* Action - enable */
+};
+
+static uint64_t bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return TS_USEC(&ts);
+}
+
+static void print_debug(const char *str, void *user_data)
+{
+	const char *prefix = user_data;
+
+	tester_print("%s%s", prefix, str);
+}
+
+static void read_info_callback(uint8_t status, uint16_t length,
+					const void *param, void *user_data)
+{
+	struct test_data *data = tester_get_data();
+	const struct mgmt_rp_read_info *rp = param;
+	char addr[18];
+
+	tester_print("Read Info callback");
+	tester_print("  Status: 0x%02x", status);
+
+	if (status || !param) {
+		tester_pre_setup_failed();
+		return;
+	}
+
+	ba2str(&rp->bdaddr, addr);
+
+	tester_print("  Address: %s", addr);
+
+	if (strcmp(hciemu_get_address(data->hciemu), addr)) {
+		tester_pre_setup_failed();
+		return;
+	}
+
+	tester_pre_setup_complete();
+}
+
+static void index_added_callback(uint16_t index, uint16_t length,
+					const void *param, void *user_data)
+{
+	struct test_data *data = tester_get_data();
+
+	tester_print("Index Added callback");
+	tester_print("  Index: 0x%04x", index);
+
+	/* Ignore controllers created by other tester instances */
+	if (data->hciemu && index != hciemu_get_index(data->hciemu))
+		return;
+
+	data->mgmt_index = index;
+
+	mgmt_send(data->mgmt, MGMT_OP_READ_INFO, data->mgmt_index, 0, NULL,
+					read_info_callback, NULL, NULL);
+}
+
+static void index_removed_callback(uint16_t index, uint16_t length,
+					const void *param, void *user_data)
+{
+	struct test_data *data = tester_get_data();
+
+	tester_print("Index Removed callback");
+	tester_print("  Index: 0x%04x", index);
+
+	if (index != data->mgmt_index)
+		return;
+
+	mgmt_unregister_index(data->mgmt, data->mgmt_index);
+
+	mgmt_unref(data->mgmt);
+	data->mgmt = NULL;
+
+	tester_post_teardown_complete();
+}
+
+static void read_index_list_callback(uint8_t status, uint16_t length,
+					const void *param, void *user_data)
+{
+	struct test_data *data = tester_get_data();
+
+	tester_print("Read Index List callback");
+	tester_print("  Status: 0x%02x", status);
+
+	if (status || !param) {
+		tester_pre_setup_failed();
+		return;
+	}
+
+	mgmt_register(data->mgmt, MGMT_EV_INDEX_ADDED, MGMT_INDEX_NONE,
+					index_added_callback, NULL, NULL);
+
+	mgmt_register(data->mgmt, MGMT_EV_INDEX_REMOVED, MGMT_INDEX_NONE,
+					index_removed_callback, NULL, NULL);
+
+	data->hciemu = hciemu_new(data->hciemu_type);
+	if (!data->hciemu)
+		data->hciemu = hciemu_new_debug(data->hciemu_type, print_debug,
+							"hciemu: ", NULL);
+	if (!data->hciemu) {
+		tester_warn("Failed to setup HCI emulation");
+		tester_pre_setup_failed();
+		mgmt_unref(data->mgmt);
+		data->mgmt = NULL;
+		return;
+	}
+
+	if (tester_use_debug())
+		hciemu_set_debug(data->hciemu, print_debug, "hciemu: ", NULL);
+
+	tester_print("New hciemu instance created");
+}
+
+static void test_pre_setup(const void *test_data)
+{
+	struct test_data *data = tester_get_data();
+
+	data->mgmt = mgmt_new_default();
+	if (!data->mgmt) {
+		tester_warn("Failed to setup management interface");
+		tester_pre_setup_failed();
+		return;
+	}
+
+	if (tester_use_debug())
+		mgmt_set_debug(data->mgmt, print_debug, "mgmt: ", NULL);
+
+	if (data->bench->transport == BENCH_ISO)
+		mgmt_send(data->mgmt, MGMT_OP_SET_EXP_FEATURE, MGMT_INDEX_NONE,
+				sizeof(set_iso_socket_param),
+				set_iso_socket_param, NULL, NULL, NULL);
+
+	mgmt_send(data->mgmt, MGMT_OP_READ_INDEX_LIST, MGMT_INDEX_NONE, 0, NULL,
+					read_index_list_callback, NULL, NULL);
+}
+
+static void test_post_teardown(const void *test_data)
+{
+	struct test_data *data = tester_get_data();
+
+	if (data->io_id > 0) {
+		g_source_remove(data->io_id);
+		data->io_id = 0;
+	}
+
+	if (data->io) {
+		g_io_channel_unref(data->io);
+		data->io = NULL;
+		data->sk = -1;
+	}
+
+	hciemu_unref(data->hciemu);
+	data->hciemu = NULL;
+}
+
+static void test_data_free(void *test_data)
+{
+	struct test_data *data = test_data;
+	struct bench_data *bench = (void *) data->bench;
+
+	free(data->buf);
+	free(data->tx_time);
+	free(data->latency);
+	g_free(bench->name);
+	free(bench);
+	free(data);
+}
+
+static void client_cmd_complete(uint16_t opcode, uint8_t status,
+					const void *param, uint8_t len,
+					void *user_data)
+{
+	switch (opcode) {
+	case BT_HCI_CMD_WRITE_SCAN_ENABLE:
+	case BT_HCI_CMD_LE_SET_EXT_ADV_ENABLE:
+		tester_print("Client set connectable status 0x%02x", status);
+		break;
+	default:
+		return;
+	}
+
+	if (status)
+		tester_setup_failed();
+	else
+		tester_setup_complete();
+}
+
+static void bench_recv(const void *buf, uint16_t len, void *user_data);
+
+static void bench_recv_sco(const void *buf, uint16_t len, uint8_t status,
+							void *user_data)
+{
+	bench_recv(buf, len, user_data);
+}
+
+static void sco_new_conn(uint16_t handle, void *user_data)
+{
+	struct test_data *data = user_data;
+	struct bthost *bthost = hciemu_client_get_host(data->hciemu);
+
+	tester_print("New SCO connection with handle 0x%04x", handle);
+
+	bthost_add_sco_hook(bthost, handle, bench_recv_sco, data, NULL);
+}
+
+static uint8_t iso_accept_conn(uint16_t handle, void *user_data)
+{
+	return 0x00;
+}
+
+static void iso_new_conn(uint16_t handle, void *user_data)
+{
+	struct test_data *data = user_data;
+	struct bthost *bthost = hciemu_client_get_host(data->hciemu);
+
+	tester_print("New ISO connection with handle 0x%04x", handle);
+
+	bthost_add_iso_hook(bthost, handle, bench_recv, data, NULL);
+}
+
+static void setup_powered_callback(uint8_t status, uint16_t length,
+					const void *param, void *user_data)
+{
+	struct test_data *data = tester_get_data();
+	const struct bench_data *bench = data->bench;
+	struct bthost *bthost;
+
+	if (status != MGMT_STATUS_SUCCESS) {
+		tester_setup_failed();
+		return;
+	}
+
+	tester_print("Controller powered on");
+
+	bthost = hciemu_client_get_host(data->hciemu);
+	bthost_set_cmd_complete_cb(bthost, client_cmd_complete, data);
+
+	switch (bench->transport) {
+	case BENCH_SCO:
+		bthost_set_sco_cb(bthost, sco_new_conn, data);
+		/* fallthrough */
+	case BENCH_L2CAP_BREDR:
+	case BENCH_RFCOMM:
+		bthost_write_scan_enable(bthost, 0x03);
+		break;
+	case BENCH_ISO:
+		bthost_set_iso_cb(bthost, iso_accept_conn, iso_new_conn, data);
+		/* fallthrough */
+	case BENCH_L2CAP_LE:
+		bthost_set_ext_adv_params(bthost, 0x00);
+		bthost_set_ext_adv_enable(bthost, 0x01);
+		break;
+	}
+}
+
+static void setup_powered(const void *test_data)
+{
+	struct test_data *data = tester_get_data();
+	unsigned char param[] = { 0x01 };
+
+	tester_print("Powering on controller");
+
+	mgmt_send(data->mgmt, MGMT_OP_SET_SSP, data->mgmt_index,
+				sizeof(param), param, NULL, NULL, NULL);
+
+	mgmt_send(data->mgmt, MGMT_OP_SET_LE, data->mgmt_index,
+				sizeof(param), param, NULL, NULL, NULL);
+
+	mgmt_send(data->mgmt, MGMT_OP_SET_BONDABLE, data->mgmt_index,
+				sizeof(param), param, NULL, NULL, NULL);
+
+	mgmt_send(data->mgmt, MGMT_OP_SET_POWERED, data->mgmt_index,
+				sizeof(param), param, setup_powered_callback,
+				NULL, NULL);
+}
+
+static int cmp_latency(const void *a, const void *b)
+{
+	uint32_t la = *(const uint32_t *) a;
+	uint32_t lb = *(const uint32_t *) b;
+
+	return la < lb ? -1 : la > lb;
+}
+
+static unsigned int hist_bucket(uint32_t usec)
+{
+	unsigned int i;
+
+	for (i = 0; i < BENCH_HIST - 1 && usec >= (2u << i); i++)
+		;
+
+	return i;
+}
+
+static void bench_done(struct test_data *data)
+{
+	const struct bench_data *bench = data->bench;
+	struct bench_result *res;
+	unsigned int i;
+
+	res = new0(struct bench_result, 1);
+	res->name = strdup(bench->name);
+	res->transport = transport_str[bench->transport];
+	res->mtu = bench->mtu ? bench->mtu : data->sdu_len;
+	res->credits = bench->credits;
+	res->phy = bench->phy_str;
+	res->sdu_len = data->sdu_len;
+	res->count = data->received;
+	res->bytes = data->rx_bytes;
+	res->usec = bench_now() - data->tx_time[0];
+
+	for (i = 0; i < data->received; i++)
+		res->hist[hist_bucket(data->latency[i])]++;
+
+	qsort(data->latency, data->received, sizeof(*data->latency),
+								cmp_latency);
+
+	res->p50 = data->latency[(data->received - 1) * 50 / 100];
+	res->p99 = data->latency[(data->received - 1) * 99 / 100];
+	res->max = data->latency[data->received - 1];
+
+	tester_print("%u x %u bytes in %" PRIu64 " usec, latency p50 %u "
+			"p99 %u max %u usec", res->count, res->sdu_len,
+			res->usec, res->p50, res->p99, res->max);
+
+	queue_push_tail(results, res);
+
+	tester_test_passed();
+}
+
+static gboolean bench_write_cb(GIOChannel *io, GIOCondition cond,
+							gpointer user_data);
+
+static void bench_send(struct test_data *data)
+{
+	while (data->sent < BENCH_COUNT &&
+			data->sent - data->received < BENCH_WINDOW) {
+		uint64_t now = bench_now();
+		ssize_t ret;
+
+		ret = write(data->sk, data->buf, data->sdu_len);
+		if (ret < 0 && errno == EAGAIN) {
+			if (!data->io_id)
+				data->io_id = g_io_add_watch(data->io,
+							G_IO_OUT,
+							bench_write_cb, data);
+			return;
+		}
+
+		if (ret != data->sdu_len) {
+			tester_warn("Unable to write %u bytes: %zd %s (%d)",
+					data->sdu_len, ret, strerror(errno),
+					errno);
+			tester_test_failed();
+			return;
+		}
+
+		data->tx_time[data->sent++] = now;
+	}
+}
+
+static gboolean bench_write_cb(GIOChannel *io, GIOCondition cond,
+							gpointer user_data)
+{
+	struct test_data *data = user_data;
+
+	data->io_id = 0;
+
+	bench_send(data);
+
+	return FALSE;
+}
+
+static void bench_recv(const void *buf, uint16_t len, void *user_data)
+{
+	struct test_data *data = user_data;
+	uint64_t now = bench_now();
+
+	if (!data->sdu_len || data->received == BENCH_COUNT)
+		return;
+
+	data->rx_bytes += len;
+
+	/* Transports may fragment or coalesce SDUs, so match them by their
+	 * offset in the byte stream as data is delivered in order.
+	 */
+	while (data->received < data->sent &&
+			data->rx_bytes >= (uint64_t) (data->received + 1) *
+							data->sdu_len) {
+		data->latency[data->received] = now -
+						data->tx_time[data->received];
+		data->received++;
+	}
+
+	if (data->received == BENCH_COUNT) {
+		bench_done(data);
+		return;
+	}
+
+	bench_send(data);
+}
+
+static void l2cap_connect_cb(uint16_t handle, uint16_t cid, void *user_data)
+{
+	struct test_data *data = user_data;
+	struct bthost *bthost = hciemu_client_get_host(data->hciemu);
+
+	tester_debug("Client connect CID 0x%04x handle 0x%04x", cid, handle);
+
+	bthost_add_cid_hook(bthost, handle, cid, bench_recv, data);
+}
+
+static void rfcomm_connect_cb(uint16_t handle, uint16_t cid,
+						void *user_data, bool status)
+{
+	struct test_data *data = user_data;
+	struct bthost *bthost = hciemu_client_get_host(data->hciemu);
+
+	bthost_add_rfcomm_chan_hook(bthost, handle, BENCH_RFCOMM_CHANNEL,
+							bench_recv, data);
+}
+
+static int bench_get_mtu(struct test_data *data)
+{
+	const struct bench_data *bench = data->bench;
+	struct l2cap_options l2o;
+	struct sco_options so;
+	uint16_t mtu;
+	socklen_t len;
+
+	switch (bench->transport) {
+	case BENCH_L2CAP_BREDR:
+		len = sizeof(l2o);
+		if (getsockopt(data->sk, SOL_L2CAP, L2CAP_OPTIONS, &l2o,
+								&len) < 0)
+			return -errno;
+		return MIN(bench->mtu, l2o.omtu);
+	case BENCH_L2CAP_LE:
+		len = sizeof(mtu);
+		if (getsockopt(data->sk, SOL_BLUETOOTH, BT_SNDMTU, &mtu,
+								&len) < 0)
+			return -errno;
+		return MIN(bench->mtu, mtu);
+	case BENCH_SCO:
+		len = sizeof(so);
+		if (getsockopt(data->sk, SOL_SCO, SCO_OPTIONS, &so, &len) < 0)
+			return -errno;
+		return so.mtu;
+	case BENCH_RFCOMM:
+	case BENCH_ISO:
+		break;
+	}
+
+	return bench->mtu;
+}
+
+static gboolean bench_connect_cb(GIOChannel *io, GIOCondition cond,
+							gpointer user_data)
+{
+	struct test_data *data = tester_get_data();
+	const struct bench_data *bench = data->bench;
+	int err, sk_err, mtu;
+	socklen_t len = sizeof(sk_err);
+
+	data->io_id = 0;
+
+	if (getsockopt(data->sk, SOL_SOCKET, SO_ERROR, &sk_err, &len) < 0)
+		err = -errno;
+	else
+		err = -sk_err;
+
+	if (err < 0) {
+		tester_warn("Connect failed: %s (%d)", strerror(-err), -err);
+		tester_test_failed();
+		return FALSE;
+	}
+
+	mtu = bench_get_mtu(data);
+	if (mtu <= 0) {
+		tester_warn("Unable to get MTU: %s (%d)", strerror(-mtu),
+									-mtu);
+		tester_test_failed();
+		return FALSE;
+	}
+
+	if (bench->transport == BENCH_L2CAP_LE && bench->phy &&
+			setsockopt(data->sk, SOL_BLUETOOTH, BT_PHY, &bench->phy,
+						sizeof(bench->phy)) < 0) {
+		tester_warn("setsockopt(BT_PHY): %s (%d)", strerror(errno),
+									errno);
+		tester_test_failed();
+		return FALSE;
+	}
+
+	tester_print("Connected, sending %u x %d bytes", BENCH_COUNT, mtu);
+
+	data->sdu_len = mtu;
+	data->buf = malloc(mtu);
+	memset(data->buf, 0xaa, mtu);
+	data->tx_time = new0(uint64_t, BENCH_COUNT);
+	data->latency = new0(uint32_t, BENCH_COUNT);
+
+	bench_send(data);
+
+	return FALSE;
+}
+
+static int bench_l2cap_sock(struct test_data *data, struct sockaddr *addr,
+							socklen_t *addr_len)
+{
+	const struct bench_data *bench = data->bench;
+	struct bthost *bthost = hciemu_client_get_host(data->hciemu);
+	struct sockaddr_l2 *l2 = (void *) addr;
+	uint16_t psm;
+	int sk, err;
+
+	if (bench->transport == BENCH_L2CAP_LE) {
+		psm = BENCH_LE_PSM;
+		bthost_add_l2cap_server_custom(bthost, psm, bench->mtu,
+						MIN(bench->mtu, 247),
+						bench->credits,
+						l2cap_connect_cb, NULL, data);
+	} else {
+		psm = BENCH_L2CAP_PSM;
+		bthost_add_l2cap_server(bthost, psm, l2cap_connect_cb, NULL,
+									data);
+	}
+
+	sk = socket(PF_BLUETOOTH, SOCK_SEQPACKET | SOCK_NONBLOCK,
+								BTPROTO_L2CAP);
+	if (sk < 0)
+		return -errno;
+
+	memset(l2, 0, sizeof(*l2));
+	l2->l2_family = AF_BLUETOOTH;
+	l2->l2_bdaddr_type = bench->transport == BENCH_L2CAP_LE ?
+					BDADDR_LE_PUBLIC : BDADDR_BREDR;
+	bacpy(&l2->l2_bdaddr, (void *) hciemu_get_central_bdaddr(data->hciemu));
+
+	if (bind(sk, addr, sizeof(*l2)) < 0)
+		goto failed;
+
+	if (bench->mode && setsockopt(sk, SOL_BLUETOOTH, BT_MODE,
+					&bench->mode, sizeof(bench->mode)) < 0)
+		goto failed;
+
+	l2->l2_psm = htobs(psm);
+	bacpy(&l2->l2_bdaddr, (void *) hciemu_get_client_bdaddr(data->hciemu));
+	*addr_len = sizeof(*l2);
+
+	return sk;
+
+failed:
+	err = -errno;
+	close(sk);
+	return err;
+}
+
+static int bench_rfcomm_sock(struct test_data *data, struct sockaddr *addr,
+							socklen_t *addr_len)
+{
+	struct bthost *bthost = hciemu_client_get_host(data->hciemu);
+	struct sockaddr_rc *rc = (void *) addr;
+	int sk;
+
+	bthost_add_l2cap_server(bthost, 0x0003, NULL, NULL, NULL);
+	bthost_add_rfcomm_server(bthost, BENCH_RFCOMM_CHANNEL,
+						rfcomm_connect_cb, data);
+
+	sk = socket(PF_BLUETOOTH, SOCK_STREAM | SOCK_NONBLOCK, BTPROTO_RFCOMM);
+	if (sk < 0)
+		return -errno;
+
+	memset(rc, 0, sizeof(*rc));
+	rc->rc_family = AF_BLUETOOTH;
+	bacpy(&rc->rc_bdaddr, (void *) hciemu_get_central_bdaddr(data->hciemu));
+
+	if (bind(sk, addr, sizeof(*rc)) < 0) {
+		close(sk);
+		return -errno;
+	}
+
+	rc->rc_channel = BENCH_RFCOMM_CHANNEL;
+	bacpy(&rc->rc_bdaddr, (void *) hciemu_get_client_bdaddr(data->hciemu));
+	*addr_len = sizeof(*rc);
+
+	return sk;
+}
+
+static int bench_sco_sock(struct test_data *data, struct sockaddr *addr,
+							socklen_t *addr_len)
+{
+	struct sockaddr_sco *sco = (void *) addr;
+	int sk;
+
+	sk = socket(PF_BLUETOOTH, SOCK_SEQPACKET | SOCK_NONBLOCK,
+								BTPROTO_SCO);
+	if (sk < 0)
+		return -errno;
+
+	memset(sco, 0, sizeof(*sco));
+	sco->sco_family = AF_BLUETOOTH;
+	bacpy(&sco->sco_bdaddr,
+			(void *) hciemu_get_central_bdaddr(data->hciemu));
+
+	if (bind(sk, addr, sizeof(*sco)) < 0) {
+		close(sk);
+		return -errno;
+	}
+
+	bacpy(&sco->sco_bdaddr,
+			(void *) hciemu_get_client_bdaddr(data->hciemu));
+	*addr_len = sizeof(*sco);
+
+	return sk;
+}
+
+static int bench_iso_sock(struct test_data *data, struct sockaddr *addr,
+							socklen_t *addr_len)
+{
+	const struct bench_data *bench = data->bench;
+	struct sockaddr_iso *iso = (void *) addr;
+	struct bt_iso_io_qos io = {
+		.interval = 10000,
+		.latency = 10,
+		.sdu = bench->mtu,
+		.phys = bench->phy,
+		.rtn = 2,
+	};
+	struct bt_iso_qos qos = {
+		.ucast = {
+			.cig = BT_ISO_QOS_CIG_UNSET,
+			.cis = BT_ISO_QOS_CIS_UNSET,
+			.sca = 0x07,
+			.in = io,
+			.out = io,
+		},
+	};
+	int sk, err;
+
+	sk = socket(PF_BLUETOOTH, SOCK_SEQPACKET | SOCK_NONBLOCK, BTPROTO_ISO);
+	if (sk < 0)
+		return -errno;
+
+	memset(iso, 0, sizeof(*iso));
+	iso->iso_family = AF_BLUETOOTH;
+	iso->iso_bdaddr_type = BDADDR_LE_PUBLIC;
+	bacpy(&iso->iso_bdaddr,
+			(void *) hciemu_get_central_bdaddr(data->hciemu));
+
+	if (bind(sk, addr, sizeof(*iso)) < 0)
+		goto failed;
+
+	if (setsockopt(sk, SOL_BLUETOOTH, BT_ISO_QOS, &qos, sizeof(qos)) < 0)
+		goto failed;
+
+	bacpy(&iso->iso_bdaddr,
+			(void *) hciemu_get_client_bdaddr(data->hciemu));
+	*addr_len = sizeof(*iso);
+
+	return sk;
+
+failed:
+	err = -errno;
+	close(sk);
+	return err;
+}
+
+static void test_bench(const void *test_data)
+{
+	struct test_data *data = tester_get_data();
+	struct sockaddr_storage addr;
+	socklen_t addr_len = 0;
+	int sk = -EINVAL;
+
+	switch (data->bench->transport) {
+	case BENCH_L2CAP_BREDR:
+	case BENCH_L2CAP_LE:
+		sk = bench_l2cap_sock(data, (void *) &addr, &addr_len);
+		break;
+	case BENCH_RFCOMM:
+		sk = bench_rfcomm_sock(data, (void *) &addr, &addr_len);
+		break;
+	case BENCH_SCO:
+		sk = bench_sco_sock(data, (void *) &addr, &addr_len);
+		break;
+	case BENCH_ISO:
+		sk = bench_iso_sock(data, (void *) &addr, &addr_len);
+		break;
+	}
+
+	if (sk < 0) {
+		tester_warn("Can't create socket: %s (%d)", strerror(-sk), -sk);
+		if (sk == -ENOPROTOOPT || sk == -EPROTONOSUPPORT)
+			tester_test_abort();
+		else
+			tester_test_failed();
+		return;
+	}
+
+	if (connect(sk, (void *) &addr, addr_len) < 0 &&
+				!(errno == EAGAIN || errno == EINPROGRESS)) {
+		tester_warn("Can't connect socket: %s (%d)", strerror(errno),
+									errno);
+		close(sk);
+		tester_test_failed();
+		return;
+	}
+
+	data->sk = sk;
+	data->io = g_io_channel_unix_new(sk);
+	g_io_channel_set_close_on_unref(data->io, TRUE);
+
+	data->io_id = g_io_add_watch(data->io, G_IO_OUT, bench_connect_cb,
+									NULL);
+
+	tester_print("Connect in progress");
+}
+
+static void bench_add(enum bench_transport transport, uint8_t mode,
+				uint16_t mtu, uint16_t credits, uint32_t phy,
+				const char *phy_str, const char *name)
+{
+	struct bench_data *bench;
+	struct test_data *user;
+
+	bench = new0(struct bench_data, 1);
+	bench->transport = transport;
+	bench->mode = mode;
+	bench->mtu = mtu;
+	bench->credits = credits;
+	bench->phy = phy;
+	bench->phy_str = phy_str;
+
+	if (credits)
+		bench->name = g_strdup_printf("%s MTU %u Credits %u PHY %s",
+						name, mtu, credits, phy_str);
+	else if (phy_str)
+		bench->name = g_strdup_printf("%s SDU %u PHY %s", name, mtu,
+								phy_str);
+	else if (mtu)
+		bench->name = g_strdup_printf("%s MTU %u", name, mtu);
+	else
+		bench->name = g_strdup(name);
+
+	user = new0(struct test_data, 1);
+	user->bench = bench;
+	user->sk = -1;
+
+	switch (transport) {
+	case BENCH_L2CAP_BREDR:
+	case BENCH_RFCOMM:
+	case BENCH_SCO:
+		user->hciemu_type = HCIEMU_TYPE_BREDRLE;
+		break;
+	case BENCH_L2CAP_LE:
+	case BENCH_ISO:
+		user->hciemu_type = HCIEMU_TYPE_BREDRLE52;
+		break;
+	}
+
+	tester_add_full(bench->name, bench, test_pre_setup, setup_powered,
+				test_bench, NULL, test_post_teardown,
+				BENCH_TIMEOUT, user, test_data_free);
+}
+
+struct print_data {
+	FILE *f;
+	bool first;
+};
+
+static void print_result(void *data, void *user_data)
+{
+	struct bench_result *res = data;
+	struct print_data *print = user_data;
+	FILE *f = print->f;
+	unsigned int i;
+
+	fprintf(f, "%s\n  {\n", print->first ? "" : ",");
+	fprintf(f, "    \"name\": \"%s\",\n", res->name);
+	fprintf(f, "    \"transport\": \"%s\",\n", res->transport);
+	fprintf(f, "    \"mtu\": %u,\n", res->mtu);
+	fprintf(f, "    \"credits\": %u,\n", res->credits);
+	if (res->phy)
+		fprintf(f, "    \"phy\": \"%s\",\n", res->phy);
+	else
+		fprintf(f, "    \"phy\": null,\n");
+	fprintf(f, "    \"sdu\": %u,\n", res->sdu_len);
+	fprintf(f, "    \"count\": %u,\n", res->count);
+	fprintf(f, "    \"bytes\": %" PRIu64 ",\n", res->bytes);
+	fprintf(f, "    \"usec\": %" PRIu64 ",\n", res->usec);
+	fprintf(f, "    \"throughput_kbps\": %" PRIu64 ",\n",
+			res->usec ? res->bytes * 8 * 1000 / res->usec : 0);
+	fprintf(f, "    \"latency_usec\": { \"p50\": %u, \"p99\": %u, "
+			"\"max\": %u },\n", res->p50, res->p99, res->max);
+	fprintf(f, "    \"histogram_log2_usec\": [");
+	for (i = 0; i < BENCH_HIST; i++)
+		fprintf(f, "%s%u", i ? ", " : " ", res->hist[i]);
+	fprintf(f, " ]\n  }");
+
+	print->first = false;
+}
+
+static void free_result(void *data)
+{
+	struct bench_result *res = data;
+
+	free(res->name);
+	free(res);
+}
+
+static const uint16_t bredr_mtu[] = { 48, 672 };
+static const uint16_t le_mtu[] = { 64, 247, 512 };
+static const uint16_t le_credits[] = { 1, 10 };
+static const uint16_t rfcomm_mtu[] = { 127, 990 };
+static const uint16_t iso_sdu[] = { 40, 120 };
+
+static const struct {
+	uint32_t phy;
+	const char *str;
+} le_phy[] = {
+	{ BT_PHY_LE_1M_TX | BT_PHY_LE_1M_RX, "1M" },
+	{ BT_PHY_LE_2M_TX | BT_PHY_LE_2M_RX, "2M" },
+	{ BT_PHY_LE_CODED_TX | BT_PHY_LE_CODED_RX, "Coded" },
+};
+
+static const struct {
+	uint32_t phy;
+	const char *str;
+} iso_phy[] = {
+	{ 0x01, "1M" },
+	{ 0x02, "2M" },
+};
+
+static GOptionEntry options[] = {
+	{ "output", 'o', 0, G_OPTION_ARG_FILENAME, &option_output,
+				"Write the results as JSON to FILE", "FILE" },
+	{ NULL },
+};
+
+static void parse_options(int *argc, char ***argv)
+{
+	GOptionContext *context;
+	GError *error = NULL;
+
+	/* Anything else is left for tester_init() to parse */
+	context = g_option_context_new(NULL);
+	g_option_context_set_ignore_unknown_options(context, TRUE);
+	g_option_context_set_help_enabled(context, FALSE);
+	g_option_context_add_main_entries(context, options, NULL);
+
+	if (g_option_context_parse(context, argc, argv, &error) == FALSE) {
+		g_printerr("%s\n", error->message);
+		g_error_free(error);
+		exit(EXIT_FAILURE);
+	}
+
+	g_option_context_free(context);
+}
+
+static int print_results(void)
+{
+	struct print_data print = { .f = stdout, .first = true };
+
+	if (queue_isempty(results))
+		return 0;
+
+	/* Keep the results apart from the tester output if asked to */
+	if (option_output) {
+		print.f = fopen(option_output, "w");
+		if (!print.f) {
+			fprintf(stderr, "Failed to open %s: %s\n",
+					option_output, strerror(errno));
+			return -errno;
+		}
+	}
+
+	fprintf(print.f, "[");
+	queue_foreach(results, print_result, &print);
+	fprintf(print.f, "\n]\n");
+
+	if (print.f != stdout && fclose(print.f) < 0) {
+		fprintf(stderr, "Failed to write %s: %s\n", option_output,
+							strerror(errno));
+		return -errno;
+	}
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int i, j, k;
+	int ret;
+
+	parse_options(&argc, &argv);
+	tester_init(&argc, &argv);
+
+	results = queue_new();
+
+	for (i = 0; i < ARRAY_SIZE(bredr_mtu); i++)
+		bench_add(BENCH_L2CAP_BREDR, 0, bredr_mtu[i], 0, 0, NULL,
+							"L2CAP BR/EDR Basic");
+
+	for (i = 0; i < ARRAY_SIZE(le_mtu); i++)
+		for (j = 0; j < ARRAY_SIZE(le_credits); j++)
+			for (k = 0; k < ARRAY_SIZE(le_phy); k++) {
+				bench_add(BENCH_L2CAP_LE, BT_MODE_LE_FLOWCTL,
+						le_mtu[i], le_credits[j],
+						le_phy[k].phy, le_phy[k].str,
+						"L2CAP LE CoC");
+				bench_add(BENCH_L2CAP_LE, BT_MODE_EXT_FLOWCTL,
+						le_mtu[i], le_credits[j],
+						le_phy[k].phy, le_phy[k].str,
+						"L2CAP LE Ext-Flowctl");
+			}
+
+	for (i = 0; i < ARRAY_SIZE(rfcomm_mtu); i++)
+		bench_add(BENCH_RFCOMM, 0, rfcomm_mtu[i], 0, 0, NULL,
+								"RFCOMM");
+
+	bench_add(BENCH_SCO, 0, 0, 0, 0, NULL, "SCO");
+
+	for (i = 0; i < ARRAY_SIZE(iso_sdu); i++)
+		for (j = 0; j < ARRAY_SIZE(iso_phy); j++)
+			bench_add(BENCH_ISO, 0, iso_sdu[i], 0, iso_phy[j].phy,
+						iso_phy[j].str, "ISO CIS");
+
+	ret = tester_run();
+
+	if (print_results() < 0 && ret == EXIT_SUCCESS)
+		ret = EXIT_FAILURE;
+
+	queue_destroy(results, free_result);
+	g_free(option_output);
+
+	return ret;
+}
@@ -114,6 +114,10 @@ static void index_added_callback(uint16_t index, uint16_t length,
 	tester_print("Index Added callback");
 	tester_print("  Index: 0x%04x", index);
 
+	/* Ignore controllers created by other tester instances */
+	if (data->hciemu && index != hciemu_get_index(data->hciemu))
+		return;
+
 	data->mgmt_index = index;
 
 	mgmt_send(data->mgmt, MGMT_OP_READ_INFO, data->mgmt_index, 0, NULL,
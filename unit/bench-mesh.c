@@ -0,0 +1,262 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <ell/ell.h>
+
+#include "mesh/mesh-defs.h"
+#include "mesh/node.h"
+#include "mesh/net.h"
+#include "mesh/crypto.h"
+#include "mesh/mesh-config.h"
+#include "mesh/appkey.h"
+
+#include "unit/bench.h"
+
+#define MSG_SRC		0x0001
+#define MSG_DST		0xc000
+#define MSG_SEQ		1
+#define MSG_IV_INDEX	0
+
+static const uint8_t msg[] = "Cached CCM context";
+
+/* Just what appkey.c needs from the network layer */
+struct mesh_net {
+	struct l_queue *app_keys;
+	struct mesh_aid_index *aid_index;
+};
+
+struct l_queue *mesh_net_get_app_keys(struct mesh_net *net)
+{
+	return net->app_keys;
+}
+
+struct mesh_aid_index *mesh_net_get_aid_index(struct mesh_net *net)
+{
+	return net->aid_index;
+}
+
+void mesh_net_set_aid_index(struct mesh_net *net, struct mesh_aid_index *index)
+{
+	net->aid_index = index;
+}
+
+bool mesh_net_have_key(struct mesh_net *net, uint16_t net_idx)
+{
+	return true;
+}
+
+struct mesh_node *mesh_net_node_get(struct mesh_net *net)
+{
+	return NULL;
+}
+
+int mesh_net_key_refresh_phase_get(struct mesh_net *net, uint16_t net_idx,
+							uint8_t *phase)
+{
+	*phase = KEY_REFRESH_PHASE_NONE;
+
+	return MESH_STATUS_SUCCESS;
+}
+
+struct mesh_config *node_config_get(struct mesh_node *node)
+{
+	return NULL;
+}
+
+void node_app_key_delete(struct mesh_node *node, uint16_t net_idx,
+							uint16_t app_idx)
+{
+}
+
+bool mesh_config_app_key_add(struct mesh_config *cfg, uint16_t net_idx,
+				uint16_t app_idx, const uint8_t key[16])
+{
+	return true;
+}
+
+bool mesh_config_app_key_update(struct mesh_config *cfg, uint16_t app_idx,
+							const uint8_t key[16])
+{
+	return true;
+}
+
+bool mesh_config_app_key_del(struct mesh_config *cfg, uint16_t net_idx,
+								uint16_t idx)
+{
+	return true;
+}
+
+struct decrypt_data {
+	struct mesh_net net;
+	uint8_t key_aid;
+	uint8_t enc[sizeof(msg) + 4];
+	uint8_t out[sizeof(msg) + 4];
+};
+
+/*
+ * Adds num_keys App Keys which all share the same AID, the last one being
+ * used to encrypt the message, so every lookup has to try all of them as
+ * when AIDs collide on a node.
+ */
+static void *decrypt_setup(unsigned int num_keys)
+{
+	struct decrypt_data *data = l_new(struct decrypt_data, 1);
+	uint8_t key[16], aid;
+	unsigned int count = 0;
+	uint32_t i;
+
+	data->net.app_keys = l_queue_new();
+	data->key_aid = APP_AID_INVALID;
+
+	if (!mesh_crypto_check_avail()) {
+		bench_skip("AES-CCM not available");
+		return data;
+	}
+
+	memset(key, 0xa5, sizeof(key));
+
+	for (i = 0; count < num_keys; i++) {
+		l_put_be32(i, key);
+
+		if (!mesh_crypto_k4(key, &aid)) {
+			bench_skip("Unable to derive AID");
+			return data;
+		}
+
+		aid = KEY_ID_AKF | (aid << KEY_AID_SHIFT);
+
+		if (data->key_aid == APP_AID_INVALID)
+			data->key_aid = aid;
+		else if (aid != data->key_aid)
+			continue;
+
+		appkey_key_init(&data->net, 0, count++, key, NULL);
+	}
+
+	mesh_crypto_payload_encrypt(NULL, msg, data->enc, sizeof(msg),
+					MSG_SRC, MSG_DST, data->key_aid,
+					MSG_SEQ, MSG_IV_INDEX, false, key);
+
+	return data;
+}
+
+static void *decrypt_setup_1(void)
+{
+	return decrypt_setup(1);
+}
+
+static void *decrypt_setup_8(void)
+{
+	return decrypt_setup(8);
+}
+
+static void *decrypt_setup_32(void)
+{
+	return decrypt_setup(32);
+}
+
+static void *decrypt_setup_128(void)
+{
+	return decrypt_setup(128);
+}
+
+static void decrypt_teardown(void *user_data)
+{
+	struct decrypt_data *data = user_data;
+
+	appkey_aid_index_free(data->net.aid_index);
+	l_queue_destroy(data->net.app_keys, appkey_key_free);
+	l_free(data);
+}
+
+/* Same lookup as app_packet_decrypt() in mesh/model.c */
+static void bench_decrypt_cached(void *user_data)
+{
+	struct decrypt_data *data = user_data;
+	const struct l_queue_entry *entry;
+
+	entry = l_queue_get_entries(appkey_get_aid_keys(&data->net,
+							data->key_aid));
+
+	for (; entry; entry = entry->next) {
+		const uint8_t *key;
+		struct l_aead_cipher *cipher;
+
+		if (appkey_get_aid_cipher(entry->data, data->key_aid, false,
+							&key, &cipher) < 0)
+			continue;
+
+		if (mesh_crypto_payload_decrypt_cipher(cipher, NULL, 0,
+					data->enc, sizeof(data->enc), false,
+					MSG_SRC, MSG_DST, data->key_aid,
+					MSG_SEQ, MSG_IV_INDEX, data->out))
+			return;
+	}
+
+	bench_skip("Message not decrypted");
+}
+
+/* Same candidates, but setting up a new cipher on every attempt */
+static void bench_decrypt_fresh(void *user_data)
+{
+	struct decrypt_data *data = user_data;
+	const struct l_queue_entry *entry;
+
+	entry = l_queue_get_entries(appkey_get_aid_keys(&data->net,
+							data->key_aid));
+
+	for (; entry; entry = entry->next) {
+		const uint8_t *key;
+		struct l_aead_cipher *cipher;
+
+		if (appkey_get_aid_cipher(entry->data, data->key_aid, false,
+							&key, &cipher) < 0)
+			continue;
+
+		if (mesh_crypto_payload_decrypt(NULL, 0, data->enc,
+					sizeof(data->enc), false,
+					MSG_SRC, MSG_DST, data->key_aid,
+					MSG_SEQ, MSG_IV_INDEX, data->out, key))
+			return;
+	}
+
+	bench_skip("Message not decrypted");
+}
+
+int main(int argc, char *argv[])
+{
+	bench_init(&argc, &argv);
+
+	bench_add("mesh/app-decrypt-cached-1", decrypt_setup_1,
+				bench_decrypt_cached, decrypt_teardown);
+	bench_add("mesh/app-decrypt-cached-8", decrypt_setup_8,
+				bench_decrypt_cached, decrypt_teardown);
+	bench_add("mesh/app-decrypt-cached-32", decrypt_setup_32,
+				bench_decrypt_cached, decrypt_teardown);
+	bench_add("mesh/app-decrypt-cached-128", decrypt_setup_128,
+				bench_decrypt_cached, decrypt_teardown);
+
+	bench_add("mesh/app-decrypt-fresh-1", decrypt_setup_1,
+				bench_decrypt_fresh, decrypt_teardown);
+	bench_add("mesh/app-decrypt-fresh-8", decrypt_setup_8,
+				bench_decrypt_fresh, decrypt_teardown);
+	bench_add("mesh/app-decrypt-fresh-32", decrypt_setup_32,
+				bench_decrypt_fresh, decrypt_teardown);
+	bench_add("mesh/app-decrypt-fresh-128", decrypt_setup_128,
+				bench_decrypt_fresh, decrypt_teardown);
+
+	return bench_run();
+}
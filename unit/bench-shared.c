@@ -0,0 +1,596 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include <glib.h>
+
+#include "bluetooth/bluetooth.h"
+#include "bluetooth/uuid.h"
+
+#include "src/shared/util.h"
+#include "src/shared/queue.h"
+#include "src/shared/ringbuf.h"
+#include "src/shared/ad.h"
+#include "src/shared/att.h"
+#include "src/shared/gatt-db.h"
+#include "src/shared/crypto.h"
+#include "src/shared/ecc.h"
+#include "src/eir.h"
+
+#include "unit/bench.h"
+
+#define QUEUE_ENTRIES		64
+#define DB_SERVICES		16
+#define DB_CHARACTERISTICS	8
+#define AD_MONITORS		200
+
+static const uint8_t adv_data[] = {
+	0x02, 0x01, 0x06,				/* Flags */
+	0x05, 0x03, 0x0d, 0x18, 0x0f, 0x18,		/* UUID16 list */
+	0x09, 0x09, 'B', 'l', 'u', 'e', 'Z', ' ',	/* Complete name */
+	'b', 'n',
+	0x07, 0xff, 0x5d, 0x00, 0x01, 0x02, 0x03, 0x04,	/* Vendor */
+	0x05, 0x16, 0x0f, 0x18, 0x55, 0x00,		/* Service data */
+	0x02, 0x0a, 0x04,				/* TX power */
+};
+
+static void *queue_setup(void)
+{
+	struct queue *queue = queue_new();
+	unsigned int i;
+
+	for (i = 1; i <= QUEUE_ENTRIES; i++)
+		queue_push_tail(queue, UINT_TO_PTR(i));
+
+	return queue;
+}
+
+static void queue_teardown(void *data)
+{
+	queue_destroy(data, NULL);
+}
+
+static void bench_queue_push_pop(void *data)
+{
+	struct queue *queue = data;
+
+	queue_push_tail(queue, UINT_TO_PTR(QUEUE_ENTRIES + 1));
+	queue_pop_head(queue);
+}
+
+static bool match_ptr(const void *a, const void *b)
+{
+	return a == b;
+}
+
+static void bench_queue_find(void *data)
+{
+	struct queue *queue = data;
+
+	queue_find(queue, match_ptr, UINT_TO_PTR(QUEUE_ENTRIES));
+}
+
+static void count_entry(void *data, void *user_data)
+{
+	unsigned int *count = user_data;
+
+	(*count)++;
+}
+
+static void bench_queue_foreach(void *data)
+{
+	struct queue *queue = data;
+	unsigned int count = 0;
+
+	queue_foreach(queue, count_entry, &count);
+}
+
+struct ringbuf_data {
+	struct ringbuf *ringbuf;
+	int fd;
+};
+
+static void *ringbuf_setup(void)
+{
+	struct ringbuf_data *data = new0(struct ringbuf_data, 1);
+
+	data->ringbuf = ringbuf_new(4096);
+	data->fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+	if (data->fd < 0)
+		bench_skip("/dev/null not available");
+
+	return data;
+}
+
+static void ringbuf_teardown(void *user_data)
+{
+	struct ringbuf_data *data = user_data;
+
+	if (data->fd >= 0)
+		close(data->fd);
+
+	ringbuf_free(data->ringbuf);
+	free(data);
+}
+
+static void bench_ringbuf_printf(void *user_data)
+{
+	struct ringbuf_data *data = user_data;
+
+	if (ringbuf_avail(data->ringbuf) < 64)
+		ringbuf_drain(data->ringbuf, ringbuf_len(data->ringbuf));
+
+	ringbuf_printf(data->ringbuf, "%s %u 0x%04x\n", "bench", 42, 0x1234);
+}
+
+static void bench_ringbuf_write(void *user_data)
+{
+	struct ringbuf_data *data = user_data;
+
+	ringbuf_printf(data->ringbuf, "%s %u 0x%04x\n", "bench", 42, 0x1234);
+	ringbuf_write(data->ringbuf, data->fd);
+}
+
+static void bench_ad_new_with_data(void *data)
+{
+	bt_ad_unref(bt_ad_new_with_data(sizeof(adv_data), adv_data));
+}
+
+static void bench_eir_parse(void *data)
+{
+	struct eir_data eir;
+
+	memset(&eir, 0, sizeof(eir));
+	eir_parse(&eir, adv_data, sizeof(adv_data));
+	eir_data_free(&eir);
+}
+
+struct matcher_data {
+	struct queue *patterns[AD_MONITORS];
+	struct bt_ad_matcher *matcher;
+};
+
+/* One set of patterns per monitor, matching on the vendor data following the
+ * company ID as asset trackers usually do.
+ */
+static void *matcher_setup(void)
+{
+	struct matcher_data *data = new0(struct matcher_data, 1);
+	unsigned int i;
+
+	data->matcher = bt_ad_matcher_new();
+
+	for (i = 0; i < AD_MONITORS; i++) {
+		uint8_t value[] = { i, 0x02 };
+
+		data->patterns[i] = queue_new();
+		queue_push_tail(data->patterns[i],
+				bt_ad_pattern_new(BT_AD_MANUFACTURER_DATA, 2,
+							sizeof(value), value));
+		bt_ad_matcher_add(data->matcher, data->patterns[i],
+							data->patterns[i]);
+	}
+
+	return data;
+}
+
+static void matcher_teardown(void *user_data)
+{
+	struct matcher_data *data = user_data;
+	unsigned int i;
+
+	bt_ad_matcher_free(data->matcher);
+
+	for (i = 0; i < AD_MONITORS; i++)
+		queue_destroy(data->patterns[i], free);
+
+	free(data);
+}
+
+static void bench_ad_pattern_match(void *user_data)
+{
+	struct matcher_data *data = user_data;
+	struct bt_ad *ad;
+	unsigned int i;
+
+	ad = bt_ad_new_with_data(sizeof(adv_data), adv_data);
+
+	for (i = 0; i < AD_MONITORS; i++)
+		bt_ad_pattern_match(ad, data->patterns[i]);
+
+	bt_ad_unref(ad);
+}
+
+static void bench_ad_matcher_match(void *user_data)
+{
+	struct matcher_data *data = user_data;
+
+	bt_ad_matcher_match(data->matcher, adv_data, sizeof(adv_data), NULL,
+									NULL);
+}
+
+struct db_data {
+	struct gatt_db *db;
+	struct queue *queue;
+	uint16_t handle;
+	uint16_t last_handle;
+};
+
+static void *db_setup(void)
+{
+	struct db_data *data = new0(struct db_data, 1);
+	unsigned int i, j;
+
+	data->db = gatt_db_new();
+	data->queue = queue_new();
+
+	for (i = 0; i < DB_SERVICES; i++) {
+		struct gatt_db_attribute *svc;
+		bt_uuid_t uuid;
+
+		bt_uuid16_create(&uuid, 0x1800 + i);
+		svc = gatt_db_add_service(data->db, &uuid, true,
+						1 + DB_CHARACTERISTICS * 2);
+
+		for (j = 0; j < DB_CHARACTERISTICS; j++) {
+			bt_uuid16_create(&uuid, 0x2a00 + j);
+			gatt_db_service_add_characteristic(svc, &uuid,
+						BT_ATT_PERM_READ,
+						BT_GATT_CHRC_PROP_READ,
+						NULL, NULL, NULL);
+		}
+
+		gatt_db_service_set_active(svc, true);
+	}
+
+	data->last_handle = DB_SERVICES * (1 + DB_CHARACTERISTICS * 2);
+
+	return data;
+}
+
+static void db_teardown(void *user_data)
+{
+	struct db_data *data = user_data;
+
+	queue_destroy(data->queue, NULL);
+	gatt_db_unref(data->db);
+	free(data);
+}
+
+static void bench_db_get_attribute(void *user_data)
+{
+	struct db_data *data = user_data;
+
+	if (++data->handle > data->last_handle)
+		data->handle = 1;
+
+	gatt_db_get_attribute(data->db, data->handle);
+}
+
+static void count_attribute(struct gatt_db_attribute *attrib, void *user_data)
+{
+	unsigned int *count = user_data;
+
+	(*count)++;
+}
+
+static void bench_db_find_by_type(void *user_data)
+{
+	struct db_data *data = user_data;
+	unsigned int count = 0;
+	bt_uuid_t uuid;
+
+	bt_uuid16_create(&uuid, GATT_CHARAC_UUID);
+	gatt_db_find_by_type(data->db, 0x0001, 0xffff, &uuid, count_attribute,
+								&count);
+}
+
+static void bench_db_read_by_type(void *user_data)
+{
+	struct db_data *data = user_data;
+	bt_uuid_t uuid;
+
+	bt_uuid16_create(&uuid, 0x2a07);
+	gatt_db_read_by_type(data->db, 0x0001, 0xffff, uuid, data->queue);
+	queue_remove_all(data->queue, NULL, NULL, NULL);
+}
+
+struct att_data {
+	struct bt_att *client;
+	struct bt_att *server;
+	bool done;
+};
+
+static void att_read_req(struct bt_att_chan *chan, uint16_t mtu,
+					uint8_t opcode, const void *pdu,
+					uint16_t length, void *user_data)
+{
+	static const uint8_t value[] = { 0x01, 0x02, 0x03, 0x04, 0x05, 0x06 };
+
+	bt_att_chan_send_rsp(chan, BT_ATT_OP_READ_RSP, value, sizeof(value));
+}
+
+static void att_notify(struct bt_att_chan *chan, uint16_t mtu,
+					uint8_t opcode, const void *pdu,
+					uint16_t length, void *user_data)
+{
+	struct att_data *data = user_data;
+
+	data->done = true;
+}
+
+static void *att_setup(void)
+{
+	struct att_data *data = new0(struct att_data, 1);
+	int fds[2];
+
+	if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds) < 0) {
+		bench_skip("socketpair failed");
+		return data;
+	}
+
+	data->client = bt_att_new(fds[0], false);
+	data->server = bt_att_new(fds[1], false);
+	bt_att_set_close_on_unref(data->client, true);
+	bt_att_set_close_on_unref(data->server, true);
+
+	bt_att_register(data->server, BT_ATT_OP_READ_REQ, att_read_req,
+							data, NULL);
+	bt_att_register(data->client, BT_ATT_OP_HANDLE_NFY, att_notify,
+							data, NULL);
+
+	return data;
+}
+
+static void att_teardown(void *user_data)
+{
+	struct att_data *data = user_data;
+
+	bt_att_unref(data->client);
+	bt_att_unref(data->server);
+	free(data);
+}
+
+static void att_wait(struct att_data *data)
+{
+	while (!data->done)
+		g_main_context_iteration(NULL, TRUE);
+
+	data->done = false;
+}
+
+static void att_read_rsp(uint8_t opcode, const void *pdu, uint16_t length,
+							void *user_data)
+{
+	struct att_data *data = user_data;
+
+	if (opcode != BT_ATT_OP_READ_RSP)
+		bench_skip("unexpected response");
+
+	data->done = true;
+}
+
+static void bench_att_read(void *user_data)
+{
+	struct att_data *data = user_data;
+	uint8_t pdu[2];
+
+	put_le16(0x0003, pdu);
+
+	if (!bt_att_send(data->client, BT_ATT_OP_READ_REQ, pdu, sizeof(pdu),
+						att_read_rsp, data, NULL)) {
+		bench_skip("bt_att_send failed");
+		return;
+	}
+
+	att_wait(data);
+}
+
+static void bench_att_notify(void *user_data)
+{
+	struct att_data *data = user_data;
+	uint8_t pdu[22];
+
+	memset(pdu, 0xaa, sizeof(pdu));
+	put_le16(0x0003, pdu);
+
+	if (!bt_att_send(data->server, BT_ATT_OP_HANDLE_NFY, pdu, sizeof(pdu),
+							NULL, NULL, NULL)) {
+		bench_skip("bt_att_send failed");
+		return;
+	}
+
+	att_wait(data);
+}
+
+struct crypto_data {
+	struct bt_crypto *crypto;
+	struct bt_crypto_key *key;
+};
+
+static const uint8_t crypto_k[16] = {
+	0x9b, 0x7d, 0x39, 0x0a, 0xa6, 0x10, 0x10, 0x34,
+	0x05, 0xad, 0xc8, 0x57, 0xa3, 0x34, 0x02, 0xec,
+};
+
+static void *crypto_setup(void)
+{
+	struct crypto_data *data = new0(struct crypto_data, 1);
+
+	data->crypto = bt_crypto_new();
+	if (!data->crypto) {
+		bench_skip("AF_ALG not available");
+		return data;
+	}
+
+	data->key = bt_crypto_key_new(data->crypto, crypto_k);
+	if (!data->key)
+		bench_skip("AF_ALG not available");
+
+	return data;
+}
+
+static void crypto_teardown(void *user_data)
+{
+	struct crypto_data *data = user_data;
+
+	bt_crypto_key_free(data->key);
+	bt_crypto_unref(data->crypto);
+	free(data);
+}
+
+static void bench_crypto_e(void *user_data)
+{
+	struct crypto_data *data = user_data;
+	uint8_t in[16] = { }, out[16];
+
+	bt_crypto_e(data->crypto, crypto_k, in, out);
+}
+
+static void bench_crypto_key_e(void *user_data)
+{
+	struct crypto_data *data = user_data;
+	uint8_t in[16] = { }, out[16];
+
+	bt_crypto_key_e(data->key, in, out);
+}
+
+static void bench_crypto_ah(void *user_data)
+{
+	struct crypto_data *data = user_data;
+	uint8_t r[3] = { 0x70, 0x81, 0x94 }, hash[3];
+
+	bt_crypto_ah(data->crypto, crypto_k, r, hash);
+}
+
+static void bench_crypto_sih(void *user_data)
+{
+	struct crypto_data *data = user_data;
+	uint8_t r[3] = { 0x70, 0x81, 0x94 }, hash[3];
+
+	bt_crypto_sih(data->crypto, crypto_k, r, hash);
+}
+
+static void bench_crypto_key_sih(void *user_data)
+{
+	struct crypto_data *data = user_data;
+	uint8_t r[3] = { 0x70, 0x81, 0x94 }, hash[3];
+
+	bt_crypto_key_sih(data->key, r, hash);
+}
+
+static void bench_crypto_sign_att(void *user_data)
+{
+	struct crypto_data *data = user_data;
+	uint8_t m[20] = { }, signature[12];
+
+	bt_crypto_sign_att(data->crypto, crypto_k, m, sizeof(m), 1,
+								signature);
+}
+
+struct ecc_data {
+	uint8_t public_key[64];
+	uint8_t private_key[32];
+	uint8_t remote_key[64];
+};
+
+static void *ecc_setup(void)
+{
+	struct ecc_data *data = new0(struct ecc_data, 1);
+	uint8_t remote_private[32];
+
+	if (!ecc_make_key(data->public_key, data->private_key) ||
+			!ecc_make_key(data->remote_key, remote_private))
+		bench_skip("ecc_make_key failed");
+
+	return data;
+}
+
+static void ecc_teardown(void *data)
+{
+	free(data);
+}
+
+static void bench_ecc_make_key(void *user_data)
+{
+	struct ecc_data *data = user_data;
+
+	ecc_make_key(data->public_key, data->private_key);
+}
+
+static void bench_ecdh_shared_secret(void *user_data)
+{
+	struct ecc_data *data = user_data;
+	uint8_t secret[32];
+
+	ecdh_shared_secret(data->remote_key, data->private_key, secret);
+}
+
+int main(int argc, char *argv[])
+{
+	bench_init(&argc, &argv);
+
+	bench_add("queue/push-tail-pop-head", queue_setup,
+				bench_queue_push_pop, queue_teardown);
+	bench_add("queue/find-64", queue_setup, bench_queue_find,
+							queue_teardown);
+	bench_add("queue/foreach-64", queue_setup, bench_queue_foreach,
+							queue_teardown);
+
+	bench_add("ringbuf/printf", ringbuf_setup, bench_ringbuf_printf,
+							ringbuf_teardown);
+	bench_add("ringbuf/printf-write", ringbuf_setup, bench_ringbuf_write,
+							ringbuf_teardown);
+
+	bench_add("ad/new-with-data", NULL, bench_ad_new_with_data, NULL);
+	bench_add("eir/parse", NULL, bench_eir_parse, NULL);
+	bench_add("ad/pattern-match-200", matcher_setup,
+				bench_ad_pattern_match, matcher_teardown);
+	bench_add("ad/matcher-match-200", matcher_setup,
+				bench_ad_matcher_match, matcher_teardown);
+
+	bench_add("gatt-db/get-attribute", db_setup, bench_db_get_attribute,
+								db_teardown);
+	bench_add("gatt-db/find-by-type", db_setup, bench_db_find_by_type,
+								db_teardown);
+	bench_add("gatt-db/read-by-type", db_setup, bench_db_read_by_type,
+								db_teardown);
+
+	bench_add("att/read-roundtrip", att_setup, bench_att_read,
+								att_teardown);
+	bench_add("att/notify", att_setup, bench_att_notify, att_teardown);
+
+	bench_add("crypto/e", crypto_setup, bench_crypto_e, crypto_teardown);
+	bench_add("crypto/key-e", crypto_setup, bench_crypto_key_e,
+							crypto_teardown);
+	bench_add("crypto/ah", crypto_setup, bench_crypto_ah,
+							crypto_teardown);
+	bench_add("crypto/sih", crypto_setup, bench_crypto_sih,
+							crypto_teardown);
+	bench_add("crypto/key-sih", crypto_setup, bench_crypto_key_sih,
+							crypto_teardown);
+	bench_add("crypto/sign-att", crypto_setup, bench_crypto_sign_att,
+							crypto_teardown);
+
+	bench_add("ecc/make-key", ecc_setup, bench_ecc_make_key,
+							ecc_teardown);
+	bench_add("ecc/shared-secret", ecc_setup, bench_ecdh_shared_secret,
+							ecc_teardown);
+
+	return bench_run();
+}
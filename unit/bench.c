@@ -0,0 +1,326 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+
+#include "src/shared/util.h"
+#include "src/shared/queue.h"
+#include "unit/bench.h"
+
+#define BENCH_WARMUP_NSEC	(50 * 1000 * 1000ULL)
+#define BENCH_TARGET_NSEC	(200 * 1000 * 1000ULL)
+#define BENCH_RUNS		5
+
+struct bench_case {
+	char *name;
+	bench_setup_func_t setup_func;
+	bench_func_t func;
+	bench_destroy_func_t destroy;
+	const char *skip;
+	uint64_t iterations;
+	double nsec_op;
+	double allocs_op;
+};
+
+static struct queue *bench_list;
+static struct bench_case *bench_current;
+static const char *option_string;
+static uint64_t option_iterations;
+static bool option_json;
+static bool option_list;
+
+/* Every allocation made by the process goes through these when linked
+ * against glibc, which is what allows reporting allocations per op.
+ */
+static uint64_t bench_allocs;
+static bool bench_allocs_valid;
+
+#ifdef __GLIBC__
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+void *malloc(size_t size)
+{
+	bench_allocs++;
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+	bench_allocs++;
+	return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+	bench_allocs++;
+	return __libc_realloc(ptr, size);
+}
+#endif
+
+static uint64_t bench_nsec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint64_t bench_loop(struct bench_case *bench, void *data,
+							uint64_t iterations)
+{
+	uint64_t start, i;
+
+	start = bench_nsec();
+
+	for (i = 0; i < iterations && !bench->skip; i++)
+		bench->func(data);
+
+	return bench_nsec() - start;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double da = *(const double *) a;
+	double db = *(const double *) b;
+
+	return da < db ? -1 : da > db;
+}
+
+static void bench_measure(struct bench_case *bench)
+{
+	double nsec[BENCH_RUNS];
+	uint64_t elapsed, iterations, allocs;
+	void *data = NULL;
+	unsigned int i;
+
+	bench_current = bench;
+
+	if (bench->setup_func) {
+		data = bench->setup_func();
+		if (bench->skip)
+			goto done;
+	}
+
+	/* Warm up caches and estimate how many iterations fit the target */
+	iterations = 0;
+	elapsed = 0;
+
+	while (elapsed < BENCH_WARMUP_NSEC && !bench->skip) {
+		uint64_t n = iterations ? iterations : 1;
+
+		elapsed += bench_loop(bench, data, n);
+		iterations += n;
+	}
+
+	if (bench->skip)
+		goto done;
+
+	if (option_iterations)
+		iterations = option_iterations;
+	else
+		iterations = MAX(1, BENCH_TARGET_NSEC * iterations /
+							MAX(elapsed, 1));
+
+	allocs = bench_allocs;
+
+	for (i = 0; i < BENCH_RUNS && !bench->skip; i++)
+		nsec[i] = (double) bench_loop(bench, data, iterations) /
+								iterations;
+
+	if (bench->skip)
+		goto done;
+
+	allocs = bench_allocs - allocs;
+
+	/* The median keeps a single noisy run from skewing results */
+	qsort(nsec, BENCH_RUNS, sizeof(*nsec), cmp_double);
+
+	bench->iterations = iterations;
+	bench->nsec_op = nsec[BENCH_RUNS / 2];
+	bench->allocs_op = (double) allocs / (iterations * BENCH_RUNS);
+
+done:
+	if (bench->destroy)
+		bench->destroy(data);
+
+	bench_current = NULL;
+}
+
+static void bench_print(void *data, void *user_data)
+{
+	struct bench_case *bench = data;
+	bool *first = user_data;
+
+	if (option_json) {
+		printf("%s\n  { \"name\": \"%s\", ", *first ? "" : ",",
+								bench->name);
+		if (bench->skip)
+			printf("\"skip\": \"%s\" }", bench->skip);
+		else if (bench_allocs_valid)
+			printf("\"iterations\": %" PRIu64 ", "
+				"\"ns_op\": %.2f, \"allocs_op\": %.2f }",
+				bench->iterations, bench->nsec_op,
+				bench->allocs_op);
+		else
+			printf("\"iterations\": %" PRIu64 ", "
+				"\"ns_op\": %.2f, \"allocs_op\": null }",
+				bench->iterations, bench->nsec_op);
+		*first = false;
+		return;
+	}
+
+	if (bench->skip)
+		printf("%-40s skipped: %s\n", bench->name, bench->skip);
+	else if (bench_allocs_valid)
+		printf("%-40s %12" PRIu64 " %12.2f ns/op %8.2f allocs/op\n",
+				bench->name, bench->iterations,
+				bench->nsec_op, bench->allocs_op);
+	else
+		printf("%-40s %12" PRIu64 " %12.2f ns/op\n", bench->name,
+				bench->iterations, bench->nsec_op);
+}
+
+static void bench_free(void *data)
+{
+	struct bench_case *bench = data;
+
+	free(bench->name);
+	free(bench);
+}
+
+void bench_add(const char *name, bench_setup_func_t setup_func,
+				bench_func_t func, bench_destroy_func_t destroy)
+{
+	struct bench_case *bench;
+
+	if (option_string && !strstr(name, option_string))
+		return;
+
+	if (option_list) {
+		printf("%s\n", name);
+		return;
+	}
+
+	bench = new0(struct bench_case, 1);
+	bench->name = strdup(name);
+	bench->setup_func = setup_func;
+	bench->func = func;
+	bench->destroy = destroy;
+
+	queue_push_tail(bench_list, bench);
+}
+
+void bench_skip(const char *reason)
+{
+	if (bench_current)
+		bench_current->skip = reason;
+}
+
+static void bench_run_one(void *data, void *user_data)
+{
+	bench_measure(data);
+}
+
+int bench_run(void)
+{
+	bool first = true;
+
+	queue_foreach(bench_list, bench_run_one, NULL);
+
+	if (option_json)
+		printf("[");
+
+	queue_foreach(bench_list, bench_print, &first);
+
+	if (option_json)
+		printf("\n]\n");
+
+	queue_destroy(bench_list, bench_free);
+	bench_list = NULL;
+
+	return EXIT_SUCCESS;
+}
+
+static void usage(const char *name)
+{
+	printf("%s - microbenchmarks\n"
+		"Usage:\n"
+		"\t%s [options]\n"
+		"Options:\n"
+		"\t-s, --string <str>      Only run benchmarks matching str\n"
+		"\t-i, --iterations <n>    Use a fixed number of iterations\n"
+		"\t-j, --json              Print results as JSON\n"
+		"\t-l, --list              Only list the benchmarks\n"
+		"\t-h, --help              Show help options\n",
+		name, name);
+}
+
+static const struct option main_options[] = {
+	{ "string",	required_argument,	NULL, 's' },
+	{ "iterations",	required_argument,	NULL, 'i' },
+	{ "json",	no_argument,		NULL, 'j' },
+	{ "list",	no_argument,		NULL, 'l' },
+	{ "help",	no_argument,		NULL, 'h' },
+	{ }
+};
+
+void bench_init(int *argc, char ***argv)
+{
+	void * volatile ptr;
+
+	for (;;) {
+		int opt;
+
+		opt = getopt_long(*argc, *argv, "s:i:jlh", main_options,
+									NULL);
+		if (opt < 0)
+			break;
+
+		switch (opt) {
+		case 's':
+			option_string = optarg;
+			break;
+		case 'i':
+			option_iterations = strtoull(optarg, NULL, 0);
+			break;
+		case 'j':
+			option_json = true;
+			break;
+		case 'l':
+			option_list = true;
+			break;
+		case 'h':
+			usage((*argv)[0]);
+			exit(EXIT_SUCCESS);
+		default:
+			usage((*argv)[0]);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	/* Check that allocations made here are actually being counted */
+	ptr = malloc(1);
+	free(ptr);
+	bench_allocs_valid = bench_allocs > 0;
+
+	bench_list = queue_new();
+}
@@ -0,0 +1,19 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *
+ */
+
+typedef void *(*bench_setup_func_t)(void);
+typedef void (*bench_func_t)(void *data);
+typedef void (*bench_destroy_func_t)(void *data);
+
+void bench_init(int *argc, char ***argv);
+int bench_run(void);
+
+void bench_add(const char *name, bench_setup_func_t setup_func,
+			bench_func_t func, bench_destroy_func_t destroy);
+
+void bench_skip(const char *reason);
@@ -25,6 +25,7 @@
 #include <sys/socket.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <time.h>
 
 #include <glib.h>
 
@@ -1452,6 +1453,161 @@ static void test_ucl_disc(void)
 						DISC_SRC_ASE_LC3);
 }
 
+/* Remote PACS restored from a previous connection: only the ASEs are read
+ * before the session is ready, the PACS values are read afterwards to
+ * revalidate the restored ones. The restored Sink PACs have outdated LC3
+ * capabilities and a vendor codec the remote no longer reports.
+ */
+#define DISC_ASE_RESTORED \
+	IOV_DATA(0x0a, SNK_HND(0)), \
+	IOV_DATA(0x0b, 0x01, 0x00), \
+	IOV_DATA(0x12, SNK_CCC_HND(0), 0x01, 0x00), \
+	IOV_DATA(0x13), \
+	IOV_DATA(0x0a, SNK_HND(1)), \
+	IOV_DATA(0x0b, 0x02, 0x00), \
+	IOV_DATA(0x12, SNK_CCC_HND(1), 0x01, 0x00), \
+	IOV_DATA(0x13), \
+	IOV_DATA(0x0a, SRC_HND(0)), \
+	IOV_DATA(0x0b, 0x03, 0x00), \
+	IOV_DATA(0x12, SRC_CCC_HND(0), 0x01, 0x00), \
+	IOV_DATA(0x13), \
+	IOV_DATA(0x0a, SRC_HND(1)), \
+	IOV_DATA(0x0b, 0x04, 0x00), \
+	IOV_DATA(0x12, SRC_CCC_HND(1), 0x01, 0x00), \
+	IOV_DATA(0x13), \
+	IOV_DATA(0x12, CP_CCC_HND, 0x01, 0x00), \
+	IOV_DATA(0x13), \
+	DISC_SUP_CTX_LC3
+
+static const uint8_t restored_pac[] = { 0x01, LC3_PAC_CAPS(0x03) };
+static const uint8_t restored_snk_pac[] = { 0x02, LC3_PAC_CAPS(0x01),
+				0xff, 0x02, 0x00, 0x01, 0x00, 0x00, 0x00 };
+static const uint8_t revalidated_pac[] = { LC3_PAC_CAPS(0x03) };
+static const uint8_t restored_loc[] = { 0x03, 0x00, 0x00, 0x00 };
+static const uint8_t restored_ctx[] = { 0xff, 0x0f, 0xff, 0x0f };
+static struct timespec restore_start;
+
+static bool pac_restored(struct bt_bap_pac *lpac, struct bt_bap_pac *rpac,
+							void *user_data)
+{
+	bool *found = user_data;
+
+	if (bt_bap_pac_get_locations(rpac) != 0x00000003)
+		return true;
+
+	*found = true;
+
+	return false;
+}
+
+static void bap_ready_restored(struct bt_bap *bap, void *user_data)
+{
+	struct timespec now;
+	bool found = false;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	tester_debug("Time to ready: %ld us",
+			(long) (now.tv_sec - restore_start.tv_sec) * 1000000 +
+			(now.tv_nsec - restore_start.tv_nsec) / 1000);
+
+	/* Restored PACs shall be usable before they are read again */
+	bt_bap_foreach_pac(bap, BT_BAP_SINK, pac_restored, &found);
+	if (!found)
+		FAIL_TEST();
+}
+
+static bool pac_revalidated(struct bt_bap_pac *lpac, struct bt_bap_pac *rpac,
+							void *user_data)
+{
+	struct iovec *caps = bt_bap_pac_get_data(rpac);
+	bool *replaced = user_data;
+
+	/* Skip the codec ID and capabilities length */
+	*replaced = caps->iov_len == revalidated_pac[5] &&
+			!memcmp(caps->iov_base, revalidated_pac + 6,
+							caps->iov_len);
+
+	return false;
+}
+
+static void pac_removed_restored(struct bt_bap_pac *pac, void *user_data)
+{
+	struct test_data *data = user_data;
+	bool replaced = false;
+	uint8_t id;
+
+	/* Only the vendor codec is gone after revalidation */
+	bt_bap_pac_get_codec(pac, &id, NULL, NULL);
+	if (id != 0xff) {
+		FAIL_TEST();
+		return;
+	}
+
+	/* Restored LC3 capabilities are replaced, not merged */
+	bt_bap_foreach_pac(data->bap, BT_BAP_SINK, pac_revalidated, &replaced);
+	if (!replaced) {
+		FAIL_TEST();
+		return;
+	}
+
+	tester_test_passed();
+}
+
+static void test_client_restored(const void *user_data)
+{
+	struct test_data *data = (void *)user_data;
+	struct io *io;
+
+	io = tester_setup_io(data->iov, data->iovcnt);
+	g_assert(io);
+
+	data->db = gatt_db_new();
+	g_assert(data->db);
+
+	test_setup_pacs(data);
+
+	data->bap = bt_bap_new(data->db, bt_gatt_client_get_db(data->client));
+	g_assert(data->bap);
+
+	bt_bap_set_debug(data->bap, print_debug, "bt_bap:", NULL);
+
+	/* The test passes once revalidation has dropped the vendor codec */
+	bt_bap_pac_register(data->bap, NULL, pac_removed_restored, data, NULL);
+
+	g_assert(bt_bap_restore_pacs(data->bap, PAC_SINK_CHRC_UUID,
+				restored_snk_pac, sizeof(restored_snk_pac)));
+	g_assert(bt_bap_restore_pacs(data->bap, PAC_SINK_LOC_CHRC_UUID,
+					restored_loc, sizeof(restored_loc)));
+	g_assert(bt_bap_restore_pacs(data->bap, PAC_SOURCE_CHRC_UUID,
+					restored_pac, sizeof(restored_pac)));
+	g_assert(bt_bap_restore_pacs(data->bap, PAC_SOURCE_LOC_CHRC_UUID,
+					restored_loc, sizeof(restored_loc)));
+	g_assert(bt_bap_restore_pacs(data->bap, PAC_CONTEXT,
+					restored_ctx, sizeof(restored_ctx)));
+	g_assert(bt_bap_restore_pacs(data->bap, PAC_SUPPORTED_CONTEXT,
+					restored_ctx, sizeof(restored_ctx)));
+
+	bt_bap_ready_register(data->bap, bap_ready_restored, data, NULL);
+
+	clock_gettime(CLOCK_MONOTONIC, &restore_start);
+
+	bt_bap_attach(data->bap, data->client);
+}
+
+static struct test_config cfg_restored = {
+	.snk = true,
+};
+
+static void test_ucl_restored(void)
+{
+	/* Reconnect to a bonded device with the PACS values restored from
+	 * the previous connection.
+	 */
+	define_test("BAP/UCL/DISC/RESTORED", test_setup, test_client_restored,
+					&cfg_restored, DISC_ASE_RESTORED);
+}
+
 static void server_state_changed(struct bt_bap_stream *stream,
 					uint8_t old_state, uint8_t new_state,
 					void *user_data)
@@ -1571,6 +1727,7 @@ static void test_usr_disc(void)
 static void test_disc(void)
 {
 	test_ucl_disc();
+	test_ucl_restored();
 	test_usr_disc();
 }
 
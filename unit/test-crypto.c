@@ -383,6 +383,55 @@ static void test_sih(const void *data)
 	tester_test_passed();
 }
 
+static void test_key_sih(const void *data)
+{
+	const uint8_t k[16] = {
+			0xcd, 0xcc, 0x72, 0xdd, 0x86, 0x8c, 0xcd, 0xce,
+			0x22, 0xfd, 0xa1, 0x21, 0x09, 0x7d, 0x7d, 0x45 };
+	const uint8_t r[3] = { 0x63, 0xf5, 0x69 };
+	const uint8_t exp[3] = { 0xda, 0x48, 0x19 };
+	struct bt_crypto_key *key;
+	uint8_t hash[3], other[3];
+	int i;
+
+	key = bt_crypto_key_new(crypto, k);
+	if (!key) {
+		tester_test_failed();
+		return;
+	}
+
+	/* The keyed context must give the same result on every use */
+	for (i = 0; i < 3; i++) {
+		if (!bt_crypto_key_sih(key, r, hash)) {
+			bt_crypto_key_free(key);
+			tester_test_failed();
+			return;
+		}
+
+		tester_debug("Result:");
+		util_hexdump(' ', hash, 3, print_debug, NULL);
+
+		if (memcmp(hash, exp, 3)) {
+			bt_crypto_key_free(key);
+			tester_test_failed();
+			return;
+		}
+	}
+
+	/* And match the unkeyed function for a different prand */
+	if (!bt_crypto_key_sih(key, exp, hash) ||
+				!bt_crypto_sih(crypto, k, exp, other) ||
+				memcmp(hash, other, 3)) {
+		bt_crypto_key_free(key);
+		tester_test_failed();
+		return;
+	}
+
+	bt_crypto_key_free(key);
+
+	tester_test_passed();
+}
+
 int main(int argc, char *argv[])
 {
 	int exit_status;
@@ -411,6 +460,7 @@ int main(int argc, char *argv[])
 						NULL, test_verify_sign, NULL);
 	tester_add("/crypto/sef", NULL, NULL, test_sef, NULL);
 	tester_add("/crypto/sih", NULL, NULL, test_sih, NULL);
+	tester_add("/crypto/key_sih", NULL, NULL, test_key_sih, NULL);
 
 	exit_status = tester_run();
 
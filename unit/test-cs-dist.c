@@ -0,0 +1,241 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <glib.h>
+
+#include "bluetooth/bluetooth.h"
+
+#include "src/shared/util.h"
+#include "src/shared/rap.h"
+#include "src/shared/cs-dist.h"
+#include "src/shared/tester.h"
+
+#define SPEED_OF_LIGHT		299792458.0
+#define TONE_AMPLITUDE		1000.0
+#define TURNAROUND_TIME		160	/* 80 us in 0.5 ns units */
+
+struct dist_data {
+	double distance;
+	uint8_t mode;
+	uint8_t num_paths;
+	unsigned int chunk;	/* Reflector steps per report, 0 for all */
+	double tolerance;
+};
+
+/* Generates the tones and timings both sides would report for a procedure
+ * hopping over channels 2 to 75, with a random local oscillator phase per
+ * step and a fixed phase per antenna path.
+ */
+static void generate_steps(const struct dist_data *data,
+				struct cs_step_data *init,
+				struct cs_step_data *refl, unsigned int count)
+{
+	unsigned int i, p;
+
+	memset(init, 0, count * sizeof(*init));
+	memset(refl, 0, count * sizeof(*refl));
+
+	for (i = 0; i < count; i++) {
+		uint8_t channel = 2 + (i * 31) % 74;
+		double freq = 2402e6 + channel * 1e6;
+		double phase = -2 * M_PI * freq * data->distance /
+							SPEED_OF_LIGHT;
+		double offset = g_random_double_range(-M_PI, M_PI);
+		struct cs_mode_one_data *one_i = NULL, *one_r = NULL;
+		struct cs_mode_two_data *two_i = NULL, *two_r = NULL;
+		int16_t tof;
+
+		init[i].step_mode = data->mode;
+		init[i].step_chnl = channel;
+		refl[i].step_mode = data->mode;
+		refl[i].step_chnl = 0xff;
+
+		switch (data->mode) {
+		case CS_MODE_ONE:
+			one_i = &init[i].step_mode_data.mode_one_data;
+			one_r = &refl[i].step_mode_data.mode_one_data;
+			break;
+		case CS_MODE_TWO:
+			two_i = &init[i].step_mode_data.mode_two_data;
+			two_r = &refl[i].step_mode_data.mode_two_data;
+			break;
+		case CS_MODE_THREE:
+			one_i = &init[i].step_mode_data.mode_three_data
+							.mode_one_data;
+			one_r = &refl[i].step_mode_data.mode_three_data
+							.mode_one_data;
+			two_i = &init[i].step_mode_data.mode_three_data
+							.mode_two_data;
+			two_r = &refl[i].step_mode_data.mode_three_data
+							.mode_two_data;
+			break;
+		}
+
+		if (one_i) {
+			tof = lround(4e9 * data->distance / SPEED_OF_LIGHT);
+			one_i->toa_tod_init = TURNAROUND_TIME + tof;
+			one_r->tod_toa_refl = TURNAROUND_TIME;
+		}
+
+		if (!two_i)
+			continue;
+
+		for (p = 0; p < data->num_paths; p++) {
+			double path = p * 0.7;
+
+			two_i->tone_pct[p].i_sample = TONE_AMPLITUDE *
+					cos(phase + offset + path);
+			two_i->tone_pct[p].q_sample = TONE_AMPLITUDE *
+					sin(phase + offset + path);
+			two_r->tone_pct[p].i_sample = TONE_AMPLITUDE *
+					cos(phase - offset + path);
+			two_r->tone_pct[p].q_sample = TONE_AMPLITUDE *
+					sin(phase - offset + path);
+		}
+	}
+}
+
+static void test_distance(const void *user_data)
+{
+	const struct dist_data *data = user_data;
+	struct cs_step_data init[CS_MAX_STEPS], refl[CS_MAX_STEPS];
+	struct bt_cs_dist_result result;
+	struct bt_cs_dist *dist;
+	unsigned int i, chunk;
+
+	generate_steps(data, init, refl, CS_MAX_STEPS);
+
+	dist = bt_cs_dist_new();
+
+	/* Reflector results arrive over RAS in several pieces, part of them
+	 * before the local results for the same steps.
+	 */
+	chunk = data->chunk ? data->chunk : CS_MAX_STEPS;
+
+	for (i = 0; i < CS_MAX_STEPS; i += chunk) {
+		unsigned int n = MIN(chunk, CS_MAX_STEPS - i);
+
+		bt_cs_dist_add_steps(dist, BT_CS_DIST_REFLECTOR, refl + i, n,
+							data->num_paths);
+
+		if (i + n >= CS_MAX_STEPS / 2 && i < CS_MAX_STEPS / 2)
+			bt_cs_dist_add_steps(dist, BT_CS_DIST_INITIATOR,
+						init, CS_MAX_STEPS / 2,
+						data->num_paths);
+	}
+
+	bt_cs_dist_add_steps(dist, BT_CS_DIST_INITIATOR,
+					init + CS_MAX_STEPS / 2,
+					CS_MAX_STEPS - CS_MAX_STEPS / 2,
+					data->num_paths);
+
+	g_assert(bt_cs_dist_estimate(dist, &result));
+
+	tester_debug("Distance %.3f m (phase %.3f m, rtt %.3f m, "
+			"quality %.2f, tones %u, rtt %u)",
+			result.distance, result.phase_distance,
+			result.rtt_distance, result.quality,
+			result.num_tones, result.num_rtt);
+
+	g_assert(fabs(result.distance - data->distance) < data->tolerance);
+
+	bt_cs_dist_reset(dist);
+	g_assert(!bt_cs_dist_estimate(dist, &result));
+
+	bt_cs_dist_free(dist);
+
+	tester_test_passed();
+}
+
+static void test_mismatch(const void *user_data)
+{
+	const struct dist_data *data = user_data;
+	struct cs_step_data init[CS_MAX_STEPS], refl[CS_MAX_STEPS];
+	struct bt_cs_dist_result result;
+	struct bt_cs_dist *dist;
+
+	generate_steps(data, init, refl, CS_MAX_STEPS);
+
+	dist = bt_cs_dist_new();
+
+	/* Steps out of alignment carry no usable phase relation */
+	bt_cs_dist_add_steps(dist, BT_CS_DIST_INITIATOR, init + 1,
+					CS_MAX_STEPS - 1, data->num_paths);
+	bt_cs_dist_add_steps(dist, BT_CS_DIST_REFLECTOR, refl,
+					CS_MAX_STEPS - 1, data->num_paths);
+
+	g_assert(!bt_cs_dist_estimate(dist, &result));
+	g_assert(result.quality < 0.2);
+
+	bt_cs_dist_free(dist);
+
+	tester_test_passed();
+}
+
+static const struct dist_data phase_1m = {
+	.distance = 1.5,
+	.mode = CS_MODE_TWO,
+	.num_paths = 1,
+	.tolerance = 0.05,
+};
+
+static const struct dist_data phase_40m = {
+	.distance = 42.7,
+	.mode = CS_MODE_TWO,
+	.num_paths = 4,
+	.tolerance = 0.05,
+};
+
+static const struct dist_data phase_chunks = {
+	.distance = 12.3,
+	.mode = CS_MODE_TWO,
+	.num_paths = 2,
+	.chunk = 7,
+	.tolerance = 0.05,
+};
+
+static const struct dist_data rtt_30m = {
+	.distance = 30.0,
+	.mode = CS_MODE_ONE,
+	.tolerance = 0.2,
+};
+
+static const struct dist_data mode3_200m = {
+	.distance = 200.0,
+	.mode = CS_MODE_THREE,
+	.num_paths = 2,
+	.chunk = 16,
+	.tolerance = 0.05,
+};
+
+int main(int argc, char *argv[])
+{
+	tester_init(&argc, &argv);
+
+	tester_add("/cs-dist/phase/1m", &phase_1m, NULL, test_distance,
+									NULL);
+	tester_add("/cs-dist/phase/40m", &phase_40m, NULL, test_distance,
+									NULL);
+	tester_add("/cs-dist/phase/chunks", &phase_chunks, NULL,
+							test_distance, NULL);
+	tester_add("/cs-dist/rtt/30m", &rtt_30m, NULL, test_distance, NULL);
+	tester_add("/cs-dist/mode3/200m", &mode3_200m, NULL, test_distance,
+									NULL);
+	tester_add("/cs-dist/mismatch", &phase_40m, NULL, test_mismatch,
+									NULL);
+
+	return tester_run();
+}
@@ -228,6 +228,59 @@ static void test_sample_3(const void *data)
 	tester_test_passed();
 }
 
+static void test_public_key(const void *data)
+{
+	/* Private and public key A from the first sample */
+	uint8_t priv[32] = {	0xbd, 0x1a, 0x3c, 0xcd, 0xa6, 0xb8, 0x99, 0x58,
+				0x99, 0xb7, 0x40, 0xeb, 0x7b, 0x60, 0xff, 0x4a,
+				0x50, 0x3f, 0x10, 0xd2, 0xe3, 0xb3, 0xc9, 0x74,
+				0x38, 0x5f, 0xc5, 0xa3, 0xd4, 0xf6, 0x49, 0x3f,
+	};
+	uint8_t pub[64] = {	0xe6, 0x9d, 0x35, 0x0e, 0x48, 0x01, 0x03, 0xcc,
+				0xdb, 0xfd, 0xf4, 0xac, 0x11, 0x91, 0xf4, 0xef,
+				0xb9, 0xa5, 0xf9, 0xe9, 0xa7, 0x83, 0x2c, 0x5e,
+				0x2c, 0xbe, 0x97, 0xf2, 0xd2, 0x03, 0xb0, 0x20,
+
+				0x8b, 0xd2, 0x89, 0x15, 0xd0, 0x8e, 0x1c, 0x74,
+				0x24, 0x30, 0xed, 0x8f, 0xc2, 0x45, 0x63, 0x76,
+				0x5c, 0x15, 0x52, 0x5a, 0xbf, 0x9a, 0x32, 0x63,
+				0x6d, 0xeb, 0x2a, 0x65, 0x49, 0x9c, 0x80, 0xdc,
+	};
+	/* n - 1, whose public key is -G */
+	uint8_t priv_max[32] = {0x50, 0x25, 0x63, 0xfc, 0xc2, 0xca, 0xb9, 0xf3,
+				0x84, 0x9e, 0x17, 0xa7, 0xad, 0xfa, 0xe6, 0xbc,
+				0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+				0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff,
+	};
+	uint8_t pub_max[64] = {	0x96, 0xc2, 0x98, 0xd8, 0x45, 0x39, 0xa1, 0xf4,
+				0xa0, 0x33, 0xeb, 0x2d, 0x81, 0x7d, 0x03, 0x77,
+				0xf2, 0x40, 0xa4, 0x63, 0xe5, 0xe6, 0xbc, 0xf8,
+				0x47, 0x42, 0x2c, 0xe1, 0xf2, 0xd1, 0x17, 0x6b,
+
+				0x0a, 0xae, 0x40, 0xc8, 0x97, 0xbf, 0x49, 0x34,
+				0x31, 0xa1, 0xce, 0x94, 0xa9, 0xcc, 0x31, 0xd4,
+				0xe9, 0x61, 0xf0, 0x83, 0xb5, 0x14, 0x18, 0x71,
+				0x65, 0x80, 0xe5, 0x01, 0x1c, 0xbd, 0x1c, 0xb0,
+	};
+	uint8_t result[64];
+
+	g_assert(ecc_make_public_key(priv, result));
+
+	if (g_test_verbose())
+		print_buf("Public key", result, sizeof(result));
+
+	g_assert(memcmp(result, pub, sizeof(pub)) == 0);
+
+	g_assert(ecc_make_public_key(priv_max, result));
+	g_assert(memcmp(result, pub_max, sizeof(pub_max)) == 0);
+
+	/* Private keys not below n are rejected */
+	priv_max[0]++;
+	g_assert(!ecc_make_public_key(priv_max, result));
+
+	tester_test_passed();
+}
+
 static void test_invalid_pub(const void *data)
 {
 	uint8_t priv_a[32] = {	0xbd, 0x1a, 0x3c, 0xcd, 0xa6, 0xb8, 0x99, 0x58,
@@ -271,6 +324,8 @@ int main(int argc, char *argv[])
 	tester_add("/ecdh/sample/2", NULL, NULL, test_sample_2, NULL);
 	tester_add("/ecdh/sample/3", NULL, NULL, test_sample_3, NULL);
 
+	tester_add("/ecdh/public-key", NULL, NULL, test_public_key, NULL);
+
 	tester_add("/ecdh/invalid", NULL, NULL, test_invalid_pub, NULL);
 
 	return tester_run();
@@ -735,6 +735,110 @@ static const struct test_data uri_beacon_test = {
 	.uuid = uri_beacon_uuid,
 };
 
+static const uint8_t matcher_data[] = {
+		0x02, 0x01, 0x06,
+		0x05, 0xff, 0x4c, 0x00, 0xaa, 0xbb,
+		0x05, 0x16, 0xd8, 0xfe, 0x01, 0x02,
+		0x04, 0x09, 'F', 'o', 'o',
+};
+
+static void matcher_collect(void *match_data, void *user_data)
+{
+	unsigned int *matched = user_data;
+
+	*matched |= PTR_TO_UINT(match_data);
+}
+
+static struct queue *matcher_patterns(const struct bt_ad_pattern *patterns,
+							unsigned int count)
+{
+	struct queue *queue = queue_new();
+	unsigned int i;
+
+	for (i = 0; i < count; i++)
+		queue_push_tail(queue, bt_ad_pattern_new(patterns[i].type,
+							patterns[i].offset,
+							patterns[i].len,
+							patterns[i].data));
+
+	return queue;
+}
+
+static void test_matcher(const void *data)
+{
+	static const struct bt_ad_pattern manufacturer[] = {
+		{ BT_AD_MANUFACTURER_DATA, 0, 2, { 0x4c, 0x00 } },
+	};
+	static const struct bt_ad_pattern service[] = {
+		{ BT_AD_SERVICE_DATA128, 1, 1, { 0x02 } },
+	};
+	static const struct bt_ad_pattern both[] = {
+		{ BT_AD_NAME_COMPLETE, 0, 3, { 'F', 'o', 'o' } },
+		{ BT_AD_MANUFACTURER_DATA, 2, 1, { 0xaa } },
+	};
+	static const struct bt_ad_pattern none[] = {
+		{ BT_AD_MANUFACTURER_DATA, 2, 2, { 0xaa, 0xcc } },
+		{ BT_AD_MANUFACTURER_DATA, 4, 1, { 0xbb } },
+		{ BT_AD_NAME_SHORT, 0, 3, { 'F', 'o', 'o' } },
+	};
+	struct queue *patterns[4];
+	struct bt_ad_matcher *matcher;
+	struct bt_ad *ad;
+	unsigned int matched, i;
+
+	patterns[0] = matcher_patterns(manufacturer,
+						G_N_ELEMENTS(manufacturer));
+	patterns[1] = matcher_patterns(service, G_N_ELEMENTS(service));
+	patterns[2] = matcher_patterns(both, G_N_ELEMENTS(both));
+	patterns[3] = matcher_patterns(none, G_N_ELEMENTS(none));
+
+	matcher = bt_ad_matcher_new();
+
+	for (i = 0; i < G_N_ELEMENTS(patterns); i++)
+		g_assert(bt_ad_matcher_add(matcher, patterns[i],
+							UINT_TO_PTR(1 << i)));
+
+	g_assert(!bt_ad_matcher_add(matcher, patterns[0], UINT_TO_PTR(1)));
+
+	/* Each set is reported once even if several of its patterns match */
+	matched = 0;
+	g_assert_cmpint(bt_ad_matcher_match(matcher, matcher_data,
+					sizeof(matcher_data), matcher_collect,
+					&matched), ==, 3);
+	g_assert_cmpint(matched, ==, 0x7);
+
+	/* Results must agree with matching a parsed bt_ad */
+	ad = bt_ad_new_with_data(sizeof(matcher_data), matcher_data);
+	g_assert(ad);
+	g_assert(bt_ad_pattern_match(ad, patterns[0]));
+	g_assert(bt_ad_pattern_match(ad, patterns[1]));
+	g_assert(!bt_ad_pattern_match(ad, patterns[3]));
+	bt_ad_unref(ad);
+
+	g_assert(bt_ad_matcher_remove(matcher, UINT_TO_PTR(1)));
+	g_assert(!bt_ad_matcher_remove(matcher, UINT_TO_PTR(1)));
+
+	matched = 0;
+	g_assert_cmpint(bt_ad_matcher_match(matcher, matcher_data,
+					sizeof(matcher_data), matcher_collect,
+					&matched), ==, 2);
+	g_assert_cmpint(matched, ==, 0x6);
+
+	/* Elements past a truncated one are not looked at */
+	matched = 0;
+	g_assert_cmpint(bt_ad_matcher_match(matcher, matcher_data,
+					sizeof(matcher_data) - 6,
+					matcher_collect, &matched), ==, 1);
+	g_assert_cmpint(matched, ==, 0x4);
+
+	bt_ad_matcher_free(matcher);
+
+	for (i = 0; i < G_N_ELEMENTS(patterns); i++)
+		queue_destroy(patterns[i], free);
+
+	tester_test_passed();
+}
+
 int main(int argc, char *argv[])
 {
 	tester_init(&argc, &argv);
@@ -767,5 +871,7 @@ int main(int argc, char *argv[])
 	tester_add("ad/g-tag", &gigaset_gtag_test, NULL, test_parsing, NULL);
 	tester_add("ad/uri-beacon", &uri_beacon_test, NULL, test_parsing, NULL);
 
+	tester_add("/ad/matcher", NULL, NULL, test_matcher, NULL);
+
 	return tester_run();
 }
@@ -604,6 +604,70 @@ static void test_midi_writer(gconstpointer data)
 	tester_test_passed();
 }
 
+struct midi_clock_test {
+	int drift_ppm;
+	int64_t interval;
+	int64_t latency;
+	guint32 seed;
+};
+
+static const struct midi_clock_test clock1 = {
+	.drift_ppm = 300,
+	.interval = 7500,
+	.latency = 3000,
+	.seed = 0x4d494449,
+};
+
+static const struct midi_clock_test clock2 = {
+	.drift_ppm = -300,
+	.interval = 15000,
+	.latency = 3000,
+	.seed = 0x636c6b32,
+};
+
+/* Events sent at random times are delivered batched at the end of each
+   connection interval, the recovered send time has to remove that jitter
+   leaving only the millisecond resolution of BLE-MIDI timestamps. The send
+   times come from a fixed seed so that every run checks the same ones. */
+static void test_midi_clock(gconstpointer data)
+{
+	const struct midi_clock_test *clock_test = data;
+	struct midi_clock clock;
+	int64_t min_err = INT64_MAX, max_err = INT64_MIN;
+	int64_t t;
+	GRand *rng;
+
+	midi_clock_reset(&clock);
+	rng = g_rand_new_with_seed(clock_test->seed);
+
+	for (t = clock_test->interval; t < 60 * 1000000;
+	                                        t += clock_test->interval) {
+		int64_t send = t - g_rand_int_range(rng, 0,
+		                                    clock_test->interval);
+		int64_t remote = send + send * clock_test->drift_ppm / 1000000;
+		int64_t err;
+
+		err = midi_clock_update(&clock, t + clock_test->latency,
+		                        (remote / 1000) & MIDI_MAX_TIMESTAMP) -
+		                                                        send;
+
+		/* Allow the estimate to settle */
+		if (t < 2 * 1000000)
+			continue;
+
+		min_err = MIN(min_err, err);
+		max_err = MAX(max_err, err);
+	}
+
+	g_rand_free(rng);
+
+	g_assert_cmpint(min_err, >=, 0);
+	g_assert_cmpint(max_err, <=, clock_test->latency + 2000);
+	g_assert_cmpint(max_err - min_err, <=, 2500);
+
+	tester_test_passed();
+}
+
 int main(int argc, char *argv[])
 {
 	tester_init(&argc, &argv);
@@ -618,6 +682,10 @@ int main(int argc, char *argv[])
 	           &midi4, NULL, test_midi_writer, NULL);
 	tester_add("Split ALSA SysEx events to raw BLE packets",
 	           &midi5, NULL, test_midi_writer, NULL);
+	tester_add("BLE-MIDI clock recovery with faster remote clock",
+	           &clock1, NULL, test_midi_clock, NULL);
+	tester_add("BLE-MIDI clock recovery with slower remote clock",
+	           &clock2, NULL, test_midi_clock, NULL);
 
 	return tester_run();
 }
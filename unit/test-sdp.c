@@ -633,6 +633,23 @@ static void register_file_transfer(void)
 	update_db_timestamp();
 }
 
+static void register_services(void)
+{
+	set_fixed_db_timestamp(0x496f0654);
+
+	register_public_browse_group();
+	register_server_service();
+
+	register_serial_port();
+	register_object_push();
+	register_hid_keyboard();
+	register_file_transfer();
+	register_file_transfer();
+	register_file_transfer();
+	register_file_transfer();
+	register_file_transfer();
+}
+
 static struct context *create_context(gconstpointer data)
 {
 	struct context *context = g_new0(struct context, 1);
@@ -671,19 +688,7 @@ static struct context *create_context(gconstpointer data)
 	context->fd = sv[1];
 	context->data = data;
 
-	set_fixed_db_timestamp(0x496f0654);
-
-	register_public_browse_group();
-	register_server_service();
-
-	register_serial_port();
-	register_object_push();
-	register_hid_keyboard();
-	register_file_transfer();
-	register_file_transfer();
-	register_file_transfer();
-	register_file_transfer();
-	register_file_transfer();
+	register_services();
 
 	return context;
 }
@@ -757,6 +762,60 @@ static void test_sdp_de_attr(gconstpointer data)
 	tester_test_passed();
 }
 
+#define BENCHMARK_RECORDS	64
+#define BENCHMARK_REQUESTS	2000
+
+/*
+ * Measure the ServiceSearchAttribute throughput of the server when
+ * answering the browse of a phone against a populated database.
+ */
+static void test_sdp_benchmark(gconstpointer data)
+{
+	static const uint8_t req[] = {
+		0x06, 0x00, 0x01, 0x00, 0x0f, 0x35, 0x03, 0x19,
+		0x01, 0x00, 0x02, 0x90, 0x35, 0x05, 0x0a, 0x00,
+		0x00, 0xff, 0xff, 0x00 };
+	unsigned char buf[1024];
+	int64_t start, elapsed;
+	ssize_t len;
+	int err, sv[2];
+	int i;
+
+	err = socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv);
+	g_assert(err == 0);
+
+	register_services();
+
+	for (i = 0; i < BENCHMARK_RECORDS; i++)
+		register_file_transfer();
+
+	start = g_get_monotonic_time();
+
+	for (i = 0; i < BENCHMARK_REQUESTS; i++) {
+		handle_internal_request(sv[0], 672, util_memdup(req,
+							sizeof(req)),
+							sizeof(req));
+
+		len = read(sv[1], buf, sizeof(buf));
+		g_assert(len > (ssize_t) sizeof(sdp_pdu_hdr_t));
+		g_assert_cmpuint(buf[0], ==, SDP_SVC_SEARCH_ATTR_RSP);
+	}
+
+	elapsed = g_get_monotonic_time() - start;
+
+	tester_debug("%u requests in %" G_GINT64_FORMAT " us (%.0f req/s)",
+			BENCHMARK_REQUESTS, elapsed,
+			BENCHMARK_REQUESTS * 1000000.0 / MAX(elapsed, 1));
+
+	sdp_cstate_cleanup(sv[0]);
+	sdp_svcdb_reset();
+
+	close(sv[0]);
+	close(sv[1]);
+
+	tester_test_passed();
+}
+
 int main(int argc, char *argv[])
 {
 	tester_init(&argc, &argv);
@@ -2813,5 +2872,8 @@ int main(int argc, char *argv[])
 				0x00, 0x09, 0x00, 0x01, 0x08),
 		raw_pdu(0x01, 0x00, 0x02, 0x00, 0x02, 0x00, 0x05));
 
+	tester_add("/sdp/benchmark/SSA", NULL, NULL, test_sdp_benchmark,
+									NULL);
+
 	return tester_run();
 }